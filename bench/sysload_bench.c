@@ -0,0 +1,722 @@
+/**
+ * Microbenchmark for sysload collectors.
+ * Reports mean, p50 and p99 wall time, syscalls and heap allocations per
+ * call for the legacy stdio reader, the one-shot API and the persistent
+ * sampler against live /proc, then the same collectors and the parsers
+ * alone against recorded fixtures. --json prints one machine-readable
+ * document instead, for tracking results across releases.
+ * Run with: ./sysload_bench [--json] [iterations]
+ */
+
+#include "sysload.h"
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+/* ------------------- Syscall and allocation counting shim ---- */
+/* Linked with -Wl,--wrap=<fn> so calls made by the library land here */
+
+static uint64_t g_syscalls = 0;
+static uint64_t g_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+int __real_open(const char *path, int flags, ...);
+int __real_openat(int dirfd, const char *path, int flags, ...);
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t __real_read(int fd, void *buf, size_t count);
+int __real_close(int fd);
+int __real_statvfs(const char *path, struct statvfs *buf);
+long __real_syscall(long number, long a1, long a2, long a3, long a4, long a5, long a6);
+
+int __wrap_open(const char *path, int flags, ...)
+{
+        mode_t mode = 0;
+        if (flags & O_CREAT) {
+                va_list args;
+                va_start(args, flags);
+                mode = (mode_t)va_arg(args, int);
+                va_end(args);
+        }
+        g_syscalls++;
+        return __real_open(path, flags, mode);
+}
+
+int __wrap_openat(int dirfd, const char *path, int flags, ...)
+{
+        mode_t mode = 0;
+        if (flags & O_CREAT) {
+                va_list args;
+                va_start(args, flags);
+                mode = (mode_t)va_arg(args, int);
+                va_end(args);
+        }
+        g_syscalls++;
+        return __real_openat(dirfd, path, flags, mode);
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t count, off_t offset)
+{
+        g_syscalls++;
+        return __real_pread(fd, buf, count, offset);
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t count)
+{
+        g_syscalls++;
+        return __real_read(fd, buf, count);
+}
+
+int __wrap_close(int fd)
+{
+        g_syscalls++;
+        return __real_close(fd);
+}
+
+int __wrap_statvfs(const char *path, struct statvfs *buf)
+{
+        g_syscalls++;
+        return __real_statvfs(path, buf);
+}
+
+/* Raw syscalls (io_uring_setup/enter, getdents64); six argument registers are forwarded */
+long __wrap_syscall(long number, long a1, long a2, long a3, long a4, long a5, long a6)
+{
+        g_syscalls++;
+        return __real_syscall(number, a1, a2, a3, a4, a5, a6);
+}
+
+void *__wrap_malloc(size_t size)
+{
+        g_allocs++;
+        return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+        g_allocs++;
+        return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+        g_allocs++;
+        return __real_realloc(ptr, size);
+}
+
+/* ------------------- Legacy stdio reader --------------------- */
+/* fopen/fscanf/fclose path used before the sampler API existed */
+
+static int legacy_cpu_get_raw(sl_cpu_raw_t *s)
+{
+        FILE *f = fopen("/proc/stat", "r");
+        if (!f) return -1;
+        int ret = fscanf(f, "%*s %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+                            " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                         &s->user, &s->nice, &s->system, &s->idle,
+                         &s->iowait, &s->irq, &s->softirq, &s->steal);
+        fclose(f);
+        return ret == 8 ? 0 : -1;
+}
+
+static int legacy_systime_get_info(sl_systime_info_t *r)
+{
+        FILE *f = fopen("/proc/uptime", "r");
+        if (!f) return -1;
+        int ret = fscanf(f, "%lf %lf", &r->uptime, &r->idle_time);
+        fclose(f);
+        return ret == 2 ? 0 : -1;
+}
+
+/* sscanf-per-line meminfo parser used before the hand-written tokenizer */
+static int legacy_parse_meminfo(const char *buf, sl_mem_info_t *result)
+{
+        const struct { const char *key; uint64_t *field; } fields[] = {
+                {"MemTotal",     &result->total},
+                {"MemFree",      &result->free},
+                {"MemAvailable", &result->available},
+                {"Buffers",      &result->buffers},
+                {"Cached",       &result->cached},
+                {"Shmem",        &result->shared},
+                {"SwapTotal",    &result->swap_total},
+                {"SwapFree",     &result->swap_free},
+        };
+
+        memset(result, 0, sizeof(*result));
+        for (const char *line = buf; line && *line; line = strchr(line, '\n')) {
+                if (*line == '\n') line++;
+
+                char key[MEMINFO_KEY_SIZE];
+                uint64_t value;
+                if (sscanf(line, "%31[^:]: %" SCNu64, key, &value) != 2) continue;
+
+                for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+                        if (strcmp(key, fields[i].key) == 0) {
+                                *fields[i].field = value;
+                                break;
+                        }
+                }
+        }
+        return 0;
+}
+
+static int legacy_parse_cpu_raw(const char *buf, sl_cpu_raw_t *s)
+{
+        int ret = sscanf(buf, "%*s %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+                              " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                         &s->user, &s->nice, &s->system, &s->idle,
+                         &s->iowait, &s->irq, &s->softirq, &s->steal);
+        return ret == 8 ? 0 : -1;
+}
+
+/* ------------------- Harness --------------------------------- */
+
+static sl_sampler_t *g_sampler = NULL;
+
+static int run_legacy_cpu(void)     { sl_cpu_raw_t s; return legacy_cpu_get_raw(&s); }
+static int run_legacy_uptime(void)  { sl_systime_info_t r; return legacy_systime_get_info(&r); }
+static int run_oneshot_cpu(void)    { sl_cpu_raw_t s; return sl_cpu_get_raw(&s); }
+static int run_oneshot_mem(void)    { sl_mem_info_t r; return sl_mem_get_info(&r); }
+static int run_oneshot_uptime(void) { sl_systime_info_t r; return sl_systime_get_info(&r); }
+static int run_sampler_cpu(void)    { sl_cpu_raw_t s; return sl_sampler_cpu_get_raw(g_sampler, &s); }
+static int run_sampler_mem(void)    { sl_mem_info_t r; return sl_sampler_mem_get_info(g_sampler, &r); }
+static int run_sampler_uptime(void) { sl_systime_info_t r; return sl_sampler_systime_get_info(g_sampler, &r); }
+
+/* Storage path and counter pair for the statvfs and calculate cases */
+static const char *g_storage_path = "/";
+static sl_cpu_raw_t g_cpu_start, g_cpu_end;
+
+static int run_oneshot_storage(void) { sl_storage_info_t r; return sl_storage_get_info(g_storage_path, &r); }
+static int run_cpu_calculate(void)   { sl_cpu_usage_t r; return sl_cpu_calculate(&g_cpu_start, &g_cpu_end, &r); }
+
+/* End snapshot a few hundred ticks after start, so calculate has an interval */
+static void cpu_pair_from(const sl_cpu_raw_t *start)
+{
+        g_cpu_start = *start;
+        g_cpu_end = *start;
+        g_cpu_end.user += 120;
+        g_cpu_end.system += 40;
+        g_cpu_end.idle += 800;
+        g_cpu_end.iowait += 15;
+}
+
+static sl_proc_sampler_t *g_procs = NULL;
+static sl_proc_handle_t g_self;
+
+/* cpu + meminfo + uptime as separate calls, and as one snapshot with and without io_uring */
+static const unsigned g_snapshot_mask = SL_SNAPSHOT_CPU | SL_SNAPSHOT_MEM | SL_SNAPSHOT_SYSTIME;
+
+static int run_sampler_separate(void)
+{
+        sl_cpu_raw_t cpu;
+        sl_mem_info_t mem;
+        sl_systime_info_t systime;
+        if (sl_sampler_cpu_get_raw(g_sampler, &cpu) != 0) return -1;
+        if (sl_sampler_mem_get_info(g_sampler, &mem) != 0) return -1;
+        return sl_sampler_systime_get_info(g_sampler, &systime);
+}
+static int run_oneshot_snapshot(void) { sl_snapshot_t r; return sl_snapshot_collect(g_snapshot_mask, NULL, 0, &r); }
+static int run_sampler_snapshot(void) { sl_snapshot_t r; return sl_sampler_snapshot_collect(g_sampler, g_snapshot_mask, NULL, 0, &r); }
+static int run_uring_snapshot(void)
+{
+        sl_snapshot_t r;
+        return sl_sampler_snapshot_collect(g_sampler, g_snapshot_mask | SL_SNAPSHOT_IO_URING, NULL, 0, &r);
+}
+
+static sl_vmstat_t *g_vmstat = NULL;
+
+static int run_vmstat(void) { sl_vmstat_raw_t r; return sl_vmstat_get_raw(g_vmstat, &r); }
+static int run_sampler_mem_ext(void) { sl_mem_ext_t r; return sl_sampler_mem_get_ext(g_sampler, &r); }
+
+static sl_numa_t *g_numa = NULL;
+
+static int run_numa(void) { static sl_numa_raw_t r; return sl_numa_get_raw(g_numa, &r); }
+
+static sl_publisher_t *g_publisher = NULL;
+static sl_subscriber_t *g_subscriber = NULL;
+
+static int run_publisher_update(void) { return sl_publisher_update(g_publisher); }
+static int run_subscriber_read(void)  { sl_monitor_snapshot_t r; return sl_subscriber_read(g_subscriber, &r) == 0 ? 0 : -1; }
+
+static int run_proc_raw(void)       { sl_proc_raw_t r; return sl_proc_get_raw(g_procs, getpid(), &r); }
+static int run_proc_handle(void)    { sl_proc_raw_t r; return sl_proc_handle_get_raw(g_procs, &g_self, &r); }
+
+/* Fixture file contents for the parse-only cases */
+static char *g_stat = NULL, *g_meminfo = NULL, *g_uptime = NULL;
+static size_t g_stat_len = 0, g_meminfo_len = 0, g_uptime_len = 0;
+static sl_cpu_cores_t g_cores;
+
+static int run_parse_legacy_cpu(void)  { sl_cpu_raw_t s; return legacy_parse_cpu_raw(g_stat, &s); }
+static int run_parse_cpu(void)         { sl_cpu_raw_t s; return sl_parse_cpu_raw(g_stat, g_stat_len, &s); }
+static int run_parse_cpu_cores(void)   { return sl_parse_cpu_cores(g_stat, g_stat_len, &g_cores); }
+static int run_parse_legacy_mem(void)  { sl_mem_info_t r; return legacy_parse_meminfo(g_meminfo, &r); }
+static int run_parse_mem(void)         { sl_mem_info_t r; return sl_parse_meminfo(g_meminfo, g_meminfo_len, &r); }
+static int run_parse_legacy_uptime(void)
+{
+        sl_systime_info_t r;
+        return sscanf(g_uptime, "%lf %lf", &r.uptime, &r.idle_time) == 2 ? 0 : -1;
+}
+static int run_parse_uptime(void)      { sl_systime_info_t r; return sl_parse_uptime(g_uptime, g_uptime_len, &r); }
+
+/* Full collector path (pread + parse) against the fixture root */
+static sl_sampler_t *g_fixture_sampler = NULL;
+
+static int run_fixture_cores(void)     { return sl_sampler_cpu_get_raw_cores(g_fixture_sampler, &g_cores); }
+static int run_fixture_mem(void)       { sl_mem_info_t r; return sl_sampler_mem_get_info(g_fixture_sampler, &r); }
+static int run_fixture_uptime(void)    { sl_systime_info_t r; return sl_sampler_systime_get_info(g_fixture_sampler, &r); }
+
+/* What the shim sees for a case; stdio opens and allocates inside libc, parsers make no syscalls */
+#define COUNT_SYSCALLS 0x1
+#define COUNT_ALLOCS 0x2
+#define COUNT_ALL (COUNT_SYSCALLS | COUNT_ALLOCS)
+
+typedef struct
+{
+        const char *name;
+        int (*fn)(void);
+        unsigned counts;
+} bench_case_t;
+
+/* Output state: section name, JSON mode and per-call latency samples */
+static const char *g_group = "live";
+static int g_json = 0;
+static int g_json_first = 1;
+static uint64_t *g_samples = NULL;
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Median cost of the now_ns() pair around each call, subtracted from samples */
+static uint64_t g_clock_overhead = 0;
+
+static int cmp_u64(const void *a, const void *b)
+{
+        uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+        return (x > y) - (x < y);
+}
+
+static void report(const char *name, unsigned counts, long iterations, uint64_t syscalls, uint64_t allocs)
+{
+        uint64_t sum = 0;
+        for (long i = 0; i < iterations; i++) {
+                sum += g_samples[i];
+        }
+        qsort(g_samples, (size_t)iterations, sizeof(uint64_t), cmp_u64);
+        double mean = (double)sum / iterations;
+        uint64_t p50 = g_samples[(iterations - 1) / 2];
+        uint64_t p99 = g_samples[(iterations - 1) * 99 / 100];
+
+        if (g_json) {
+                printf("%s\n    {\"group\": \"%s\", \"name\": \"%s\", \"iterations\": %ld, "
+                       "\"mean_ns\": %.1f, \"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64,
+                       g_json_first ? "" : ",", g_group, name, iterations, mean, p50, p99);
+                if (counts & COUNT_SYSCALLS) printf(", \"syscalls_per_call\": %.2f", (double)syscalls / iterations);
+                else printf(", \"syscalls_per_call\": null");
+                if (counts & COUNT_ALLOCS) printf(", \"allocs_per_call\": %.2f}", (double)allocs / iterations);
+                else printf(", \"allocs_per_call\": null}");
+                g_json_first = 0;
+                return;
+        }
+
+        char sys_col[16] = "n/a", alloc_col[16] = "n/a";
+        if (counts & COUNT_SYSCALLS) snprintf(sys_col, sizeof(sys_col), "%.2f", (double)syscalls / iterations);
+        if (counts & COUNT_ALLOCS) snprintf(alloc_col, sizeof(alloc_col), "%.2f", (double)allocs / iterations);
+        printf("%-24s %12.1f %10" PRIu64 " %10" PRIu64 " %9s %9s\n", name, mean, p50, p99, sys_col, alloc_col);
+}
+
+static void print_section(const char *title)
+{
+        if (g_json) return;
+        printf("\n--- %s ---\n", title);
+        printf("%-24s %12s %10s %10s %9s %9s\n", "case", "mean ns", "p50 ns", "p99 ns", "syscalls", "allocs");
+}
+
+static void calibrate_clock(long iterations)
+{
+        for (long i = 0; i < iterations; i++) {
+                uint64_t t0 = now_ns();
+                g_samples[i] = now_ns() - t0;
+        }
+        qsort(g_samples, (size_t)iterations, sizeof(uint64_t), cmp_u64);
+        g_clock_overhead = g_samples[iterations / 2];
+}
+
+static void run_case(const bench_case_t *c, long iterations)
+{
+        /* Warm-up: opens sampler files and sizes buffers */
+        for (int i = 0; i < 16; i++) {
+                c->fn();
+        }
+
+        g_syscalls = 0;
+        g_allocs = 0;
+        for (long i = 0; i < iterations; i++) {
+                uint64_t t0 = now_ns();
+                if (c->fn() != 0) {
+                        fprintf(stderr, "%s: call failed\n", c->name);
+                        return;
+                }
+                uint64_t t = now_ns() - t0;
+                g_samples[i] = (t > g_clock_overhead) ? t - g_clock_overhead : 0;
+        }
+
+        report(c->name, c->counts, iterations, g_syscalls, g_allocs);
+}
+
+static char *load_file(const char *dir, const char *name, size_t *len)
+{
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+        FILE *f = fopen(path, "r");
+        if (!f) {
+                fprintf(stderr, "failed to open fixture %s\n", path);
+                return NULL;
+        }
+
+        char *buf = malloc(1 << 20);
+        size_t n = buf ? fread(buf, 1, (1 << 20) - 1, f) : 0;
+        fclose(f);
+        if (!buf) return NULL;
+
+        buf[n] = '\0';
+        *len = n;
+        return buf;
+}
+
+static void run_fixture(const char *name, long iterations)
+{
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s/%s/proc", SYSLOAD_FIXTURE_DIR, name);
+
+        g_stat = load_file(dir, "stat", &g_stat_len);
+        g_meminfo = load_file(dir, "meminfo", &g_meminfo_len);
+        g_uptime = load_file(dir, "uptime", &g_uptime_len);
+
+        g_fixture_sampler = sl_sampler_create_at(dir);
+
+        sl_cpu_raw_t fixture_cpu;
+        if (g_stat && g_meminfo && g_uptime && g_fixture_sampler &&
+            sl_parse_cpu_raw(g_stat, g_stat_len, &fixture_cpu) == 0) {
+                const bench_case_t cases[] = {
+                        {"parse cpu (sscanf)",     run_parse_legacy_cpu,    COUNT_ALLOCS},
+                        {"parse cpu",              run_parse_cpu,           COUNT_ALLOCS},
+                        {"parse cpu cores",        run_parse_cpu_cores,     COUNT_ALLOCS},
+                        {"parse meminfo (sscanf)", run_parse_legacy_mem,    COUNT_ALLOCS},
+                        {"parse meminfo",          run_parse_mem,           COUNT_ALLOCS},
+                        {"parse uptime (sscanf)",  run_parse_legacy_uptime, COUNT_ALLOCS},
+                        {"parse uptime",           run_parse_uptime,        COUNT_ALLOCS},
+                        {"one-shot cpu",           run_oneshot_cpu,         COUNT_ALL},
+                        {"one-shot meminfo",       run_oneshot_mem,         COUNT_ALL},
+                        {"one-shot uptime",        run_oneshot_uptime,      COUNT_ALL},
+                        {"one-shot storage",       run_oneshot_storage,     COUNT_ALL},
+                        {"cpu calculate",          run_cpu_calculate,       COUNT_ALL},
+                        {"collect cpu cores",      run_fixture_cores,       COUNT_ALL},
+                        {"collect meminfo",        run_fixture_mem,         COUNT_ALL},
+                        {"collect uptime",         run_fixture_uptime,      COUNT_ALL},
+                };
+
+                char title[128];
+                snprintf(title, sizeof(title), "fixture %s (stat %zu B, meminfo %zu B)", name, g_stat_len, g_meminfo_len);
+                print_section(title);
+
+                /* One-shot calls resolve the library-wide root; statvfs the fixture itself */
+                g_group = name;
+                g_storage_path = dir;
+                cpu_pair_from(&fixture_cpu);
+                sl_set_proc_root(dir);
+                for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+                        run_case(&cases[i], iterations);
+                }
+                sl_set_proc_root(NULL);
+                g_storage_path = "/";
+        }
+
+        sl_sampler_destroy(g_fixture_sampler);
+        g_fixture_sampler = NULL;
+        free(g_stat);
+        free(g_meminfo);
+        free(g_uptime);
+        g_stat = g_meminfo = g_uptime = NULL;
+}
+
+/* ------------------- Interrupt matrix ------------------------ */
+
+static char *g_irq_text = NULL;
+static size_t g_irq_text_len = 0;
+static sl_irq_t *g_irq = NULL;
+static sl_irq_raw_t g_irq_start, g_irq_end;
+static uint64_t g_irq_legacy[4096];
+static double g_irq_rates[4096];
+
+/* The usual approach: sscanf per row name and per count */
+static int run_parse_legacy_irq(void)
+{
+        int n = 0;
+        for (const char *line = strchr(g_irq_text, '\n'); line && line[1]; line = strchr(line + 1, '\n')) {
+                char name[16];
+                int used;
+                if (sscanf(line + 1, " %15[^:]:%n", name, &used) != 1) continue;
+
+                const char *p = line + 1 + used;
+                unsigned long value;
+                while (n < 4096 && sscanf(p, "%lu%n", &value, &used) == 1) {
+                        g_irq_legacy[n++] = value;
+                        p += used;
+                }
+        }
+        return (n > 0) ? 0 : -1;
+}
+static int run_irq_raw(void)       { return sl_irq_get_raw(g_irq, &g_irq_end); }
+static int run_irq_calculate(void) { return sl_irq_calculate(&g_irq_start, &g_irq_end, g_irq_rates, 4096) > 0 ? 0 : -1; }
+
+static void run_irq_fixture(const char *name, long iterations)
+{
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s/%s/proc", SYSLOAD_FIXTURE_DIR, name);
+
+        g_irq_text = load_file(dir, "interrupts", &g_irq_text_len);
+        sl_set_proc_root(dir);
+        g_irq = sl_irq_create(SL_IRQ_INTERRUPTS);
+        if (g_irq_text && g_irq && sl_irq_raw_init(&g_irq_start, 0) == 0 && sl_irq_raw_init(&g_irq_end, 0) == 0 &&
+            sl_irq_get_raw(g_irq, &g_irq_start) == 0 && sl_irq_get_raw(g_irq, &g_irq_end) == 0) {
+                const bench_case_t cases[] = {
+                        {"parse interrupts (sscanf)", run_parse_legacy_irq, COUNT_ALLOCS},
+                        {"collect interrupts",        run_irq_raw,          COUNT_ALL},
+                        {"interrupts calculate",      run_irq_calculate,    COUNT_ALL},
+                };
+
+                char title[128];
+                snprintf(title, sizeof(title), "fixture %s (interrupts %zu B, %d x %d)", name, g_irq_text_len,
+                         g_irq_end.rows, g_irq_end.cpus);
+                print_section(title);
+
+                /* Only the rates are timed; the interval itself is arbitrary */
+                g_irq_end.timestamp_ns = g_irq_start.timestamp_ns + 1000000000ULL;
+                g_group = name;
+                for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+                        run_case(&cases[i], iterations);
+                }
+        }
+        sl_set_proc_root(NULL);
+
+        sl_irq_raw_free(&g_irq_start);
+        sl_irq_raw_free(&g_irq_end);
+        sl_irq_destroy(g_irq);
+        g_irq = NULL;
+        free(g_irq_text);
+        g_irq_text = NULL;
+}
+
+/* ------------------- Top-N scanner --------------------------- */
+
+#define FAKE_PROCS 20000
+
+/* Build a directory with FAKE_PROCS <pid>/stat files shaped like procfs */
+static int fake_proc_create(char *dir)
+{
+        if (!mkdtemp(dir)) return -1;
+
+        for (int pid = 1; pid <= FAKE_PROCS; pid++) {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/%d", dir, pid);
+                if (mkdir(path, 0755) != 0) return -1;
+
+                snprintf(path, sizeof(path), "%s/%d/stat", dir, pid);
+                FILE *f = fopen(path, "w");
+                if (!f) return -1;
+                fprintf(f, "%d (worker-%d) S 1 %d %d 0 -1 4194560 %d 0 0 0 %d %d 0 0 20 0 1 0 %d "
+                           "%d %d 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 0 0 0 0 0 0\n",
+                        pid, pid % 97, pid, pid, pid * 3, pid * 7 % 10007, pid % 503,
+                        1000 + pid, 4096 * (pid % 4099), pid % 8191);
+                fclose(f);
+        }
+        return 0;
+}
+
+static void fake_proc_remove(const char *dir)
+{
+        for (int pid = 1; pid <= FAKE_PROCS; pid++) {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/%d/stat", dir, pid);
+                unlink(path);
+                snprintf(path, sizeof(path), "%s/%d", dir, pid);
+                rmdir(path);
+        }
+        rmdir(dir);
+}
+
+static sl_proc_top_t *g_top = NULL;
+static sl_proc_top_entry_t g_top_entries[10];
+
+static int run_top_refresh(void) { return sl_proc_top_refresh(g_top, g_top_entries, 10) < 0 ? -1 : 0; }
+
+static void run_top(const char *label, const char *proc_root, long iterations)
+{
+        g_top = sl_proc_top_create(proc_root, 32768, 10, SL_PROC_TOP_CPU);
+        if (!g_top) {
+                fprintf(stderr, "%s: failed to create scanner\n", label);
+                return;
+        }
+
+        const bench_case_t c = {label, run_top_refresh, COUNT_ALL};
+        run_case(&c, iterations);
+
+        sl_proc_top_destroy(g_top);
+        g_top = NULL;
+}
+
+int main(int argc, char **argv)
+{
+        long iterations = 20000;
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--json") == 0) {
+                        g_json = 1;
+                } else {
+                        iterations = strtol(argv[i], NULL, 10);
+                        if (iterations <= 0) {
+                                fprintf(stderr, "usage: %s [--json] [iterations]\n", argv[0]);
+                                return 1;
+                        }
+                }
+        }
+
+        g_samples = malloc((size_t)iterations * sizeof(uint64_t));
+        if (!g_samples) {
+                fprintf(stderr, "failed to allocate %ld samples\n", iterations);
+                return 1;
+        }
+        calibrate_clock(iterations);
+
+        g_sampler = sl_sampler_create();
+        if (!g_sampler) {
+                fprintf(stderr, "failed to create sampler\n");
+                return 1;
+        }
+
+        const bench_case_t cases[] = {
+                {"legacy stdio cpu",     run_legacy_cpu,      0},
+                {"one-shot cpu",         run_oneshot_cpu,     COUNT_ALL},
+                {"sampler cpu",          run_sampler_cpu,     COUNT_ALL},
+                {"cpu calculate",        run_cpu_calculate,   COUNT_ALL},
+                {"one-shot meminfo",     run_oneshot_mem,     COUNT_ALL},
+                {"sampler meminfo",      run_sampler_mem,     COUNT_ALL},
+                {"sampler meminfo ext",  run_sampler_mem_ext, COUNT_ALL},
+                {"legacy stdio uptime",  run_legacy_uptime,   0},
+                {"one-shot uptime",      run_oneshot_uptime,  COUNT_ALL},
+                {"sampler uptime",       run_sampler_uptime,  COUNT_ALL},
+                {"one-shot storage",     run_oneshot_storage, COUNT_ALL},
+                {"sampler 3 calls",      run_sampler_separate, COUNT_ALL},
+                {"one-shot snapshot",    run_oneshot_snapshot, COUNT_ALL},
+                {"sampler snapshot",     run_sampler_snapshot, COUNT_ALL},
+                {"snapshot io_uring",    run_uring_snapshot,  COUNT_ALL},
+                {"vmstat 11 keys",       run_vmstat,          COUNT_ALL},
+                {"numa nodes",           run_numa,            COUNT_ALL},
+                {"publisher update",     run_publisher_update, COUNT_ALL},
+                {"subscriber read",      run_subscriber_read, COUNT_ALL},
+                {"process one-shot",     run_proc_raw,        COUNT_ALL},
+                {"process handle",       run_proc_handle,     COUNT_ALL},
+        };
+
+        sl_cpu_raw_t live_cpu;
+        if (sl_cpu_get_raw(&live_cpu) != 0) {
+                fprintf(stderr, "failed to read /proc/stat\n");
+                return 1;
+        }
+        cpu_pair_from(&live_cpu);
+
+        g_vmstat = sl_vmstat_create(NULL, 0);
+        if (!g_vmstat) {
+                fprintf(stderr, "failed to open /proc/vmstat\n");
+                return 1;
+        }
+
+        /* NUMA sysfs is missing on some kernels and containers; only its case is skipped */
+        g_numa = sl_numa_create();
+        if (!g_numa) {
+                fprintf(stderr, "failed to read NUMA topology, skipping numa nodes\n");
+        }
+
+        char shm_name[SL_SHARED_NAME_SIZE];
+        snprintf(shm_name, sizeof(shm_name), "/sysload-bench-%d", (int)getpid());
+        g_publisher = sl_publisher_create(shm_name, &g_storage_path, 1);
+        g_subscriber = sl_subscriber_create(shm_name, 60.0f, NULL, 0);
+        if (!g_publisher || !g_subscriber || sl_publisher_update(g_publisher) != 0) {
+                /* No /dev/shm in some containers; skip both shared memory cases */
+                fprintf(stderr, "failed to set up shared memory publishing, skipping publisher and subscriber\n");
+                sl_subscriber_destroy(g_subscriber);
+                sl_publisher_destroy(g_publisher);
+                g_subscriber = NULL;
+                g_publisher = NULL;
+        }
+
+        g_procs = sl_proc_sampler_create();
+        if (!g_procs || sl_proc_open(g_procs, getpid(), &g_self) != 0) {
+                fprintf(stderr, "failed to create process sampler\n");
+                return 1;
+        }
+
+        if (g_json) {
+                printf("{\n  \"version\": \"%s\",\n  \"iterations\": %ld,\n  \"clock_overhead_ns\": %" PRIu64 ",\n  \"results\": [",
+                       SYSLOAD_VERSION, iterations, g_clock_overhead);
+        } else {
+                printf("=== sysload bench (%ld iterations, %" PRIu64 " ns clock overhead subtracted) ===\n",
+                       iterations, g_clock_overhead);
+        }
+
+        print_section("live /proc");
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+                if (cases[i].fn == run_numa && !g_numa) continue;
+                if ((cases[i].fn == run_publisher_update || cases[i].fn == run_subscriber_read) && !g_publisher) continue;
+                run_case(&cases[i], iterations);
+        }
+
+        sl_sampler_destroy(g_sampler);
+        sl_vmstat_destroy(g_vmstat);
+        sl_numa_destroy(g_numa);
+        sl_subscriber_destroy(g_subscriber);
+        sl_publisher_destroy(g_publisher);
+        sl_proc_close(&g_self);
+        sl_proc_sampler_destroy(g_procs);
+
+        const char *fixtures[] = {"laptop-2core", "server-32core", "server-256core"};
+        if (sl_cpu_cores_init(&g_cores, 0) != 0) {
+                return 1;
+        }
+        for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+                run_fixture(fixtures[i], iterations);
+        }
+        sl_cpu_cores_free(&g_cores);
+        run_irq_fixture("server-32core", iterations);
+
+        long top_iterations = (iterations < 20) ? iterations : 20;
+        print_section("top-N process scanner");
+        g_group = "top";
+        run_top("top live /proc", NULL, top_iterations);
+
+        char fake_dir[] = "/tmp/sysload-fakeproc-XXXXXX";
+        if (fake_proc_create(fake_dir) == 0) {
+                run_top("top fake /proc (20k)", fake_dir, top_iterations);
+        } else {
+                fprintf(stderr, "failed to create fake proc directory\n");
+        }
+        fake_proc_remove(fake_dir);
+
+        if (g_json) printf("\n  ]\n}\n");
+        free(g_samples);
+        return 0;
+}
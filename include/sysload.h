@@ -5,11 +5,49 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define MEMINFO_LINE_SIZE 256
 #define MEMINFO_KEY_SIZE 32
 #define EXPECTED_MEMINFO_KEYS 8
+#define SL_MONITOR_MAX_MOUNTS 16
+#define SL_DISK_MAX_DEVICES 64
+#define SL_DISK_NAME_SIZE 32
+
+/* Device filter flags for sl_disk_get_raw() */
+#define SL_DISK_INCLUDE_PARTITIONS 0x1  /**< Also report partitions (sda1, nvme0n1p2, ...) */
+#define SL_DISK_INCLUDE_VIRTUAL 0x2     /**< Also report loop and ram devices */
+#define SL_NET_MAX_IFACES 64
+#define SL_NET_NAME_SIZE 16
+
+/* cgroup v2 controllers whose files were found, see sl_cgroup_raw_t */
+#define SL_CGROUP_CPU 0x1       /**< cpu.max and throttling counters */
+#define SL_CGROUP_MEMORY 0x2    /**< memory.current, memory.max, memory.stat */
+#define SL_CGROUP_IO 0x4        /**< io.stat */
+#define SL_CGROUP_UNLIMITED UINT64_MAX
+#define SL_VMSTAT_MAX_KEYS 32
+#define SL_VMSTAT_KEY_SIZE 48
+#define SL_NUMA_MAX_NODES 64
+#define SL_IRQ_NAME_SIZE 16
+#define SL_IRQ_DESC_SIZE 64
+#define SL_MOUNT_PATH_SIZE 256
+#define SL_MOUNT_FSTYPE_SIZE 32
+#define SL_HISTORY_MAX_WINDOWS 4
+#define SL_HISTORY_BUCKETS 200          /* Histogram buckets over 0-100%, 0.5% each */
+#define SL_RECORD_MAX_SLOTS 16          /* Storage slots (mount points) per recording */
+#define SL_SNAPSHOT_MAX_PATHS 16
+#define SL_SHARED_DEFAULT_NAME "/sysload"   /* shm_open() name used when none is given */
+#define SL_SHARED_NAME_SIZE 64
+#define SL_SCHED_MAX_COLLECTORS 32
+
+/* Metric groups for sl_snapshot_collect() */
+#define SL_SNAPSHOT_CPU 0x1             /**< /proc/stat aggregate counters */
+#define SL_SNAPSHOT_MEM 0x2             /**< /proc/meminfo */
+#define SL_SNAPSHOT_SYSTIME 0x4         /**< /proc/uptime */
+#define SL_SNAPSHOT_STORAGE 0x8         /**< statvfs() of the given paths */
+#define SL_SNAPSHOT_ALL 0xF
+#define SL_SNAPSHOT_IO_URING 0x100      /**< Flag: batch the procfs reads with io_uring */
 
 #define SYSLOAD_VERSION_MAJOR 0
 #define SYSLOAD_VERSION_MINOR 1
@@ -37,6 +75,71 @@ typedef struct
     float percent_used;    /**< Memory usage percentage */
 } sl_mem_info_t;
 
+/* Every /proc/meminfo field; sizes in KB, HugePages_* in pages, 0 if the kernel lacks the key */
+typedef struct
+{
+    uint64_t mem_total;
+    uint64_t mem_free;
+    uint64_t mem_available;
+    uint64_t buffers;
+    uint64_t cached;
+    uint64_t swap_cached;
+    uint64_t active;
+    uint64_t inactive;
+    uint64_t active_anon;
+    uint64_t inactive_anon;
+    uint64_t active_file;
+    uint64_t inactive_file;
+    uint64_t unevictable;
+    uint64_t mlocked;
+    uint64_t swap_total;
+    uint64_t swap_free;
+    uint64_t zswap;
+    uint64_t zswapped;
+    uint64_t dirty;                 /**< Waiting to be written back */
+    uint64_t writeback;             /**< Being written back now */
+    uint64_t anon_pages;
+    uint64_t mapped;
+    uint64_t shmem;
+    uint64_t kreclaimable;
+    uint64_t slab;
+    uint64_t sreclaimable;
+    uint64_t sunreclaim;
+    uint64_t kernel_stack;
+    uint64_t page_tables;
+    uint64_t sec_page_tables;
+    uint64_t nfs_unstable;
+    uint64_t bounce;
+    uint64_t writeback_tmp;
+    uint64_t commit_limit;
+    uint64_t committed_as;          /**< Memory promised to processes; compare with commit_limit */
+    uint64_t vmalloc_total;
+    uint64_t vmalloc_used;
+    uint64_t vmalloc_chunk;
+    uint64_t percpu;
+    uint64_t hardware_corrupted;
+    uint64_t anon_huge_pages;       /**< Transparent huge pages backing anonymous memory */
+    uint64_t shmem_huge_pages;
+    uint64_t shmem_pmd_mapped;
+    uint64_t file_huge_pages;
+    uint64_t file_pmd_mapped;
+    uint64_t cma_total;
+    uint64_t cma_free;
+    uint64_t unaccepted;
+    uint64_t balloon;
+    uint64_t hugepages_total;       /**< hugetlbfs pool size, in pages */
+    uint64_t hugepages_free;
+    uint64_t hugepages_rsvd;
+    uint64_t hugepages_surp;
+    uint64_t hugepagesize;
+    uint64_t hugetlb;
+    uint64_t direct_map_4k;
+    uint64_t direct_map_2m;
+    uint64_t direct_map_4m;
+    uint64_t direct_map_1g;
+    int unknown;                    /**< Lines with keys this version does not know */
+} sl_mem_ext_t;
+
 /* CPU usage percentages */
 typedef struct
 {
@@ -64,6 +167,25 @@ typedef struct
     uint64_t steal;
 } sl_cpu_raw_t;
 
+/* Caller-owned state for non-blocking CPU usage polling */
+typedef struct
+{
+    sl_cpu_raw_t prev;      /**< Counters from the previous sample */
+    uint64_t prev_ns;       /**< CLOCK_MONOTONIC time of the previous sample */
+    int primed;             /**< Non-zero once prev holds a sample */
+} sl_cpu_delta_t;
+
+/* Per-core raw CPU counters snapshot, indexed by CPU id */
+typedef struct
+{
+    sl_cpu_raw_t total;     /**< Aggregate "cpu" line */
+    sl_cpu_raw_t *cores;    /**< Per-core counters, cores[N] holds "cpuN" */
+    uint8_t *online;        /**< Non-zero if "cpuN" was present in the snapshot */
+    int count;              /**< Valid slots (highest CPU id seen + 1) */
+    int capacity;           /**< Allocated slots in cores/online */
+    int owned;              /**< Non-zero if arrays are owned by the library */
+} sl_cpu_cores_t;
+
 /* System time information (seconds) */
 typedef struct
 {
@@ -81,6 +203,524 @@ typedef struct
     double percent_usage;   /**< Percentage of used storage */
 } sl_storage_info_t;
 
+/* One mounted filesystem and its storage information */
+typedef struct
+{
+    char mount_point[SL_MOUNT_PATH_SIZE];
+    char fstype[SL_MOUNT_FSTYPE_SIZE];
+    char source[SL_MOUNT_PATH_SIZE];    /**< Mount source (/dev/sda1, server:/export, tmpfs, ...) */
+    uint32_t major;                     /**< st_dev of the filesystem */
+    uint32_t minor;
+    int error;                          /**< 0, or the errno of statvfs (ETIMEDOUT if it did not finish in time) */
+    sl_storage_info_t storage;          /**< Valid when error is 0 */
+} sl_mount_info_t;
+
+/* Cached mount table (opaque) */
+typedef struct sl_mounts sl_mounts_t;
+
+/* Raw I/O counters of one block device from /proc/diskstats */
+typedef struct
+{
+    char name[SL_DISK_NAME_SIZE];   /**< Kernel device name (sda, nvme0n1, ...) */
+    uint32_t major;
+    uint32_t minor;
+    uint64_t reads_completed;
+    uint64_t reads_merged;
+    uint64_t sectors_read;          /**< 512-byte sectors */
+    uint64_t read_time_ms;          /**< Time spent on reads in ms */
+    uint64_t writes_completed;
+    uint64_t writes_merged;
+    uint64_t sectors_written;       /**< 512-byte sectors */
+    uint64_t write_time_ms;         /**< Time spent on writes in ms */
+    uint64_t in_flight;             /**< I/Os currently in progress */
+    uint64_t io_time_ms;            /**< Time the device had I/O in flight in ms */
+    uint64_t weighted_io_time_ms;   /**< io_time weighted by queue depth in ms */
+} sl_disk_dev_raw_t;
+
+/* Snapshot of all matching block devices */
+typedef struct
+{
+    sl_disk_dev_raw_t devices[SL_DISK_MAX_DEVICES];
+    int count;                      /**< Number of valid devices */
+    uint64_t timestamp_ns;          /**< CLOCK_MONOTONIC time of the sample */
+} sl_disk_raw_t;
+
+/* Block device usage between two snapshots */
+typedef struct
+{
+    char name[SL_DISK_NAME_SIZE];
+    double read_iops;               /**< Completed reads per second */
+    double write_iops;              /**< Completed writes per second */
+    double read_bytes_per_sec;
+    double write_bytes_per_sec;
+    double read_await_ms;           /**< Average time per completed read */
+    double write_await_ms;          /**< Average time per completed write */
+    double await_ms;                /**< Average time per completed I/O */
+    double utilization;             /**< Percentage of time the device was busy, 0-100 */
+    uint64_t in_flight;             /**< I/Os in progress at the end snapshot */
+} sl_disk_usage_t;
+
+/* Raw counters of one network interface from /proc/net/dev */
+typedef struct
+{
+    char name[SL_NET_NAME_SIZE];    /**< Interface name (eth0, lo, ...) */
+    uint32_t id;                    /**< Interned name id, stable within one sampler */
+    uint64_t rx_bytes;
+    uint64_t rx_packets;
+    uint64_t rx_errors;
+    uint64_t rx_dropped;
+    uint64_t rx_fifo;
+    uint64_t rx_frame;
+    uint64_t rx_compressed;
+    uint64_t rx_multicast;
+    uint64_t tx_bytes;
+    uint64_t tx_packets;
+    uint64_t tx_errors;
+    uint64_t tx_dropped;
+    uint64_t tx_fifo;
+    uint64_t tx_collisions;
+    uint64_t tx_carrier;
+    uint64_t tx_compressed;
+} sl_net_iface_raw_t;
+
+/* Snapshot of all network interfaces */
+typedef struct
+{
+    sl_net_iface_raw_t ifaces[SL_NET_MAX_IFACES];
+    int count;                      /**< Number of valid interfaces */
+    uint64_t names_tag;             /**< Identifies the name table the ids belong to */
+    int counter_bits;               /**< Width of the kernel's counters (its unsigned long): 32 or 64 */
+    uint64_t timestamp_ns;          /**< CLOCK_MONOTONIC time of the sample */
+} sl_net_raw_t;
+
+/* Network interface rates between two snapshots */
+typedef struct
+{
+    char name[SL_NET_NAME_SIZE];
+    double rx_bytes_per_sec;
+    double tx_bytes_per_sec;
+    double rx_packets_per_sec;
+    double tx_packets_per_sec;
+    double rx_errors_per_sec;
+    double tx_errors_per_sec;
+    double rx_dropped_per_sec;
+    double tx_dropped_per_sec;
+} sl_net_usage_t;
+
+/* Resources with Pressure Stall Information under /proc/pressure */
+typedef enum {
+    SL_PSI_CPU,
+    SL_PSI_MEMORY,
+    SL_PSI_IO,
+    SL_PSI_RESOURCES        /**< Number of resources, not a valid value */
+} sl_psi_resource_t;
+
+/* One "some" or "full" line of a pressure file */
+typedef struct
+{
+    double avg10;           /**< Percentage of time stalled, 10 s average */
+    double avg60;           /**< Percentage of time stalled, 60 s average */
+    double avg300;          /**< Percentage of time stalled, 300 s average */
+    uint64_t total_us;      /**< Total stall time in microseconds */
+} sl_psi_line_t;
+
+/* Raw pressure counters of one resource */
+typedef struct
+{
+    sl_psi_line_t some;     /**< At least one task stalled */
+    sl_psi_line_t full;     /**< All non-idle tasks stalled */
+    int has_full;           /**< 0 if the kernel has no "full" line (cpu before 5.13) */
+    uint64_t timestamp_ns;  /**< CLOCK_MONOTONIC time of the sample */
+} sl_psi_raw_t;
+
+/* Stall time between two pressure snapshots */
+typedef struct
+{
+    uint64_t some_us;       /**< Time at least one task was stalled */
+    uint64_t full_us;       /**< Time all non-idle tasks were stalled */
+    double some_percent;    /**< some_us as a percentage of the interval */
+    double full_percent;    /**< full_us as a percentage of the interval */
+} sl_psi_usage_t;
+
+/* Registered PSI trigger; caller-owned */
+typedef struct
+{
+    int fd;                 /**< Pressure file descriptor, -1 when closed */
+    sl_psi_resource_t resource;
+} sl_psi_trigger_t;
+
+/* System load averages from /proc/loadavg */
+typedef struct
+{
+    double load1;           /**< 1 minute load average */
+    double load5;           /**< 5 minute load average */
+    double load15;          /**< 15 minute load average */
+    uint32_t running;       /**< Runnable scheduling entities */
+    uint32_t total;         /**< Existing scheduling entities */
+    int32_t last_pid;       /**< Most recently created pid */
+} sl_loadavg_t;
+
+/* Raw counters and limits of a cgroup v2 group */
+typedef struct
+{
+    unsigned controllers;           /**< SL_CGROUP_* bits of the files present */
+    uint64_t usage_usec;            /**< CPU time consumed */
+    uint64_t user_usec;
+    uint64_t system_usec;
+    uint64_t nr_periods;            /**< Enforcement periods elapsed */
+    uint64_t nr_throttled;          /**< Periods in which the group was throttled */
+    uint64_t throttled_usec;        /**< Time spent throttled */
+    uint64_t cpu_quota_usec;        /**< Tightest quota per period of the group and its parents, SL_CGROUP_UNLIMITED if none */
+    uint64_t cpu_period_usec;       /**< Period that goes with cpu_quota_usec */
+    uint64_t memory_current;        /**< Memory charged to the group in bytes */
+    uint64_t memory_max;            /**< Lowest memory.max of the group and its parents in bytes, SL_CGROUP_UNLIMITED if none */
+    uint64_t anon;                  /**< memory.stat values in bytes */
+    uint64_t file;
+    uint64_t shmem;
+    uint64_t slab;
+    uint64_t sock;
+    uint64_t active_file;
+    uint64_t inactive_file;
+    uint64_t pgmajfault;
+    uint64_t io_rbytes;             /**< io.stat summed over devices */
+    uint64_t io_wbytes;
+    uint64_t io_rios;
+    uint64_t io_wios;
+    double host_cpus;               /**< Online host CPUs, the limit when there is no quota */
+    uint64_t host_memory;           /**< Host memory in bytes, the limit when there is no memory.max */
+    uint64_t timestamp_ns;          /**< CLOCK_MONOTONIC time of the sample */
+} sl_cgroup_raw_t;
+
+/* cgroup usage between two snapshots, relative to the group's limits */
+typedef struct
+{
+    double cpu_percent;             /**< CPU used, 100 = one full core */
+    double cpu_limit;               /**< CPUs available: quota/period, or host CPUs */
+    double cpu_percent_of_limit;    /**< CPU used as a percentage of cpu_limit */
+    double throttled_percent;       /**< Percentage of periods that were throttled */
+    uint64_t memory_used;           /**< memory.current in bytes at the end snapshot */
+    uint64_t memory_working_set;    /**< memory_used minus inactive file cache */
+    uint64_t memory_limit;          /**< memory.max in bytes, or host memory */
+    double memory_percent;          /**< memory_working_set as a percentage of memory_limit */
+    double read_bytes_per_sec;
+    double write_bytes_per_sec;
+    double read_iops;
+    double write_iops;
+} sl_cgroup_usage_t;
+
+/* cgroup v2 collector (opaque) */
+typedef struct sl_cgroup sl_cgroup_t;
+
+/* Position of each counter when a vmstat collector is created with the default keys */
+typedef enum
+{
+    SL_VMSTAT_PGFAULT,              /**< Page faults, minor and major */
+    SL_VMSTAT_PGMAJFAULT,           /**< Faults that needed I/O */
+    SL_VMSTAT_PGPGIN,               /**< KB paged in from block devices */
+    SL_VMSTAT_PGPGOUT,              /**< KB paged out to block devices */
+    SL_VMSTAT_PSWPIN,               /**< Pages swapped in */
+    SL_VMSTAT_PSWPOUT,              /**< Pages swapped out */
+    SL_VMSTAT_PGSCAN_KSWAPD,        /**< Pages scanned by background reclaim */
+    SL_VMSTAT_PGSCAN_DIRECT,        /**< Pages scanned by allocating tasks (stalls) */
+    SL_VMSTAT_PGSTEAL_KSWAPD,       /**< Pages reclaimed by background reclaim */
+    SL_VMSTAT_PGSTEAL_DIRECT,       /**< Pages reclaimed by allocating tasks */
+    SL_VMSTAT_OOM_KILL,             /**< OOM killer invocations (Linux 4.13+) */
+    SL_VMSTAT_DEFAULT_KEYS
+} sl_vmstat_default_t;
+
+/* Selected /proc/vmstat counters, in the order the keys were given */
+typedef struct
+{
+    uint64_t values[SL_VMSTAT_MAX_KEYS];
+    uint32_t present;               /**< Bit i set if key i exists on this kernel; absent keys read 0 */
+    int count;                      /**< Number of selected keys */
+    uint64_t timestamp_ns;          /**< CLOCK_MONOTONIC time of the sample */
+} sl_vmstat_raw_t;
+
+/* vmstat counter rates between two snapshots */
+typedef struct
+{
+    double per_sec[SL_VMSTAT_MAX_KEYS];     /**< Increase per second, 0 for absent keys */
+    int count;
+} sl_vmstat_rates_t;
+
+/* /proc/vmstat collector (opaque) */
+typedef struct sl_vmstat sl_vmstat_t;
+
+/* Raw counters of one NUMA node; memory values are in KB */
+typedef struct
+{
+    int id;                         /**< Node number (N in /sys/devices/system/node/nodeN) */
+    int cpu_count;                  /**< CPUs of the node present in /proc/stat */
+    sl_cpu_raw_t cpu;               /**< Sum of the node's per-core counters */
+    uint64_t mem_total;
+    uint64_t mem_free;
+    uint64_t mem_used;
+    uint64_t active;
+    uint64_t inactive;
+    uint64_t file_pages;
+    uint64_t anon_pages;
+    uint64_t shmem;
+    uint64_t dirty;
+    uint64_t writeback;
+    uint64_t slab;
+    uint64_t hugepages_total;       /**< In pages */
+    uint64_t hugepages_free;        /**< In pages */
+    uint64_t numa_hit;              /**< numastat counters, in pages */
+    uint64_t numa_miss;
+    uint64_t numa_foreign;
+    uint64_t interleave_hit;
+    uint64_t local_node;
+    uint64_t other_node;
+} sl_numa_node_raw_t;
+
+/* Raw counters of all NUMA nodes, in node order */
+typedef struct
+{
+    sl_numa_node_raw_t nodes[SL_NUMA_MAX_NODES];
+    int count;
+    uint64_t timestamp_ns;          /**< CLOCK_MONOTONIC time of the sample */
+} sl_numa_raw_t;
+
+/* Per-node usage between two snapshots */
+typedef struct
+{
+    int id;
+    sl_cpu_usage_t cpu;             /**< Usage of the node's CPUs, all zero for CPU-less nodes */
+    uint64_t mem_total;             /**< KB, from the end snapshot */
+    uint64_t mem_free;              /**< KB, from the end snapshot */
+    double mem_percent_used;
+    double miss_per_sec;            /**< Pages placed here though another node was preferred */
+    double foreign_per_sec;         /**< Pages meant for this node placed elsewhere */
+    double local_percent;           /**< Allocations by this node's tasks served locally, 100 if none */
+} sl_numa_usage_t;
+
+/* NUMA topology collector (opaque) */
+typedef struct sl_numa sl_numa_t;
+
+/* Per-CPU interrupt counter files */
+typedef enum {
+    SL_IRQ_INTERRUPTS,      /**< /proc/interrupts: hardware IRQs and arch interrupts (LOC, RES, ...) */
+    SL_IRQ_SOFTIRQS         /**< /proc/softirqs: NET_RX, TIMER, SCHED, ... */
+} sl_irq_source_t;
+
+/* Interrupt counter matrix, one row per source and one column per online CPU */
+typedef struct
+{
+    uint64_t *counts;       /**< rows x cpus, row-major: counts[row * cpus + column] */
+    int rows;
+    int cpus;
+    int capacity;           /**< Allocated entries in counts */
+    uint64_t layout;        /**< Layout generation the rows and columns belong to, unique across collectors */
+    uint64_t timestamp_ns;  /**< CLOCK_MONOTONIC time of the sample */
+} sl_irq_raw_t;
+
+/* One busy (source, CPU) pair */
+typedef struct
+{
+    int row;                /**< Row of the source, see sl_irq_name() */
+    int cpu;                /**< CPU id */
+    double per_sec;
+} sl_irq_hotspot_t;
+
+/* /proc/interrupts or /proc/softirqs collector (opaque) */
+typedef struct sl_irq sl_irq_t;
+
+/* Metrics recorded by the history buffer; all are percentages */
+typedef enum {
+    SL_METRIC_CPU_TOTAL,
+    SL_METRIC_CPU_USER,
+    SL_METRIC_CPU_SYSTEM,
+    SL_METRIC_CPU_IOWAIT,
+    SL_METRIC_CPU_STEAL,
+    SL_METRIC_MEM_USED,
+    SL_METRIC_SWAP_USED,
+    SL_METRIC_COUNT         /**< Number of metrics, not a valid value */
+} sl_metric_t;
+
+/* Statistics of one metric over one history window */
+typedef struct
+{
+    int count;              /**< Samples in the window */
+    double mean;
+    double min;
+    double max;
+    double p50;             /**< Percentiles from the histogram, within 0.5% */
+    double p95;
+    double p99;
+} sl_history_stats_t;
+
+/* Time-series ring buffer with rolling window statistics (opaque) */
+typedef struct sl_history sl_history_t;
+
+/* Time a metric group was read */
+typedef struct
+{
+    uint64_t monotonic_ns;      /**< CLOCK_MONOTONIC */
+    uint64_t boottime_ns;       /**< CLOCK_BOOTTIME, keeps counting during suspend */
+} sl_timestamp_t;
+
+/* Metric groups gathered in one pass by sl_snapshot_collect() */
+typedef struct
+{
+    unsigned collected;                 /**< SL_SNAPSHOT_* groups that were read successfully */
+    sl_cpu_raw_t cpu;
+    sl_timestamp_t cpu_time;
+    sl_mem_info_t mem;
+    sl_timestamp_t mem_time;
+    sl_systime_info_t systime;
+    sl_timestamp_t systime_time;
+    sl_storage_info_t storage[SL_SNAPSHOT_MAX_PATHS];   /**< In the order of the paths given */
+    int storage_count;
+    sl_timestamp_t storage_time;
+} sl_snapshot_t;
+
+/* Kinds of records in a recording */
+typedef enum {
+    SL_RECORD_SESSION,      /**< A recorder was opened; following records restart from it */
+    SL_RECORD_CPU,
+    SL_RECORD_MEM,
+    SL_RECORD_SYSTIME,
+    SL_RECORD_STORAGE
+} sl_record_type_t;
+
+/* One record decoded from a recording */
+typedef struct
+{
+    sl_record_type_t type;
+    uint64_t timestamp_ns;              /**< Time given when writing (SESSION: CLOCK_MONOTONIC at open) */
+    int slot;                           /**< Storage slot, SL_RECORD_STORAGE only */
+    union {
+        uint64_t realtime_ns;           /**< SESSION: CLOCK_REALTIME at open */
+        sl_cpu_raw_t cpu;
+        sl_mem_info_t mem;              /**< Raw fields only; derive the rest with sl_mem_calculate() */
+        sl_systime_info_t systime;      /**< Stored with 10 ms resolution */
+        sl_storage_info_t storage;
+    };
+} sl_record_t;
+
+/* Append-only snapshot recorder (opaque) */
+typedef struct sl_recorder sl_recorder_t;
+
+/* Memory-mapped recording reader (opaque) */
+typedef struct sl_replay sl_replay_t;
+
+/* Latest results published by the background monitor */
+typedef struct
+{
+    sl_cpu_usage_t cpu;                 /**< CPU usage over the last interval */
+    sl_mem_info_t mem;                  /**< Memory information */
+    sl_systime_info_t systime;          /**< Uptime information */
+    sl_storage_info_t storage[SL_MONITOR_MAX_MOUNTS]; /**< Per configured mount, in start order */
+    int storage_count;                  /**< Number of valid storage entries */
+    unsigned collected;                 /**< SL_SNAPSHOT_* groups read for this sample; the others are stale */
+    uint64_t timestamp_ns;              /**< CLOCK_MONOTONIC time the sample was taken */
+    uint64_t sequence;                  /**< Number of samples published since start */
+} sl_monitor_snapshot_t;
+
+/* Raw counters of one process or thread */
+typedef struct
+{
+    int32_t pid;            /**< Process or thread id */
+    char comm[16];          /**< Command name */
+    char state;             /**< Scheduler state (R, S, D, Z, ...) */
+    uint64_t utime;         /**< User time in clock ticks */
+    uint64_t stime;         /**< System time in clock ticks */
+    uint64_t start_time;    /**< Start time in clock ticks after boot, detects pid reuse */
+    uint64_t num_threads;   /**< Number of threads */
+    uint64_t minflt;        /**< Minor page faults */
+    uint64_t majflt;        /**< Major page faults */
+    uint64_t vsize;         /**< Virtual memory size in bytes */
+    uint64_t rss;           /**< Resident set size in bytes */
+    uint64_t shared;        /**< Resident shared memory in bytes (0 for threads) */
+    uint64_t read_bytes;    /**< Bytes fetched from storage (0 if /proc/<pid>/io is not readable) */
+    uint64_t write_bytes;   /**< Bytes sent to storage (0 if /proc/<pid>/io is not readable) */
+    uint64_t timestamp_ns;  /**< CLOCK_MONOTONIC time of the sample */
+} sl_proc_raw_t;
+
+/* Process or thread usage between two snapshots */
+typedef struct
+{
+    float user;                     /**< User CPU, 100 = one full core */
+    float system;                   /**< System CPU, 100 = one full core */
+    float total;                    /**< user + system */
+    uint64_t rss;                   /**< Resident set size in bytes at the end snapshot */
+    double read_bytes_per_sec;      /**< Storage read rate */
+    double write_bytes_per_sec;     /**< Storage write rate */
+    double minflt_per_sec;          /**< Minor page fault rate */
+    double majflt_per_sec;          /**< Major page fault rate */
+} sl_proc_usage_t;
+
+/* Persistent descriptors for re-sampling one process; caller-owned */
+typedef struct
+{
+    int pid;
+    int stat_fd;
+    int statm_fd;           /**< -1 if unavailable */
+    int io_fd;              /**< -1 if unavailable (needs ptrace access) */
+} sl_proc_handle_t;
+
+/* Process sampler context (opaque) */
+typedef struct sl_proc_sampler sl_proc_sampler_t;
+
+/* Ranking key for the top-N process scanner */
+typedef enum {
+    SL_PROC_TOP_CPU,        /**< CPU usage since the previous refresh */
+    SL_PROC_TOP_RSS         /**< Resident set size */
+} sl_proc_top_key_t;
+
+/* One entry of a top-N process ranking */
+typedef struct
+{
+    int32_t pid;
+    char comm[16];          /**< Command name */
+    float cpu;              /**< CPU since the previous refresh, 100 = one full core */
+    uint64_t rss;           /**< Resident set size in bytes */
+} sl_proc_top_entry_t;
+
+/* Top-N process scanner (opaque) */
+typedef struct sl_proc_top sl_proc_top_t;
+
+/* Sampler context keeping /proc files open between samples (opaque) */
+typedef struct sl_sampler sl_sampler_t;
+
+/* Writer of a shared-memory snapshot for other processes (opaque) */
+typedef struct sl_publisher sl_publisher_t;
+
+/* Reader of a shared-memory snapshot with direct-collection fallback (opaque) */
+typedef struct sl_subscriber sl_subscriber_t;
+
+/* What a scheduled collector reads */
+typedef enum {
+    SL_SCHED_CPU,           /**< CPU usage since the collector's previous run */
+    SL_SCHED_MEM,           /**< /proc/meminfo */
+    SL_SCHED_SYSTIME,       /**< /proc/uptime */
+    SL_SCHED_STORAGE,       /**< statvfs() of one path */
+    SL_SCHED_CUSTOM         /**< Nothing; only the callback runs */
+} sl_sched_kind_t;
+
+/* Result handed to a scheduled collector's callback */
+typedef struct
+{
+    int id;                             /**< Id returned by sl_sched_add() */
+    sl_sched_kind_t kind;
+    int status;                         /**< 0; 1 if a CPU run saw no new clock tick, -1 if the read failed (both keep the previous data) */
+    uint64_t timestamp_ns;              /**< CLOCK_MONOTONIC time of the batch, shared by its collectors */
+    const char *path;                   /**< Path for SL_SCHED_STORAGE, NULL otherwise */
+    union {
+        sl_cpu_usage_t cpu;
+        sl_mem_info_t mem;
+        sl_systime_info_t systime;
+        sl_storage_info_t storage;
+    };
+} sl_sched_result_t;
+
+/* Callback of a scheduled collector */
+typedef void (*sl_sched_callback_t)(const sl_sched_result_t *result, void *user_data);
+
+/* Multi-rate collection scheduler driven by a timerfd (opaque) */
+typedef struct sl_sched sl_sched_t;
+
 /* ============================================================= */
 /*                        FUNCTION PROTOTYPES                     */
 /* ============================================================= */
@@ -128,6 +768,95 @@ int sl_cpu_get_raw(sl_cpu_raw_t *snapshot);
  */
 int sl_cpu_calculate(const sl_cpu_raw_t *start, const sl_cpu_raw_t *end, sl_cpu_usage_t *result);
 
+/**
+ * @brief Initialize a CPU delta context
+ * @param ctx Context to reset; the next update only records a baseline
+ */
+void sl_cpu_delta_init(sl_cpu_delta_t *ctx);
+
+/**
+ * @brief Get CPU usage since the previous call without sleeping
+ *
+ * Reads /proc/stat once and computes usage against the counters stored in
+ * ctx, then stores the new counters. If the aggregate counters went
+ * backwards (reset) the context is rebased instead of failing; single
+ * counters that dip slightly are clamped to zero.
+ *
+ * @param ctx Delta context initialized with sl_cpu_delta_init()
+ * @param sampler Sampler to read through, or NULL for a one-shot read
+ * @param result Pointer to store CPU usage percentages
+ * @param elapsed_sec Optional pointer to store the measured interval (CLOCK_MONOTONIC)
+ * @return 0 if result was written, 1 if only a baseline was recorded
+ *         (first call, counter reset or less than one tick elapsed), -1 on error
+ */
+int sl_cpu_delta_update(sl_cpu_delta_t *ctx, sl_sampler_t *sampler, sl_cpu_usage_t *result, double *elapsed_sec);
+
+/**
+ * @brief Feed an externally collected snapshot into a CPU delta context
+ * @param ctx Delta context initialized with sl_cpu_delta_init()
+ * @param snapshot Raw counters
+ * @param timestamp_ns CLOCK_MONOTONIC time the counters were read, in nanoseconds
+ * @param result Pointer to store CPU usage percentages
+ * @param elapsed_sec Optional pointer to store the interval since the previous snapshot
+ * @return 0 if result was written, 1 if only a baseline was recorded, -1 on error
+ */
+int sl_cpu_delta_feed(sl_cpu_delta_t *ctx, const sl_cpu_raw_t *snapshot, uint64_t timestamp_ns,
+                      sl_cpu_usage_t *result, double *elapsed_sec);
+
+/**
+ * @brief Prepare a per-core snapshot with library-allocated arrays
+ *
+ * Arrays are grown only when a CPU id beyond the current capacity
+ * appears (hotplug), so repeated sampling does not allocate.
+ *
+ * @param snapshot Snapshot to initialize
+ * @param capacity Initial number of CPU slots, or 0 to use the configured CPU count
+ * @return 0 on success, -1 on error
+ */
+int sl_cpu_cores_init(sl_cpu_cores_t *snapshot, int capacity);
+
+/**
+ * @brief Prepare a per-core snapshot backed by caller-provided arrays
+ *
+ * The arrays are never reallocated; sampling fails if a CPU id does not fit.
+ *
+ * @param snapshot Snapshot to initialize
+ * @param cores Array of at least capacity counters
+ * @param online Array of at least capacity flags
+ * @param capacity Number of CPU slots in both arrays
+ */
+void sl_cpu_cores_init_with(sl_cpu_cores_t *snapshot, sl_cpu_raw_t *cores, uint8_t *online, int capacity);
+
+/**
+ * @brief Release arrays allocated by sl_cpu_cores_init()
+ * @param snapshot Snapshot to release
+ */
+void sl_cpu_cores_free(sl_cpu_cores_t *snapshot);
+
+/**
+ * @brief Get aggregate and per-core CPU counters from one read of /proc/stat
+ *
+ * CPUs missing from /proc/stat (offline) keep their slot with online[N] = 0.
+ *
+ * @param snapshot Initialized per-core snapshot
+ * @return 0 on success, -1 on error
+ */
+int sl_cpu_get_raw_cores(sl_cpu_cores_t *snapshot);
+
+/**
+ * @brief Calculate per-core CPU usage between two per-core snapshots
+ *
+ * Slots for CPUs that are offline in either snapshot, or whose counters
+ * did not advance, are zeroed; check end->online[N] to tell them apart.
+ *
+ * @param start First snapshot
+ * @param end Second snapshot
+ * @param results Array to store per-core percentages, indexed by CPU id
+ * @param max_results Number of entries in results
+ * @return Number of entries written (min(end->count, max_results)), -1 on error
+ */
+int sl_cpu_calculate_cores(const sl_cpu_cores_t *start, const sl_cpu_cores_t *end, sl_cpu_usage_t *results, int max_results);
+
 /**
  * @brief Get CPU usage over a time interval
  * @param interval_sec Measurement interval in seconds
@@ -152,6 +881,13 @@ int sl_mem_calculate(sl_mem_info_t *result);
  */
 int sl_mem_get_info(sl_mem_info_t *result);
 
+/**
+ * @brief Get every /proc/meminfo field, including dirty/writeback, slab and hugepages
+ * @param result Pointer to store the fields
+ * @return 0 on success, -1 on error
+ */
+int sl_mem_get_ext(sl_mem_ext_t *result);
+
 /* ------------------- Storage functions ----------------------- */
 
 /**
@@ -162,24 +898,1097 @@ int sl_mem_get_info(sl_mem_info_t *result);
  */
 int sl_storage_get_info(const char *path, sl_storage_info_t *result);
 
+/**
+ * @brief Create a cached mount table for batched storage queries
+ *
+ * /proc/self/mountinfo is parsed once and kept open; it is only parsed
+ * again when the kernel signals a mount table change. With threads > 0,
+ * statvfs() calls are spread over a pool of worker threads, and a query
+ * returns after timeout_ms even if a mount (e.g. a hung NFS server) has
+ * not answered; such entries get error ETIMEDOUT. A worker stuck on a
+ * mount stays busy until the call returns.
+ *
+ * @param threads Number of worker threads, 0 to call statvfs() in the caller
+ * @param timeout_ms Per-query timeout with workers, 0 or less to wait indefinitely
+ * @return New mount table, or NULL on error
+ */
+sl_mounts_t *sl_mounts_create(int threads, int timeout_ms);
 
-/* ----------------------- Logging ----------------------------- */
-/* Log  levels for library message */
-typedef enum {
-    SL_LOG_INFO,
-    SL_LOG_WARN,
-    SL_LOG_ERROR
-} sl_log_level_t;
+/**
+ * @brief Stop the workers and free a mount table
+ * @param mounts Mount table to destroy (NULL is ignored)
+ */
+void sl_mounts_destroy(sl_mounts_t *mounts);
 
-/* Log callback type */
-typedef void (*sl_log_handler_t)(sl_log_level_t level, const char* func, const char* msg, void* user_data);
+/**
+ * @brief Re-parse the mount table regardless of change notifications
+ * @param mounts Mount table
+ * @return Number of mounts, -1 on error
+ */
+int sl_mounts_refresh(sl_mounts_t *mounts);
 
 /**
- * @brief Set library-wide log handler
- * @param handler User-defined callback function, or NULL to disable logging
- * @param user_data User data pointer passed to callback
+ * @brief Get storage information for all or a subset of mounts
+ *
+ * A mount matches if its fstype is one of fstypes and its mount point is
+ * prefix or below it. Mounts are reported in mountinfo order.
+ *
+ * @param mounts Mount table
+ * @param fstypes Comma-separated filesystem types ("ext4,xfs"), or NULL for any
+ * @param prefix Mount point prefix ("/data"), or NULL for any
+ * @param results Array to store the matching mounts
+ * @param max_results Number of entries in the array
+ * @return Number of entries stored, -1 on error
  */
-void sl_set_log_handler(sl_log_handler_t handler, void* user_data);
+int sl_mounts_query(sl_mounts_t *mounts, const char *fstypes, const char *prefix,
+                    sl_mount_info_t *results, int max_results);
+
+/* ------------------- Disk I/O functions ---------------------- */
+
+/**
+ * @brief Get raw block device counters from /proc/diskstats
+ *
+ * Loop and ram devices and partitions are skipped unless requested with
+ * flags. At most SL_DISK_MAX_DEVICES devices are reported.
+ *
+ * @param snapshot Pointer to store the snapshot
+ * @param flags Bitmask of SL_DISK_INCLUDE_* flags, 0 for whole physical disks
+ * @return 0 on success, -1 on error
+ */
+int sl_disk_get_raw(sl_disk_raw_t *snapshot, unsigned flags);
+
+/**
+ * @brief Calculate per-device I/O rates, latency and utilization
+ *
+ * Devices are matched by major:minor; devices missing from start are
+ * skipped.
+ *
+ * @param start Earlier snapshot
+ * @param end Later snapshot
+ * @param results Array to store per-device usage
+ * @param max_results Number of entries in the array
+ * @return Number of entries stored, -1 on error
+ */
+int sl_disk_calculate(const sl_disk_raw_t *start, const sl_disk_raw_t *end, sl_disk_usage_t *results, int max_results);
+
+/* ------------------- Network functions ----------------------- */
+
+/**
+ * @brief Get raw network interface counters from /proc/net/dev
+ *
+ * At most SL_NET_MAX_IFACES interfaces are reported.
+ *
+ * @param snapshot Pointer to store the snapshot
+ * @return 0 on success, -1 on error
+ */
+int sl_net_get_raw(sl_net_raw_t *snapshot);
+
+/**
+ * @brief Calculate per-interface rates between two snapshots
+ *
+ * Snapshots taken through the same sampler are matched by interned id,
+ * others by name. Interfaces missing from start are skipped. Counters
+ * that went backwards are treated as a wrap at the snapshots'
+ * counter_bits (32 only if both say 32 and neither value exceeds 32
+ * bits) when that explains the values, otherwise as a reset (rate 0).
+ *
+ * @param start Earlier snapshot
+ * @param end Later snapshot
+ * @param results Array to store per-interface rates
+ * @param max_results Number of entries in the array
+ * @return Number of entries stored, -1 on error
+ */
+int sl_net_calculate(const sl_net_raw_t *start, const sl_net_raw_t *end, sl_net_usage_t *results, int max_results);
+
+/* ------------------- Pressure and load ----------------------- */
+
+/**
+ * @brief Get raw Pressure Stall Information for a resource
+ * @param resource Resource to read
+ * @param raw Pointer to store the counters
+ * @return 0 on success, -1 on error (including kernels without PSI)
+ */
+int sl_psi_get_raw(sl_psi_resource_t resource, sl_psi_raw_t *raw);
+
+/**
+ * @brief Calculate stall time between two pressure snapshots
+ *
+ * Uses the microsecond total= counters, so the result is exact for any
+ * interval rather than an exponential average. full values are 0 unless
+ * both snapshots have a "full" line.
+ *
+ * @param start Earlier snapshot
+ * @param end Later snapshot
+ * @param result Pointer to store the stall time
+ * @return 0 on success, -1 on error
+ */
+int sl_psi_calculate(const sl_psi_raw_t *start, const sl_psi_raw_t *end, sl_psi_usage_t *result);
+
+/**
+ * @brief Register a PSI trigger
+ *
+ * The kernel signals the trigger when tasks were stalled for at least
+ * stall_us within any window_us window. The window must be between
+ * 500 ms and 10 s; unprivileged processes need a multiple of 2 s.
+ *
+ * @param trigger Pointer to the trigger to initialize
+ * @param resource Resource to watch
+ * @param full Non-zero to watch "full" stalls, zero for "some"
+ * @param stall_us Stall threshold in microseconds
+ * @param window_us Tracking window in microseconds
+ * @return 0 on success, -1 on error
+ */
+int sl_psi_trigger_open(sl_psi_trigger_t *trigger, sl_psi_resource_t resource, int full,
+                        uint32_t stall_us, uint32_t window_us);
+
+/**
+ * @brief Wait for a PSI trigger to fire
+ * @param trigger Registered trigger
+ * @param timeout_ms Timeout in milliseconds, -1 to wait forever, 0 to poll
+ * @return 1 if the trigger fired, 0 on timeout, -1 on error
+ */
+int sl_psi_trigger_wait(const sl_psi_trigger_t *trigger, int timeout_ms);
+
+/**
+ * @brief Unregister a PSI trigger
+ * @param trigger Trigger to close (closed triggers are ignored)
+ */
+void sl_psi_trigger_close(sl_psi_trigger_t *trigger);
+
+/**
+ * @brief Get load averages from /proc/loadavg
+ * @param result Pointer to store the load averages
+ * @return 0 on success, -1 on error
+ */
+int sl_loadavg_get_info(sl_loadavg_t *result);
+
+/* ------------------- cgroup v2 ------------------------------- */
+
+/**
+ * @brief Open a cgroup v2 group for sampling
+ *
+ * Files are opened once and re-read on every sample. Controller files
+ * that do not exist (e.g. memory.max in the root group) are skipped.
+ * The cpu.max and memory.max of every parent up to the cgroup2 mount
+ * are kept open too, since a limit set on a slice or pod binds the
+ * groups below it; the tightest one is reported.
+ * The cgroup2 mount is looked up under the sysfs root, at fs/cgroup or,
+ * on hybrid hierarchies, fs/cgroup/unified.
+ *
+ * @param path Group path relative to the cgroup2 mount ("/system.slice/x.service"),
+ *             or NULL for the caller's own group from /proc/self/cgroup
+ * @return New collector, or NULL on error
+ */
+sl_cgroup_t *sl_cgroup_create(const char *path);
+
+/**
+ * @brief Close all files and free a cgroup collector
+ * @param cgroup Collector to destroy (NULL is ignored)
+ */
+void sl_cgroup_destroy(sl_cgroup_t *cgroup);
+
+/**
+ * @brief Get raw counters and limits of the group
+ * @param cgroup Collector
+ * @param raw Pointer to store the snapshot
+ * @return 0 on success, -1 on error
+ */
+int sl_cgroup_get_raw(sl_cgroup_t *cgroup, sl_cgroup_raw_t *raw);
+
+/**
+ * @brief Calculate usage relative to the group's limits
+ * @param start Earlier snapshot
+ * @param end Later snapshot
+ * @param result Pointer to store the usage
+ * @return 0 on success, -1 on error
+ */
+int sl_cgroup_calculate(const sl_cgroup_raw_t *start, const sl_cgroup_raw_t *end, sl_cgroup_usage_t *result);
+
+/* ------------------- Virtual memory activity ----------------- */
+
+/**
+ * @brief Create a /proc/vmstat collector for a set of counters
+ *
+ * The file is read once here to find the line of each key; later reads
+ * skip straight to those lines and parse only their values. If the
+ * layout changes (different kernel under the same root), the positions
+ * are looked up again.
+ *
+ * @param keys Counter names ("pgfault", "oom_kill", ...), or NULL for the
+ *             SL_VMSTAT_DEFAULT_KEYS counters in sl_vmstat_default_t order
+ * @param key_count Number of keys (at most SL_VMSTAT_MAX_KEYS), ignored if keys is NULL
+ * @return New collector, or NULL on error (including a key given twice)
+ */
+sl_vmstat_t *sl_vmstat_create(const char *const *keys, int key_count);
+
+/**
+ * @brief Close the file and free a vmstat collector
+ * @param vmstat Collector to destroy (NULL is ignored)
+ */
+void sl_vmstat_destroy(sl_vmstat_t *vmstat);
+
+/**
+ * @brief Name of a selected counter
+ * @param vmstat Collector
+ * @param index Position in the snapshot
+ * @return Key name, or NULL if index is out of range
+ */
+const char *sl_vmstat_key(const sl_vmstat_t *vmstat, int index);
+
+/**
+ * @brief Get the selected counters from /proc/vmstat
+ * @param vmstat Collector
+ * @param raw Pointer to store the snapshot
+ * @return 0 on success, -1 on error
+ */
+int sl_vmstat_get_raw(sl_vmstat_t *vmstat, sl_vmstat_raw_t *raw);
+
+/**
+ * @brief Calculate per-second rates between two snapshots
+ *
+ * Counters that went backwards (wrapped or reset) report 0.
+ *
+ * @param start Earlier snapshot
+ * @param end Later snapshot of the same collector
+ * @param result Pointer to store the rates
+ * @return 0 on success, -1 on error
+ */
+int sl_vmstat_calculate(const sl_vmstat_raw_t *start, const sl_vmstat_raw_t *end, sl_vmstat_rates_t *result);
+
+/* ------------------- NUMA topology --------------------------- */
+
+/**
+ * @brief Create a NUMA collector
+ *
+ * Discovers the online nodes and their CPU lists under the library-wide
+ * sysfs root once; later hotplug is not picked up. Each node's meminfo
+ * and numastat stay open, and per-core CPU counters come from one read
+ * of /proc/stat, so sampling does not allocate.
+ *
+ * @return New collector, or NULL on error (including kernels without NUMA sysfs)
+ */
+sl_numa_t *sl_numa_create(void);
+
+/**
+ * @brief Close all files and free a NUMA collector
+ * @param numa Collector to destroy (NULL is ignored)
+ */
+void sl_numa_destroy(sl_numa_t *numa);
+
+/**
+ * @brief Get per-node CPU, memory and allocation counters
+ * @param numa Collector
+ * @param raw Pointer to store the counters
+ * @return 0 on success, -1 on error
+ */
+int sl_numa_get_raw(sl_numa_t *numa, sl_numa_raw_t *raw);
+
+/**
+ * @brief Calculate per-node usage between two snapshots
+ * @param start First snapshot
+ * @param end Second snapshot from the same collector
+ * @param results Array to store one entry per node
+ * @param max_results Number of entries in the array
+ * @return Number of nodes stored, -1 on error
+ */
+int sl_numa_calculate(const sl_numa_raw_t *start, const sl_numa_raw_t *end, sl_numa_usage_t *results, int max_results);
+
+/* ------------------- Interrupts ------------------------------ */
+
+/**
+ * @brief Create a collector for /proc/interrupts or /proc/softirqs
+ *
+ * The first read learns the rows (sources) and columns (online CPUs);
+ * later reads check each row name in place and parse only the numbers.
+ * Rows without a count per CPU (ERR, MIS) are skipped. When IRQs are
+ * registered or CPUs go on- or offline, the layout is relearned and its
+ * generation changes.
+ *
+ * @param source File to read
+ * @return New collector, or NULL on error
+ */
+sl_irq_t *sl_irq_create(sl_irq_source_t source);
+
+/**
+ * @brief Close the file and free an interrupt collector
+ * @param irq Collector to destroy (NULL is ignored)
+ */
+void sl_irq_destroy(sl_irq_t *irq);
+
+/**
+ * @brief Name of a row ("24", "LOC", "NET_RX")
+ * @param irq Collector
+ * @param row Row index of the current layout
+ * @return Name, or NULL if row is out of range
+ */
+const char *sl_irq_name(const sl_irq_t *irq, int row);
+
+/**
+ * @brief Description of a row after the counts ("IR-PCI-MSI 524288-edge eth0-TxRx-0")
+ * @param irq Collector
+ * @param row Row index of the current layout
+ * @return Description (empty for softirqs), or NULL if row is out of range
+ */
+const char *sl_irq_desc(const sl_irq_t *irq, int row);
+
+/**
+ * @brief CPU id of a column
+ * @param irq Collector
+ * @param column Column index of the current layout
+ * @return CPU id, or -1 if column is out of range
+ */
+int sl_irq_cpu(const sl_irq_t *irq, int column);
+
+/**
+ * @brief Prepare a matrix with library-allocated storage
+ *
+ * Storage grows in sl_irq_get_raw() only when the layout grows.
+ *
+ * @param raw Matrix to initialize
+ * @param capacity Initial entries (rows x CPUs), 0 to allocate on first use
+ * @return 0 on success, -1 on error
+ */
+int sl_irq_raw_init(sl_irq_raw_t *raw, int capacity);
+
+/**
+ * @brief Release storage allocated for a matrix
+ * @param raw Matrix
+ */
+void sl_irq_raw_free(sl_irq_raw_t *raw);
+
+/**
+ * @brief Read the counter matrix
+ * @param irq Collector
+ * @param raw Matrix initialized with sl_irq_raw_init()
+ * @return 0 on success, -1 on error
+ */
+int sl_irq_get_raw(sl_irq_t *irq, sl_irq_raw_t *raw);
+
+/**
+ * @brief Calculate per-source per-CPU rates between two matrices
+ * @param start First matrix
+ * @param end Second matrix of the same layout
+ * @param rates Array to store rows x cpus rates per second, row-major
+ * @param max_rates Number of entries in the array
+ * @return Number of rates stored, -1 on error (including a layout change in between)
+ */
+int sl_irq_calculate(const sl_irq_raw_t *start, const sl_irq_raw_t *end, double *rates, int max_rates);
+
+/**
+ * @brief Find the busiest (source, CPU) pairs between two matrices
+ * @param irq Collector the matrices were read with
+ * @param start First matrix
+ * @param end Second matrix of the same layout
+ * @param top Array to store the hotspots, highest rate first
+ * @param max_top Number of entries in the array
+ * @return Number of hotspots stored (pairs with no interrupts are left out), -1 on error
+ */
+int sl_irq_top(const sl_irq_t *irq, const sl_irq_raw_t *start, const sl_irq_raw_t *end,
+               sl_irq_hotspot_t *top, int max_top);
+
+/* ------------------- Sampler context ------------------------- */
+
+/**
+ * @brief Create a sampler that keeps /proc files open across samples
+ *
+ * Files are opened on first use and re-read with pread() into buffers
+ * owned by the sampler, so repeated sampling costs one read syscall per
+ * file and no allocations. A sampler must not be shared between threads
+ * without external locking.
+ *
+ * @return New sampler, or NULL on allocation failure
+ */
+sl_sampler_t *sl_sampler_create(void);
+
+/**
+ * @brief Create a sampler reading from an alternative procfs root
+ *
+ * Paths are resolved once here, e.g. "/host/proc" for a host /proc
+ * bind-mounted into a container, or a directory of recorded files.
+ *
+ * @param proc_root procfs directory, or NULL for the library-wide root
+ * @return New sampler, or NULL on error
+ */
+sl_sampler_t *sl_sampler_create_at(const char *proc_root);
+
+/**
+ * @brief Close all files and free a sampler
+ * @param sampler Sampler to destroy (NULL is ignored)
+ */
+void sl_sampler_destroy(sl_sampler_t *sampler);
+
+/**
+ * @brief Get raw CPU counters from /proc/stat using a sampler
+ * @param sampler Sampler context
+ * @param snapshot Pointer to store raw counters
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_cpu_get_raw(sl_sampler_t *sampler, sl_cpu_raw_t *snapshot);
+
+/**
+ * @brief Get aggregate and per-core CPU counters using a sampler
+ * @param sampler Sampler context
+ * @param snapshot Initialized per-core snapshot
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_cpu_get_raw_cores(sl_sampler_t *sampler, sl_cpu_cores_t *snapshot);
+
+/**
+ * @brief Get memory information from /proc/meminfo using a sampler
+ * @param sampler Sampler context
+ * @param result Pointer to store memory information
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_mem_get_info(sl_sampler_t *sampler, sl_mem_info_t *result);
+
+/**
+ * @brief Get every /proc/meminfo field using a sampler
+ *
+ * The first call learns which field each line holds; later calls only
+ * check each line still starts with the expected key and parse its value.
+ * A changed layout is learned again.
+ *
+ * @param sampler Sampler context
+ * @param result Pointer to store the fields
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_mem_get_ext(sl_sampler_t *sampler, sl_mem_ext_t *result);
+
+/**
+ * @brief Get system uptime and idle time from /proc/uptime using a sampler
+ * @param sampler Sampler context
+ * @param result Pointer to store values
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_systime_get_info(sl_sampler_t *sampler, sl_systime_info_t *result);
+
+/**
+ * @brief Get raw block device counters from /proc/diskstats using a sampler
+ * @param sampler Sampler context
+ * @param snapshot Pointer to store the snapshot
+ * @param flags Bitmask of SL_DISK_INCLUDE_* flags
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_disk_get_raw(sl_sampler_t *sampler, sl_disk_raw_t *snapshot, unsigned flags);
+
+/**
+ * @brief Get raw network interface counters from /proc/net/dev using a sampler
+ * @param sampler Sampler context
+ * @param snapshot Pointer to store the snapshot
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_net_get_raw(sl_sampler_t *sampler, sl_net_raw_t *snapshot);
+
+/**
+ * @brief Get raw Pressure Stall Information using a sampler
+ * @param sampler Sampler context
+ * @param resource Resource to read
+ * @param raw Pointer to store the counters
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_psi_get_raw(sl_sampler_t *sampler, sl_psi_resource_t resource, sl_psi_raw_t *raw);
+
+/**
+ * @brief Get load averages from /proc/loadavg using a sampler
+ * @param sampler Sampler context
+ * @param result Pointer to store the load averages
+ * @return 0 on success, -1 on error
+ */
+int sl_sampler_loadavg_get_info(sl_sampler_t *sampler, sl_loadavg_t *result);
+
+/* ------------------- Snapshots ------------------------------- */
+
+/**
+ * @brief Collect several metric groups in one pass
+ *
+ * Reads the groups selected in mask (SL_SNAPSHOT_*) and stamps each with
+ * CLOCK_MONOTONIC and CLOCK_BOOTTIME. Groups left out of the mask are not
+ * read. Opens and closes its files on every call, so SL_SNAPSHOT_IO_URING
+ * has no effect; use sl_sampler_snapshot_collect() when sampling repeatedly.
+ *
+ * @param mask Groups to collect
+ * @param paths Paths to statvfs() for SL_SNAPSHOT_STORAGE (may be NULL otherwise)
+ * @param path_count Number of paths (at most SL_SNAPSHOT_MAX_PATHS)
+ * @param snapshot Pointer to store the results; collected tells which groups were read
+ * @return 0 if every selected group was read, -1 on error
+ */
+int sl_snapshot_collect(unsigned mask, const char *const *paths, int path_count, sl_snapshot_t *snapshot);
+
+/**
+ * @brief Collect several metric groups in one pass using a sampler
+ *
+ * Like sl_snapshot_collect(), on the sampler's open files. With
+ * SL_SNAPSHOT_IO_URING in mask, once the files are open the procfs reads
+ * are submitted with a single io_uring_enter() where the kernel supports
+ * it, falling back to pread() otherwise. procfs cannot complete reads
+ * inline, so io_uring hands them to kernel worker threads: this saves
+ * syscalls (useful under seccomp auditing or heavy syscall tracing) but is
+ * usually slower than the default pread() path.
+ *
+ * @param sampler Sampler context
+ * @param mask Groups to collect, optionally with SL_SNAPSHOT_IO_URING
+ * @param paths Paths to statvfs() for SL_SNAPSHOT_STORAGE (may be NULL otherwise)
+ * @param path_count Number of paths (at most SL_SNAPSHOT_MAX_PATHS)
+ * @param snapshot Pointer to store the results; collected tells which groups were read
+ * @return 0 if every selected group was read, -1 on error
+ */
+int sl_sampler_snapshot_collect(sl_sampler_t *sampler, unsigned mask, const char *const *paths, int path_count,
+                                sl_snapshot_t *snapshot);
+
+/* ------------------- Process functions ----------------------- */
+
+/**
+ * @brief Create a process sampler
+ *
+ * Holds a directory handle on /proc for openat() and a fixed read buffer,
+ * so sampling processes does no heap allocation. Not thread-safe.
+ *
+ * @return New sampler, or NULL on error
+ */
+sl_proc_sampler_t *sl_proc_sampler_create(void);
+
+/**
+ * @brief Create a process sampler reading from an alternative procfs root
+ * @param proc_root procfs directory, or NULL for the library-wide root
+ * @return New sampler, or NULL on error
+ */
+sl_proc_sampler_t *sl_proc_sampler_create_at(const char *proc_root);
+
+/**
+ * @brief Destroy a process sampler
+ * @param sampler Sampler to destroy (NULL is ignored)
+ */
+void sl_proc_sampler_destroy(sl_proc_sampler_t *sampler);
+
+/**
+ * @brief Read /proc/<pid>/stat, statm and io once
+ * @param sampler Process sampler
+ * @param pid Process id
+ * @param raw Pointer to store raw counters
+ * @return 0 on success, -1 on error (including process exit)
+ */
+int sl_proc_get_raw(sl_proc_sampler_t *sampler, int pid, sl_proc_raw_t *raw);
+
+/**
+ * @brief Open persistent descriptors for a process
+ *
+ * Subsequent sl_proc_handle_get_raw() calls cost one pread() per file.
+ *
+ * @param sampler Process sampler
+ * @param pid Process id
+ * @param handle Handle to initialize
+ * @return 0 on success, -1 on error
+ */
+int sl_proc_open(sl_proc_sampler_t *sampler, int pid, sl_proc_handle_t *handle);
+
+/**
+ * @brief Read raw counters through a persistent handle
+ * @param sampler Process sampler
+ * @param handle Handle opened with sl_proc_open()
+ * @param raw Pointer to store raw counters
+ * @return 0 on success, -1 on error (including process exit)
+ */
+int sl_proc_handle_get_raw(sl_proc_sampler_t *sampler, const sl_proc_handle_t *handle, sl_proc_raw_t *raw);
+
+/**
+ * @brief Close the descriptors of a process handle
+ * @param handle Handle to close
+ */
+void sl_proc_close(sl_proc_handle_t *handle);
+
+/**
+ * @brief Read raw counters of every thread of a process
+ *
+ * Lists /proc/<pid>/task with getdents64 and reads each task's stat and io.
+ * Threads share memory, so only rss from stat is filled.
+ *
+ * @param sampler Process sampler
+ * @param pid Process id
+ * @param threads Array to store per-thread counters
+ * @param max_threads Number of entries in threads
+ * @return Number of threads stored, -1 on error
+ */
+int sl_proc_get_threads(sl_proc_sampler_t *sampler, int pid, sl_proc_raw_t *threads, int max_threads);
+
+/**
+ * @brief Calculate process or thread usage between two snapshots
+ * @param start First snapshot
+ * @param end Second snapshot of the same pid/tid
+ * @param result Pointer to store usage
+ * @return 0 on success, -1 on error (different process or empty interval)
+ */
+int sl_proc_calculate(const sl_proc_raw_t *start, const sl_proc_raw_t *end, sl_proc_usage_t *result);
+
+/**
+ * @brief Create a top-N process scanner
+ *
+ * All memory (previous-counter tables, ranking heap, read buffers) is
+ * allocated here; refreshes do not allocate.
+ *
+ * @param proc_root procfs directory to scan, or NULL for the library-wide root
+ * @param max_procs Maximum number of processes tracked between refreshes
+ * @param top_n Number of entries kept in the ranking
+ * @param key Ranking key
+ * @return New scanner, or NULL on error
+ */
+sl_proc_top_t *sl_proc_top_create(const char *proc_root, int max_procs, int top_n, sl_proc_top_key_t key);
+
+/**
+ * @brief Destroy a top-N process scanner
+ * @param top Scanner to destroy (NULL is ignored)
+ */
+void sl_proc_top_destroy(sl_proc_top_t *top);
+
+/**
+ * @brief Scan all processes and return the current top-N
+ *
+ * Lists the proc directory with getdents64 and reads each <pid>/stat
+ * once. CPU values are relative to the previous refresh, so after the
+ * first refresh every process reports 0 CPU.
+ *
+ * @param top Scanner
+ * @param entries Array to store the ranking, highest first
+ * @param max_entries Number of entries in the array
+ * @return Number of entries stored, -1 on error
+ */
+int sl_proc_top_refresh(sl_proc_top_t *top, sl_proc_top_entry_t *entries, int max_entries);
+
+/* ------------------- Metric history -------------------------- */
+
+/**
+ * @brief Create a fixed-size history of CPU and memory samples
+ *
+ * All memory is allocated here. Each window keeps its statistics up to
+ * date on every push in O(1) amortized time (running sum, monotonic
+ * min/max queues, histogram), so reading them does not scan samples.
+ * A window spans at most capacity samples, whatever its duration.
+ *
+ * @param capacity Samples kept, rounded up to a power of two
+ * @param windows_sec Window durations in seconds (e.g. {60, 300})
+ * @param window_count Number of windows (1 to SL_HISTORY_MAX_WINDOWS)
+ * @return New history, or NULL on error
+ */
+sl_history_t *sl_history_create(int capacity, const float *windows_sec, int window_count);
+
+/**
+ * @brief Free a history
+ * @param history History to destroy (NULL is ignored)
+ */
+void sl_history_destroy(sl_history_t *history);
+
+/**
+ * @brief Append one sample of every metric
+ *
+ * Only one thread may push; any number of threads may read concurrently
+ * without locks.
+ *
+ * @param history History
+ * @param timestamp_ns CLOCK_MONOTONIC time of the sample, 0 for now; must not go backwards
+ * @param cpu CPU usage over the last interval
+ * @param mem Memory information
+ * @return 0 on success, -1 on error
+ */
+int sl_history_push(sl_history_t *history, uint64_t timestamp_ns, const sl_cpu_usage_t *cpu, const sl_mem_info_t *mem);
+
+/**
+ * @brief Get statistics of a metric over a window
+ * @param history History
+ * @param metric Metric
+ * @param window Index into the windows given at creation
+ * @param stats Pointer to store the statistics (count 0 if the window is empty)
+ * @return 0 on success, -1 on error
+ */
+int sl_history_stats(const sl_history_t *history, sl_metric_t metric, int window, sl_history_stats_t *stats);
+
+/**
+ * @brief Copy the most recent samples of a metric, oldest first
+ * @param history History
+ * @param metric Metric
+ * @param timestamps Array to store sample times (may be NULL)
+ * @param values Array to store sample values
+ * @param max_samples Number of entries in the arrays
+ * @return Number of samples stored, -1 on error
+ */
+int sl_history_read(const sl_history_t *history, sl_metric_t metric, uint64_t *timestamps, float *values, int max_samples);
+
+/* ------------------- Recording ------------------------------- */
+
+/**
+ * @brief Open a recording for appending, creating it if needed
+ *
+ * Snapshots are stored as varint-encoded deltas against the previous
+ * snapshot of the same kind, so a CPU sample at 10 Hz takes about 15
+ * bytes. Records are collected in a buffer and written with one write()
+ * when it fills up, on sl_recorder_flush() and on close; a crash loses
+ * at most the buffered records. Each open starts a new session record.
+ *
+ * @param path Recording file; an existing file must be a recording
+ * @param buffer_size Write buffer size in bytes, 0 for 64 KiB
+ * @return New recorder, or NULL on error
+ */
+sl_recorder_t *sl_recorder_open(const char *path, size_t buffer_size);
+
+/**
+ * @brief Record CPU counters
+ * @param recorder Recorder
+ * @param timestamp_ns CLOCK_MONOTONIC time of the snapshot, 0 for now
+ * @param cpu Raw counters
+ * @return 0 on success, -1 on error
+ */
+int sl_recorder_write_cpu(sl_recorder_t *recorder, uint64_t timestamp_ns, const sl_cpu_raw_t *cpu);
+
+/**
+ * @brief Record memory information (raw fields; used and percentages are derived on replay)
+ * @param recorder Recorder
+ * @param timestamp_ns CLOCK_MONOTONIC time of the snapshot, 0 for now
+ * @param mem Memory information
+ * @return 0 on success, -1 on error
+ */
+int sl_recorder_write_mem(sl_recorder_t *recorder, uint64_t timestamp_ns, const sl_mem_info_t *mem);
+
+/**
+ * @brief Record uptime and idle time
+ * @param recorder Recorder
+ * @param timestamp_ns CLOCK_MONOTONIC time of the snapshot, 0 for now
+ * @param systime System time information
+ * @return 0 on success, -1 on error
+ */
+int sl_recorder_write_systime(sl_recorder_t *recorder, uint64_t timestamp_ns, const sl_systime_info_t *systime);
+
+/**
+ * @brief Record storage information of one mount point
+ * @param recorder Recorder
+ * @param timestamp_ns CLOCK_MONOTONIC time of the snapshot, 0 for now
+ * @param slot Caller-chosen index of the mount point (0 to SL_RECORD_MAX_SLOTS - 1)
+ * @param storage Storage information
+ * @return 0 on success, -1 on error
+ */
+int sl_recorder_write_storage(sl_recorder_t *recorder, uint64_t timestamp_ns, int slot, const sl_storage_info_t *storage);
+
+/**
+ * @brief Write buffered records to the file
+ *
+ * If the write fails the buffered records are dropped and the next
+ * record starts a new session, so the file stays decodable.
+ *
+ * @param recorder Recorder
+ * @return 0 on success, -1 on error
+ */
+int sl_recorder_flush(sl_recorder_t *recorder);
+
+/**
+ * @brief Flush and close a recording
+ * @param recorder Recorder to close (NULL is ignored)
+ * @return 0 on success, -1 if the final flush failed
+ */
+int sl_recorder_close(sl_recorder_t *recorder);
+
+/**
+ * @brief Map a recording for reading
+ *
+ * Records are decoded straight from the mapping. Data appended after
+ * opening is not seen.
+ *
+ * @param path Recording file
+ * @return New reader, or NULL on error
+ */
+sl_replay_t *sl_replay_open(const char *path);
+
+/**
+ * @brief Decode the next record
+ *
+ * Damaged data (e.g. a record torn by a crash or a full disk) is skipped
+ * up to the next session with a warning.
+ *
+ * @param replay Reader
+ * @param record Pointer to store the record
+ * @return 1 if a record was stored, 0 at the end of the recording, -1 on error
+ */
+int sl_replay_next(sl_replay_t *replay, sl_record_t *record);
+
+/**
+ * @brief Unmap and free a reader
+ * @param replay Reader to close (NULL is ignored)
+ */
+void sl_replay_close(sl_replay_t *replay);
+
+/* ------------------- Background monitor ---------------------- */
+
+/**
+ * @brief Start the background monitor thread
+ *
+ * The thread samples CPU, memory, uptime and the given mount points every
+ * interval and publishes the results for sl_monitor_read(). Mount paths
+ * are copied. Only one monitor can run at a time.
+ *
+ * @param interval_sec Sampling interval in seconds (minimum 0.01)
+ * @param mounts Array of mount point paths, or NULL if mount_count is 0
+ * @param mount_count Number of mount points (at most SL_MONITOR_MAX_MOUNTS)
+ * @return 0 on success, -1 on error
+ */
+int sl_monitor_start(float interval_sec, const char *const *mounts, int mount_count);
+
+/**
+ * @brief Stop the background monitor thread and wait for it to exit
+ * @return 0 on success, -1 if the monitor is not running
+ */
+int sl_monitor_stop(void);
+
+/**
+ * @brief Copy the latest snapshot published by the monitor
+ *
+ * Lock-free and syscall-free; safe to call from any number of threads.
+ * The first snapshot is available one interval after sl_monitor_start().
+ *
+ * @param snapshot Pointer to store the snapshot
+ * @return 0 on success, -1 if no snapshot has been published yet
+ */
+int sl_monitor_read(sl_monitor_snapshot_t *snapshot);
+
+/* ------------------- Cross-process sharing ------------------- */
+
+/**
+ * @brief Create a publisher writing snapshots to a POSIX shared memory segment
+ *
+ * One process samples and any number of processes read the results with
+ * sl_subscriber_read(). The segment is created if needed (mode 0644) and
+ * locked, so only one publisher per name can exist. Mount paths are copied.
+ *
+ * @param name shm_open() name such as "/sysload", or NULL for SL_SHARED_DEFAULT_NAME
+ * @param mounts Array of mount point paths, or NULL if mount_count is 0
+ * @param mount_count Number of mount points (at most SL_MONITOR_MAX_MOUNTS)
+ * @return New publisher, or NULL on error (including another live publisher)
+ */
+sl_publisher_t *sl_publisher_create(const char *name, const char *const *mounts, int mount_count);
+
+/**
+ * @brief Collect CPU, memory, uptime and storage once and publish them
+ *
+ * CPU usage covers the time since the previous update (since creation on
+ * the first one). Call at the sampling interval; every call also renews
+ * the heartbeat subscribers use to detect a dead publisher.
+ *
+ * @param publisher Publisher
+ * @return 0 on success, -1 if a group could not be read (the rest is still published)
+ */
+int sl_publisher_update(sl_publisher_t *publisher);
+
+/**
+ * @brief Stop publishing, remove the segment name and free a publisher
+ *
+ * Subscribers still mapping the segment see it as stale and fall back.
+ *
+ * @param publisher Publisher to destroy (NULL is ignored)
+ */
+void sl_publisher_destroy(sl_publisher_t *publisher);
+
+/**
+ * @brief Create a subscriber for a published segment
+ *
+ * Succeeds whether or not a publisher is running; the segment is mapped
+ * read-only when it appears. Mount paths are copied and only used when
+ * collecting directly.
+ *
+ * @param name shm_open() name, or NULL for SL_SHARED_DEFAULT_NAME
+ * @param max_age_sec Heartbeat age after which the publisher counts as dead
+ * @param mounts Mount points to read when falling back, or NULL if mount_count is 0
+ * @param mount_count Number of mount points (at most SL_MONITOR_MAX_MOUNTS)
+ * @return New subscriber, or NULL on error
+ */
+sl_subscriber_t *sl_subscriber_create(const char *name, float max_age_sec, const char *const *mounts, int mount_count);
+
+/**
+ * @brief Get the latest snapshot, from the publisher if it is alive
+ *
+ * With a live publisher this copies the snapshot under a seqlock and
+ * makes no syscalls. Otherwise it samples directly through its own
+ * sampler (CPU usage then covers the time since the previous fallback
+ * read, and is 0 on the first) and retries attaching at most once per
+ * max_age_sec.
+ *
+ * @param subscriber Subscriber
+ * @param snapshot Pointer to store the snapshot
+ * @return 0 if read from the publisher, 1 if collected directly, -1 on error
+ */
+int sl_subscriber_read(sl_subscriber_t *subscriber, sl_monitor_snapshot_t *snapshot);
+
+/**
+ * @brief Unmap the segment and free a subscriber
+ * @param subscriber Subscriber to destroy (NULL is ignored)
+ */
+void sl_subscriber_destroy(sl_subscriber_t *subscriber);
+
+/* ------------------- Scheduler ------------------------------- */
+
+/**
+ * @brief Create a collection scheduler
+ *
+ * Collectors registered with sl_sched_add() run at their own intervals
+ * from a single timerfd. Deadlines are aligned to the creation time, so
+ * collectors whose intervals are multiples of each other fall due on the
+ * same tick and run as one batch: the due /proc files are read in one
+ * pass and the results share a timestamp. Not thread-safe; the scheduler
+ * runs on the thread that dispatches it.
+ *
+ * @return New scheduler, or NULL on error
+ */
+sl_sched_t *sl_sched_create(void);
+
+/**
+ * @brief Close the scheduler's descriptors and free it
+ * @param sched Scheduler to destroy (NULL is ignored)
+ */
+void sl_sched_destroy(sl_sched_t *sched);
+
+/**
+ * @brief Register a collector
+ *
+ * The first run is on the first tick of the interval after now. Intervals
+ * are rounded to microseconds. May be called from a callback.
+ *
+ * SL_SCHED_STORAGE collectors call statvfs() on a pool of worker threads,
+ * created with the first one. Dispatch waits for them at most the storage
+ * timeout (see sl_sched_set_storage_timeout()); a path that has not
+ * answered by then, e.g. a hung NFS or FUSE mount, gets status -1 for
+ * that run and keeps a worker busy until statvfs() returns.
+ *
+ * @param sched Scheduler
+ * @param kind What to read
+ * @param path Path to statvfs() for SL_SCHED_STORAGE (copied), NULL otherwise
+ * @param interval_sec Interval in seconds (minimum 0.001)
+ * @param callback Called with the result after every run
+ * @param user_data Passed to callback
+ * @return Collector id (>= 0), or -1 on error (including SL_SCHED_MAX_COLLECTORS reached)
+ */
+int sl_sched_add(sl_sched_t *sched, sl_sched_kind_t kind, const char *path, float interval_sec,
+                 sl_sched_callback_t callback, void *user_data);
+
+/**
+ * @brief Unregister a collector; may be called from a callback
+ * @param sched Scheduler
+ * @param id Id returned by sl_sched_add()
+ * @return 0 on success, -1 if id is not registered
+ */
+int sl_sched_remove(sl_sched_t *sched, int id);
+
+/**
+ * @brief Set how long a dispatch waits for storage collectors
+ * @param sched Scheduler
+ * @param timeout_ms Timeout in milliseconds (default 500), 0 or less to wait indefinitely
+ * @return 0 on success, -1 if sched is NULL
+ */
+int sl_sched_set_storage_timeout(sl_sched_t *sched, int timeout_ms);
+
+/**
+ * @brief Get the scheduler's epoll descriptor
+ *
+ * The descriptor becomes readable (EPOLLIN) when a batch is due. Add it to
+ * an existing epoll, poll or select loop and call sl_sched_dispatch()
+ * when it is readable; it stays owned by the scheduler.
+ *
+ * @param sched Scheduler
+ * @return Descriptor, or -1 if sched is NULL
+ */
+int sl_sched_fd(const sl_sched_t *sched);
+
+/**
+ * @brief Run the collectors that are due
+ *
+ * Every collector due now (or within a millisecond) runs in one batch,
+ * then the timer is re-armed for the next deadline. Only storage
+ * collectors can make it wait, for at most the storage timeout. Ticks missed because
+ * dispatch was late are skipped rather than run back to back.
+ *
+ * @param sched Scheduler
+ * @return Number of collectors run (0 if none was due), -1 on error
+ */
+int sl_sched_dispatch(sl_sched_t *sched);
+
+/**
+ * @brief Wait for the next batch and run it
+ *
+ * For callers without an event loop of their own.
+ *
+ * @param sched Scheduler
+ * @param timeout_ms Maximum wait in milliseconds, -1 to wait for the next batch
+ * @return Number of collectors run (0 on timeout), -1 on error
+ */
+int sl_sched_run(sl_sched_t *sched, int timeout_ms);
+
+
+/* ------------------- Filesystem roots ------------------------ */
+
+/**
+ * @brief Set the library-wide procfs root (default "/proc")
+ *
+ * Used by one-shot functions and by contexts created afterwards without
+ * an explicit root; existing contexts keep the root they resolved.
+ * Other threads may sample concurrently and see either root.
+ *
+ * @param path Directory to use instead of /proc, or NULL to restore the default
+ * @return 0 on success, -1 on error
+ */
+int sl_set_proc_root(const char *path);
+
+/**
+ * @brief Set the library-wide sysfs root (default "/sys")
+ * @param path Directory to use instead of /sys, or NULL to restore the default
+ * @return 0 on success, -1 on error
+ */
+int sl_set_sys_root(const char *path);
+
+/* ----------------------- Logging ----------------------------- */
+/* Log  levels for library message */
+typedef enum {
+    SL_LOG_INFO,
+    SL_LOG_WARN,
+    SL_LOG_ERROR
+} sl_log_level_t;
+
+/* Log callback type */
+typedef void (*sl_log_handler_t)(sl_log_level_t level, const char* func, const char* msg, void* user_data);
+
+/**
+ * @brief Set library-wide log handler
+ *
+ * Safe to call while other threads use the library; each message goes
+ * to either the old or the new handler with its own user data.
+ *
+ * @param handler User-defined callback function, or NULL to disable logging
+ * @param user_data User data pointer passed to callback
+ */
+void sl_set_log_handler(sl_log_handler_t handler, void* user_data);
+
+/**
+ * @brief Set the lowest level that is logged
+ *
+ * Messages below it are discarded before they are formatted.
+ *
+ * @param min_level Minimum level (default SL_LOG_INFO)
+ */
+void sl_set_log_level(sl_log_level_t min_level);
+
+/**
+ * @brief Queue messages per thread instead of calling the handler
+ *
+ * When enabled, a library call that logs formats the message into a
+ * ring owned by the calling thread (64 messages) and returns without
+ * locking or calling the handler. sl_log_drain() delivers the queued
+ * messages; those that did not fit are counted and reported instead.
+ *
+ * @param enabled Non-zero to queue, zero to call the handler directly (default)
+ */
+void sl_set_log_deferred(int enabled);
+
+/**
+ * @brief Pass queued messages of all threads to the log handler
+ *
+ * Messages keep their order within a thread. Without a handler they
+ * are discarded.
+ *
+ * @return Number of messages delivered
+ */
+int sl_log_drain(void);
 
 
 #ifdef __cplusplus
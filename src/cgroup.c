@@ -0,0 +1,417 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+enum {
+        CG_CPU_STAT,
+        CG_CPU_MAX,
+        CG_MEMORY_CURRENT,
+        CG_MEMORY_MAX,
+        CG_MEMORY_STAT,
+        CG_IO_STAT,
+        CG_FILES
+};
+
+static const char *const cgroup_files[CG_FILES] = {
+        "cpu.stat", "cpu.max", "memory.current", "memory.max", "memory.stat", "io.stat"
+};
+
+/* Parent groups whose limits are checked, nearest first */
+#define CG_MAX_ANCESTORS 32
+
+struct sl_cgroup
+{
+        char dir[SL_PATH_SIZE];             /**< Absolute path of the group directory */
+        sl_procfile_t files[CG_FILES];      /**< fd is -1 for files the group does not have */
+        sl_procfile_t parent_cpu_max[CG_MAX_ANCESTORS];
+        sl_procfile_t parent_memory_max[CG_MAX_ANCESTORS];
+        int parents;                        /**< Ancestors up to the cgroup2 mount */
+        double host_cpus;
+        uint64_t host_memory;
+};
+
+/* Keys of flat-keyed files ("key value" per line) and where they go */
+typedef struct
+{
+        const char *key;
+        size_t len;
+        size_t offset;
+} cgroup_key_t;
+
+#define CG_KEY(name, field) {name, sizeof(name) - 1, offsetof(sl_cgroup_raw_t, field)}
+
+static const cgroup_key_t cpu_stat_keys[] = {
+        CG_KEY("usage_usec", usage_usec),
+        CG_KEY("user_usec", user_usec),
+        CG_KEY("system_usec", system_usec),
+        CG_KEY("nr_periods", nr_periods),
+        CG_KEY("nr_throttled", nr_throttled),
+        CG_KEY("throttled_usec", throttled_usec),
+};
+
+static const cgroup_key_t memory_stat_keys[] = {
+        CG_KEY("anon", anon),
+        CG_KEY("file", file),
+        CG_KEY("shmem", shmem),
+        CG_KEY("slab", slab),
+        CG_KEY("sock", sock),
+        CG_KEY("active_file", active_file),
+        CG_KEY("inactive_file", inactive_file),
+        CG_KEY("pgmajfault", pgmajfault),
+};
+
+
+/* Read "0::/path" from /proc/self/cgroup into path */
+static int cgroup_self_path(char *path, size_t size)
+{
+        char root[SL_ROOT_SIZE];
+        sl_procfile_t file;
+        sl_procfile_init(&file, sl_proc_root(root), "self/cgroup");
+
+        int ret = -1;
+        if (sl_procfile_read(&file) == 0) {
+                const char *end = file.buf + file.len;
+                for (const char *line = file.len ? file.buf : NULL; line; line = sl_next_line(line, end)) {
+                        if (strncmp(line, "0::", 3) != 0) continue;
+
+                        const char *p = line + 3;
+                        size_t len = strcspn(p, "\n");
+                        if (len < size) {
+                                memcpy(path, p, len);
+                                path[len] = '\0';
+                                ret = 0;
+                        }
+                        break;
+                }
+                if (ret != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "no cgroup v2 entry in %s", file.path);
+                }
+        }
+
+        sl_procfile_close(&file);
+        return ret;
+}
+
+
+/* Find the cgroup2 mount: fs/cgroup on unified hosts, fs/cgroup/unified on hybrid ones */
+static int cgroup_mount(char *mount, size_t size)
+{
+        static const char *const candidates[] = {"fs/cgroup", "fs/cgroup/unified"};
+        char root[SL_ROOT_SIZE], probe[SL_PATH_SIZE];
+
+        sl_sys_root(root);
+        for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+                snprintf(probe, sizeof(probe), "%s/%s/cgroup.controllers", root, candidates[i]);
+                if (access(probe, F_OK) == 0) {
+                        snprintf(mount, size, "%s/%s", root, candidates[i]);
+                        return 0;
+                }
+        }
+
+        sl_log(SL_LOG_ERROR, __func__, "no cgroup v2 hierarchy under %s/fs/cgroup", root);
+        return -1;
+}
+
+
+/* Host totals used as limits when the group has none */
+static void cgroup_host_limits(sl_cgroup_t *cgroup)
+{
+        sl_sampler_t sampler;
+        sl_mem_info_t mem;
+        sl_cpu_cores_t cores;
+
+        sl_sampler_init(&sampler, NULL);
+
+        cgroup->host_memory = 0;
+        if (sl_sampler_mem_get_info(&sampler, &mem) == 0) {
+                cgroup->host_memory = mem.total * 1024;
+        }
+
+        cgroup->host_cpus = 0.0;
+        if (sl_cpu_cores_init(&cores, 0) == 0) {
+                if (sl_sampler_cpu_get_raw_cores(&sampler, &cores) == 0) {
+                        for (int i = 0; i < cores.count; i++) {
+                                cgroup->host_cpus += cores.online[i] ? 1.0 : 0.0;
+                        }
+                }
+                sl_cpu_cores_free(&cores);
+        }
+        if (cgroup->host_cpus < 1.0) {
+                long n = sysconf(_SC_NPROCESSORS_ONLN);
+                cgroup->host_cpus = (n > 0) ? (double)n : 1.0;
+        }
+
+        sl_sampler_fini(&sampler);
+}
+
+
+sl_cgroup_t *sl_cgroup_create(const char *path)
+{
+        char self[SL_PATH_SIZE];
+        char mount[SL_PATH_SIZE];
+
+        if (!path) {
+                if (cgroup_self_path(self, sizeof(self)) != 0) return NULL;
+                path = self;
+        }
+
+        if (cgroup_mount(mount, sizeof(mount)) != 0) {
+                return NULL;
+        }
+
+        sl_cgroup_t *cgroup = malloc(sizeof(*cgroup));
+        if (!cgroup) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate cgroup collector");
+                return NULL;
+        }
+
+        /* "/" is the root group; leave room for the longest file name */
+        int n = snprintf(cgroup->dir, sizeof(cgroup->dir), "%s%s", mount, strcmp(path, "/") == 0 ? "" : path);
+        if (n < 0 || (size_t)n + sizeof("/memory.current") > sizeof(cgroup->dir)) {
+                sl_log(SL_LOG_ERROR, __func__, "cgroup path is too long: %.64s", path);
+                free(cgroup);
+                return NULL;
+        }
+
+        for (int i = 0; i < CG_FILES; i++) {
+                sl_procfile_init(&cgroup->files[i], cgroup->dir, cgroup_files[i]);
+                cgroup->files[i].fd = open(cgroup->files[i].path, O_RDONLY | O_CLOEXEC);
+        }
+
+        /*
+         * Limits set on a parent (a systemd slice, a Kubernetes pod) bind
+         * the group too, so keep the parents' limit files open as well.
+         */
+        char parent[SL_PATH_SIZE];
+        size_t mount_len = strlen(mount);
+        strcpy(parent, cgroup->dir);
+        cgroup->parents = 0;
+        while (strlen(parent) > mount_len) {
+                if (cgroup->parents == CG_MAX_ANCESTORS) {
+                        sl_log(SL_LOG_WARN, __func__, "limits more than %d levels above %s are ignored",
+                               CG_MAX_ANCESTORS, cgroup->dir);
+                        break;
+                }
+                *strrchr(parent, '/') = '\0';
+
+                int i = cgroup->parents++;
+                sl_procfile_init(&cgroup->parent_cpu_max[i], parent, "cpu.max");
+                cgroup->parent_cpu_max[i].fd = open(cgroup->parent_cpu_max[i].path, O_RDONLY | O_CLOEXEC);
+                sl_procfile_init(&cgroup->parent_memory_max[i], parent, "memory.max");
+                cgroup->parent_memory_max[i].fd = open(cgroup->parent_memory_max[i].path, O_RDONLY | O_CLOEXEC);
+        }
+
+        if (cgroup->files[CG_CPU_STAT].fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s", cgroup->files[CG_CPU_STAT].path);
+                sl_cgroup_destroy(cgroup);
+                return NULL;
+        }
+
+        cgroup_host_limits(cgroup);
+        return cgroup;
+}
+
+
+void sl_cgroup_destroy(sl_cgroup_t *cgroup)
+{
+        if (!cgroup) return;
+
+        for (int i = 0; i < CG_FILES; i++) {
+                sl_procfile_close(&cgroup->files[i]);
+        }
+        for (int i = 0; i < cgroup->parents; i++) {
+                sl_procfile_close(&cgroup->parent_cpu_max[i]);
+                sl_procfile_close(&cgroup->parent_memory_max[i]);
+        }
+        free(cgroup);
+}
+
+
+static void cgroup_parse_keys(const sl_procfile_t *file, const cgroup_key_t *keys, size_t count, sl_cgroup_raw_t *raw)
+{
+        const char *end = file->buf + file->len;
+
+        for (const char *line = file->len ? file->buf : NULL; line; line = sl_next_line(line, end)) {
+                for (size_t i = 0; i < count; i++) {
+                        if (strncmp(line, keys[i].key, keys[i].len) == 0 && line[keys[i].len] == ' ') {
+                                sl_parse_u64(line + keys[i].len, (uint64_t *)((char *)raw + keys[i].offset));
+                                break;
+                        }
+                }
+        }
+}
+
+
+/* A single number, or "max" for no limit */
+static uint64_t cgroup_parse_limit(const char *p)
+{
+        uint64_t value;
+        return sl_parse_u64(p, &value) ? value : SL_CGROUP_UNLIMITED;
+}
+
+
+/* "quota period" from cpu.max; 0 on success */
+static int cgroup_read_cpu_max(sl_procfile_t *file, uint64_t *quota, uint64_t *period)
+{
+        if (file->fd < 0 || sl_procfile_read(file) != 0) return -1;
+
+        const char *p = file->buf;
+        *quota = cgroup_parse_limit(p);
+        while (*p != ' ' && *p != '\0') p++;
+        if (!sl_parse_u64(p, period)) *period = 100000;
+        return 0;
+}
+
+
+/* Tighten the limits in raw with those of every parent group */
+static void cgroup_parent_limits(sl_cgroup_t *cgroup, sl_cgroup_raw_t *raw)
+{
+        for (int i = 0; i < cgroup->parents; i++) {
+                uint64_t quota, period;
+                if (cgroup_read_cpu_max(&cgroup->parent_cpu_max[i], &quota, &period) == 0 &&
+                    quota != SL_CGROUP_UNLIMITED && period > 0) {
+                        /* Compare CPUs allowed, since periods may differ between levels */
+                        if (raw->cpu_quota_usec == SL_CGROUP_UNLIMITED ||
+                            (double)quota / (double)period < (double)raw->cpu_quota_usec / (double)raw->cpu_period_usec) {
+                                raw->cpu_quota_usec = quota;
+                                raw->cpu_period_usec = period;
+                        }
+                }
+
+                sl_procfile_t *memory_max = &cgroup->parent_memory_max[i];
+                if (memory_max->fd >= 0 && sl_procfile_read(memory_max) == 0) {
+                        uint64_t limit = cgroup_parse_limit(memory_max->buf);
+                        if (limit < raw->memory_max) raw->memory_max = limit;
+                }
+        }
+}
+
+
+/* "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0" per device */
+static void cgroup_parse_io(const sl_procfile_t *file, sl_cgroup_raw_t *raw)
+{
+        const char *p = file->buf;
+
+        while (*p != '\0') {
+                uint64_t value;
+                const char *eq = p;
+                while (*eq != '=' && *eq != ' ' && *eq != '\n' && *eq != '\0') eq++;
+
+                if (*eq == '=' && sl_parse_u64(eq + 1, &value)) {
+                        size_t len = (size_t)(eq - p);
+                        if (len == 6 && memcmp(p, "rbytes", 6) == 0) raw->io_rbytes += value;
+                        else if (len == 6 && memcmp(p, "wbytes", 6) == 0) raw->io_wbytes += value;
+                        else if (len == 4 && memcmp(p, "rios", 4) == 0) raw->io_rios += value;
+                        else if (len == 4 && memcmp(p, "wios", 4) == 0) raw->io_wios += value;
+                }
+
+                /* Next token */
+                p = eq;
+                while (*p != ' ' && *p != '\n' && *p != '\0') p++;
+                while (*p == ' ' || *p == '\n') p++;
+        }
+}
+
+
+int sl_cgroup_get_raw(sl_cgroup_t *cgroup, sl_cgroup_raw_t *raw)
+{
+        if (!cgroup || !raw) {
+                sl_log(SL_LOG_ERROR, __func__, "cgroup or raw pointer is NULL");
+                return -1;
+        }
+
+        memset(raw, 0, sizeof(*raw));
+        raw->cpu_quota_usec = SL_CGROUP_UNLIMITED;
+        raw->memory_max = SL_CGROUP_UNLIMITED;
+        raw->host_cpus = cgroup->host_cpus;
+        raw->host_memory = cgroup->host_memory;
+
+        sl_procfile_t *files = cgroup->files;
+
+        if (sl_procfile_read(&files[CG_CPU_STAT]) != 0) {
+                return -1;
+        }
+        cgroup_parse_keys(&files[CG_CPU_STAT], cpu_stat_keys, sizeof(cpu_stat_keys) / sizeof(cpu_stat_keys[0]), raw);
+
+        if (cgroup_read_cpu_max(&files[CG_CPU_MAX], &raw->cpu_quota_usec, &raw->cpu_period_usec) == 0) {
+                raw->controllers |= SL_CGROUP_CPU;
+        }
+
+        if (files[CG_MEMORY_CURRENT].fd >= 0 && sl_procfile_read(&files[CG_MEMORY_CURRENT]) == 0) {
+                sl_parse_u64(files[CG_MEMORY_CURRENT].buf, &raw->memory_current);
+                raw->controllers |= SL_CGROUP_MEMORY;
+
+                if (files[CG_MEMORY_MAX].fd >= 0 && sl_procfile_read(&files[CG_MEMORY_MAX]) == 0) {
+                        raw->memory_max = cgroup_parse_limit(files[CG_MEMORY_MAX].buf);
+                }
+                if (files[CG_MEMORY_STAT].fd >= 0 && sl_procfile_read(&files[CG_MEMORY_STAT]) == 0) {
+                        cgroup_parse_keys(&files[CG_MEMORY_STAT], memory_stat_keys,
+                                          sizeof(memory_stat_keys) / sizeof(memory_stat_keys[0]), raw);
+                }
+        }
+
+        if (files[CG_IO_STAT].fd >= 0 && sl_procfile_read(&files[CG_IO_STAT]) == 0) {
+                cgroup_parse_io(&files[CG_IO_STAT], raw);
+                raw->controllers |= SL_CGROUP_IO;
+        }
+
+        cgroup_parent_limits(cgroup, raw);
+
+        raw->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+static inline uint64_t cgroup_delta(uint64_t start, uint64_t end)
+{
+        return (end >= start) ? end - start : 0;
+}
+
+
+int sl_cgroup_calculate(const sl_cgroup_raw_t *start, const sl_cgroup_raw_t *end, sl_cgroup_usage_t *result)
+{
+        if (!start || !end || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end or result pointer is NULL");
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval");
+                return -1;
+        }
+
+        double elapsed_us = (double)(end->timestamp_ns - start->timestamp_ns) / 1e3;
+        double elapsed_sec = elapsed_us / 1e6;
+
+        result->cpu_percent = (double)cgroup_delta(start->usage_usec, end->usage_usec) / elapsed_us * 100.0;
+        if (end->cpu_quota_usec != SL_CGROUP_UNLIMITED && end->cpu_period_usec > 0) {
+                result->cpu_limit = (double)end->cpu_quota_usec / (double)end->cpu_period_usec;
+        } else {
+                result->cpu_limit = end->host_cpus;
+        }
+        result->cpu_percent_of_limit = (result->cpu_limit > 0.0) ? result->cpu_percent / result->cpu_limit : 0.0;
+
+        uint64_t periods = cgroup_delta(start->nr_periods, end->nr_periods);
+        uint64_t throttled = cgroup_delta(start->nr_throttled, end->nr_throttled);
+        result->throttled_percent = periods ? (double)throttled / (double)periods * 100.0 : 0.0;
+
+        /* Inactive file cache is reclaimed before the group hits its limit */
+        result->memory_used = end->memory_current;
+        result->memory_working_set = (end->memory_current > end->inactive_file) ? end->memory_current - end->inactive_file : 0;
+        result->memory_limit = (end->memory_max != SL_CGROUP_UNLIMITED) ? end->memory_max : end->host_memory;
+        if (end->host_memory > 0 && result->memory_limit > end->host_memory) {
+                result->memory_limit = end->host_memory;
+        }
+        result->memory_percent = result->memory_limit ? (double)result->memory_working_set / (double)result->memory_limit * 100.0 : 0.0;
+
+        result->read_bytes_per_sec = cgroup_delta(start->io_rbytes, end->io_rbytes) / elapsed_sec;
+        result->write_bytes_per_sec = cgroup_delta(start->io_wbytes, end->io_wbytes) / elapsed_sec;
+        result->read_iops = cgroup_delta(start->io_rios, end->io_rios) / elapsed_sec;
+        result->write_iops = cgroup_delta(start->io_wios, end->io_wios) / elapsed_sec;
+
+        return 0;
+}
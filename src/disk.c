@@ -0,0 +1,195 @@
+#include "sysload_internal.h"
+#include <string.h>
+
+#define SECTOR_SIZE 512ULL
+
+
+static int name_has_prefix(const char *name, size_t len, const char *prefix)
+{
+        size_t plen = strlen(prefix);
+        return len > plen && memcmp(name, prefix, plen) == 0;
+}
+
+
+/* loop and ram devices are backed by files or memory, not storage */
+static int disk_is_virtual(const char *name, size_t len)
+{
+        return name_has_prefix(name, len, "loop") || name_has_prefix(name, len, "ram");
+}
+
+
+/*
+ * Decide from the name alone whether a device is a partition, so filtering
+ * needs no sysfs lookups: sda1/vdb2/xvda1/hdc3 end in a digit, while
+ * nvme0n1p2/mmcblk0p1/nbd0p1 use a 'p' between the device and partition
+ * number. dm-N, mdN, zramN and the like are whole devices.
+ */
+static int disk_is_partition(const char *name, size_t len)
+{
+        if ((unsigned)(name[len - 1] - '0') > 9) return 0;
+
+        if (name_has_prefix(name, len, "sd") || name_has_prefix(name, len, "vd") ||
+            name_has_prefix(name, len, "xvd") || name_has_prefix(name, len, "hd")) {
+                return 1;
+        }
+
+        if (name_has_prefix(name, len, "nvme") || name_has_prefix(name, len, "mmcblk") ||
+            name_has_prefix(name, len, "nbd")) {
+                size_t i = len;
+                while (i > 0 && (unsigned)(name[i - 1] - '0') <= 9) i--;
+                return i >= 2 && name[i - 1] == 'p' && (unsigned)(name[i - 2] - '0') <= 9;
+        }
+
+        return 0;
+}
+
+
+int sl_parse_diskstats(const char *buf, size_t len, unsigned flags, sl_disk_raw_t *snapshot)
+{
+        const char *end = buf + len;
+        int count = 0;
+        int dropped = 0;
+
+        for (const char *line = (len > 0) ? buf : NULL; line; line = sl_next_line(line, end)) {
+                uint64_t major, minor;
+                const char *p = sl_parse_u64(line, &major);
+                if (p) p = sl_parse_u64(p, &minor);
+                if (!p) continue;
+
+                p = sl_skip_blanks(p);
+                const char *name = p;
+                while (*p != ' ' && *p != '\n' && *p != '\0') p++;
+                size_t name_len = (size_t)(p - name);
+                if (name_len == 0) continue;
+
+                if (!(flags & SL_DISK_INCLUDE_VIRTUAL) && disk_is_virtual(name, name_len)) continue;
+                if (!(flags & SL_DISK_INCLUDE_PARTITIONS) && disk_is_partition(name, name_len)) continue;
+
+                if (count == SL_DISK_MAX_DEVICES) {
+                        dropped++;
+                        continue;
+                }
+
+                uint64_t v[11];
+                int n = 0;
+                while (n < 11 && (p = sl_parse_u64(p, &v[n])) != NULL) {
+                        n++;
+                }
+                if (n < 11) {
+                        sl_log(SL_LOG_WARN, __func__, "skipping malformed diskstats line for %.*s", (int)name_len, name);
+                        continue;
+                }
+
+                sl_disk_dev_raw_t *dev = &snapshot->devices[count++];
+                if (name_len >= sizeof(dev->name)) name_len = sizeof(dev->name) - 1;
+                memcpy(dev->name, name, name_len);
+                dev->name[name_len] = '\0';
+                dev->major = (uint32_t)major;
+                dev->minor = (uint32_t)minor;
+                dev->reads_completed = v[0];
+                dev->reads_merged = v[1];
+                dev->sectors_read = v[2];
+                dev->read_time_ms = v[3];
+                dev->writes_completed = v[4];
+                dev->writes_merged = v[5];
+                dev->sectors_written = v[6];
+                dev->write_time_ms = v[7];
+                dev->in_flight = v[8];
+                dev->io_time_ms = v[9];
+                dev->weighted_io_time_ms = v[10];
+        }
+
+        if (dropped > 0) {
+                sl_log(SL_LOG_WARN, __func__, "%d devices beyond SL_DISK_MAX_DEVICES were skipped", dropped);
+        }
+
+        snapshot->count = count;
+        snapshot->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+int sl_disk_get_raw(sl_disk_raw_t *snapshot, unsigned flags)
+{
+        if (!snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
+                return -1;
+        }
+
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_disk_get_raw(&sampler, snapshot, flags);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
+
+
+/* Find a device of start matching end's device i; usually at the same index */
+static const sl_disk_dev_raw_t *disk_match(const sl_disk_raw_t *start, const sl_disk_dev_raw_t *dev, int i)
+{
+        if (i < start->count && start->devices[i].major == dev->major && start->devices[i].minor == dev->minor) {
+                return &start->devices[i];
+        }
+
+        for (int j = 0; j < start->count; j++) {
+                if (start->devices[j].major == dev->major && start->devices[j].minor == dev->minor) {
+                        return &start->devices[j];
+                }
+        }
+
+        return NULL;
+}
+
+
+static inline uint64_t disk_delta(uint64_t start, uint64_t end)
+{
+        return (end >= start) ? end - start : 0;
+}
+
+
+int sl_disk_calculate(const sl_disk_raw_t *start, const sl_disk_raw_t *end, sl_disk_usage_t *results, int max_results)
+{
+        if (!start || !end || !results || max_results <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end, results pointers are NULL or max_results is zero");
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval");
+                return -1;
+        }
+
+        double elapsed = (double)(end->timestamp_ns - start->timestamp_ns) / 1e9;
+        int count = 0;
+
+        for (int i = 0; i < end->count && count < max_results; i++) {
+                const sl_disk_dev_raw_t *e = &end->devices[i];
+                const sl_disk_dev_raw_t *s = disk_match(start, e, i);
+
+                /* Devices added between the snapshots have no baseline */
+                if (!s) continue;
+
+                sl_disk_usage_t *r = &results[count++];
+                memcpy(r->name, e->name, sizeof(r->name));
+
+                uint64_t reads = disk_delta(s->reads_completed, e->reads_completed);
+                uint64_t writes = disk_delta(s->writes_completed, e->writes_completed);
+                uint64_t read_ms = disk_delta(s->read_time_ms, e->read_time_ms);
+                uint64_t write_ms = disk_delta(s->write_time_ms, e->write_time_ms);
+                uint64_t busy_ms = disk_delta(s->io_time_ms, e->io_time_ms);
+
+                r->read_iops = reads / elapsed;
+                r->write_iops = writes / elapsed;
+                r->read_bytes_per_sec = disk_delta(s->sectors_read, e->sectors_read) * SECTOR_SIZE / elapsed;
+                r->write_bytes_per_sec = disk_delta(s->sectors_written, e->sectors_written) * SECTOR_SIZE / elapsed;
+                r->read_await_ms = reads ? (double)read_ms / reads : 0.0;
+                r->write_await_ms = writes ? (double)write_ms / writes : 0.0;
+                r->await_ms = (reads + writes) ? (double)(read_ms + write_ms) / (reads + writes) : 0.0;
+                r->utilization = busy_ms / (elapsed * 1000.0) * 100.0;
+                if (r->utilization > 100.0) r->utilization = 100.0;
+                r->in_flight = e->in_flight;
+        }
+
+        return count;
+}
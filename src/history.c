@@ -0,0 +1,355 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define HISTORY_FIXED_SCALE 1000000.0   /* Sums are kept in millionths so removal is exact */
+#define HISTORY_BUCKET_WIDTH (100.0 / SL_HISTORY_BUCKETS)
+
+/*
+ * Rolling state of one metric in one window. The queues hold sample
+ * numbers (low 32 bits) whose values are increasing (min) or decreasing
+ * (max) from front to back, so the front is always the window's extreme.
+ * Fields prefixed pub_ are what readers see.
+ */
+typedef struct
+{
+        uint32_t *min_q;
+        uint32_t *max_q;
+        uint32_t min_head, min_tail;
+        uint32_t max_head, max_tail;
+        int64_t sum;
+        _Atomic int64_t pub_sum;
+        _Atomic float pub_min;
+        _Atomic float pub_max;
+        _Atomic uint32_t *hist;
+} history_series_t;
+
+typedef struct
+{
+        uint64_t span_ns;
+        uint64_t oldest;                /**< Number of the oldest sample in the window */
+        _Atomic uint32_t count;
+        history_series_t series[SL_METRIC_COUNT];
+} history_window_t;
+
+/*
+ * Samples are stored struct-of-arrays: one timestamp array and one value
+ * array per metric, indexed by sample number & mask. A seqlock makes
+ * each push appear atomic to readers; all shared words are atomics.
+ */
+struct sl_history
+{
+        uint32_t capacity;              /**< Power of two */
+        uint32_t mask;
+        uint64_t next;                  /**< Number of the next sample, writer only */
+        uint64_t last_ns;
+
+        atomic_uint_fast64_t seq;
+        _Atomic uint64_t published;     /**< Samples pushed so far */
+        _Atomic uint64_t *timestamps;
+        _Atomic float *values;          /**< [metric][capacity] */
+
+        int window_count;
+        history_window_t windows[SL_HISTORY_MAX_WINDOWS];
+        void *arena;
+};
+
+
+sl_history_t *sl_history_create(int capacity, const float *windows_sec, int window_count)
+{
+        if (capacity <= 0 || capacity > (1 << 24) || !windows_sec ||
+            window_count <= 0 || window_count > SL_HISTORY_MAX_WINDOWS) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid capacity or window list (at most %d windows)", SL_HISTORY_MAX_WINDOWS);
+                return NULL;
+        }
+
+        for (int w = 0; w < window_count; w++) {
+                if (!(windows_sec[w] > 0.0f)) {
+                        sl_log(SL_LOG_ERROR, __func__, "window %d must be longer than 0 seconds", w);
+                        return NULL;
+                }
+        }
+
+        uint32_t cap = 1;
+        while (cap < (uint32_t)capacity) cap <<= 1;
+
+        sl_history_t *history = calloc(1, sizeof(*history));
+        if (!history) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate history");
+                return NULL;
+        }
+
+        /* Everything else lives in one arena: samples, then per-series queues and histograms */
+        size_t series_count = (size_t)window_count * SL_METRIC_COUNT;
+        size_t samples_size = cap * (sizeof(uint64_t) + SL_METRIC_COUNT * sizeof(float));
+        size_t series_size = 2 * cap * sizeof(uint32_t) + SL_HISTORY_BUCKETS * sizeof(uint32_t);
+
+        char *arena = calloc(1, samples_size + series_count * series_size);
+        if (!arena) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate %u samples", cap);
+                free(history);
+                return NULL;
+        }
+
+        history->arena = arena;
+        history->capacity = cap;
+        history->mask = cap - 1;
+        history->timestamps = (_Atomic uint64_t *)arena;
+        history->values = (_Atomic float *)(arena + cap * sizeof(uint64_t));
+        history->window_count = window_count;
+
+        char *p = arena + samples_size;
+        for (int w = 0; w < window_count; w++) {
+                history_window_t *win = &history->windows[w];
+                win->span_ns = (uint64_t)((double)windows_sec[w] * 1e9);
+
+                for (int m = 0; m < SL_METRIC_COUNT; m++) {
+                        history_series_t *s = &win->series[m];
+                        s->min_q = (uint32_t *)p;
+                        s->max_q = s->min_q + cap;
+                        s->hist = (_Atomic uint32_t *)(s->max_q + cap);
+                        p += series_size;
+                }
+        }
+
+        return history;
+}
+
+
+void sl_history_destroy(sl_history_t *history)
+{
+        if (!history) return;
+
+        free(history->arena);
+        free(history);
+}
+
+
+static inline float history_value(const sl_history_t *history, int metric, uint64_t n)
+{
+        return atomic_load_explicit(&history->values[(size_t)metric * history->capacity + (n & history->mask)],
+                                    memory_order_relaxed);
+}
+
+
+static inline int history_bucket(float value)
+{
+        int b = (int)(value / HISTORY_BUCKET_WIDTH);
+        if (b < 0) return 0;
+        return (b >= SL_HISTORY_BUCKETS) ? SL_HISTORY_BUCKETS - 1 : b;
+}
+
+
+static inline int64_t history_fixed(float value)
+{
+        double v = (double)value * HISTORY_FIXED_SCALE;
+        return (int64_t)(v >= 0.0 ? v + 0.5 : v - 0.5);
+}
+
+
+/* Drop sample n, the oldest in the window */
+static void window_evict(sl_history_t *history, history_window_t *win, uint64_t n)
+{
+        uint32_t mask = history->mask;
+
+        for (int m = 0; m < SL_METRIC_COUNT; m++) {
+                history_series_t *s = &win->series[m];
+                float v = history_value(history, m, n);
+
+                s->sum -= history_fixed(v);
+                atomic_fetch_sub_explicit(&s->hist[history_bucket(v)], 1, memory_order_relaxed);
+
+                if (s->min_head != s->min_tail && s->min_q[s->min_head & mask] == (uint32_t)n) s->min_head++;
+                if (s->max_head != s->max_tail && s->max_q[s->max_head & mask] == (uint32_t)n) s->max_head++;
+        }
+
+        atomic_fetch_sub_explicit(&win->count, 1, memory_order_relaxed);
+}
+
+
+/* Add sample n, already stored, as the newest in the window */
+static void window_add(sl_history_t *history, history_window_t *win, uint64_t n)
+{
+        uint32_t mask = history->mask;
+
+        for (int m = 0; m < SL_METRIC_COUNT; m++) {
+                history_series_t *s = &win->series[m];
+                float v = history_value(history, m, n);
+
+                s->sum += history_fixed(v);
+                atomic_fetch_add_explicit(&s->hist[history_bucket(v)], 1, memory_order_relaxed);
+
+                while (s->min_tail != s->min_head && history_value(history, m, s->min_q[(s->min_tail - 1) & mask]) >= v) {
+                        s->min_tail--;
+                }
+                s->min_q[s->min_tail++ & mask] = (uint32_t)n;
+
+                while (s->max_tail != s->max_head && history_value(history, m, s->max_q[(s->max_tail - 1) & mask]) <= v) {
+                        s->max_tail--;
+                }
+                s->max_q[s->max_tail++ & mask] = (uint32_t)n;
+
+                atomic_store_explicit(&s->pub_sum, s->sum, memory_order_relaxed);
+                atomic_store_explicit(&s->pub_min, history_value(history, m, s->min_q[s->min_head & mask]), memory_order_relaxed);
+                atomic_store_explicit(&s->pub_max, history_value(history, m, s->max_q[s->max_head & mask]), memory_order_relaxed);
+        }
+
+        atomic_fetch_add_explicit(&win->count, 1, memory_order_relaxed);
+}
+
+
+int sl_history_push(sl_history_t *history, uint64_t timestamp_ns, const sl_cpu_usage_t *cpu, const sl_mem_info_t *mem)
+{
+        if (!history || !cpu || !mem) {
+                sl_log(SL_LOG_ERROR, __func__, "history, cpu or mem pointer is NULL");
+                return -1;
+        }
+
+        uint64_t now = timestamp_ns ? timestamp_ns : sl_now_ns();
+        if (history->next > 0 && now < history->last_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "timestamp goes backwards");
+                return -1;
+        }
+
+        float values[SL_METRIC_COUNT];
+        values[SL_METRIC_CPU_TOTAL] = cpu->total;
+        values[SL_METRIC_CPU_USER] = cpu->user;
+        values[SL_METRIC_CPU_SYSTEM] = cpu->system;
+        values[SL_METRIC_CPU_IOWAIT] = cpu->iowait;
+        values[SL_METRIC_CPU_STEAL] = cpu->steal;
+        values[SL_METRIC_MEM_USED] = mem->percent_used;
+        values[SL_METRIC_SWAP_USED] = mem->swap_total ? (float)((double)mem->swap_used / (double)mem->swap_total * 100.0) : 0.0f;
+
+        uint64_t n = history->next;
+        uint64_t seq = atomic_load_explicit(&history->seq, memory_order_relaxed);
+        atomic_store_explicit(&history->seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        /* Leave the window (now - span, now]; the slot about to be reused is always dropped */
+        for (int w = 0; w < history->window_count; w++) {
+                history_window_t *win = &history->windows[w];
+                while (win->oldest < n && (n - win->oldest >= history->capacity ||
+                       now - atomic_load_explicit(&history->timestamps[win->oldest & history->mask], memory_order_relaxed) >= win->span_ns)) {
+                        window_evict(history, win, win->oldest++);
+                }
+        }
+
+        atomic_store_explicit(&history->timestamps[n & history->mask], now, memory_order_relaxed);
+        for (int m = 0; m < SL_METRIC_COUNT; m++) {
+                atomic_store_explicit(&history->values[(size_t)m * history->capacity + (n & history->mask)], values[m], memory_order_relaxed);
+        }
+
+        for (int w = 0; w < history->window_count; w++) {
+                window_add(history, &history->windows[w], n);
+        }
+
+        history->next = n + 1;
+        history->last_ns = now;
+        atomic_store_explicit(&history->published, n + 1, memory_order_relaxed);
+        atomic_store_explicit(&history->seq, seq + 2, memory_order_release);
+
+        return 0;
+}
+
+
+/* Value at rank ceil(p * count) from the histogram, kept within the exact min/max */
+static double history_percentile(const uint32_t *hist, int count, double p, double min, double max)
+{
+        uint32_t rank = (uint32_t)(p * count + 0.999999);
+        if (rank == 0) rank = 1;
+
+        uint32_t seen = 0;
+        int b = 0;
+        for (; b < SL_HISTORY_BUCKETS - 1; b++) {
+                seen += hist[b];
+                if (seen >= rank) break;
+        }
+
+        double value = (b + 0.5) * HISTORY_BUCKET_WIDTH;
+        if (value < min) return min;
+        return (value > max) ? max : value;
+}
+
+
+int sl_history_stats(const sl_history_t *history, sl_metric_t metric, int window, sl_history_stats_t *stats)
+{
+        if (!history || !stats || (unsigned)metric >= SL_METRIC_COUNT || window < 0 || window >= history->window_count) {
+                sl_log(SL_LOG_ERROR, __func__, "history or stats pointer is NULL, or invalid metric or window");
+                return -1;
+        }
+
+        sl_history_t *h = (sl_history_t *)history;
+        history_window_t *win = &h->windows[window];
+        history_series_t *s = &win->series[metric];
+        uint32_t hist[SL_HISTORY_BUCKETS];
+        uint64_t seq1, seq2;
+        uint32_t count;
+        int64_t sum;
+        float min, max;
+
+        do {
+                seq1 = atomic_load_explicit(&h->seq, memory_order_acquire);
+                if (seq1 & 1) continue;
+
+                count = atomic_load_explicit(&win->count, memory_order_relaxed);
+                sum = atomic_load_explicit(&s->pub_sum, memory_order_relaxed);
+                min = atomic_load_explicit(&s->pub_min, memory_order_relaxed);
+                max = atomic_load_explicit(&s->pub_max, memory_order_relaxed);
+                for (int b = 0; b < SL_HISTORY_BUCKETS; b++) {
+                        hist[b] = atomic_load_explicit(&s->hist[b], memory_order_relaxed);
+                }
+
+                atomic_thread_fence(memory_order_acquire);
+                seq2 = atomic_load_explicit(&h->seq, memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+
+        memset(stats, 0, sizeof(*stats));
+        stats->count = (int)count;
+        if (count == 0) return 0;
+
+        stats->mean = (double)sum / HISTORY_FIXED_SCALE / count;
+        stats->min = min;
+        stats->max = max;
+        stats->p50 = history_percentile(hist, (int)count, 0.50, min, max);
+        stats->p95 = history_percentile(hist, (int)count, 0.95, min, max);
+        stats->p99 = history_percentile(hist, (int)count, 0.99, min, max);
+
+        return 0;
+}
+
+
+int sl_history_read(const sl_history_t *history, sl_metric_t metric, uint64_t *timestamps, float *values, int max_samples)
+{
+        if (!history || !values || (unsigned)metric >= SL_METRIC_COUNT || max_samples <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "history or values pointer is NULL, invalid metric or max_samples is zero");
+                return -1;
+        }
+
+        sl_history_t *h = (sl_history_t *)history;
+        uint64_t seq1, seq2;
+        int count;
+
+        do {
+                seq1 = atomic_load_explicit(&h->seq, memory_order_acquire);
+                if (seq1 & 1) continue;
+
+                uint64_t published = atomic_load_explicit(&h->published, memory_order_relaxed);
+                uint64_t available = (published < h->capacity) ? published : h->capacity;
+                count = (available < (uint64_t)max_samples) ? (int)available : max_samples;
+
+                uint64_t first = published - (uint64_t)count;
+                for (int i = 0; i < count; i++) {
+                        uint64_t n = first + (uint64_t)i;
+                        values[i] = history_value(h, metric, n);
+                        if (timestamps) {
+                                timestamps[i] = atomic_load_explicit(&h->timestamps[n & h->mask], memory_order_relaxed);
+                        }
+                }
+
+                atomic_thread_fence(memory_order_acquire);
+                seq2 = atomic_load_explicit(&h->seq, memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+
+        return count;
+}
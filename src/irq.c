@@ -0,0 +1,382 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+        char name[SL_IRQ_NAME_SIZE];
+        size_t name_len;
+        char desc[SL_IRQ_DESC_SIZE];
+} irq_row_t;
+
+/* Layout generations come from one counter, so matrices of different collectors never pair */
+static atomic_uint_fast64_t g_irq_layouts;
+
+struct sl_irq
+{
+        sl_procfile_t file;
+        uint64_t layout;                /**< Generation, new on every relearn; 0 before the first */
+        char *header;                   /**< "CPU0 CPU1 ..." line of the learned layout, without newline */
+        size_t header_len;
+        int *cpu_ids;                   /**< CPU id per column */
+        int cpus;
+        int cpu_capacity;
+        irq_row_t *rows;
+        int row_count;
+        int row_capacity;
+        int *line_row;                  /**< Row of each line after the header, -1 for skipped lines */
+        int lines;
+        int line_capacity;
+};
+
+
+/* Make room for count elements of size bytes; returns the array, or NULL (old array kept) */
+static void *irq_grow(void *array, int *capacity, int count, size_t size)
+{
+        if (count <= *capacity) return array;
+
+        int new_capacity = *capacity ? *capacity : 16;
+        while (new_capacity < count) new_capacity *= 2;
+
+        void *grown = realloc(array, (size_t)new_capacity * size);
+        if (!grown) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to grow to %d entries", new_capacity);
+                return NULL;
+        }
+        *capacity = new_capacity;
+        return grown;
+}
+
+
+/* Learn columns from the header and rows from every line with one count per CPU */
+static int irq_learn(sl_irq_t *irq)
+{
+        const char *buf = irq->file.buf;
+        const char *end = buf + irq->file.len;
+        const char *nl = memchr(buf, '\n', irq->file.len);
+        if (!nl) {
+                sl_log(SL_LOG_ERROR, __func__, "no header line in %s", irq->file.path);
+                return -1;
+        }
+
+        char *header = realloc(irq->header, (size_t)(nl - buf) + 1);
+        if (!header) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate header");
+                return -1;
+        }
+        irq->header = header;
+        irq->header_len = (size_t)(nl - buf);
+        memcpy(irq->header, buf, irq->header_len);
+        irq->header[irq->header_len] = '\0';
+
+        irq->cpus = 0;
+        for (const char *p = sl_skip_blanks(buf); p < nl && strncmp(p, "CPU", 3) == 0; p = sl_skip_blanks(p)) {
+                uint64_t id;
+                p = sl_parse_u64(p + 3, &id);
+                if (!p) break;
+                int *cpu_ids = irq_grow(irq->cpu_ids, &irq->cpu_capacity, irq->cpus + 1, sizeof(int));
+                if (!cpu_ids) return -1;
+                irq->cpu_ids = cpu_ids;
+                irq->cpu_ids[irq->cpus++] = (int)id;
+        }
+        if (irq->cpus == 0) {
+                sl_log(SL_LOG_ERROR, __func__, "no CPU columns in %s", irq->file.path);
+                return -1;
+        }
+
+        irq->row_count = 0;
+        irq->lines = 0;
+        for (const char *line = sl_next_line(buf, end); line; line = sl_next_line(line, end)) {
+                int *line_row = irq_grow(irq->line_row, &irq->line_capacity, irq->lines + 1, sizeof(int));
+                if (!line_row) return -1;
+                irq->line_row = line_row;
+                int *slot = &irq->line_row[irq->lines++];
+                *slot = -1;
+
+                const char *name = sl_skip_blanks(line);
+                size_t name_len = strcspn(name, ":\n");
+                if (name[name_len] != ':' || name_len == 0 || name_len >= SL_IRQ_NAME_SIZE) continue;
+                /* System-wide totals; on one CPU they would pass the count check below */
+                if (name_len == 3 && (memcmp(name, "ERR", 3) == 0 || memcmp(name, "MIS", 3) == 0)) continue;
+
+                const char *p = name + name_len + 1;
+                int counts = 0;
+                uint64_t value;
+                while (counts < irq->cpus && (p = sl_parse_u64(p, &value)) != NULL) counts++;
+                if (counts != irq->cpus) continue;
+
+                irq_row_t *rows = irq_grow(irq->rows, &irq->row_capacity, irq->row_count + 1, sizeof(irq_row_t));
+                if (!rows) return -1;
+                irq->rows = rows;
+                irq_row_t *row = &irq->rows[irq->row_count];
+                memcpy(row->name, name, name_len);
+                row->name[name_len] = '\0';
+                row->name_len = name_len;
+
+                p = sl_skip_blanks(p);
+                size_t desc_len = strcspn(p, "\n");
+                if (desc_len >= SL_IRQ_DESC_SIZE) desc_len = SL_IRQ_DESC_SIZE - 1;
+                memcpy(row->desc, p, desc_len);
+                row->desc[desc_len] = '\0';
+
+                *slot = irq->row_count++;
+        }
+
+        irq->layout = atomic_fetch_add_explicit(&g_irq_layouts, 1, memory_order_relaxed) + 1;
+        return 0;
+}
+
+
+/*
+ * Parse the counts along the learned layout: the header must be unchanged
+ * and every kept line must still start with its row name. Returns 1 if
+ * the file no longer matches.
+ */
+static int irq_extract(const sl_irq_t *irq, uint64_t *counts)
+{
+        const char *buf = irq->file.buf;
+        const char *end = buf + irq->file.len;
+
+        if (irq->file.len <= irq->header_len || buf[irq->header_len] != '\n' ||
+            memcmp(buf, irq->header, irq->header_len) != 0) {
+                return 1;
+        }
+
+        const char *line = sl_next_line(buf, end);
+        for (int i = 0; i < irq->lines; i++) {
+                if (!line) return 1;
+
+                int r = irq->line_row[i];
+                if (r >= 0) {
+                        const irq_row_t *row = &irq->rows[r];
+                        const char *p = sl_skip_blanks(line);
+                        if (strncmp(p, row->name, row->name_len) != 0 || p[row->name_len] != ':') return 1;
+
+                        p += row->name_len + 1;
+                        uint64_t *out = counts + (size_t)r * (size_t)irq->cpus;
+                        for (int c = 0; c < irq->cpus; c++) {
+                                p = sl_parse_u64(p, &out[c]);
+                                if (!p) return 1;
+                        }
+                }
+                line = sl_next_line(line, end);
+        }
+
+        return line ? 1 : 0;
+}
+
+
+sl_irq_t *sl_irq_create(sl_irq_source_t source)
+{
+        if (source != SL_IRQ_INTERRUPTS && source != SL_IRQ_SOFTIRQS) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid source %d", (int)source);
+                return NULL;
+        }
+
+        sl_irq_t *irq = calloc(1, sizeof(*irq));
+        if (!irq) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate collector");
+                return NULL;
+        }
+
+        char root[SL_ROOT_SIZE];
+        sl_procfile_init(&irq->file, sl_proc_root(root), (source == SL_IRQ_INTERRUPTS) ? "interrupts" : "softirqs");
+        if (sl_procfile_read(&irq->file) != 0 || irq_learn(irq) != 0) {
+                sl_irq_destroy(irq);
+                return NULL;
+        }
+
+        return irq;
+}
+
+
+void sl_irq_destroy(sl_irq_t *irq)
+{
+        if (!irq) return;
+
+        sl_procfile_close(&irq->file);
+        free(irq->header);
+        free(irq->cpu_ids);
+        free(irq->rows);
+        free(irq->line_row);
+        free(irq);
+}
+
+
+const char *sl_irq_name(const sl_irq_t *irq, int row)
+{
+        if (!irq || row < 0 || row >= irq->row_count) return NULL;
+        return irq->rows[row].name;
+}
+
+
+const char *sl_irq_desc(const sl_irq_t *irq, int row)
+{
+        if (!irq || row < 0 || row >= irq->row_count) return NULL;
+        return irq->rows[row].desc;
+}
+
+
+int sl_irq_cpu(const sl_irq_t *irq, int column)
+{
+        if (!irq || column < 0 || column >= irq->cpus) return -1;
+        return irq->cpu_ids[column];
+}
+
+
+int sl_irq_raw_init(sl_irq_raw_t *raw, int capacity)
+{
+        if (!raw || capacity < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "raw pointer is NULL or capacity is negative");
+                return -1;
+        }
+
+        memset(raw, 0, sizeof(*raw));
+        if (capacity > 0) {
+                raw->counts = calloc((size_t)capacity, sizeof(uint64_t));
+                if (!raw->counts) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to allocate %d entries", capacity);
+                        return -1;
+                }
+                raw->capacity = capacity;
+        }
+        return 0;
+}
+
+
+void sl_irq_raw_free(sl_irq_raw_t *raw)
+{
+        if (!raw) return;
+        free(raw->counts);
+        memset(raw, 0, sizeof(*raw));
+}
+
+
+static int irq_raw_reserve(sl_irq_raw_t *raw, int entries)
+{
+        if (entries <= raw->capacity) return 0;
+
+        uint64_t *counts = irq_grow(raw->counts, &raw->capacity, entries, sizeof(uint64_t));
+        if (!counts) return -1;
+        raw->counts = counts;
+        return 0;
+}
+
+
+int sl_irq_get_raw(sl_irq_t *irq, sl_irq_raw_t *raw)
+{
+        if (!irq || !raw) {
+                sl_log(SL_LOG_ERROR, __func__, "irq or raw pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&irq->file) != 0) {
+                return -1;
+        }
+
+        if (irq_raw_reserve(raw, irq->row_count * irq->cpus) != 0) {
+                return -1;
+        }
+
+        if (irq_extract(irq, raw->counts) != 0) {
+                if (irq_learn(irq) != 0 || irq_raw_reserve(raw, irq->row_count * irq->cpus) != 0) return -1;
+                if (irq_extract(irq, raw->counts) != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to parse %s", irq->file.path);
+                        return -1;
+                }
+        }
+
+        raw->rows = irq->row_count;
+        raw->cpus = irq->cpus;
+        raw->layout = irq->layout;
+        raw->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+static int irq_check_pair(const sl_irq_raw_t *start, const sl_irq_raw_t *end, const char *func)
+{
+        if (start->layout == 0 || start->layout != end->layout || start->rows != end->rows || start->cpus != end->cpus) {
+                sl_log(SL_LOG_ERROR, func, "matrices have different layouts");
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, func, "invalid time interval");
+                return -1;
+        }
+        return 0;
+}
+
+
+int sl_irq_calculate(const sl_irq_raw_t *start, const sl_irq_raw_t *end, double *rates, int max_rates)
+{
+        if (!start || !end || !rates) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end or rates pointer is NULL");
+                return -1;
+        }
+
+        if (irq_check_pair(start, end, __func__) != 0) {
+                return -1;
+        }
+
+        int n = end->rows * end->cpus;
+        if (n > max_rates) n = max_rates;
+
+        /*
+         * The kernel keeps these counters as unsigned int, so the difference
+         * is taken modulo 2^32 to survive a wrap. Branch-free, so compilers
+         * vectorize the loop.
+         */
+        const uint64_t *s = start->counts, *e = end->counts;
+        double scale = 1e9 / (double)(end->timestamp_ns - start->timestamp_ns);
+        for (int i = 0; i < n; i++) {
+                uint32_t delta = (uint32_t)e[i] - (uint32_t)s[i];
+                rates[i] = (double)delta * scale;
+        }
+
+        return n;
+}
+
+
+int sl_irq_top(const sl_irq_t *irq, const sl_irq_raw_t *start, const sl_irq_raw_t *end,
+               sl_irq_hotspot_t *top, int max_top)
+{
+        if (!irq || !start || !end || !top || max_top <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "irq, start, end or top pointer is NULL, or max_top is not positive");
+                return -1;
+        }
+
+        if (irq_check_pair(start, end, __func__) != 0) {
+                return -1;
+        }
+
+        if (end->layout != irq->layout) {
+                sl_log(SL_LOG_ERROR, __func__, "matrices are from an older layout of the collector");
+                return -1;
+        }
+
+        /* Insertion into a short sorted array; most entries fail the first compare */
+        double scale = 1e9 / (double)(end->timestamp_ns - start->timestamp_ns);
+        int count = 0;
+        for (int r = 0; r < end->rows; r++) {
+                const uint64_t *s = start->counts + (size_t)r * (size_t)end->cpus;
+                const uint64_t *e = end->counts + (size_t)r * (size_t)end->cpus;
+                for (int c = 0; c < end->cpus; c++) {
+                        uint32_t delta = (uint32_t)e[c] - (uint32_t)s[c];
+                        if (delta == 0 || (count == max_top && delta * scale <= top[count - 1].per_sec)) continue;
+
+                        int i = (count < max_top) ? count++ : count - 1;
+                        while (i > 0 && top[i - 1].per_sec < delta * scale) {
+                                top[i] = top[i - 1];
+                                i--;
+                        }
+                        top[i].row = r;
+                        top[i].cpu = irq->cpu_ids[c];
+                        top[i].per_sec = delta * scale;
+                }
+        }
+
+        return count;
+}
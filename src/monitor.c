@@ -0,0 +1,248 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * Seqlock-protected copy of the latest snapshot. The payload is stored as
+ * atomic words so readers racing with the writer stay well-defined; a
+ * reader retries if the sequence was odd or changed while it copied.
+ */
+#define MONITOR_WORDS ((sizeof(sl_monitor_snapshot_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+typedef struct
+{
+        pthread_mutex_t lock;           /**< Serializes start/stop */
+        pthread_cond_t wake;            /**< Signalled by stop to end the sleep early */
+        pthread_t thread;
+        int running;
+        int stopping;
+
+        float interval_sec;
+        char mounts[SL_MONITOR_MAX_MOUNTS][SL_PATH_SIZE];
+        int mount_count;
+
+        atomic_uint_fast64_t seq;
+        _Atomic uint64_t words[MONITOR_WORDS];
+} monitor_state_t;
+
+static monitor_state_t g_monitor = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+static void monitor_publish(const sl_monitor_snapshot_t *snapshot)
+{
+        uint64_t words[MONITOR_WORDS] = {0};
+        memcpy(words, snapshot, sizeof(*snapshot));
+
+        uint64_t seq = atomic_load_explicit(&g_monitor.seq, memory_order_relaxed);
+        atomic_store_explicit(&g_monitor.seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        for (size_t i = 0; i < MONITOR_WORDS; i++) {
+                atomic_store_explicit(&g_monitor.words[i], words[i], memory_order_relaxed);
+        }
+
+        atomic_store_explicit(&g_monitor.seq, seq + 2, memory_order_release);
+}
+
+
+/* Sleep until the next deadline; returns non-zero if stop was requested */
+static int monitor_wait(struct timespec *deadline)
+{
+        uint64_t ns = (uint64_t)(g_monitor.interval_sec * 1e9);
+        deadline->tv_sec += (time_t)(ns / 1000000000ULL);
+        deadline->tv_nsec += (long)(ns % 1000000000ULL);
+        if (deadline->tv_nsec >= 1000000000L) {
+                deadline->tv_sec++;
+                deadline->tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&g_monitor.lock);
+        while (!g_monitor.stopping) {
+                if (pthread_cond_timedwait(&g_monitor.wake, &g_monitor.lock, deadline) == ETIMEDOUT) {
+                        break;
+                }
+        }
+        int stopping = g_monitor.stopping;
+        pthread_mutex_unlock(&g_monitor.lock);
+
+        return stopping;
+}
+
+
+static void *monitor_thread(void *arg)
+{
+        (void)arg;
+
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+
+        sl_monitor_snapshot_t snapshot;
+        memset(&snapshot, 0, sizeof(snapshot));
+        snapshot.storage_count = g_monitor.mount_count;
+
+        sl_cpu_delta_t cpu_delta;
+        sl_cpu_delta_init(&cpu_delta);
+        sl_cpu_delta_update(&cpu_delta, &sampler, &snapshot.cpu, NULL);
+
+        /* Mounts whose last statvfs() failed; logged once per failure, not every interval */
+        int mount_failed[SL_MONITOR_MAX_MOUNTS] = {0};
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        while (!monitor_wait(&deadline)) {
+                /* Groups that fail keep their previous values and are left out of collected */
+                unsigned collected = 0;
+
+                /* Keeps the previous usage, and is not counted, if less than one tick elapsed */
+                if (sl_cpu_delta_update(&cpu_delta, &sampler, &snapshot.cpu, NULL) == 0) collected |= SL_SNAPSHOT_CPU;
+                if (sl_sampler_mem_get_info(&sampler, &snapshot.mem) == 0) collected |= SL_SNAPSHOT_MEM;
+                if (sl_sampler_systime_get_info(&sampler, &snapshot.systime) == 0) collected |= SL_SNAPSHOT_SYSTIME;
+
+                int storage_ok = g_monitor.mount_count > 0;
+                for (int i = 0; i < g_monitor.mount_count; i++) {
+                        sl_storage_info_t info;
+                        int err = sl_storage_stat(g_monitor.mounts[i], &info);
+                        if (err == 0) {
+                                snapshot.storage[i] = info;
+                                mount_failed[i] = 0;
+                                continue;
+                        }
+                        if (!mount_failed[i]) {
+                                sl_log(SL_LOG_ERROR, __func__, "failed to get filesystem info for %s: %s",
+                                       g_monitor.mounts[i], strerror(err));
+                                mount_failed[i] = 1;
+                        }
+                        storage_ok = 0;
+                }
+                if (storage_ok) collected |= SL_SNAPSHOT_STORAGE;
+                snapshot.collected = collected;
+
+                snapshot.timestamp_ns = sl_now_ns();
+                snapshot.sequence++;
+                monitor_publish(&snapshot);
+        }
+
+        sl_sampler_fini(&sampler);
+        return NULL;
+}
+
+
+int sl_monitor_start(float interval_sec, const char *const *mounts, int mount_count)
+{
+        if (interval_sec < 0.01f) {
+                sl_log(SL_LOG_ERROR, __func__, "interval too small, minimum is 0.01 seconds");
+                return -1;
+        }
+
+        if (mount_count < 0 || mount_count > SL_MONITOR_MAX_MOUNTS || (mount_count > 0 && !mounts)) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid mount list (at most %d mounts)", SL_MONITOR_MAX_MOUNTS);
+                return -1;
+        }
+
+        pthread_mutex_lock(&g_monitor.lock);
+
+        if (g_monitor.running) {
+                pthread_mutex_unlock(&g_monitor.lock);
+                sl_log(SL_LOG_ERROR, __func__, "monitor is already running");
+                return -1;
+        }
+
+        for (int i = 0; i < mount_count; i++) {
+                if (!mounts[i] || strlen(mounts[i]) >= SL_PATH_SIZE) {
+                        pthread_mutex_unlock(&g_monitor.lock);
+                        sl_log(SL_LOG_ERROR, __func__, "mount path %d is NULL or too long", i);
+                        return -1;
+                }
+                strcpy(g_monitor.mounts[i], mounts[i]);
+        }
+        g_monitor.mount_count = mount_count;
+        g_monitor.interval_sec = interval_sec;
+        g_monitor.stopping = 0;
+
+        /* Drop any snapshot left by a previous run */
+        for (size_t i = 0; i < MONITOR_WORDS; i++) {
+                atomic_store_explicit(&g_monitor.words[i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&g_monitor.seq, 0, memory_order_release);
+
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&g_monitor.wake, &attr);
+        pthread_condattr_destroy(&attr);
+
+        if (pthread_create(&g_monitor.thread, NULL, monitor_thread, NULL) != 0) {
+                pthread_cond_destroy(&g_monitor.wake);
+                pthread_mutex_unlock(&g_monitor.lock);
+                sl_log(SL_LOG_ERROR, __func__, "failed to create monitor thread");
+                return -1;
+        }
+
+        g_monitor.running = 1;
+        pthread_mutex_unlock(&g_monitor.lock);
+        return 0;
+}
+
+
+int sl_monitor_stop(void)
+{
+        pthread_mutex_lock(&g_monitor.lock);
+
+        if (!g_monitor.running) {
+                pthread_mutex_unlock(&g_monitor.lock);
+                sl_log(SL_LOG_ERROR, __func__, "monitor is not running");
+                return -1;
+        }
+
+        g_monitor.stopping = 1;
+        pthread_cond_signal(&g_monitor.wake);
+        pthread_mutex_unlock(&g_monitor.lock);
+
+        pthread_join(g_monitor.thread, NULL);
+
+        pthread_mutex_lock(&g_monitor.lock);
+        pthread_cond_destroy(&g_monitor.wake);
+        g_monitor.running = 0;
+        pthread_mutex_unlock(&g_monitor.lock);
+
+        return 0;
+}
+
+
+int sl_monitor_read(sl_monitor_snapshot_t *snapshot)
+{
+        if (!snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
+                return -1;
+        }
+
+        uint64_t words[MONITOR_WORDS];
+        uint64_t seq1, seq2;
+
+        do {
+                seq1 = atomic_load_explicit(&g_monitor.seq, memory_order_acquire);
+                if (seq1 & 1) continue;
+
+                for (size_t i = 0; i < MONITOR_WORDS; i++) {
+                        words[i] = atomic_load_explicit(&g_monitor.words[i], memory_order_relaxed);
+                }
+
+                atomic_thread_fence(memory_order_acquire);
+                seq2 = atomic_load_explicit(&g_monitor.seq, memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+
+        if (seq1 == 0) {
+                /* No sample published yet; not logged, callers may poll this */
+                return -1;
+        }
+
+        memcpy(snapshot, words, sizeof(*snapshot));
+        return 0;
+}
@@ -0,0 +1,300 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+/* One mountinfo line; strings are offsets into the table's string pool */
+typedef struct
+{
+        uint32_t mount_point;
+        uint32_t fstype;
+        uint32_t source;
+        uint32_t major;
+        uint32_t minor;
+} mount_entry_t;
+
+struct sl_mounts
+{
+        sl_procfile_t mountinfo;
+        mount_entry_t *entries;
+        int count;
+        int capacity;
+        char *strings;                  /**< NUL-separated mount points, types and sources */
+        size_t strings_len;
+        size_t strings_cap;
+
+        sl_statvfs_pool_t *pool;        /**< NULL without worker threads */
+        int timeout_ms;
+};
+
+
+/* Append a mountinfo field, decoding \ooo escapes; returns its offset or -1 */
+static long mounts_intern(sl_mounts_t *mounts, const char *p, size_t len)
+{
+        if (mounts->strings_len + len + 1 > mounts->strings_cap) {
+                size_t cap = mounts->strings_cap ? mounts->strings_cap : 4096;
+                while (mounts->strings_len + len + 1 > cap) cap *= 2;
+
+                char *strings = realloc(mounts->strings, cap);
+                if (!strings) return -1;
+                mounts->strings = strings;
+                mounts->strings_cap = cap;
+        }
+
+        size_t offset = mounts->strings_len;
+        char *dest = mounts->strings + offset;
+
+        for (size_t i = 0; i < len; i++) {
+                if (p[i] == '\\' && i + 3 < len &&
+                    (unsigned)(p[i + 1] - '0') <= 3 && (unsigned)(p[i + 2] - '0') <= 7 && (unsigned)(p[i + 3] - '0') <= 7) {
+                        *dest++ = (char)(((p[i + 1] - '0') << 6) | ((p[i + 2] - '0') << 3) | (p[i + 3] - '0'));
+                        i += 3;
+                } else {
+                        *dest++ = p[i];
+                }
+        }
+        *dest++ = '\0';
+
+        mounts->strings_len = (size_t)(dest - mounts->strings);
+        return (long)offset;
+}
+
+
+/* Field ending at the next blank */
+static const char *mounts_field(const char *p, const char **start, size_t *len)
+{
+        p = sl_skip_blanks(p);
+        *start = p;
+        while (*p != ' ' && *p != '\n' && *p != '\0') p++;
+        *len = (size_t)(p - *start);
+        return p;
+}
+
+
+/*
+ * "36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw"
+ * mount id, parent id, major:minor, root, mount point, options, optional
+ * fields up to "-", then fstype, source and superblock options.
+ */
+static int mounts_parse(sl_mounts_t *mounts)
+{
+        const char *buf = mounts->mountinfo.buf;
+        const char *end = buf + mounts->mountinfo.len;
+
+        mounts->count = 0;
+        mounts->strings_len = 0;
+
+        for (const char *line = (mounts->mountinfo.len > 0) ? buf : NULL; line; line = sl_next_line(line, end)) {
+                uint64_t id, parent, major, minor;
+                const char *p = sl_parse_u64(line, &id);
+                if (p) p = sl_parse_u64(p, &parent);
+                if (p) p = sl_parse_u64(p, &major);
+                if (p && *p == ':') p = sl_parse_u64(p + 1, &minor);
+                else p = NULL;
+                if (!p) continue;
+
+                const char *root, *point, *field, *fstype, *source;
+                size_t root_len, point_len, field_len, fstype_len, source_len;
+
+                p = mounts_field(p, &root, &root_len);
+                p = mounts_field(p, &point, &point_len);
+                p = mounts_field(p, &field, &field_len);          /* mount options */
+                do {
+                        p = mounts_field(p, &field, &field_len);
+                } while (field_len > 0 && !(field_len == 1 && field[0] == '-'));
+                p = mounts_field(p, &fstype, &fstype_len);
+                p = mounts_field(p, &source, &source_len);
+
+                if (point_len == 0 || fstype_len == 0) continue;
+
+                if (mounts->count == mounts->capacity) {
+                        int capacity = mounts->capacity ? mounts->capacity * 2 : 64;
+                        mount_entry_t *entries = realloc(mounts->entries, (size_t)capacity * sizeof(*entries));
+                        if (!entries) goto nomem;
+                        mounts->entries = entries;
+                        mounts->capacity = capacity;
+                }
+
+                long point_off = mounts_intern(mounts, point, point_len);
+                long fstype_off = mounts_intern(mounts, fstype, fstype_len);
+                long source_off = mounts_intern(mounts, source, source_len);
+                if (point_off < 0 || fstype_off < 0 || source_off < 0) goto nomem;
+
+                mount_entry_t *e = &mounts->entries[mounts->count++];
+                e->mount_point = (uint32_t)point_off;
+                e->fstype = (uint32_t)fstype_off;
+                e->source = (uint32_t)source_off;
+                e->major = (uint32_t)major;
+                e->minor = (uint32_t)minor;
+        }
+
+        return mounts->count;
+
+nomem:
+        sl_log(SL_LOG_ERROR, __func__, "failed to allocate mount table");
+        mounts->count = 0;
+        return -1;
+}
+
+
+int sl_mounts_refresh(sl_mounts_t *mounts)
+{
+        if (!mounts) {
+                sl_log(SL_LOG_ERROR, __func__, "mounts pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&mounts->mountinfo) != 0) {
+                return -1;
+        }
+
+        return mounts_parse(mounts);
+}
+
+
+/* Re-parse only if the kernel flagged a mount table change since the last poll */
+static int mounts_update(sl_mounts_t *mounts)
+{
+        struct pollfd pfd = {mounts->mountinfo.fd, POLLPRI, 0};
+
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR))) {
+                return sl_mounts_refresh(mounts);
+        }
+
+        return 0;
+}
+
+
+sl_mounts_t *sl_mounts_create(int threads, int timeout_ms)
+{
+        if (threads < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "threads must not be negative");
+                return NULL;
+        }
+
+        sl_mounts_t *mounts = calloc(1, sizeof(*mounts));
+        if (!mounts) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate mount table");
+                return NULL;
+        }
+
+        char root[SL_ROOT_SIZE];
+        sl_procfile_init(&mounts->mountinfo, sl_proc_root(root), "self/mountinfo");
+        mounts->timeout_ms = timeout_ms;
+
+        if (sl_mounts_refresh(mounts) < 0) {
+                sl_mounts_destroy(mounts);
+                return NULL;
+        }
+
+        if (threads > 0) {
+                mounts->pool = sl_statvfs_pool_create(threads);
+                if (!mounts->pool) {
+                        sl_mounts_destroy(mounts);
+                        return NULL;
+                }
+        }
+
+        return mounts;
+}
+
+
+void sl_mounts_destroy(sl_mounts_t *mounts)
+{
+        if (!mounts) return;
+
+        sl_statvfs_pool_release(mounts->pool);
+        sl_procfile_close(&mounts->mountinfo);
+        free(mounts->entries);
+        free(mounts->strings);
+        free(mounts);
+}
+
+
+/* fstype is one of the comma-separated names in list */
+static int fstype_listed(const char *list, const char *fstype)
+{
+        size_t len = strlen(fstype);
+
+        for (const char *p = list; *p; ) {
+                size_t n = strcspn(p, ",");
+                if (n == len && memcmp(p, fstype, len) == 0) return 1;
+                p += n;
+                if (*p == ',') p++;
+        }
+
+        return 0;
+}
+
+
+/* path is prefix itself or below it ("/data" matches "/data/x" but not "/database") */
+static int path_below(const char *path, const char *prefix, size_t prefix_len)
+{
+        if (strncmp(path, prefix, prefix_len) != 0) return 0;
+        return path[prefix_len] == '\0' || path[prefix_len] == '/' || (prefix_len > 0 && prefix[prefix_len - 1] == '/');
+}
+
+
+/* Run statvfs() for the selected mounts on the pool; unfinished ones get ETIMEDOUT */
+static int mounts_stat_pooled(sl_mounts_t *mounts, sl_mount_info_t *results, int count)
+{
+        for (int i = 0; i < count; i++) {
+                if (sl_statvfs_pool_add(mounts->pool, results[i].mount_point) < 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to allocate %d jobs", count);
+                        return -1;
+                }
+        }
+
+        sl_statvfs_pool_run(mounts->pool, mounts->timeout_ms);
+
+        for (int i = 0; i < count; i++) {
+                results[i].error = sl_statvfs_pool_result(mounts->pool, i, &results[i].storage);
+        }
+
+        return 0;
+}
+
+
+int sl_mounts_query(sl_mounts_t *mounts, const char *fstypes, const char *prefix,
+                    sl_mount_info_t *results, int max_results)
+{
+        if (!mounts || !results || max_results <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "mounts or results pointer is NULL, or max_results is zero");
+                return -1;
+        }
+
+        if (mounts_update(mounts) < 0) {
+                return -1;
+        }
+
+        size_t prefix_len = prefix ? strlen(prefix) : 0;
+        int count = 0;
+
+        for (int i = 0; i < mounts->count && count < max_results; i++) {
+                const mount_entry_t *e = &mounts->entries[i];
+                const char *point = mounts->strings + e->mount_point;
+                const char *fstype = mounts->strings + e->fstype;
+
+                if (fstypes && !fstype_listed(fstypes, fstype)) continue;
+                if (prefix && !path_below(point, prefix, prefix_len)) continue;
+
+                sl_mount_info_t *r = &results[count++];
+                snprintf(r->mount_point, sizeof(r->mount_point), "%s", point);
+                snprintf(r->fstype, sizeof(r->fstype), "%s", fstype);
+                snprintf(r->source, sizeof(r->source), "%s", mounts->strings + e->source);
+                r->major = e->major;
+                r->minor = e->minor;
+                memset(&r->storage, 0, sizeof(r->storage));
+        }
+
+        if (mounts->pool && count > 0) {
+                return (mounts_stat_pooled(mounts, results, count) == 0) ? count : -1;
+        }
+
+        for (int i = 0; i < count; i++) {
+                results[i].error = sl_storage_stat(results[i].mount_point, &results[i].storage);
+        }
+
+        return count;
+}
@@ -0,0 +1,236 @@
+#include "sysload_internal.h"
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/utsname.h>
+
+#define NET_COUNTERS 16
+
+/* Source of name table tags; 0 is never handed out */
+static atomic_uint_fast64_t g_net_tag;
+
+/* Kernel counter width, 0 until detected */
+static atomic_int g_net_counter_bits;
+
+
+void sl_net_names_reset(sl_net_names_t *names)
+{
+        names->count = 0;
+        names->tag = atomic_fetch_add_explicit(&g_net_tag, 1, memory_order_relaxed) + 1;
+}
+
+
+/*
+ * Counters are unsigned long in the kernel. A 32-bit process may run on
+ * a 64-bit kernel, so the machine name decides when long is narrower.
+ */
+static int net_counter_bits(void)
+{
+        int bits = atomic_load_explicit(&g_net_counter_bits, memory_order_relaxed);
+        if (bits != 0) return bits;
+
+        bits = 64;
+        if (sizeof(long) < 8) {
+                struct utsname uts;
+                if (uname(&uts) != 0 || (!strstr(uts.machine, "64") && strcmp(uts.machine, "s390x") != 0)) {
+                        bits = 32;
+                }
+        }
+
+        atomic_store_explicit(&g_net_counter_bits, bits, memory_order_relaxed);
+        return bits;
+}
+
+
+static inline int net_name_equal(const sl_net_names_t *names, int id, const char *name, size_t len, uint32_t hash)
+{
+        return names->hashes[id] == hash && memcmp(names->names[id], name, len) == 0 && names->names[id][len] == '\0';
+}
+
+
+/*
+ * Id of a name, adding it if new. /proc/net/dev lists interfaces in a
+ * stable order, so the slot at the same position as in the first sample
+ * is tried before scanning.
+ */
+static uint32_t net_intern(sl_net_names_t *names, int hint, const char *name, size_t len, uint32_t hash)
+{
+        if (hint < names->count && net_name_equal(names, hint, name, len, hash)) {
+                return (uint32_t)hint;
+        }
+
+        for (int i = 0; i < names->count; i++) {
+                if (net_name_equal(names, i, name, len, hash)) return (uint32_t)i;
+        }
+
+        int id = names->count++;
+        memcpy(names->names[id], name, len);
+        names->names[id][len] = '\0';
+        names->hashes[id] = hash;
+        return (uint32_t)id;
+}
+
+
+int sl_parse_net_dev(const char *buf, size_t len, sl_net_names_t *names, sl_net_raw_t *snapshot)
+{
+        const char *end = buf + len;
+        int count = 0;
+        int dropped = 0;
+
+        /* Interfaces come and go (veth, tun); start over before the table can fill up */
+        if (names->count > SL_NET_MAX_NAMES - SL_NET_MAX_IFACES) {
+                sl_net_names_reset(names);
+        }
+
+        for (const char *line = (len > 0) ? buf : NULL; line; line = sl_next_line(line, end)) {
+                const char *p = sl_skip_blanks(line);
+                const char *name = p;
+                uint32_t hash = 2166136261u;
+
+                /* Header lines have no ':' and are skipped here */
+                while (*p != ':' && *p != '\n' && *p != '\0') {
+                        hash = (hash ^ (uint8_t)*p) * 16777619u;
+                        p++;
+                }
+                if (*p != ':') continue;
+
+                size_t name_len = (size_t)(p - name);
+                if (name_len == 0 || name_len >= SL_NET_NAME_SIZE) continue;
+
+                if (count == SL_NET_MAX_IFACES) {
+                        dropped++;
+                        continue;
+                }
+
+                uint64_t v[NET_COUNTERS];
+                int n = 0;
+                p++;
+                while (n < NET_COUNTERS && (p = sl_parse_u64(p, &v[n])) != NULL) {
+                        n++;
+                }
+                if (n < NET_COUNTERS) {
+                        sl_log(SL_LOG_WARN, __func__, "skipping malformed net/dev line for %.*s", (int)name_len, name);
+                        continue;
+                }
+
+                sl_net_iface_raw_t *iface = &snapshot->ifaces[count];
+                iface->id = net_intern(names, count, name, name_len, hash);
+                memcpy(iface->name, names->names[iface->id], SL_NET_NAME_SIZE);
+                iface->rx_bytes = v[0];
+                iface->rx_packets = v[1];
+                iface->rx_errors = v[2];
+                iface->rx_dropped = v[3];
+                iface->rx_fifo = v[4];
+                iface->rx_frame = v[5];
+                iface->rx_compressed = v[6];
+                iface->rx_multicast = v[7];
+                iface->tx_bytes = v[8];
+                iface->tx_packets = v[9];
+                iface->tx_errors = v[10];
+                iface->tx_dropped = v[11];
+                iface->tx_fifo = v[12];
+                iface->tx_collisions = v[13];
+                iface->tx_carrier = v[14];
+                iface->tx_compressed = v[15];
+                count++;
+        }
+
+        if (dropped > 0) {
+                sl_log(SL_LOG_WARN, __func__, "%d interfaces beyond SL_NET_MAX_IFACES were skipped", dropped);
+        }
+
+        snapshot->count = count;
+        snapshot->names_tag = names->tag;
+        snapshot->counter_bits = net_counter_bits();
+        snapshot->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+int sl_net_get_raw(sl_net_raw_t *snapshot)
+{
+        if (!snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
+                return -1;
+        }
+
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_net_get_raw(&sampler, snapshot);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
+
+
+/* Interface of start matching end's interface i; usually at the same index */
+static const sl_net_iface_raw_t *net_match(const sl_net_raw_t *start, const sl_net_raw_t *end, int i)
+{
+        const sl_net_iface_raw_t *e = &end->ifaces[i];
+
+        if (start->names_tag == end->names_tag) {
+                if (i < start->count && start->ifaces[i].id == e->id) return &start->ifaces[i];
+                for (int j = 0; j < start->count; j++) {
+                        if (start->ifaces[j].id == e->id) return &start->ifaces[j];
+                }
+                return NULL;
+        }
+
+        /* Ids from different samplers are unrelated */
+        for (int j = 0; j < start->count; j++) {
+                if (strcmp(start->ifaces[j].name, e->name) == 0) return &start->ifaces[j];
+        }
+        return NULL;
+}
+
+
+/*
+ * Counters wrap at 2^32 on 32-bit kernels and at 2^64 otherwise. A
+ * decrease the wrap does not explain means the interface was recreated.
+ */
+static inline uint64_t net_delta(uint64_t start, uint64_t end, int wrap32)
+{
+        if (end >= start) return end - start;
+        if (wrap32 && start <= UINT32_MAX) return end + (UINT32_MAX - start) + 1;
+
+        uint64_t wrapped = end - start;
+        return (wrapped < (1ULL << 63)) ? wrapped : 0;
+}
+
+
+int sl_net_calculate(const sl_net_raw_t *start, const sl_net_raw_t *end, sl_net_usage_t *results, int max_results)
+{
+        if (!start || !end || !results || max_results <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end, results pointers are NULL or max_results is zero");
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval");
+                return -1;
+        }
+
+        double elapsed = (double)(end->timestamp_ns - start->timestamp_ns) / 1e9;
+        int wrap32 = start->counter_bits == 32 && end->counter_bits == 32;
+        int count = 0;
+
+        for (int i = 0; i < end->count && count < max_results; i++) {
+                const sl_net_iface_raw_t *e = &end->ifaces[i];
+                const sl_net_iface_raw_t *s = net_match(start, end, i);
+
+                /* Interfaces added between the snapshots have no baseline */
+                if (!s) continue;
+
+                sl_net_usage_t *r = &results[count++];
+                memcpy(r->name, e->name, sizeof(r->name));
+                r->rx_bytes_per_sec = net_delta(s->rx_bytes, e->rx_bytes, wrap32) / elapsed;
+                r->tx_bytes_per_sec = net_delta(s->tx_bytes, e->tx_bytes, wrap32) / elapsed;
+                r->rx_packets_per_sec = net_delta(s->rx_packets, e->rx_packets, wrap32) / elapsed;
+                r->tx_packets_per_sec = net_delta(s->tx_packets, e->tx_packets, wrap32) / elapsed;
+                r->rx_errors_per_sec = net_delta(s->rx_errors, e->rx_errors, wrap32) / elapsed;
+                r->tx_errors_per_sec = net_delta(s->tx_errors, e->tx_errors, wrap32) / elapsed;
+                r->rx_dropped_per_sec = net_delta(s->rx_dropped, e->rx_dropped, wrap32) / elapsed;
+                r->tx_dropped_per_sec = net_delta(s->tx_dropped, e->tx_dropped, wrap32) / elapsed;
+        }
+
+        return count;
+}
@@ -0,0 +1,365 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#define NUMA_DIR "devices/system/node"
+
+typedef struct
+{
+        int id;
+        sl_procfile_t meminfo;              /**< nodeN/meminfo, "Node N Key: value kB" */
+        sl_procfile_t numastat;             /**< nodeN/numastat, "key value" */
+} numa_node_t;
+
+struct sl_numa
+{
+        numa_node_t nodes[SL_NUMA_MAX_NODES];
+        int count;
+        int16_t *cpu_node;                  /**< Index into nodes per CPU id, -1 if unassigned */
+        int cpu_count;                      /**< Entries in cpu_node */
+        sl_sampler_t sampler;
+        sl_cpu_cores_t cores;
+};
+
+/* Keys of the per-node files and where they go */
+typedef struct
+{
+        const char *key;
+        size_t len;
+        size_t offset;
+} numa_key_t;
+
+#define NUMA_KEY(name, field) {name, sizeof(name) - 1, offsetof(sl_numa_node_raw_t, field)}
+
+static const numa_key_t meminfo_keys[] = {
+        NUMA_KEY("MemTotal", mem_total),
+        NUMA_KEY("MemFree", mem_free),
+        NUMA_KEY("MemUsed", mem_used),
+        NUMA_KEY("Active", active),
+        NUMA_KEY("Inactive", inactive),
+        NUMA_KEY("Dirty", dirty),
+        NUMA_KEY("Writeback", writeback),
+        NUMA_KEY("FilePages", file_pages),
+        NUMA_KEY("AnonPages", anon_pages),
+        NUMA_KEY("Shmem", shmem),
+        NUMA_KEY("Slab", slab),
+        NUMA_KEY("HugePages_Total", hugepages_total),
+        NUMA_KEY("HugePages_Free", hugepages_free),
+};
+
+static const numa_key_t numastat_keys[] = {
+        NUMA_KEY("numa_hit", numa_hit),
+        NUMA_KEY("numa_miss", numa_miss),
+        NUMA_KEY("numa_foreign", numa_foreign),
+        NUMA_KEY("interleave_hit", interleave_hit),
+        NUMA_KEY("local_node", local_node),
+        NUMA_KEY("other_node", other_node),
+};
+
+
+/* Next "a" or "a-b" range of a sysfs list such as "0-7,16-23"; returns 0 at the end */
+static int numa_list_next(const char **p, int *first, int *last)
+{
+        uint64_t a, b;
+        const char *q = sl_parse_u64(*p, &a);
+        if (!q || a > INT16_MAX) return 0;
+
+        b = a;
+        if (*q == '-') {
+                q = sl_parse_u64(q + 1, &b);
+                if (!q || b < a || b > INT16_MAX) return 0;
+        }
+        if (*q == ',') q++;
+
+        *p = q;
+        *first = (int)a;
+        *last = (int)b;
+        return 1;
+}
+
+
+/* Parse the known keys of nodeN/meminfo (node_prefix set) or nodeN/numastat */
+static void numa_parse_keys(const sl_procfile_t *file, int node_prefix, const numa_key_t *keys, size_t key_count,
+                            sl_numa_node_raw_t *node)
+{
+        const char *end = file->buf + file->len;
+
+        for (const char *line = file->len ? file->buf : NULL; line; line = sl_next_line(line, end)) {
+                const char *p = line;
+                if (node_prefix) {
+                        /* "Node 0 MemTotal:" */
+                        uint64_t id;
+                        if (strncmp(p, "Node ", 5) != 0 || !(p = sl_parse_u64(p + 5, &id))) continue;
+                        p = sl_skip_blanks(p);
+                }
+
+                size_t len = strcspn(p, node_prefix ? ":\n" : " \n");
+                for (size_t k = 0; k < key_count; k++) {
+                        if (keys[k].len == len && memcmp(p, keys[k].key, len) == 0) {
+                                sl_parse_u64(p + len + (node_prefix ? 1 : 0), (uint64_t *)((char *)node + keys[k].offset));
+                                break;
+                        }
+                }
+        }
+}
+
+
+/* One range of a node's cpulist */
+typedef struct
+{
+        int first;
+        int last;
+        int node;                           /**< Index into nodes */
+} numa_range_t;
+
+
+/* Read the node list and every node's CPU list once */
+static int numa_discover(sl_numa_t *numa, const char *root)
+{
+        sl_procfile_t file;
+        char name[64];
+
+        sl_procfile_init(&file, root, NUMA_DIR "/online");
+        if (sl_procfile_read(&file) != 0) {
+                sl_procfile_close(&file);
+                return -1;
+        }
+
+        const char *p = file.buf;
+        int first, last, full = 0;
+        while (!full && numa_list_next(&p, &first, &last)) {
+                for (int id = first; id <= last; id++) {
+                        if (numa->count == SL_NUMA_MAX_NODES) {
+                                sl_log(SL_LOG_WARN, __func__, "more than %d NUMA nodes, ignoring node%d and above",
+                                       SL_NUMA_MAX_NODES, id);
+                                full = 1;
+                                break;
+                        }
+                        numa->nodes[numa->count++].id = id;
+                }
+        }
+        sl_procfile_close(&file);
+
+        if (numa->count == 0) {
+                sl_log(SL_LOG_ERROR, __func__, "no online NUMA nodes under %s/" NUMA_DIR, root);
+                return -1;
+        }
+
+        /* Collect the CPU ranges of all nodes, then size the map from the highest id */
+        numa_range_t *ranges = NULL;
+        int range_count = 0, range_cap = 0, max_cpu = -1, ret = 0;
+
+        for (int n = 0; n < numa->count && ret == 0; n++) {
+                snprintf(name, sizeof(name), NUMA_DIR "/node%d/cpulist", numa->nodes[n].id);
+                sl_procfile_init(&file, root, name);
+                if (sl_procfile_read(&file) == 0) {
+                        p = file.buf;
+                        while (numa_list_next(&p, &first, &last)) {
+                                if (range_count == range_cap) {
+                                        int cap = range_cap ? range_cap * 2 : 16;
+                                        numa_range_t *grown = realloc(ranges, (size_t)cap * sizeof(*ranges));
+                                        if (!grown) {
+                                                sl_log(SL_LOG_ERROR, __func__, "failed to allocate CPU ranges");
+                                                ret = -1;
+                                                break;
+                                        }
+                                        ranges = grown;
+                                        range_cap = cap;
+                                }
+                                ranges[range_count++] = (numa_range_t){first, last, n};
+                                if (last > max_cpu) max_cpu = last;
+                        }
+                }
+                sl_procfile_close(&file);
+        }
+
+        if (ret == 0) {
+                numa->cpu_count = max_cpu + 1;
+                numa->cpu_node = malloc((size_t)(numa->cpu_count > 0 ? numa->cpu_count : 1) * sizeof(int16_t));
+                if (!numa->cpu_node) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to allocate CPU map");
+                        ret = -1;
+                }
+        }
+
+        if (ret == 0) {
+                for (int cpu = 0; cpu < numa->cpu_count; cpu++) numa->cpu_node[cpu] = -1;
+                for (int r = 0; r < range_count; r++) {
+                        for (int cpu = ranges[r].first; cpu <= ranges[r].last; cpu++) {
+                                numa->cpu_node[cpu] = (int16_t)ranges[r].node;
+                        }
+                }
+        }
+
+        free(ranges);
+        return ret;
+}
+
+
+sl_numa_t *sl_numa_create(void)
+{
+        sl_numa_t *numa = calloc(1, sizeof(*numa));
+        if (!numa) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate collector");
+                return NULL;
+        }
+
+        for (int n = 0; n < SL_NUMA_MAX_NODES; n++) {
+                numa->nodes[n].meminfo.fd = -1;
+                numa->nodes[n].numastat.fd = -1;
+        }
+        sl_sampler_init(&numa->sampler, NULL);
+
+        char root[SL_ROOT_SIZE], name[64];
+        if (numa_discover(numa, sl_sys_root(root)) != 0 ||
+            sl_cpu_cores_init(&numa->cores, numa->cpu_count) != 0) {
+                sl_numa_destroy(numa);
+                return NULL;
+        }
+
+        /* First reads size the buffers, so sampling does not allocate */
+        for (int n = 0; n < numa->count; n++) {
+                numa_node_t *node = &numa->nodes[n];
+                snprintf(name, sizeof(name), NUMA_DIR "/node%d/meminfo", node->id);
+                sl_procfile_init(&node->meminfo, root, name);
+                snprintf(name, sizeof(name), NUMA_DIR "/node%d/numastat", node->id);
+                sl_procfile_init(&node->numastat, root, name);
+
+                if (sl_procfile_read(&node->meminfo) != 0 || sl_procfile_read(&node->numastat) != 0) {
+                        sl_numa_destroy(numa);
+                        return NULL;
+                }
+        }
+
+        if (sl_sampler_cpu_get_raw_cores(&numa->sampler, &numa->cores) != 0) {
+                sl_numa_destroy(numa);
+                return NULL;
+        }
+
+        return numa;
+}
+
+
+void sl_numa_destroy(sl_numa_t *numa)
+{
+        if (!numa) return;
+
+        for (int n = 0; n < SL_NUMA_MAX_NODES; n++) {
+                sl_procfile_close(&numa->nodes[n].meminfo);
+                sl_procfile_close(&numa->nodes[n].numastat);
+        }
+        sl_cpu_cores_free(&numa->cores);
+        sl_sampler_fini(&numa->sampler);
+        free(numa->cpu_node);
+        free(numa);
+}
+
+
+static void cpu_add(sl_cpu_raw_t *sum, const sl_cpu_raw_t *core)
+{
+        sum->user += core->user;
+        sum->nice += core->nice;
+        sum->system += core->system;
+        sum->idle += core->idle;
+        sum->iowait += core->iowait;
+        sum->irq += core->irq;
+        sum->softirq += core->softirq;
+        sum->steal += core->steal;
+}
+
+
+int sl_numa_get_raw(sl_numa_t *numa, sl_numa_raw_t *raw)
+{
+        if (!numa || !raw) {
+                sl_log(SL_LOG_ERROR, __func__, "numa or raw pointer is NULL");
+                return -1;
+        }
+
+        if (sl_sampler_cpu_get_raw_cores(&numa->sampler, &numa->cores) != 0) {
+                return -1;
+        }
+
+        memset(raw->nodes, 0, sizeof(raw->nodes[0]) * (size_t)numa->count);
+        for (int n = 0; n < numa->count; n++) {
+                numa_node_t *node = &numa->nodes[n];
+                sl_numa_node_raw_t *out = &raw->nodes[n];
+                out->id = node->id;
+
+                if (sl_procfile_read(&node->meminfo) != 0 || sl_procfile_read(&node->numastat) != 0) {
+                        return -1;
+                }
+                numa_parse_keys(&node->meminfo, 1, meminfo_keys, sizeof(meminfo_keys) / sizeof(meminfo_keys[0]), out);
+                numa_parse_keys(&node->numastat, 0, numastat_keys, sizeof(numastat_keys) / sizeof(numastat_keys[0]), out);
+        }
+
+        int cpus = (numa->cores.count < numa->cpu_count) ? numa->cores.count : numa->cpu_count;
+        for (int cpu = 0; cpu < cpus; cpu++) {
+                int n = numa->cpu_node[cpu];
+                if (n < 0 || !numa->cores.online[cpu]) continue;
+                cpu_add(&raw->nodes[n].cpu, &numa->cores.cores[cpu]);
+                raw->nodes[n].cpu_count++;
+        }
+
+        raw->count = numa->count;
+        raw->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+static uint64_t cpu_sum(const sl_cpu_raw_t *c)
+{
+        return c->user + c->nice + c->system + c->idle + c->iowait + c->irq + c->softirq + c->steal;
+}
+
+
+int sl_numa_calculate(const sl_numa_raw_t *start, const sl_numa_raw_t *end, sl_numa_usage_t *results, int max_results)
+{
+        if (!start || !end || !results) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end or results pointer is NULL");
+                return -1;
+        }
+
+        if (start->count != end->count || end->count < 0 || end->count > SL_NUMA_MAX_NODES) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshots are from different topologies");
+                return -1;
+        }
+
+        double elapsed = (end->timestamp_ns > start->timestamp_ns) ?
+                         (double)(end->timestamp_ns - start->timestamp_ns) / 1e9 : 0.0;
+
+        int count = (end->count < max_results) ? end->count : max_results;
+        for (int n = 0; n < count; n++) {
+                const sl_numa_node_raw_t *s = &start->nodes[n], *e = &end->nodes[n];
+                sl_numa_usage_t *r = &results[n];
+
+                if (s->id != e->id) {
+                        sl_log(SL_LOG_ERROR, __func__, "snapshots are from different topologies");
+                        return -1;
+                }
+
+                memset(r, 0, sizeof(*r));
+                r->id = e->id;
+                /* Idle nodes and CPU-less nodes have no ticks to divide */
+                if (cpu_sum(&e->cpu) > cpu_sum(&s->cpu)) sl_cpu_calculate(&s->cpu, &e->cpu, &r->cpu);
+
+                r->mem_total = e->mem_total;
+                r->mem_free = e->mem_free;
+                if (e->mem_total > 0 && e->mem_free <= e->mem_total) {
+                        r->mem_percent_used = (double)(e->mem_total - e->mem_free) / (double)e->mem_total * 100.0;
+                }
+
+                if (elapsed > 0.0) {
+                        r->miss_per_sec = (e->numa_miss >= s->numa_miss) ? (double)(e->numa_miss - s->numa_miss) / elapsed : 0.0;
+                        r->foreign_per_sec = (e->numa_foreign >= s->numa_foreign) ?
+                                             (double)(e->numa_foreign - s->numa_foreign) / elapsed : 0.0;
+                }
+
+                uint64_t local = (e->local_node >= s->local_node) ? e->local_node - s->local_node : 0;
+                uint64_t other = (e->other_node >= s->other_node) ? e->other_node - s->other_node : 0;
+                r->local_percent = (local + other > 0) ? (double)local / (double)(local + other) * 100.0 : 100.0;
+        }
+
+        return count;
+}
@@ -0,0 +1,227 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+const char *const sl_psi_names[SL_PSI_RESOURCES] = {"cpu", "memory", "io"};
+
+
+/* Parse the value after the next '=' on the line */
+static const char *psi_field(const char *p, double *value)
+{
+        while (*p != '=' && *p != '\n' && *p != '\0') p++;
+        return (*p == '=') ? sl_parse_udouble(p + 1, value) : NULL;
+}
+
+
+/* "avg10=0.00 avg60=0.00 avg300=0.00 total=0" */
+static const char *psi_parse_line(const char *p, sl_psi_line_t *line)
+{
+        p = psi_field(p, &line->avg10);
+        if (p) p = psi_field(p, &line->avg60);
+        if (p) p = psi_field(p, &line->avg300);
+        if (!p) return NULL;
+
+        while (*p != '=' && *p != '\n' && *p != '\0') p++;
+        return (*p == '=') ? sl_parse_u64(p + 1, &line->total_us) : NULL;
+}
+
+
+int sl_parse_pressure(const char *buf, size_t len, sl_psi_raw_t *raw)
+{
+        const char *end = buf + len;
+        int has_some = 0;
+
+        memset(raw, 0, sizeof(*raw));
+
+        for (const char *line = (len > 0) ? buf : NULL; line; line = sl_next_line(line, end)) {
+                sl_psi_line_t *dest;
+
+                if (strncmp(line, "some ", 5) == 0) {
+                        dest = &raw->some;
+                        has_some = 1;
+                } else if (strncmp(line, "full ", 5) == 0) {
+                        dest = &raw->full;
+                        raw->has_full = 1;
+                } else {
+                        continue;
+                }
+
+                if (!psi_parse_line(line + 5, dest)) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to parse pressure line: %.64s", line);
+                        return -1;
+                }
+        }
+
+        if (!has_some) {
+                sl_log(SL_LOG_ERROR, __func__, "no \"some\" line in pressure file");
+                return -1;
+        }
+
+        raw->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+int sl_psi_get_raw(sl_psi_resource_t resource, sl_psi_raw_t *raw)
+{
+        if (!raw) {
+                sl_log(SL_LOG_ERROR, __func__, "raw pointer is NULL");
+                return -1;
+        }
+
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_psi_get_raw(&sampler, resource, raw);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
+
+
+static inline uint64_t psi_delta(uint64_t start, uint64_t end)
+{
+        return (end >= start) ? end - start : 0;
+}
+
+
+int sl_psi_calculate(const sl_psi_raw_t *start, const sl_psi_raw_t *end, sl_psi_usage_t *result)
+{
+        if (!start || !end || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end or result pointer is NULL");
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval");
+                return -1;
+        }
+
+        double interval_us = (double)(end->timestamp_ns - start->timestamp_ns) / 1e3;
+
+        result->some_us = psi_delta(start->some.total_us, end->some.total_us);
+        result->full_us = (start->has_full && end->has_full) ? psi_delta(start->full.total_us, end->full.total_us) : 0;
+
+        /* Stall totals and our timestamps come from different clocks; keep within 0-100 */
+        result->some_percent = (double)result->some_us / interval_us * 100.0;
+        result->full_percent = (double)result->full_us / interval_us * 100.0;
+        if (result->some_percent > 100.0) result->some_percent = 100.0;
+        if (result->full_percent > 100.0) result->full_percent = 100.0;
+
+        return 0;
+}
+
+
+int sl_psi_trigger_open(sl_psi_trigger_t *trigger, sl_psi_resource_t resource, int full,
+                        uint32_t stall_us, uint32_t window_us)
+{
+        if (!trigger || (unsigned)resource >= SL_PSI_RESOURCES || stall_us == 0 || stall_us > window_us) {
+                sl_log(SL_LOG_ERROR, __func__, "trigger pointer is NULL, invalid resource or stall_us > window_us");
+                return -1;
+        }
+
+        char root[SL_ROOT_SIZE], path[SL_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/pressure/%s", sl_proc_root(root), sl_psi_names[resource]);
+
+        trigger->fd = -1;
+        trigger->resource = resource;
+
+        int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s: %s", path, strerror(errno));
+                return -1;
+        }
+
+        /* The kernel expects the terminating NUL as part of the write */
+        char spec[64];
+        int n = snprintf(spec, sizeof(spec), "%s %u %u", full ? "full" : "some", stall_us, window_us);
+        if (write(fd, spec, (size_t)n + 1) < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to register trigger \"%s\" on %s: %s", spec, path, strerror(errno));
+                close(fd);
+                return -1;
+        }
+
+        trigger->fd = fd;
+        return 0;
+}
+
+
+int sl_psi_trigger_wait(const sl_psi_trigger_t *trigger, int timeout_ms)
+{
+        if (!trigger || trigger->fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "trigger pointer is NULL or trigger is closed");
+                return -1;
+        }
+
+        struct pollfd pfd = {trigger->fd, POLLPRI, 0};
+        int ret;
+        do {
+                ret = poll(&pfd, 1, timeout_ms);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "poll failed: %s", strerror(errno));
+                return -1;
+        }
+
+        if (pfd.revents & POLLERR) {
+                sl_log(SL_LOG_ERROR, __func__, "%s pressure trigger is no longer valid", sl_psi_names[trigger->resource]);
+                return -1;
+        }
+
+        return (pfd.revents & POLLPRI) ? 1 : 0;
+}
+
+
+void sl_psi_trigger_close(sl_psi_trigger_t *trigger)
+{
+        if (!trigger || trigger->fd < 0) return;
+
+        close(trigger->fd);
+        trigger->fd = -1;
+}
+
+
+/* "0.00 0.04 0.02 2/71 7584" */
+int sl_parse_loadavg(const char *buf, size_t len, sl_loadavg_t *result)
+{
+        uint64_t running = 0, total = 0, last_pid = 0;
+        const char *p = (len > 0) ? buf : NULL;
+
+        if (p) p = sl_parse_udouble(p, &result->load1);
+        if (p) p = sl_parse_udouble(p, &result->load5);
+        if (p) p = sl_parse_udouble(p, &result->load15);
+        if (p) p = sl_parse_u64(p, &running);
+        if (p && *p == '/') p = sl_parse_u64(p + 1, &total);
+        else p = NULL;
+        if (p) p = sl_parse_u64(p, &last_pid);
+
+        if (!p) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to parse /proc/loadavg: %.64s", buf);
+                return -1;
+        }
+
+        result->running = (uint32_t)running;
+        result->total = (uint32_t)total;
+        result->last_pid = (int32_t)last_pid;
+        return 0;
+}
+
+
+int sl_loadavg_get_info(sl_loadavg_t *result)
+{
+        if (!result) {
+                sl_log(SL_LOG_ERROR, __func__, "result pointer is NULL");
+                return -1;
+        }
+
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_loadavg_get_info(&sampler, result);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
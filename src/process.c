@@ -0,0 +1,404 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define PROC_READ_SIZE 4096
+#define PROC_DIRENT_SIZE 32768
+
+struct sl_proc_sampler
+{
+        int proc_fd;                        /**< O_DIRECTORY handle on /proc for openat() */
+        char root[SL_PATH_SIZE];            /**< Path proc_fd was opened at, for log messages */
+        long page_size;                     /**< Bytes per page for statm */
+        char buf[PROC_READ_SIZE];           /**< Shared read buffer */
+        char dirents[PROC_DIRENT_SIZE];     /**< getdents64 buffer for task/ listings */
+};
+
+
+sl_proc_sampler_t *sl_proc_sampler_create(void)
+{
+        return sl_proc_sampler_create_at(NULL);
+}
+
+
+sl_proc_sampler_t *sl_proc_sampler_create_at(const char *proc_root)
+{
+        char root_buf[SL_ROOT_SIZE];
+        const char *root = proc_root ? proc_root : sl_proc_root(root_buf);
+        sl_proc_sampler_t *sampler = malloc(sizeof(*sampler));
+        if (!sampler) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate process sampler");
+                return NULL;
+        }
+
+        sampler->proc_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (sampler->proc_fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s", root);
+                free(sampler);
+                return NULL;
+        }
+
+        snprintf(sampler->root, sizeof(sampler->root), "%s", root);
+        sampler->page_size = sysconf(_SC_PAGESIZE);
+        if (sampler->page_size <= 0) sampler->page_size = 4096;
+
+        return sampler;
+}
+
+
+void sl_proc_sampler_destroy(sl_proc_sampler_t *sampler)
+{
+        if (!sampler) return;
+
+        close(sampler->proc_fd);
+        free(sampler);
+}
+
+
+/* pread a small file into the shared buffer; returns bytes read or -1 */
+static ssize_t proc_pread(sl_proc_sampler_t *sampler, int fd)
+{
+        ssize_t n;
+        do {
+                n = pread(fd, sampler->buf, sizeof(sampler->buf) - 1, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0) return -1;
+
+        sampler->buf[n] = '\0';
+        return n;
+}
+
+
+/* Open, read and close a file relative to dirfd */
+static ssize_t proc_read_at(sl_proc_sampler_t *sampler, int dirfd, const char *path)
+{
+        int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return -1;
+
+        ssize_t n = proc_pread(sampler, fd);
+        close(fd);
+        return n;
+}
+
+
+/* Skip one whitespace-separated field */
+static const char *skip_field(const char *p)
+{
+        p = sl_skip_blanks(p);
+        while (*p != ' ' && *p != '\n' && *p != '\0') p++;
+        return p;
+}
+
+
+/* Parse /proc/<pid>/stat or /proc/<pid>/task/<tid>/stat; rss is left in pages */
+int sl_parse_pid_stat(const char *buf, size_t len, sl_proc_raw_t *raw)
+{
+        uint64_t pid = 0;
+        const char *p = sl_parse_u64(buf, &pid);
+        const char *open_paren = p ? strchr(p, '(') : NULL;
+
+        /* comm may itself contain ')' or spaces; the last ')' ends it */
+        const char *close_paren = NULL;
+        for (const char *q = buf + len; q > buf; q--) {
+                if (q[-1] == ')') {
+                        close_paren = q - 1;
+                        break;
+                }
+        }
+
+        if (!open_paren || !close_paren || close_paren < open_paren) {
+                return -1;
+        }
+
+        size_t comm_len = (size_t)(close_paren - open_paren - 1);
+        if (comm_len >= sizeof(raw->comm)) comm_len = sizeof(raw->comm) - 1;
+        memcpy(raw->comm, open_paren + 1, comm_len);
+        raw->comm[comm_len] = '\0';
+        raw->pid = (int32_t)pid;
+
+        p = sl_skip_blanks(close_paren + 1);
+        raw->state = *p;
+        if (*p != '\0') p++;
+
+        /* Fields are numbered as in proc(5); p now points past field 3 */
+        uint64_t ignored;
+        for (int field = 4; field <= 24; field++) {
+                uint64_t *dest = &ignored;
+
+                switch (field) {
+                case 10: dest = &raw->minflt; break;
+                case 12: dest = &raw->majflt; break;
+                case 14: dest = &raw->utime; break;
+                case 15: dest = &raw->stime; break;
+                case 20: dest = &raw->num_threads; break;
+                case 22: dest = &raw->start_time; break;
+                case 23: dest = &raw->vsize; break;
+                case 24: dest = &raw->rss; break;
+                default: break;
+                }
+
+                if (dest == &ignored) {
+                        /* priority and nice may be negative */
+                        p = skip_field(p);
+                } else if (!(p = sl_parse_u64(p, dest))) {
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+
+/* Parse /proc/<pid>/statm; rss from statm overrides the rss from stat */
+static int parse_pid_statm(const char *buf, long page_size, sl_proc_raw_t *raw)
+{
+        uint64_t size, resident, shared;
+        const char *p = sl_parse_u64(buf, &size);
+        if (p) p = sl_parse_u64(p, &resident);
+        if (p) p = sl_parse_u64(p, &shared);
+        if (!p) return -1;
+
+        raw->rss = resident * (uint64_t)page_size;
+        raw->shared = shared * (uint64_t)page_size;
+        return 0;
+}
+
+
+/* Parse read_bytes/write_bytes from /proc/<pid>/io */
+static void parse_pid_io(const char *buf, size_t len, sl_proc_raw_t *raw)
+{
+        const char *end = buf + len;
+
+        for (const char *line = (len > 0) ? buf : NULL; line; line = sl_next_line(line, end)) {
+                if (strncmp(line, "read_bytes:", 11) == 0) {
+                        sl_parse_u64(line + 11, &raw->read_bytes);
+                } else if (strncmp(line, "write_bytes:", 12) == 0) {
+                        sl_parse_u64(line + 12, &raw->write_bytes);
+                        break;
+                }
+        }
+}
+
+
+/* Convert rss from stat (pages) to bytes when statm was unavailable, and stamp */
+static void proc_finish_raw(sl_proc_sampler_t *sampler, sl_proc_raw_t *raw, int have_statm)
+{
+        if (!have_statm) {
+                raw->rss *= (uint64_t)sampler->page_size;
+        }
+        raw->timestamp_ns = sl_now_ns();
+}
+
+
+int sl_proc_get_raw(sl_proc_sampler_t *sampler, int pid, sl_proc_raw_t *raw)
+{
+        if (!sampler || !raw || pid <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or raw pointer is NULL, or pid is invalid");
+                return -1;
+        }
+
+        char path[48];
+        ssize_t n;
+
+        memset(raw, 0, sizeof(*raw));
+
+        snprintf(path, sizeof(path), "%d/stat", pid);
+        n = proc_read_at(sampler, sampler->proc_fd, path);
+        if (n <= 0 || sl_parse_pid_stat(sampler->buf, (size_t)n, raw) != 0) {
+                /* Processes exit between listing and reading; not worth an error */
+                sl_log(SL_LOG_INFO, __func__, "failed to read %s/%s", sampler->root, path);
+                return -1;
+        }
+
+        snprintf(path, sizeof(path), "%d/statm", pid);
+        n = proc_read_at(sampler, sampler->proc_fd, path);
+        int have_statm = (n > 0 && parse_pid_statm(sampler->buf, sampler->page_size, raw) == 0);
+
+        /* io needs ptrace access; leave counters at zero if denied */
+        snprintf(path, sizeof(path), "%d/io", pid);
+        n = proc_read_at(sampler, sampler->proc_fd, path);
+        if (n > 0) {
+                parse_pid_io(sampler->buf, (size_t)n, raw);
+        }
+
+        proc_finish_raw(sampler, raw, have_statm);
+        return 0;
+}
+
+
+int sl_proc_open(sl_proc_sampler_t *sampler, int pid, sl_proc_handle_t *handle)
+{
+        if (!sampler || !handle || pid <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or handle pointer is NULL, or pid is invalid");
+                return -1;
+        }
+
+        char path[48];
+
+        handle->pid = pid;
+
+        snprintf(path, sizeof(path), "%d/stat", pid);
+        handle->stat_fd = openat(sampler->proc_fd, path, O_RDONLY | O_CLOEXEC);
+        if (handle->stat_fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s/%s", sampler->root, path);
+                return -1;
+        }
+
+        snprintf(path, sizeof(path), "%d/statm", pid);
+        handle->statm_fd = openat(sampler->proc_fd, path, O_RDONLY | O_CLOEXEC);
+
+        snprintf(path, sizeof(path), "%d/io", pid);
+        handle->io_fd = openat(sampler->proc_fd, path, O_RDONLY | O_CLOEXEC);
+
+        return 0;
+}
+
+
+int sl_proc_handle_get_raw(sl_proc_sampler_t *sampler, const sl_proc_handle_t *handle, sl_proc_raw_t *raw)
+{
+        if (!sampler || !handle || !raw || handle->stat_fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler, handle or raw pointer is NULL, or handle is closed");
+                return -1;
+        }
+
+        ssize_t n;
+
+        memset(raw, 0, sizeof(*raw));
+
+        /* Reads fail with ESRCH once the process has exited */
+        n = proc_pread(sampler, handle->stat_fd);
+        if (n <= 0 || sl_parse_pid_stat(sampler->buf, (size_t)n, raw) != 0) {
+                sl_log(SL_LOG_INFO, __func__, "failed to read %s/%d/stat", sampler->root, handle->pid);
+                return -1;
+        }
+
+        int have_statm = 0;
+        if (handle->statm_fd >= 0) {
+                n = proc_pread(sampler, handle->statm_fd);
+                have_statm = (n > 0 && parse_pid_statm(sampler->buf, sampler->page_size, raw) == 0);
+        }
+
+        if (handle->io_fd >= 0) {
+                n = proc_pread(sampler, handle->io_fd);
+                if (n > 0) {
+                        parse_pid_io(sampler->buf, (size_t)n, raw);
+                }
+        }
+
+        proc_finish_raw(sampler, raw, have_statm);
+        return 0;
+}
+
+
+void sl_proc_close(sl_proc_handle_t *handle)
+{
+        if (!handle) return;
+
+        if (handle->stat_fd >= 0) close(handle->stat_fd);
+        if (handle->statm_fd >= 0) close(handle->statm_fd);
+        if (handle->io_fd >= 0) close(handle->io_fd);
+
+        handle->stat_fd = handle->statm_fd = handle->io_fd = -1;
+}
+
+
+int sl_proc_get_threads(sl_proc_sampler_t *sampler, int pid, sl_proc_raw_t *threads, int max_threads)
+{
+        if (!sampler || !threads || pid <= 0 || max_threads <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or threads pointer is NULL, or pid/max_threads is invalid");
+                return -1;
+        }
+
+        char path[48];
+        snprintf(path, sizeof(path), "%d/task", pid);
+
+        int task_fd = openat(sampler->proc_fd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (task_fd < 0) {
+                sl_log(SL_LOG_INFO, __func__, "failed to open %s/%s", sampler->root, path);
+                return -1;
+        }
+
+        int count = 0;
+
+        for (;;) {
+                long nread = sl_getdents64(task_fd, sampler->dirents, sizeof(sampler->dirents));
+                if (nread <= 0) break;
+
+                for (long off = 0; off < nread && count < max_threads; ) {
+                        struct sl_dirent64 *d = (struct sl_dirent64 *)(sampler->dirents + off);
+                        off += d->d_reclen;
+
+                        if (d->d_name[0] < '1' || d->d_name[0] > '9') continue;
+
+                        sl_proc_raw_t *raw = &threads[count];
+                        memset(raw, 0, sizeof(*raw));
+
+                        char rel[32];
+                        snprintf(rel, sizeof(rel), "%s/stat", d->d_name);
+                        ssize_t n = proc_read_at(sampler, task_fd, rel);
+                        if (n <= 0 || sl_parse_pid_stat(sampler->buf, (size_t)n, raw) != 0) {
+                                continue;   /* thread exited meanwhile */
+                        }
+
+                        snprintf(rel, sizeof(rel), "%s/io", d->d_name);
+                        n = proc_read_at(sampler, task_fd, rel);
+                        if (n > 0) {
+                                parse_pid_io(sampler->buf, (size_t)n, raw);
+                        }
+
+                        proc_finish_raw(sampler, raw, 0);
+                        count++;
+                }
+
+                if (count >= max_threads) break;
+        }
+
+        close(task_fd);
+        return count;
+}
+
+
+int sl_proc_calculate(const sl_proc_raw_t *start, const sl_proc_raw_t *end, sl_proc_usage_t *result)
+{
+        if (!start || !end || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end, result pointers are NULL");
+                return -1;
+        }
+
+        if (start->pid != end->pid || start->start_time != end->start_time) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshots belong to different processes (pid %d reused?)", (int)end->pid);
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval");
+                return -1;
+        }
+
+        long clk_tck = sysconf(_SC_CLK_TCK);
+        if (clk_tck <= 0) clk_tck = 100;
+
+        double elapsed = (double)(end->timestamp_ns - start->timestamp_ns) / 1e9;
+        double ticks = elapsed * (double)clk_tck;
+
+        uint64_t d_user = (end->utime > start->utime) ? end->utime - start->utime : 0;
+        uint64_t d_system = (end->stime > start->stime) ? end->stime - start->stime : 0;
+        uint64_t d_read = (end->read_bytes > start->read_bytes) ? end->read_bytes - start->read_bytes : 0;
+        uint64_t d_write = (end->write_bytes > start->write_bytes) ? end->write_bytes - start->write_bytes : 0;
+
+        result->user = (float)(d_user / ticks * 100.0);
+        result->system = (float)(d_system / ticks * 100.0);
+        result->total = result->user + result->system;
+        result->rss = end->rss;
+        result->read_bytes_per_sec = d_read / elapsed;
+        result->write_bytes_per_sec = d_write / elapsed;
+        result->minflt_per_sec = ((end->minflt > start->minflt) ? end->minflt - start->minflt : 0) / elapsed;
+        result->majflt_per_sec = ((end->majflt > start->majflt) ? end->majflt - start->majflt : 0) / elapsed;
+
+        return 0;
+}
@@ -0,0 +1,299 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TOP_READ_SIZE 1024
+#define TOP_DIRENT_SIZE 65536
+
+/* Previous counters of one pid; pid 0 marks an empty slot */
+typedef struct
+{
+        int32_t pid;
+        uint64_t start_time;
+        uint64_t cpu_ticks;     /**< utime + stime */
+} top_slot_t;
+
+struct sl_proc_top
+{
+        int proc_fd;
+        sl_proc_top_key_t key;
+        long clk_tck;
+        long page_size;
+
+        /*
+         * Two open-addressing tables carved from one arena: lookups hit the
+         * previous refresh, inserts go to the current one, then they swap.
+         * Exited pids simply are not carried over, so no deletion is needed.
+         */
+        top_slot_t *arena;
+        top_slot_t *prev;
+        top_slot_t *cur;
+        size_t table_size;      /**< Slots per table, power of two */
+        int table_shift;        /**< 64 - log2(table_size) for Fibonacci hashing */
+        int max_procs;
+        uint64_t prev_ns;       /**< Time of the previous refresh, 0 before the first */
+
+        sl_proc_top_entry_t *heap;  /**< Min-heap of the current top entries */
+        int top_n;
+
+        char buf[TOP_READ_SIZE];
+        char dirents[TOP_DIRENT_SIZE];
+};
+
+
+static inline size_t top_hash(const sl_proc_top_t *top, int32_t pid)
+{
+        return (size_t)(((uint64_t)(uint32_t)pid * 0x9E3779B97F4A7C15ULL) >> top->table_shift);
+}
+
+
+static const top_slot_t *top_lookup(const sl_proc_top_t *top, int32_t pid)
+{
+        size_t mask = top->table_size - 1;
+
+        for (size_t i = top_hash(top, pid); ; i = (i + 1) & mask) {
+                const top_slot_t *slot = &top->prev[i];
+                if (slot->pid == pid) return slot;
+                if (slot->pid == 0) return NULL;
+        }
+}
+
+
+static void top_insert(sl_proc_top_t *top, const top_slot_t *entry)
+{
+        size_t mask = top->table_size - 1;
+        size_t i = top_hash(top, entry->pid);
+
+        while (top->cur[i].pid != 0) {
+                i = (i + 1) & mask;
+        }
+        top->cur[i] = *entry;
+}
+
+
+static inline double top_value(const sl_proc_top_t *top, const sl_proc_top_entry_t *e)
+{
+        return (top->key == SL_PROC_TOP_CPU) ? (double)e->cpu : (double)e->rss;
+}
+
+
+static void heap_sift_down(sl_proc_top_t *top, int count, int i)
+{
+        sl_proc_top_entry_t *h = top->heap;
+
+        for (;;) {
+                int smallest = i;
+                int l = 2 * i + 1, r = l + 1;
+
+                if (l < count && top_value(top, &h[l]) < top_value(top, &h[smallest])) smallest = l;
+                if (r < count && top_value(top, &h[r]) < top_value(top, &h[smallest])) smallest = r;
+                if (smallest == i) return;
+
+                sl_proc_top_entry_t tmp = h[i];
+                h[i] = h[smallest];
+                h[smallest] = tmp;
+                i = smallest;
+        }
+}
+
+
+static void heap_push(sl_proc_top_t *top, int *count, const sl_proc_top_entry_t *entry)
+{
+        sl_proc_top_entry_t *h = top->heap;
+
+        if (*count < top->top_n) {
+                int i = (*count)++;
+                h[i] = *entry;
+                while (i > 0) {
+                        int parent = (i - 1) / 2;
+                        if (top_value(top, &h[parent]) <= top_value(top, &h[i])) break;
+                        sl_proc_top_entry_t tmp = h[i];
+                        h[i] = h[parent];
+                        h[parent] = tmp;
+                        i = parent;
+                }
+        } else if (top_value(top, entry) > top_value(top, &h[0])) {
+                h[0] = *entry;
+                heap_sift_down(top, *count, 0);
+        }
+}
+
+
+sl_proc_top_t *sl_proc_top_create(const char *proc_root, int max_procs, int top_n, sl_proc_top_key_t key)
+{
+        if (max_procs <= 0 || top_n <= 0 || (key != SL_PROC_TOP_CPU && key != SL_PROC_TOP_RSS)) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid max_procs, top_n or key");
+                return NULL;
+        }
+
+        sl_proc_top_t *top = calloc(1, sizeof(*top));
+        if (!top) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate scanner");
+                return NULL;
+        }
+
+        /* Keep the load factor at or below 50% */
+        size_t table_size = 16;
+        int bits = 4;
+        while (table_size < (size_t)max_procs * 2) {
+                table_size *= 2;
+                bits++;
+        }
+
+        top->table_size = table_size;
+        top->table_shift = 64 - bits;
+        top->max_procs = max_procs;
+        top->top_n = top_n;
+        top->key = key;
+        top->clk_tck = sysconf(_SC_CLK_TCK);
+        top->page_size = sysconf(_SC_PAGESIZE);
+        if (top->clk_tck <= 0) top->clk_tck = 100;
+        if (top->page_size <= 0) top->page_size = 4096;
+
+        top->arena = calloc(table_size * 2, sizeof(top_slot_t));
+        top->heap = calloc((size_t)top_n, sizeof(sl_proc_top_entry_t));
+        top->proc_fd = -1;
+        if (!top->arena || !top->heap) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate tables for %d processes", max_procs);
+                sl_proc_top_destroy(top);
+                return NULL;
+        }
+        top->prev = top->arena;
+        top->cur = top->arena + table_size;
+
+        char root_buf[SL_ROOT_SIZE];
+        const char *root = proc_root ? proc_root : sl_proc_root(root_buf);
+        top->proc_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (top->proc_fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s", root);
+                sl_proc_top_destroy(top);
+                return NULL;
+        }
+
+        return top;
+}
+
+
+void sl_proc_top_destroy(sl_proc_top_t *top)
+{
+        if (!top) return;
+
+        if (top->proc_fd >= 0) close(top->proc_fd);
+        free(top->arena);
+        free(top->heap);
+        free(top);
+}
+
+
+/* Read <pid>/stat relative to the proc directory; -1 if the pid vanished */
+static int top_read_stat(sl_proc_top_t *top, const char *name, sl_proc_raw_t *raw)
+{
+        char path[32];
+        snprintf(path, sizeof(path), "%s/stat", name);
+
+        int fd = openat(top->proc_fd, path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return -1;
+
+        ssize_t n;
+        do {
+                n = read(fd, top->buf, sizeof(top->buf) - 1);
+        } while (n < 0 && errno == EINTR);
+        close(fd);
+
+        if (n <= 0) return -1;
+        top->buf[n] = '\0';
+
+        return sl_parse_pid_stat(top->buf, (size_t)n, raw);
+}
+
+
+int sl_proc_top_refresh(sl_proc_top_t *top, sl_proc_top_entry_t *entries, int max_entries)
+{
+        if (!top || !entries || max_entries <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "top or entries pointer is NULL, or max_entries is zero");
+                return -1;
+        }
+
+        if (lseek(top->proc_fd, 0, SEEK_SET) < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to rewind proc directory");
+                return -1;
+        }
+
+        uint64_t now = sl_now_ns();
+        double ticks = (top->prev_ns > 0) ? (double)(now - top->prev_ns) / 1e9 * (double)top->clk_tck : 0.0;
+
+        memset(top->cur, 0, top->table_size * sizeof(top_slot_t));
+
+        int tracked = 0;
+        int heap_count = 0;
+        int overflow = 0;
+
+        for (;;) {
+                long nread = sl_getdents64(top->proc_fd, top->dirents, sizeof(top->dirents));
+                if (nread < 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to list proc directory: %s", strerror(errno));
+                        return -1;
+                }
+                if (nread == 0) break;
+
+                for (long off = 0; off < nread; ) {
+                        struct sl_dirent64 *d = (struct sl_dirent64 *)(top->dirents + off);
+                        off += d->d_reclen;
+
+                        if (d->d_name[0] < '1' || d->d_name[0] > '9') continue;
+
+                        sl_proc_raw_t raw;
+                        if (top_read_stat(top, d->d_name, &raw) != 0) continue;
+
+                        top_slot_t slot = {raw.pid, raw.start_time, raw.utime + raw.stime};
+                        sl_proc_top_entry_t entry;
+
+                        entry.pid = raw.pid;
+                        memcpy(entry.comm, raw.comm, sizeof(entry.comm));
+                        entry.rss = raw.rss * (uint64_t)top->page_size;
+                        entry.cpu = 0.0f;
+
+                        /* A pid seen for the first time (or reused) only gets a baseline */
+                        const top_slot_t *prev = top_lookup(top, raw.pid);
+                        if (prev && prev->start_time == slot.start_time && ticks > 0.0 &&
+                            slot.cpu_ticks >= prev->cpu_ticks) {
+                                entry.cpu = (float)((double)(slot.cpu_ticks - prev->cpu_ticks) / ticks * 100.0);
+                        }
+
+                        if (tracked < top->max_procs) {
+                                top_insert(top, &slot);
+                                tracked++;
+                        } else {
+                                overflow++;
+                        }
+
+                        heap_push(top, &heap_count, &entry);
+                }
+        }
+
+        if (overflow > 0) {
+                sl_log(SL_LOG_WARN, __func__, "%d processes beyond max_procs=%d are not tracked for CPU", overflow, top->max_procs);
+        }
+
+        top_slot_t *swap = top->prev;
+        top->prev = top->cur;
+        top->cur = swap;
+        top->prev_ns = now;
+
+        /* Heap sort in place: repeatedly move the minimum to the end */
+        for (int n = heap_count; n > 1; n--) {
+                sl_proc_top_entry_t tmp = top->heap[0];
+                top->heap[0] = top->heap[n - 1];
+                top->heap[n - 1] = tmp;
+                heap_sift_down(top, n - 1, 0);
+        }
+
+        int count = (heap_count < max_entries) ? heap_count : max_entries;
+        memcpy(entries, top->heap, (size_t)count * sizeof(sl_proc_top_entry_t));
+
+        return count;
+}
@@ -0,0 +1,553 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * File layout: an 8-byte header, then blocks. Each block is one write():
+ * 4 sync bytes, the payload length (u32 little-endian) and the records.
+ * A record is a type byte, the timestamp and the fields, each encoded as
+ * a zigzag varint of the difference to the previous record of the same
+ * kind. Differences wrap, so counter resets are exact, just longer.
+ *
+ * A session record (type, CLOCK_MONOTONIC and CLOCK_REALTIME at open)
+ * starts every recorder and resets all previous values to zero. A block
+ * that is not followed by another sync or the end of the file was torn
+ * (crash, full disk) and is skipped; decoding resumes at the next
+ * session.
+ */
+#define RECORD_VERSION 1
+#define RECORD_HEADER_SIZE 8
+#define RECORD_BLOCK_HEADER 8
+#define RECORD_MAX_SIZE 96          /* Type, timestamp and 8 fields of at most 10 bytes */
+#define RECORD_DEFAULT_BUFFER 65536
+#define RECORD_MIN_BUFFER 4096
+
+#define CPU_FIELDS 8
+#define MEM_FIELDS 8
+#define SYSTIME_FIELDS 2
+#define STORAGE_FIELDS 3
+
+static const uint8_t record_header[RECORD_HEADER_SIZE] = {'S', 'L', 'R', 'E', 'C', 0, RECORD_VERSION, 0};
+static const uint8_t record_sync[4] = {0xA5, 'S', 'L', 0x5A};
+
+/* Previous values of each kind; encoder and decoder keep the same state */
+typedef struct
+{
+        uint64_t timestamp_ns;
+        uint64_t cpu[CPU_FIELDS];
+        uint64_t mem[MEM_FIELDS];
+        uint64_t systime[SYSTIME_FIELDS];
+        uint64_t storage[SL_RECORD_MAX_SLOTS][STORAGE_FIELDS];
+} record_state_t;
+
+struct sl_recorder
+{
+        int fd;
+        int need_session;           /**< Next record must be preceded by a session */
+        record_state_t state;
+        size_t len;                 /**< Bytes used in buf, block header included */
+        size_t cap;
+        uint8_t *buf;
+};
+
+struct sl_replay
+{
+        const uint8_t *data;
+        size_t size;
+        size_t pos;                 /**< Offset of the next record or block */
+        size_t block_end;
+        int in_session;
+        record_state_t state;
+};
+
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t value)
+{
+        while (value >= 0x80) {
+                *p++ = (uint8_t)value | 0x80;
+                value >>= 7;
+        }
+        *p++ = (uint8_t)value;
+        return p;
+}
+
+
+/* Store value as a zigzag difference to *prev and remember it */
+static inline uint8_t *put_delta(uint8_t *p, uint64_t *prev, uint64_t value)
+{
+        uint64_t diff = value - *prev;
+        *prev = value;
+        return put_varint(p, (diff << 1) ^ (0 - (diff >> 63)));
+}
+
+
+/* NULL if the varint is truncated or longer than 64 bits */
+static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+        uint64_t v = 0;
+
+        for (int shift = 0; shift < 64 && p < end; shift += 7) {
+                uint8_t byte = *p++;
+                v |= (uint64_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                        *value = v;
+                        return p;
+                }
+        }
+        return NULL;
+}
+
+
+static inline const uint8_t *get_delta(const uint8_t *p, const uint8_t *end, uint64_t *prev)
+{
+        uint64_t zigzag;
+
+        p = get_varint(p, end, &zigzag);
+        if (p) *prev += (zigzag >> 1) ^ (0 - (zigzag & 1));
+        return p;
+}
+
+
+/* Seconds with two decimals, as in /proc/uptime */
+static inline uint64_t to_centiseconds(double seconds)
+{
+        return (seconds > 0.0) ? (uint64_t)(seconds * 100.0 + 0.5) : 0;
+}
+
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+        while (len > 0) {
+                ssize_t n = write(fd, buf, len);
+                if (n < 0) {
+                        if (errno == EINTR) continue;
+                        return -1;
+                }
+                buf += n;
+                len -= (size_t)n;
+        }
+        return 0;
+}
+
+
+sl_recorder_t *sl_recorder_open(const char *path, size_t buffer_size)
+{
+        if (!path) {
+                sl_log(SL_LOG_ERROR, __func__, "path is NULL");
+                return NULL;
+        }
+
+        if (buffer_size == 0) buffer_size = RECORD_DEFAULT_BUFFER;
+        if (buffer_size < RECORD_MIN_BUFFER) buffer_size = RECORD_MIN_BUFFER;
+
+        int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s: %s", path, strerror(errno));
+                return NULL;
+        }
+
+        struct stat st;
+        uint8_t header[RECORD_HEADER_SIZE];
+        if (fstat(fd, &st) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to stat %s: %s", path, strerror(errno));
+                close(fd);
+                return NULL;
+        }
+
+        if (st.st_size == 0) {
+                if (write_all(fd, record_header, sizeof(record_header)) != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to write header to %s: %s", path, strerror(errno));
+                        close(fd);
+                        return NULL;
+                }
+        } else if (pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+                   memcmp(header, record_header, sizeof(header)) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "%s is not a version %d sysload recording", path, RECORD_VERSION);
+                close(fd);
+                return NULL;
+        }
+
+        sl_recorder_t *recorder = malloc(sizeof(*recorder) + buffer_size);
+        if (!recorder) {
+                sl_log(SL_LOG_ERROR, __func__, "out of memory");
+                close(fd);
+                return NULL;
+        }
+
+        memset(recorder, 0, sizeof(*recorder));
+        recorder->fd = fd;
+        recorder->need_session = 1;
+        recorder->buf = (uint8_t *)(recorder + 1);
+        recorder->cap = buffer_size;
+        recorder->len = RECORD_BLOCK_HEADER;
+        return recorder;
+}
+
+
+int sl_recorder_flush(sl_recorder_t *recorder)
+{
+        if (!recorder) {
+                sl_log(SL_LOG_ERROR, __func__, "recorder pointer is NULL");
+                return -1;
+        }
+
+        size_t payload = recorder->len - RECORD_BLOCK_HEADER;
+        if (payload == 0) return 0;
+
+        uint8_t *h = recorder->buf;
+        memcpy(h, record_sync, sizeof(record_sync));
+        h[4] = (uint8_t)payload;
+        h[5] = (uint8_t)(payload >> 8);
+        h[6] = (uint8_t)(payload >> 16);
+        h[7] = (uint8_t)(payload >> 24);
+
+        int ret = write_all(recorder->fd, recorder->buf, recorder->len);
+        if (ret != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to write %zu bytes of recording: %s", recorder->len, strerror(errno));
+                /* Later records would be deltas against the dropped ones */
+                recorder->need_session = 1;
+        }
+
+        recorder->len = RECORD_BLOCK_HEADER;
+        return ret;
+}
+
+
+/* Make room for a record, then write its type and timestamp; NULL on error */
+static uint8_t *recorder_begin(sl_recorder_t *recorder, sl_record_type_t type, uint64_t timestamp_ns)
+{
+        if (recorder->cap - recorder->len < 2 * RECORD_MAX_SIZE && sl_recorder_flush(recorder) != 0) {
+                return NULL;
+        }
+
+        uint8_t *p = recorder->buf + recorder->len;
+
+        if (recorder->need_session) {
+                struct timespec realtime;
+                clock_gettime(CLOCK_REALTIME, &realtime);
+                uint64_t monotonic_ns = sl_now_ns();
+
+                memset(&recorder->state, 0, sizeof(recorder->state));
+                *p++ = SL_RECORD_SESSION;
+                p = put_delta(p, &recorder->state.timestamp_ns, monotonic_ns);
+                p = put_varint(p, (uint64_t)realtime.tv_sec * 1000000000ULL + (uint64_t)realtime.tv_nsec);
+                recorder->need_session = 0;
+        }
+
+        *p++ = (uint8_t)type;
+        return put_delta(p, &recorder->state.timestamp_ns, timestamp_ns ? timestamp_ns : sl_now_ns());
+}
+
+
+int sl_recorder_write_cpu(sl_recorder_t *recorder, uint64_t timestamp_ns, const sl_cpu_raw_t *cpu)
+{
+        if (!recorder || !cpu) {
+                sl_log(SL_LOG_ERROR, __func__, "recorder or cpu pointer is NULL");
+                return -1;
+        }
+
+        uint8_t *p = recorder_begin(recorder, SL_RECORD_CPU, timestamp_ns);
+        if (!p) return -1;
+
+        uint64_t *prev = recorder->state.cpu;
+        p = put_delta(p, &prev[0], cpu->user);
+        p = put_delta(p, &prev[1], cpu->nice);
+        p = put_delta(p, &prev[2], cpu->system);
+        p = put_delta(p, &prev[3], cpu->idle);
+        p = put_delta(p, &prev[4], cpu->iowait);
+        p = put_delta(p, &prev[5], cpu->irq);
+        p = put_delta(p, &prev[6], cpu->softirq);
+        p = put_delta(p, &prev[7], cpu->steal);
+
+        recorder->len = (size_t)(p - recorder->buf);
+        return 0;
+}
+
+
+int sl_recorder_write_mem(sl_recorder_t *recorder, uint64_t timestamp_ns, const sl_mem_info_t *mem)
+{
+        if (!recorder || !mem) {
+                sl_log(SL_LOG_ERROR, __func__, "recorder or mem pointer is NULL");
+                return -1;
+        }
+
+        uint8_t *p = recorder_begin(recorder, SL_RECORD_MEM, timestamp_ns);
+        if (!p) return -1;
+
+        uint64_t *prev = recorder->state.mem;
+        p = put_delta(p, &prev[0], mem->total);
+        p = put_delta(p, &prev[1], mem->free);
+        p = put_delta(p, &prev[2], mem->available);
+        p = put_delta(p, &prev[3], mem->buffers);
+        p = put_delta(p, &prev[4], mem->cached);
+        p = put_delta(p, &prev[5], mem->shared);
+        p = put_delta(p, &prev[6], mem->swap_total);
+        p = put_delta(p, &prev[7], mem->swap_free);
+
+        recorder->len = (size_t)(p - recorder->buf);
+        return 0;
+}
+
+
+int sl_recorder_write_systime(sl_recorder_t *recorder, uint64_t timestamp_ns, const sl_systime_info_t *systime)
+{
+        if (!recorder || !systime) {
+                sl_log(SL_LOG_ERROR, __func__, "recorder or systime pointer is NULL");
+                return -1;
+        }
+
+        uint8_t *p = recorder_begin(recorder, SL_RECORD_SYSTIME, timestamp_ns);
+        if (!p) return -1;
+
+        uint64_t *prev = recorder->state.systime;
+        p = put_delta(p, &prev[0], to_centiseconds(systime->uptime));
+        p = put_delta(p, &prev[1], to_centiseconds(systime->idle_time));
+
+        recorder->len = (size_t)(p - recorder->buf);
+        return 0;
+}
+
+
+int sl_recorder_write_storage(sl_recorder_t *recorder, uint64_t timestamp_ns, int slot, const sl_storage_info_t *storage)
+{
+        if (!recorder || !storage || slot < 0 || slot >= SL_RECORD_MAX_SLOTS) {
+                sl_log(SL_LOG_ERROR, __func__, "recorder or storage pointer is NULL, or slot is out of range");
+                return -1;
+        }
+
+        uint8_t *p = recorder_begin(recorder, SL_RECORD_STORAGE, timestamp_ns);
+        if (!p) return -1;
+
+        uint64_t *prev = recorder->state.storage[slot];
+        *p++ = (uint8_t)slot;
+        p = put_delta(p, &prev[0], storage->total);
+        p = put_delta(p, &prev[1], storage->free);
+        p = put_delta(p, &prev[2], storage->available);
+
+        recorder->len = (size_t)(p - recorder->buf);
+        return 0;
+}
+
+
+int sl_recorder_close(sl_recorder_t *recorder)
+{
+        if (!recorder) return 0;
+
+        int ret = sl_recorder_flush(recorder);
+        close(recorder->fd);
+        free(recorder);
+
+        return ret;
+}
+
+
+sl_replay_t *sl_replay_open(const char *path)
+{
+        if (!path) {
+                sl_log(SL_LOG_ERROR, __func__, "path is NULL");
+                return NULL;
+        }
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to open %s: %s", path, strerror(errno));
+                return NULL;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < RECORD_HEADER_SIZE) {
+                sl_log(SL_LOG_ERROR, __func__, "%s is not a sysload recording", path);
+                close(fd);
+                return NULL;
+        }
+
+        size_t size = (size_t)st.st_size;
+        void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to map %s: %s", path, strerror(errno));
+                return NULL;
+        }
+
+        if (memcmp(data, record_header, RECORD_HEADER_SIZE) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "%s is not a version %d sysload recording", path, RECORD_VERSION);
+                munmap(data, size);
+                return NULL;
+        }
+
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        sl_replay_t *replay = calloc(1, sizeof(*replay));
+        if (!replay) {
+                sl_log(SL_LOG_ERROR, __func__, "out of memory");
+                munmap(data, size);
+                return NULL;
+        }
+
+        replay->data = data;
+        replay->size = size;
+        replay->pos = RECORD_HEADER_SIZE;
+        replay->block_end = RECORD_HEADER_SIZE;
+        return replay;
+}
+
+
+static inline int replay_sync_at(const sl_replay_t *replay, size_t pos)
+{
+        return pos + sizeof(record_sync) <= replay->size && memcmp(replay->data + pos, record_sync, sizeof(record_sync)) == 0;
+}
+
+
+/* Enter the block at pos, or skip to the next sync if it is damaged */
+static void replay_enter_block(sl_replay_t *replay)
+{
+        size_t pos = replay->pos;
+
+        if (pos + RECORD_BLOCK_HEADER <= replay->size && replay_sync_at(replay, pos)) {
+                const uint8_t *h = replay->data + pos + 4;
+                size_t end = pos + RECORD_BLOCK_HEADER +
+                             ((size_t)h[0] | (size_t)h[1] << 8 | (size_t)h[2] << 16 | (size_t)h[3] << 24);
+
+                if (end <= replay->size && (end == replay->size || replay_sync_at(replay, end))) {
+                        replay->pos = pos + RECORD_BLOCK_HEADER;
+                        replay->block_end = end;
+                        return;
+                }
+        }
+
+        size_t next = pos + 1;
+        while (next < replay->size && !replay_sync_at(replay, next)) next++;
+
+        sl_log(SL_LOG_WARN, __func__, "skipping %zu damaged bytes at offset %zu", next - pos, pos);
+        replay->pos = replay->block_end = next;
+        replay->in_session = 0;
+}
+
+
+/* Decode one record at p; NULL if it is damaged or not within a session */
+static const uint8_t *replay_decode(sl_replay_t *replay, const uint8_t *p, const uint8_t *end, sl_record_t *record)
+{
+        record_state_t *state = &replay->state;
+        uint8_t type = *p++;
+
+        memset(record, 0, sizeof(*record));
+        record->type = (sl_record_type_t)type;
+
+        if (type == SL_RECORD_SESSION) {
+                memset(state, 0, sizeof(*state));
+                p = get_delta(p, end, &state->timestamp_ns);
+                if (p) p = get_varint(p, end, &record->realtime_ns);
+                if (!p) return NULL;
+
+                record->timestamp_ns = state->timestamp_ns;
+                replay->in_session = 1;
+                return p;
+        }
+
+        if (!replay->in_session || type > SL_RECORD_STORAGE) return NULL;
+
+        p = get_delta(p, end, &state->timestamp_ns);
+        if (!p) return NULL;
+        record->timestamp_ns = state->timestamp_ns;
+
+        uint64_t *v;
+        int count;
+        switch (record->type) {
+        case SL_RECORD_CPU:
+                v = state->cpu;
+                count = CPU_FIELDS;
+                break;
+        case SL_RECORD_MEM:
+                v = state->mem;
+                count = MEM_FIELDS;
+                break;
+        case SL_RECORD_SYSTIME:
+                v = state->systime;
+                count = SYSTIME_FIELDS;
+                break;
+        default:
+                if (p >= end || *p >= SL_RECORD_MAX_SLOTS) return NULL;
+                record->slot = *p++;
+                v = state->storage[record->slot];
+                count = STORAGE_FIELDS;
+                break;
+        }
+
+        for (int i = 0; i < count && p; i++) {
+                p = get_delta(p, end, &v[i]);
+        }
+        if (!p) return NULL;
+
+        switch (record->type) {
+        case SL_RECORD_CPU:
+                record->cpu = (sl_cpu_raw_t){v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]};
+                break;
+        case SL_RECORD_MEM:
+                record->mem.total = v[0];
+                record->mem.free = v[1];
+                record->mem.available = v[2];
+                record->mem.buffers = v[3];
+                record->mem.cached = v[4];
+                record->mem.shared = v[5];
+                record->mem.swap_total = v[6];
+                record->mem.swap_free = v[7];
+                break;
+        case SL_RECORD_SYSTIME:
+                record->systime.uptime = (double)v[0] / 100.0;
+                record->systime.idle_time = (double)v[1] / 100.0;
+                break;
+        default:
+                record->storage.total = v[0];
+                record->storage.free = v[1];
+                record->storage.available = v[2];
+                sl_storage_derive(&record->storage);
+                break;
+        }
+
+        return p;
+}
+
+
+int sl_replay_next(sl_replay_t *replay, sl_record_t *record)
+{
+        if (!replay || !record) {
+                sl_log(SL_LOG_ERROR, __func__, "replay or record pointer is NULL");
+                return -1;
+        }
+
+        for (;;) {
+                if (replay->pos >= replay->block_end) {
+                        if (replay->pos >= replay->size) return 0;
+                        replay_enter_block(replay);
+                        continue;
+                }
+
+                const uint8_t *start = replay->data + replay->pos;
+                const uint8_t *p = replay_decode(replay, start, replay->data + replay->block_end, record);
+                if (p) {
+                        replay->pos = (size_t)(p - replay->data);
+                        return 1;
+                }
+
+                /* Deltas after a bad record are meaningless until the next session */
+                if (replay->in_session) {
+                        sl_log(SL_LOG_WARN, __func__, "skipping damaged record at offset %zu", replay->pos);
+                }
+                replay->in_session = 0;
+                replay->pos = replay->block_end;
+        }
+}
+
+
+void sl_replay_close(sl_replay_t *replay)
+{
+        if (!replay) return;
+
+        munmap((void *)replay->data, replay->size);
+        free(replay);
+}
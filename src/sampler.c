@@ -0,0 +1,312 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+void sl_procfile_init(sl_procfile_t *file, const char *root, const char *name)
+{
+        file->fd = -1;
+        file->buf = NULL;
+        file->cap = 0;
+        file->len = 0;
+        snprintf(file->path, sizeof(file->path), "%s/%s", root, name);
+}
+
+
+static int procfile_grow(sl_procfile_t *file)
+{
+        size_t new_cap = file->cap ? file->cap * 2 : SL_PROCFILE_INIT_SIZE;
+        char *new_buf = realloc(file->buf, new_cap);
+
+        if (!new_buf) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to grow buffer for %s to %zu bytes", file->path, new_cap);
+                return -1;
+        }
+
+        file->buf = new_buf;
+        file->cap = new_cap;
+        return 0;
+}
+
+
+int sl_procfile_read(sl_procfile_t *file)
+{
+        if (file->fd < 0) {
+                file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+                if (file->fd < 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to open %s", file->path);
+                        return -1;
+                }
+        }
+
+        if (!file->buf && procfile_grow(file) != 0) {
+                return -1;
+        }
+
+        /*
+         * procfs/sysfs generate the whole file on a read from offset 0 and
+         * fill as much of the buffer as they can, so a short read marks the
+         * end of the file. In steady state this is a single pread().
+         */
+        size_t len = 0;
+        for (;;) {
+                size_t want = file->cap - 1 - len;
+                ssize_t n = pread(file->fd, file->buf + len, want, (off_t)len);
+
+                if (n < 0) {
+                        if (errno == EINTR) continue;
+                        sl_log(SL_LOG_ERROR, __func__, "failed to read %s: %s", file->path, strerror(errno));
+                        return -1;
+                }
+
+                len += (size_t)n;
+                if ((size_t)n < want) break;
+
+                if (procfile_grow(file) != 0) {
+                        return -1;
+                }
+        }
+
+        file->buf[len] = '\0';
+        file->len = len;
+        return 0;
+}
+
+
+void sl_procfile_close(sl_procfile_t *file)
+{
+        if (file->fd >= 0) {
+                close(file->fd);
+                file->fd = -1;
+        }
+        free(file->buf);
+        file->buf = NULL;
+        file->cap = 0;
+        file->len = 0;
+}
+
+
+void sl_sampler_init(sl_sampler_t *sampler, const char *proc_root)
+{
+        if (proc_root) {
+                snprintf(sampler->proc_root, sizeof(sampler->proc_root), "%s", proc_root);
+        } else {
+                sl_proc_root(sampler->proc_root);
+        }
+
+        sl_procfile_init(&sampler->stat, sampler->proc_root, "stat");
+        sl_procfile_init(&sampler->meminfo, sampler->proc_root, "meminfo");
+        sampler->meminfo_layout.lines = 0;
+        sl_procfile_init(&sampler->uptime, sampler->proc_root, "uptime");
+        sl_procfile_init(&sampler->diskstats, sampler->proc_root, "diskstats");
+        sl_procfile_init(&sampler->net_dev, sampler->proc_root, "net/dev");
+        sl_net_names_reset(&sampler->net_names);
+        sl_procfile_init(&sampler->loadavg, sampler->proc_root, "loadavg");
+        sampler->uring = NULL;
+        sampler->uring_unavailable = 0;
+
+        for (int i = 0; i < SL_PSI_RESOURCES; i++) {
+                char name[32];
+                snprintf(name, sizeof(name), "pressure/%s", sl_psi_names[i]);
+                sl_procfile_init(&sampler->pressure[i], sampler->proc_root, name);
+        }
+}
+
+
+void sl_sampler_fini(sl_sampler_t *sampler)
+{
+        sl_procfile_close(&sampler->stat);
+        sl_procfile_close(&sampler->meminfo);
+        sl_procfile_close(&sampler->uptime);
+        sl_procfile_close(&sampler->diskstats);
+        sl_procfile_close(&sampler->net_dev);
+        sl_procfile_close(&sampler->loadavg);
+
+        for (int i = 0; i < SL_PSI_RESOURCES; i++) {
+                sl_procfile_close(&sampler->pressure[i]);
+        }
+
+        sl_uring_destroy(sampler->uring);
+        sampler->uring = NULL;
+}
+
+
+sl_sampler_t *sl_sampler_create(void)
+{
+        return sl_sampler_create_at(NULL);
+}
+
+
+sl_sampler_t *sl_sampler_create_at(const char *proc_root)
+{
+        if (proc_root && strlen(proc_root) >= SL_ROOT_SIZE) {
+                sl_log(SL_LOG_ERROR, __func__, "proc root is too long: %.64s", proc_root);
+                return NULL;
+        }
+
+        sl_sampler_t *sampler = malloc(sizeof(*sampler));
+        if (!sampler) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate sampler");
+                return NULL;
+        }
+
+        sl_sampler_init(sampler, proc_root);
+        return sampler;
+}
+
+
+void sl_sampler_destroy(sl_sampler_t *sampler)
+{
+        if (!sampler) return;
+
+        sl_sampler_fini(sampler);
+        free(sampler);
+}
+
+
+int sl_sampler_cpu_get_raw(sl_sampler_t *sampler, sl_cpu_raw_t *snapshot)
+{
+        if (!sampler || !snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or snapshot pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->stat) != 0) {
+                return -1;
+        }
+
+        return sl_parse_cpu_raw(sampler->stat.buf, sampler->stat.len, snapshot);
+}
+
+
+int sl_sampler_cpu_get_raw_cores(sl_sampler_t *sampler, sl_cpu_cores_t *snapshot)
+{
+        if (!sampler || !snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or snapshot pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->stat) != 0) {
+                return -1;
+        }
+
+        return sl_parse_cpu_cores(sampler->stat.buf, sampler->stat.len, snapshot);
+}
+
+
+int sl_sampler_mem_get_info(sl_sampler_t *sampler, sl_mem_info_t *result)
+{
+        if (!sampler || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or result pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->meminfo) != 0) {
+                return -1;
+        }
+
+        if (sl_parse_meminfo(sampler->meminfo.buf, sampler->meminfo.len, result) != 0) {
+                return -1;
+        }
+
+        if (sl_mem_calculate(result) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to calculate memory usage");
+                return -1;
+        }
+
+        return 0;
+}
+
+
+int sl_sampler_mem_get_ext(sl_sampler_t *sampler, sl_mem_ext_t *result)
+{
+        if (!sampler || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or result pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->meminfo) != 0) {
+                return -1;
+        }
+
+        return sl_parse_meminfo_ext(sampler->meminfo.buf, sampler->meminfo.len, &sampler->meminfo_layout, result);
+}
+
+
+int sl_sampler_systime_get_info(sl_sampler_t *sampler, sl_systime_info_t *result)
+{
+        if (!sampler || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or result pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->uptime) != 0) {
+                return -1;
+        }
+
+        return sl_parse_uptime(sampler->uptime.buf, sampler->uptime.len, result);
+}
+
+
+int sl_sampler_disk_get_raw(sl_sampler_t *sampler, sl_disk_raw_t *snapshot, unsigned flags)
+{
+        if (!sampler || !snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or snapshot pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->diskstats) != 0) {
+                return -1;
+        }
+
+        return sl_parse_diskstats(sampler->diskstats.buf, sampler->diskstats.len, flags, snapshot);
+}
+
+
+int sl_sampler_net_get_raw(sl_sampler_t *sampler, sl_net_raw_t *snapshot)
+{
+        if (!sampler || !snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or snapshot pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->net_dev) != 0) {
+                return -1;
+        }
+
+        return sl_parse_net_dev(sampler->net_dev.buf, sampler->net_dev.len, &sampler->net_names, snapshot);
+}
+
+
+int sl_sampler_psi_get_raw(sl_sampler_t *sampler, sl_psi_resource_t resource, sl_psi_raw_t *raw)
+{
+        if (!sampler || !raw || (unsigned)resource >= SL_PSI_RESOURCES) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or raw pointer is NULL, or invalid resource");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->pressure[resource]) != 0) {
+                return -1;
+        }
+
+        return sl_parse_pressure(sampler->pressure[resource].buf, sampler->pressure[resource].len, raw);
+}
+
+
+int sl_sampler_loadavg_get_info(sl_sampler_t *sampler, sl_loadavg_t *result)
+{
+        if (!sampler || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or result pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&sampler->loadavg) != 0) {
+                return -1;
+        }
+
+        return sl_parse_loadavg(sampler->loadavg.buf, sampler->loadavg.len, result);
+}
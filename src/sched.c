@@ -0,0 +1,366 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+/*
+ * One timerfd inside a private epoll instance, armed at the earliest
+ * deadline. Deadlines sit on multiples of each collector's interval from
+ * the scheduler's epoch, so a 100 ms and a 1 s collector meet exactly
+ * every second; the slack absorbs intervals that are not exact multiples
+ * after rounding.
+ */
+#define SCHED_SLACK_NS 1000000ULL
+#define SCHED_MIN_INTERVAL_NS 1000000ULL
+
+/* statvfs() runs on workers so a hung network mount cannot stall dispatch */
+#define SCHED_STORAGE_THREADS 2
+#define SCHED_STORAGE_TIMEOUT_MS 500
+
+typedef struct
+{
+        int active;
+        sl_sched_kind_t kind;
+        uint64_t interval_ns;
+        uint64_t next_ns;               /**< Next deadline, CLOCK_MONOTONIC */
+        sl_sched_callback_t callback;
+        void *user_data;
+        sl_cpu_delta_t cpu_delta;       /**< SL_SCHED_CPU: counters of the previous run */
+        sl_sched_result_t result;       /**< Last result, kept when a read fails */
+        char path[SL_PATH_SIZE];
+} sched_entry_t;
+
+struct sl_sched
+{
+        int epoll_fd;
+        int timer_fd;
+        uint64_t epoch_ns;
+        uint64_t armed_ns;              /**< Deadline the timer is set to, 0 if disarmed */
+        sl_sampler_t sampler;
+        sl_statvfs_pool_t *storage_pool;        /**< Created with the first storage collector */
+        int storage_timeout_ms;
+        sched_entry_t entries[SL_SCHED_MAX_COLLECTORS];
+};
+
+
+static unsigned sched_group(sl_sched_kind_t kind)
+{
+        switch (kind) {
+        case SL_SCHED_CPU: return SL_SNAPSHOT_CPU;
+        case SL_SCHED_MEM: return SL_SNAPSHOT_MEM;
+        case SL_SCHED_SYSTIME: return SL_SNAPSHOT_SYSTIME;
+        default: return 0;
+        }
+}
+
+
+/* Arm the timer at the earliest deadline, or disarm it without collectors */
+static int sched_arm(sl_sched_t *sched)
+{
+        uint64_t next = 0;
+        for (int i = 0; i < SL_SCHED_MAX_COLLECTORS; i++) {
+                const sched_entry_t *entry = &sched->entries[i];
+                if (entry->active && (next == 0 || entry->next_ns < next)) next = entry->next_ns;
+        }
+
+        if (next == sched->armed_ns) return 0;
+
+        /* An all-zero it_value disarms; deadlines are never 0 on CLOCK_MONOTONIC */
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = (time_t)(next / 1000000000ULL);
+        spec.it_value.tv_nsec = (long)(next % 1000000000ULL);
+
+        if (timerfd_settime(sched->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "timerfd_settime failed: %s", strerror(errno));
+                return -1;
+        }
+
+        sched->armed_ns = next;
+        return 0;
+}
+
+
+/* Move a deadline that has been reached to the first one after now */
+static void sched_advance(sched_entry_t *entry, uint64_t now)
+{
+        entry->next_ns += entry->interval_ns;
+        if (entry->next_ns <= now) {
+                entry->next_ns += ((now - entry->next_ns) / entry->interval_ns + 1) * entry->interval_ns;
+        }
+}
+
+
+sl_sched_t *sl_sched_create(void)
+{
+        sl_sched_t *sched = calloc(1, sizeof(*sched));
+        if (!sched) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate scheduler");
+                return NULL;
+        }
+
+        sched->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (sched->timer_fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "timerfd_create failed: %s", strerror(errno));
+                free(sched);
+                return NULL;
+        }
+
+        sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (sched->epoll_fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "epoll_create1 failed: %s", strerror(errno));
+                close(sched->timer_fd);
+                free(sched);
+                return NULL;
+        }
+
+        struct epoll_event ev = {.events = EPOLLIN, .data.fd = sched->timer_fd};
+        if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, sched->timer_fd, &ev) < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "epoll_ctl failed: %s", strerror(errno));
+                close(sched->epoll_fd);
+                close(sched->timer_fd);
+                free(sched);
+                return NULL;
+        }
+
+        sl_sampler_init(&sched->sampler, NULL);
+        sched->storage_timeout_ms = SCHED_STORAGE_TIMEOUT_MS;
+        sched->epoch_ns = sl_now_ns();
+        return sched;
+}
+
+
+void sl_sched_destroy(sl_sched_t *sched)
+{
+        if (!sched) return;
+
+        sl_sampler_fini(&sched->sampler);
+        sl_statvfs_pool_release(sched->storage_pool);
+        close(sched->epoll_fd);
+        close(sched->timer_fd);
+        free(sched);
+}
+
+
+int sl_sched_add(sl_sched_t *sched, sl_sched_kind_t kind, const char *path, float interval_sec,
+                 sl_sched_callback_t callback, void *user_data)
+{
+        if (!sched || !callback || (unsigned)kind > SL_SCHED_CUSTOM) {
+                sl_log(SL_LOG_ERROR, __func__, "sched or callback pointer is NULL, or invalid kind");
+                return -1;
+        }
+
+        if (kind == SL_SCHED_STORAGE && (!path || strlen(path) >= SL_PATH_SIZE)) {
+                sl_log(SL_LOG_ERROR, __func__, "storage path is NULL or too long");
+                return -1;
+        }
+
+        /* Range first: converting a negative or NaN interval to unsigned is undefined */
+        uint64_t interval_ns = 0;
+        if (interval_sec > 0.0f && interval_sec <= 1e6f) {
+                interval_ns = (uint64_t)((double)interval_sec * 1e6 + 0.5) * 1000ULL;
+        }
+        if (interval_ns < SCHED_MIN_INTERVAL_NS) {
+                sl_log(SL_LOG_ERROR, __func__, "interval must be between 0.001 and 1e6 seconds");
+                return -1;
+        }
+
+        if (kind == SL_SCHED_STORAGE && !sched->storage_pool) {
+                sched->storage_pool = sl_statvfs_pool_create(SCHED_STORAGE_THREADS);
+                if (!sched->storage_pool) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to create statvfs workers");
+                        return -1;
+                }
+        }
+
+        int id = 0;
+        while (id < SL_SCHED_MAX_COLLECTORS && sched->entries[id].active) id++;
+        if (id == SL_SCHED_MAX_COLLECTORS) {
+                sl_log(SL_LOG_ERROR, __func__, "too many collectors (at most %d)", SL_SCHED_MAX_COLLECTORS);
+                return -1;
+        }
+
+        sched_entry_t *entry = &sched->entries[id];
+        memset(entry, 0, sizeof(*entry));
+        entry->kind = kind;
+        entry->interval_ns = interval_ns;
+        entry->callback = callback;
+        entry->user_data = user_data;
+        entry->result.id = id;
+        entry->result.kind = kind;
+        if (kind == SL_SCHED_STORAGE) {
+                strcpy(entry->path, path);
+                entry->result.path = entry->path;
+        }
+
+        uint64_t now = sl_now_ns();
+        entry->next_ns = sched->epoch_ns;
+        sched_advance(entry, now);
+
+        if (kind == SL_SCHED_CPU) {
+                /* Baseline for the first interval */
+                sl_cpu_delta_init(&entry->cpu_delta);
+                sl_cpu_delta_update(&entry->cpu_delta, &sched->sampler, &entry->result.cpu, NULL);
+        }
+
+        entry->active = 1;
+        if (sched_arm(sched) < 0) {
+                entry->active = 0;
+                return -1;
+        }
+        return id;
+}
+
+
+int sl_sched_remove(sl_sched_t *sched, int id)
+{
+        if (!sched || id < 0 || id >= SL_SCHED_MAX_COLLECTORS || !sched->entries[id].active) {
+                sl_log(SL_LOG_ERROR, __func__, "sched pointer is NULL or collector %d is not registered", id);
+                return -1;
+        }
+
+        sched->entries[id].active = 0;
+        sched_arm(sched);
+        return 0;
+}
+
+
+int sl_sched_set_storage_timeout(sl_sched_t *sched, int timeout_ms)
+{
+        if (!sched) {
+                sl_log(SL_LOG_ERROR, __func__, "sched pointer is NULL");
+                return -1;
+        }
+
+        sched->storage_timeout_ms = timeout_ms;
+        return 0;
+}
+
+
+int sl_sched_fd(const sl_sched_t *sched)
+{
+        return sched ? sched->epoll_fd : -1;
+}
+
+
+int sl_sched_dispatch(sl_sched_t *sched)
+{
+        if (!sched) {
+                sl_log(SL_LOG_ERROR, __func__, "sched pointer is NULL");
+                return -1;
+        }
+
+        /* Drain the expiration count so the descriptor stops polling readable */
+        uint64_t expirations;
+        if (read(sched->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to read timerfd: %s", strerror(errno));
+                return -1;
+        }
+        sched->armed_ns = 0;
+
+        uint64_t now = sl_now_ns();
+        uint64_t due = 0;
+        unsigned mask = 0;
+        int jobs[SL_SCHED_MAX_COLLECTORS];
+        int job_count = 0;
+        int pooled = 1;                 /* A failed add drops the queue, failing the batch's storage */
+
+        for (int i = 0; i < SL_SCHED_MAX_COLLECTORS; i++) {
+                const sched_entry_t *entry = &sched->entries[i];
+                if (entry->active && entry->next_ns <= now + SCHED_SLACK_NS) {
+                        due |= 1ULL << i;
+                        mask |= sched_group(entry->kind);
+                        if (entry->kind == SL_SCHED_STORAGE) {
+                                jobs[i] = pooled ? sl_statvfs_pool_add(sched->storage_pool, entry->path) : -1;
+                                if (jobs[i] < 0) pooled = 0;
+                                else job_count++;
+                        }
+                }
+        }
+
+        /* One pass over the /proc files any due collector needs */
+        sl_snapshot_t snap;
+        snap.collected = 0;
+        if (mask) sl_sampler_snapshot_collect(&sched->sampler, mask, NULL, 0, &snap);
+
+        /* Storage of the whole batch, bounded by the timeout; unfinished paths fail with ETIMEDOUT */
+        if (pooled && job_count > 0) sl_statvfs_pool_run(sched->storage_pool, sched->storage_timeout_ms);
+
+        int ran = 0;
+        for (int i = 0; i < SL_SCHED_MAX_COLLECTORS; i++) {
+                sched_entry_t *entry = &sched->entries[i];
+
+                /* A callback earlier in the batch may have removed or replaced this one */
+                if (!(due & (1ULL << i)) || !entry->active || entry->next_ns > now + SCHED_SLACK_NS) continue;
+
+                sl_sched_result_t *result = &entry->result;
+                result->status = 0;
+                result->timestamp_ns = now;
+
+                switch (entry->kind) {
+                case SL_SCHED_CPU:
+                        if (snap.collected & SL_SNAPSHOT_CPU) {
+                                /* 1 keeps the previous usage: less than one tick elapsed */
+                                result->status = sl_cpu_delta_feed(&entry->cpu_delta, &snap.cpu, snap.cpu_time.monotonic_ns,
+                                                                   &result->cpu, NULL);
+                        } else {
+                                result->status = -1;
+                        }
+                        break;
+                case SL_SCHED_MEM:
+                        if (snap.collected & SL_SNAPSHOT_MEM) result->mem = snap.mem;
+                        else result->status = -1;
+                        break;
+                case SL_SCHED_SYSTIME:
+                        if (snap.collected & SL_SNAPSHOT_SYSTIME) result->systime = snap.systime;
+                        else result->status = -1;
+                        break;
+                case SL_SCHED_STORAGE: {
+                        sl_storage_info_t info;
+                        int err = pooled ? sl_statvfs_pool_result(sched->storage_pool, jobs[i], &info) : ENOMEM;
+                        if (err == 0) {
+                                result->storage = info;
+                        } else {
+                                sl_log(SL_LOG_ERROR, __func__, "failed to get filesystem info for %s: %s",
+                                       entry->path, strerror(err));
+                                result->status = -1;
+                        }
+                        break;
+                }
+                case SL_SCHED_CUSTOM:
+                        break;
+                }
+
+                sched_advance(entry, now);
+                ran++;
+                entry->callback(result, entry->user_data);
+        }
+
+        if (sched_arm(sched) < 0) return -1;
+        return ran;
+}
+
+
+int sl_sched_run(sl_sched_t *sched, int timeout_ms)
+{
+        if (!sched) {
+                sl_log(SL_LOG_ERROR, __func__, "sched pointer is NULL");
+                return -1;
+        }
+
+        struct epoll_event ev;
+        int ret;
+        do {
+                ret = epoll_wait(sched->epoll_fd, &ev, 1, timeout_ms);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "epoll_wait failed: %s", strerror(errno));
+                return -1;
+        }
+
+        return ret == 0 ? 0 : sl_sched_dispatch(sched);
+}
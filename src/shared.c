@@ -0,0 +1,399 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+/*
+ * Shared segment: a header, a heartbeat and a seqlock-protected copy of
+ * the latest sl_monitor_snapshot_t, stored as atomic words like the
+ * in-process monitor so a reader racing with the writer stays
+ * well-defined. The publisher stores magic last, after the rest of the
+ * header, and clears the heartbeat when it exits.
+ */
+#define SHARED_MAGIC 0x534c5348u        /* "SLSH" */
+#define SHARED_VERSION 1
+#define SHARED_WORDS ((sizeof(sl_monitor_snapshot_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+#define SHARED_READ_RETRIES 64          /* A writer that died mid-update leaves the sequence odd */
+
+typedef struct
+{
+        _Atomic uint32_t magic;
+        uint32_t version;
+        uint32_t payload_size;          /**< sizeof(sl_monitor_snapshot_t) of the writer */
+        uint32_t reserved;
+        _Atomic uint64_t heartbeat_ns;  /**< CLOCK_MONOTONIC time of the last update, 0 once stopped */
+        atomic_uint_fast64_t seq;
+        _Atomic uint64_t words[SHARED_WORDS];
+} shared_segment_t;
+
+/* Sampling state of the publisher and of the subscriber fallback */
+typedef struct
+{
+        sl_sampler_t sampler;
+        sl_cpu_delta_t cpu_delta;
+        char mounts[SL_MONITOR_MAX_MOUNTS][SL_PATH_SIZE];
+        const char *paths[SL_MONITOR_MAX_MOUNTS];
+        int mount_count;
+        sl_monitor_snapshot_t snapshot;
+} shared_source_t;
+
+struct sl_publisher
+{
+        char name[SL_SHARED_NAME_SIZE];
+        int fd;                         /**< Kept open for the flock() */
+        shared_segment_t *segment;
+        shared_source_t source;
+};
+
+struct sl_subscriber
+{
+        char name[SL_SHARED_NAME_SIZE];
+        const shared_segment_t *segment;
+        uint64_t max_age_ns;
+        uint64_t next_attach_ns;        /**< Earliest time of the next shm_open() attempt */
+        shared_source_t *source;        /**< Fallback, allocated on first use */
+        char mount_copy[SL_MONITOR_MAX_MOUNTS][SL_PATH_SIZE];
+        const char *mount_paths[SL_MONITOR_MAX_MOUNTS];
+        int mount_count;
+};
+
+
+static int shared_name(char name[SL_SHARED_NAME_SIZE], const char *requested)
+{
+        if (!requested) requested = SL_SHARED_DEFAULT_NAME;
+
+        size_t len = strlen(requested);
+        if (requested[0] != '/' || len < 2 || len >= SL_SHARED_NAME_SIZE || strchr(requested + 1, '/')) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid shared memory name \"%s\" (\"/name\", below %d bytes)",
+                       requested, SL_SHARED_NAME_SIZE);
+                return -1;
+        }
+
+        memcpy(name, requested, len + 1);
+        return 0;
+}
+
+
+static int shared_mounts(char copy[][SL_PATH_SIZE], const char **paths, const char *const *mounts, int mount_count)
+{
+        if (mount_count < 0 || mount_count > SL_MONITOR_MAX_MOUNTS || (mount_count > 0 && !mounts)) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid mount list (at most %d mounts)", SL_MONITOR_MAX_MOUNTS);
+                return -1;
+        }
+
+        for (int i = 0; i < mount_count; i++) {
+                if (!mounts[i] || strlen(mounts[i]) >= SL_PATH_SIZE) {
+                        sl_log(SL_LOG_ERROR, __func__, "mount path %d is NULL or too long", i);
+                        return -1;
+                }
+                strcpy(copy[i], mounts[i]);
+                paths[i] = copy[i];
+        }
+        return 0;
+}
+
+
+static void source_init(shared_source_t *source)
+{
+        sl_sampler_init(&source->sampler, NULL);
+        sl_cpu_delta_init(&source->cpu_delta);
+        memset(&source->snapshot, 0, sizeof(source->snapshot));
+        source->snapshot.storage_count = source->mount_count;
+
+        /* Baseline for the first CPU interval */
+        sl_cpu_delta_update(&source->cpu_delta, &source->sampler, &source->snapshot.cpu, NULL);
+}
+
+
+/* One pass over every group; groups that fail keep their previous values */
+static int source_collect(shared_source_t *source)
+{
+        sl_snapshot_t snap;
+        unsigned mask = SL_SNAPSHOT_CPU | SL_SNAPSHOT_MEM | SL_SNAPSHOT_SYSTIME;
+        if (source->mount_count > 0) mask |= SL_SNAPSHOT_STORAGE;
+
+        int ret = sl_sampler_snapshot_collect(&source->sampler, mask, source->paths, source->mount_count, &snap);
+
+        sl_monitor_snapshot_t *out = &source->snapshot;
+        unsigned collected = snap.collected;
+        if (snap.collected & SL_SNAPSHOT_CPU) {
+                /* Keeps the previous usage, and is not counted, if less than one tick elapsed */
+                if (sl_cpu_delta_feed(&source->cpu_delta, &snap.cpu, snap.cpu_time.monotonic_ns, &out->cpu, NULL) != 0) {
+                        collected &= ~SL_SNAPSHOT_CPU;
+                }
+        }
+        if (snap.collected & SL_SNAPSHOT_MEM) out->mem = snap.mem;
+        if (snap.collected & SL_SNAPSHOT_SYSTIME) out->systime = snap.systime;
+        if (source->mount_count > 0) {
+                memcpy(out->storage, snap.storage, sizeof(snap.storage[0]) * (size_t)source->mount_count);
+        }
+
+        out->collected = collected;
+        out->timestamp_ns = sl_now_ns();
+        out->sequence++;
+        return ret;
+}
+
+
+static void segment_publish(shared_segment_t *segment, const sl_monitor_snapshot_t *snapshot)
+{
+        uint64_t words[SHARED_WORDS] = {0};
+        memcpy(words, snapshot, sizeof(*snapshot));
+
+        uint64_t seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+        atomic_store_explicit(&segment->seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        for (size_t i = 0; i < SHARED_WORDS; i++) {
+                atomic_store_explicit(&segment->words[i], words[i], memory_order_relaxed);
+        }
+
+        atomic_store_explicit(&segment->seq, seq + 2, memory_order_release);
+        atomic_store_explicit(&segment->heartbeat_ns, snapshot->timestamp_ns, memory_order_release);
+}
+
+
+/* Returns 0 with a consistent copy, -1 if nothing was published or the writer is stuck */
+static int segment_read(const shared_segment_t *segment, sl_monitor_snapshot_t *snapshot)
+{
+        uint64_t words[SHARED_WORDS];
+        uint64_t seq1, seq2;
+        int retries = 0;
+
+        do {
+                if (retries++ == SHARED_READ_RETRIES) return -1;
+
+                seq1 = atomic_load_explicit(&segment->seq, memory_order_acquire);
+                if (seq1 & 1) continue;
+
+                for (size_t i = 0; i < SHARED_WORDS; i++) {
+                        words[i] = atomic_load_explicit(&segment->words[i], memory_order_relaxed);
+                }
+
+                atomic_thread_fence(memory_order_acquire);
+                seq2 = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+
+        if (seq1 == 0) return -1;
+
+        memcpy(snapshot, words, sizeof(*snapshot));
+        return 0;
+}
+
+
+sl_publisher_t *sl_publisher_create(const char *name, const char *const *mounts, int mount_count)
+{
+        sl_publisher_t *publisher = calloc(1, sizeof(*publisher));
+        if (!publisher) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate publisher");
+                return NULL;
+        }
+        publisher->fd = -1;
+
+        if (shared_name(publisher->name, name) != 0 ||
+            shared_mounts(publisher->source.mounts, publisher->source.paths, mounts, mount_count) != 0) {
+                free(publisher);
+                return NULL;
+        }
+        publisher->source.mount_count = mount_count;
+
+        /* Not unlinked first: readers that mapped a previous run's segment keep working */
+        publisher->fd = shm_open(publisher->name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (publisher->fd < 0) {
+                sl_log(SL_LOG_ERROR, __func__, "shm_open(%s) failed: %s", publisher->name, strerror(errno));
+                free(publisher);
+                return NULL;
+        }
+
+        if (flock(publisher->fd, LOCK_EX | LOCK_NB) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "%s already has a publisher", publisher->name);
+                close(publisher->fd);
+                free(publisher);
+                return NULL;
+        }
+
+        struct stat st;
+        if (fstat(publisher->fd, &st) != 0 ||
+            ((size_t)st.st_size < sizeof(shared_segment_t) && ftruncate(publisher->fd, sizeof(shared_segment_t)) != 0)) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to size %s: %s", publisher->name, strerror(errno));
+                close(publisher->fd);
+                free(publisher);
+                return NULL;
+        }
+
+        void *map = mmap(NULL, sizeof(shared_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, publisher->fd, 0);
+        if (map == MAP_FAILED) {
+                sl_log(SL_LOG_ERROR, __func__, "mmap(%s) failed: %s", publisher->name, strerror(errno));
+                close(publisher->fd);
+                free(publisher);
+                return NULL;
+        }
+        publisher->segment = map;
+
+        shared_segment_t *segment = publisher->segment;
+        atomic_store_explicit(&segment->heartbeat_ns, 0, memory_order_relaxed);
+
+        /* A previous publisher may have died mid-update */
+        uint64_t seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+        if (seq & 1) atomic_store_explicit(&segment->seq, seq + 1, memory_order_relaxed);
+
+        segment->version = SHARED_VERSION;
+        segment->payload_size = sizeof(sl_monitor_snapshot_t);
+        atomic_store_explicit(&segment->magic, SHARED_MAGIC, memory_order_release);
+
+        source_init(&publisher->source);
+        return publisher;
+}
+
+
+int sl_publisher_update(sl_publisher_t *publisher)
+{
+        if (!publisher) {
+                sl_log(SL_LOG_ERROR, __func__, "publisher pointer is NULL");
+                return -1;
+        }
+
+        int ret = source_collect(&publisher->source);
+        segment_publish(publisher->segment, &publisher->source.snapshot);
+        return ret;
+}
+
+
+void sl_publisher_destroy(sl_publisher_t *publisher)
+{
+        if (!publisher) return;
+
+        atomic_store_explicit(&publisher->segment->heartbeat_ns, 0, memory_order_release);
+        munmap(publisher->segment, sizeof(shared_segment_t));
+        shm_unlink(publisher->name);
+        close(publisher->fd);
+        sl_sampler_fini(&publisher->source.sampler);
+        free(publisher);
+}
+
+
+static void subscriber_detach(sl_subscriber_t *subscriber)
+{
+        if (!subscriber->segment) return;
+        munmap((void *)subscriber->segment, sizeof(shared_segment_t));
+        subscriber->segment = NULL;
+}
+
+
+/* Map the segment read-only; quietly fails if no publisher created it yet */
+static void subscriber_attach(sl_subscriber_t *subscriber, uint64_t now)
+{
+        subscriber->next_attach_ns = now + subscriber->max_age_ns;
+
+        int fd = shm_open(subscriber->name, O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shared_segment_t)) {
+                void *map = mmap(NULL, sizeof(shared_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+                if (map != MAP_FAILED) subscriber->segment = map;
+        }
+        close(fd);
+}
+
+
+static int subscriber_fresh(const shared_segment_t *segment, uint64_t now, uint64_t max_age_ns)
+{
+        if (atomic_load_explicit(&segment->magic, memory_order_acquire) != SHARED_MAGIC ||
+            segment->version != SHARED_VERSION || segment->payload_size != sizeof(sl_monitor_snapshot_t)) {
+                return 0;
+        }
+
+        uint64_t heartbeat = atomic_load_explicit(&segment->heartbeat_ns, memory_order_acquire);
+        return heartbeat != 0 && now - heartbeat <= max_age_ns;
+}
+
+
+sl_subscriber_t *sl_subscriber_create(const char *name, float max_age_sec, const char *const *mounts, int mount_count)
+{
+        if (max_age_sec < 0.01f) {
+                sl_log(SL_LOG_ERROR, __func__, "max age too small, minimum is 0.01 seconds");
+                return NULL;
+        }
+
+        sl_subscriber_t *subscriber = calloc(1, sizeof(*subscriber));
+        if (!subscriber) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate subscriber");
+                return NULL;
+        }
+
+        if (shared_name(subscriber->name, name) != 0 ||
+            shared_mounts(subscriber->mount_copy, subscriber->mount_paths, mounts, mount_count) != 0) {
+                free(subscriber);
+                return NULL;
+        }
+        subscriber->mount_count = mount_count;
+        subscriber->max_age_ns = (uint64_t)(max_age_sec * 1e9);
+
+        subscriber_attach(subscriber, sl_now_ns());
+        return subscriber;
+}
+
+
+int sl_subscriber_read(sl_subscriber_t *subscriber, sl_monitor_snapshot_t *snapshot)
+{
+        if (!subscriber || !snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "subscriber or snapshot pointer is NULL");
+                return -1;
+        }
+
+        uint64_t now = sl_now_ns();
+        if (subscriber->segment && subscriber_fresh(subscriber->segment, now, subscriber->max_age_ns) &&
+            segment_read(subscriber->segment, snapshot) == 0) {
+                return 0;
+        }
+
+        /* Dead or restarted publisher: the name may now point at a new segment */
+        if (now >= subscriber->next_attach_ns) {
+                subscriber_detach(subscriber);
+                subscriber_attach(subscriber, now);
+                if (subscriber->segment && subscriber_fresh(subscriber->segment, now, subscriber->max_age_ns) &&
+                    segment_read(subscriber->segment, snapshot) == 0) {
+                        return 0;
+                }
+        }
+
+        if (!subscriber->source) {
+                shared_source_t *source = calloc(1, sizeof(*source));
+                if (!source) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to allocate fallback sampler");
+                        return -1;
+                }
+                memcpy(source->mounts, subscriber->mount_copy, sizeof(source->mounts));
+                for (int i = 0; i < subscriber->mount_count; i++) source->paths[i] = source->mounts[i];
+                source->mount_count = subscriber->mount_count;
+                source_init(source);
+                subscriber->source = source;
+        }
+
+        if (source_collect(subscriber->source) != 0 && subscriber->source->snapshot.mem.total == 0) {
+                return -1;
+        }
+
+        *snapshot = subscriber->source->snapshot;
+        return 1;
+}
+
+
+void sl_subscriber_destroy(sl_subscriber_t *subscriber)
+{
+        if (!subscriber) return;
+
+        subscriber_detach(subscriber);
+        if (subscriber->source) {
+                sl_sampler_fini(&subscriber->source->sampler);
+                free(subscriber->source);
+        }
+        free(subscriber);
+}
@@ -0,0 +1,185 @@
+#include "sysload_internal.h"
+#include <string.h>
+#include <time.h>
+
+#define SNAPSHOT_FILES 3
+#define SNAPSHOT_URING_ENTRIES 4
+
+
+static void snapshot_stamp(sl_timestamp_t *stamp)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        stamp->monotonic_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        stamp->boottime_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+static int snapshot_parse(sl_snapshot_t *snapshot, unsigned group, const sl_procfile_t *file)
+{
+        switch (group) {
+        case SL_SNAPSHOT_CPU:
+                return sl_parse_cpu_raw(file->buf, file->len, &snapshot->cpu);
+        case SL_SNAPSHOT_MEM:
+                if (sl_parse_meminfo(file->buf, file->len, &snapshot->mem) != 0) return -1;
+                if (sl_mem_calculate(&snapshot->mem) != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to calculate memory usage");
+                        return -1;
+                }
+                return 0;
+        case SL_SNAPSHOT_SYSTIME:
+                return sl_parse_uptime(file->buf, file->len, &snapshot->systime);
+        default:
+                return -1;
+        }
+}
+
+
+static sl_timestamp_t *snapshot_time(sl_snapshot_t *snapshot, unsigned group)
+{
+        switch (group) {
+        case SL_SNAPSHOT_CPU: return &snapshot->cpu_time;
+        case SL_SNAPSHOT_MEM: return &snapshot->mem_time;
+        default: return &snapshot->systime_time;
+        }
+}
+
+
+/*
+ * Read all files with one io_uring submission. Only once every file is
+ * open with a buffer, so the first snapshot (and the one-shot API) never
+ * pays for ring setup. results[i] is the byte count, or negative where
+ * the file still needs a pread. Returns -1 if nothing was submitted.
+ */
+static int snapshot_batch(sl_sampler_t *sampler, sl_procfile_t *const *files, int count, long *results)
+{
+        if (count < 2 || sampler->uring_unavailable) return -1;
+
+        for (int i = 0; i < count; i++) {
+                if (files[i]->fd < 0 || !files[i]->buf) return -1;
+        }
+
+        if (!sampler->uring) {
+                sampler->uring = sl_uring_create(SNAPSHOT_URING_ENTRIES);
+                if (!sampler->uring) {
+                        sampler->uring_unavailable = 1;
+                        sl_log(SL_LOG_INFO, __func__, "io_uring unavailable, reading with pread");
+                        return -1;
+                }
+        }
+
+        int ret = sl_uring_read(sampler->uring, files, count, results);
+        if (ret == -2) {
+                /* Reads may still land in the buffers: abandon them, pread allocates new ones */
+                for (int i = 0; i < count; i++) {
+                        files[i]->buf = NULL;
+                        files[i]->cap = 0;
+                        files[i]->len = 0;
+                }
+                sl_log(SL_LOG_ERROR, __func__, "io_uring reads could not be reaped, their buffers are abandoned");
+        }
+        if (ret != 0) {
+                sl_uring_destroy(sampler->uring);
+                sampler->uring = NULL;
+                sampler->uring_unavailable = 1;
+                sl_log(SL_LOG_INFO, __func__, "io_uring submission failed, reading with pread");
+                return -1;
+        }
+
+        /* A full buffer may be a truncated file; let pread grow it */
+        for (int i = 0; i < count; i++) {
+                if (results[i] >= 0 && (size_t)results[i] >= files[i]->cap - 1) results[i] = -1;
+        }
+        return 0;
+}
+
+
+static void snapshot_storage(const char *const *paths, int path_count, sl_snapshot_t *snapshot)
+{
+        int failed = 0;
+
+        for (int i = 0; i < path_count; i++) {
+                int err = sl_storage_stat(paths[i], &snapshot->storage[i]);
+                if (err != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to get filesystem info for %s: %s", paths[i], strerror(err));
+                        memset(&snapshot->storage[i], 0, sizeof(snapshot->storage[i]));
+                        failed = 1;
+                }
+        }
+
+        snapshot->storage_count = path_count;
+        snapshot_stamp(&snapshot->storage_time);
+        if (!failed) snapshot->collected |= SL_SNAPSHOT_STORAGE;
+}
+
+
+int sl_sampler_snapshot_collect(sl_sampler_t *sampler, unsigned mask, const char *const *paths, int path_count,
+                                sl_snapshot_t *snapshot)
+{
+        if (!sampler || !snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "sampler or snapshot pointer is NULL");
+                return -1;
+        }
+
+        unsigned groups_mask = mask & SL_SNAPSHOT_ALL;
+        if (groups_mask == 0 || (mask & ~(unsigned)(SL_SNAPSHOT_ALL | SL_SNAPSHOT_IO_URING))) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid group mask 0x%x", mask);
+                return -1;
+        }
+
+        if ((mask & SL_SNAPSHOT_STORAGE) &&
+            (path_count < 0 || path_count > SL_SNAPSHOT_MAX_PATHS || (path_count > 0 && !paths))) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid path list (at most %d paths)", SL_SNAPSHOT_MAX_PATHS);
+                return -1;
+        }
+
+        memset(snapshot, 0, sizeof(*snapshot));
+
+        sl_procfile_t *files[SNAPSHOT_FILES];
+        unsigned groups[SNAPSHOT_FILES];
+        long results[SNAPSHOT_FILES];
+        int count = 0;
+
+        if (mask & SL_SNAPSHOT_CPU) { files[count] = &sampler->stat; groups[count++] = SL_SNAPSHOT_CPU; }
+        if (mask & SL_SNAPSHOT_MEM) { files[count] = &sampler->meminfo; groups[count++] = SL_SNAPSHOT_MEM; }
+        if (mask & SL_SNAPSHOT_SYSTIME) { files[count] = &sampler->uptime; groups[count++] = SL_SNAPSHOT_SYSTIME; }
+
+        int batched = (mask & SL_SNAPSHOT_IO_URING) && snapshot_batch(sampler, files, count, results) == 0;
+        sl_timestamp_t batch_time;
+        if (batched) snapshot_stamp(&batch_time);
+
+        for (int i = 0; i < count; i++) {
+                sl_timestamp_t *stamp = snapshot_time(snapshot, groups[i]);
+
+                if (batched && results[i] >= 0) {
+                        files[i]->len = (size_t)results[i];
+                        files[i]->buf[files[i]->len] = '\0';
+                        *stamp = batch_time;
+                } else {
+                        if (sl_procfile_read(files[i]) != 0) continue;
+                        snapshot_stamp(stamp);
+                }
+
+                if (snapshot_parse(snapshot, groups[i], files[i]) == 0) snapshot->collected |= groups[i];
+        }
+
+        if (mask & SL_SNAPSHOT_STORAGE) {
+                snapshot_storage(paths, path_count, snapshot);
+        }
+
+        return (snapshot->collected == groups_mask) ? 0 : -1;
+}
+
+
+int sl_snapshot_collect(unsigned mask, const char *const *paths, int path_count, sl_snapshot_t *snapshot)
+{
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+
+        int ret = sl_sampler_snapshot_collect(&sampler, mask, paths, path_count, snapshot);
+
+        sl_sampler_fini(&sampler);
+        return ret;
+}
@@ -0,0 +1,208 @@
+#include "sysload_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * statvfs() worker pool. Jobs are claimed by index under the lock and
+ * results are only stored if the batch is still current, so a worker
+ * returning from a hung mount after its batch gave up is harmless. The
+ * pool is reference counted because such a worker may outlive its owner.
+ */
+struct sl_statvfs_pool
+{
+        pthread_mutex_t lock;
+        pthread_cond_t work;            /**< A batch was posted or stop requested */
+        pthread_cond_t done;            /**< The last job of a batch finished */
+        int refs;                       /**< Live workers + the owner */
+        int stopping;
+
+        uint64_t batch;                 /**< Current batch id */
+        int next;                       /**< Next job to claim */
+        int count;                      /**< Jobs posted in the current batch */
+        int queued;                     /**< Jobs added for the next batch */
+        int pending;                    /**< Jobs not finished yet */
+
+        int capacity;
+        char (*paths)[SL_PATH_SIZE];
+        sl_storage_info_t *infos;
+        int *errors;
+};
+
+
+static void pool_free(sl_statvfs_pool_t *pool)
+{
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->work);
+        pthread_cond_destroy(&pool->done);
+        free(pool->paths);
+        free(pool->infos);
+        free(pool->errors);
+        free(pool);
+}
+
+
+static void *pool_worker(void *arg)
+{
+        sl_statvfs_pool_t *pool = arg;
+        char path[SL_PATH_SIZE];
+
+        pthread_mutex_lock(&pool->lock);
+        for (;;) {
+                while (!pool->stopping && pool->next >= pool->count) {
+                        pthread_cond_wait(&pool->work, &pool->lock);
+                }
+                if (pool->stopping) break;
+
+                int i = pool->next++;
+                uint64_t batch = pool->batch;
+                memcpy(path, pool->paths[i], sizeof(path));
+                pthread_mutex_unlock(&pool->lock);
+
+                sl_storage_info_t info;
+                int err = sl_storage_stat(path, &info);
+
+                pthread_mutex_lock(&pool->lock);
+                if (pool->batch == batch) {
+                        pool->infos[i] = info;
+                        pool->errors[i] = err;
+                        if (--pool->pending == 0) pthread_cond_signal(&pool->done);
+                }
+        }
+
+        int last = (--pool->refs == 0);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (last) pool_free(pool);
+
+        return NULL;
+}
+
+
+void sl_statvfs_pool_release(sl_statvfs_pool_t *pool)
+{
+        if (!pool) return;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->stopping = 1;
+        pthread_cond_broadcast(&pool->work);
+        int last = (--pool->refs == 0);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (last) pool_free(pool);
+}
+
+
+sl_statvfs_pool_t *sl_statvfs_pool_create(int threads)
+{
+        sl_statvfs_pool_t *pool = calloc(1, sizeof(*pool));
+        if (!pool) return NULL;
+
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->work, NULL);
+        pthread_cond_init(&pool->done, &attr);
+        pthread_condattr_destroy(&attr);
+        pool->refs = 1;
+
+        for (int i = 0; i < threads; i++) {
+                pthread_t thread;
+
+                pthread_mutex_lock(&pool->lock);
+                pool->refs++;
+                pthread_mutex_unlock(&pool->lock);
+
+                if (pthread_create(&thread, NULL, pool_worker, pool) != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to create worker %d of %d", i + 1, threads);
+                        pthread_mutex_lock(&pool->lock);
+                        pool->refs--;
+                        pthread_mutex_unlock(&pool->lock);
+                        sl_statvfs_pool_release(pool);
+                        return NULL;
+                }
+                pthread_detach(thread);
+        }
+
+        return pool;
+}
+
+
+int sl_statvfs_pool_add(sl_statvfs_pool_t *pool, const char *path)
+{
+        pthread_mutex_lock(&pool->lock);
+
+        /* Grown under the lock because workers copy their path under it */
+        if (pool->queued == pool->capacity) {
+                int capacity = pool->capacity ? pool->capacity * 2 : 8;
+
+                char (*paths)[SL_PATH_SIZE] = realloc(pool->paths, (size_t)capacity * sizeof(*paths));
+                if (paths) pool->paths = paths;
+                sl_storage_info_t *infos = realloc(pool->infos, (size_t)capacity * sizeof(*infos));
+                if (infos) pool->infos = infos;
+                int *errors = realloc(pool->errors, (size_t)capacity * sizeof(*errors));
+                if (errors) pool->errors = errors;
+
+                if (!paths || !infos || !errors) {
+                        pool->queued = 0;
+                        pthread_mutex_unlock(&pool->lock);
+                        return -1;
+                }
+                pool->capacity = capacity;
+        }
+
+        int i = pool->queued++;
+        snprintf(pool->paths[i], SL_PATH_SIZE, "%s", path);
+        pool->errors[i] = ETIMEDOUT;
+
+        pthread_mutex_unlock(&pool->lock);
+        return i;
+}
+
+
+void sl_statvfs_pool_run(sl_statvfs_pool_t *pool, int timeout_ms)
+{
+        pthread_mutex_lock(&pool->lock);
+
+        pool->batch++;
+        pool->next = 0;
+        pool->count = pool->queued;
+        pool->pending = pool->queued;
+        pool->queued = 0;
+        pthread_cond_broadcast(&pool->work);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (pool->pending > 0) {
+                if (timeout_ms <= 0) {
+                        pthread_cond_wait(&pool->done, &pool->lock);
+                } else if (pthread_cond_timedwait(&pool->done, &pool->lock, &deadline) == ETIMEDOUT) {
+                        break;
+                }
+        }
+
+        /* Abandon unclaimed jobs; late results are dropped by the batch check */
+        pool->next = pool->count = 0;
+        pool->batch++;
+
+        pthread_mutex_unlock(&pool->lock);
+}
+
+
+int sl_statvfs_pool_result(const sl_statvfs_pool_t *pool, int index, sl_storage_info_t *info)
+{
+        /* Workers only write results of the current batch, which run() has closed */
+        if (pool->errors[index] == 0) *info = pool->infos[index];
+        return pool->errors[index];
+}
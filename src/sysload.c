@@ -1,39 +1,327 @@
-#include "sysload.h"
+#include "sysload_internal.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <errno.h>
 #include <string.h>
-#include <inttypes.h>
 #include <stdarg.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <sys/statvfs.h>
 
+/*
+ * Library-wide settings are written rarely (under g_settings_lock) and
+ * read on every call, so readers go through seqlocks over atomic words
+ * instead of taking the lock: a reader retries if the sequence was odd
+ * or changed while it copied.
+ */
+#define LOG_MSG_SIZE 512
+#define LOG_RING_SIZE 64                /* Messages per thread, power of two */
+#define ROOT_WORDS (SL_ROOT_SIZE / sizeof(uint64_t))
+
+static pthread_mutex_t g_settings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_uint_fast64_t g_log_seq;
+static _Atomic(sl_log_handler_t) g_log_handler;
+static _Atomic(void *) g_log_user_data;
+static atomic_int g_log_level = SL_LOG_INFO;
+static atomic_int g_log_deferred;
+
+/* A root that was never set has sequence 0 and reads as its default */
 typedef struct
 {
-        const char *key;
-        size_t key_len;
-        uint64_t *field; 
-} meminfo_field_t;
+        atomic_uint_fast64_t seq;
+        _Atomic uint64_t words[ROOT_WORDS];
+} root_setting_t;
+
+static root_setting_t g_proc_root;
+static root_setting_t g_sys_root;
 
-static sl_log_handler_t g_log_handler = NULL;
-static void *g_log_user_data = NULL;
 
 void sl_set_log_handler(sl_log_handler_t handler, void* user_data)
 {
-        g_log_handler = handler;
-        g_log_user_data = user_data;
+        pthread_mutex_lock(&g_settings_lock);
+
+        uint64_t seq = atomic_load_explicit(&g_log_seq, memory_order_relaxed);
+        atomic_store_explicit(&g_log_seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        atomic_store_explicit(&g_log_handler, handler, memory_order_relaxed);
+        atomic_store_explicit(&g_log_user_data, user_data, memory_order_relaxed);
+
+        atomic_store_explicit(&g_log_seq, seq + 2, memory_order_release);
+        pthread_mutex_unlock(&g_settings_lock);
+}
+
+
+/* Handler and user data as set together by one sl_set_log_handler() call */
+static sl_log_handler_t log_handler(void **user_data)
+{
+        sl_log_handler_t handler;
+        uint64_t seq1, seq2;
+
+        do {
+                seq1 = atomic_load_explicit(&g_log_seq, memory_order_acquire);
+                handler = atomic_load_explicit(&g_log_handler, memory_order_relaxed);
+                *user_data = atomic_load_explicit(&g_log_user_data, memory_order_relaxed);
+                atomic_thread_fence(memory_order_acquire);
+                seq2 = atomic_load_explicit(&g_log_seq, memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+
+        return handler;
 }
 
-static void sl_log(sl_log_level_t level, const char* func, const char* fmt, ...)
+
+void sl_set_log_level(sl_log_level_t min_level)
 {
-        if (!g_log_handler) return;
-        
-        char buffer[512];
+        atomic_store_explicit(&g_log_level, (int)min_level, memory_order_relaxed);
+}
+
+
+/*
+ * Deferred logging: each thread that logs gets a single-producer ring.
+ * Rings are linked into a list that only grows; a ring whose thread
+ * exited is drained and then handed to the next new thread, so the list
+ * is bounded by the peak number of logging threads. Draining is
+ * serialized by g_drain_lock, which producers never touch.
+ */
+typedef struct
+{
+        sl_log_level_t level;
+        const char *func;               /* __func__ of the caller, static storage */
+        char msg[LOG_MSG_SIZE];
+} log_entry_t;
+
+enum { RING_ACTIVE, RING_ORPHANED, RING_FREE };
+
+typedef struct log_ring
+{
+        atomic_uint_fast32_t head;      /**< Written by the owning thread */
+        atomic_uint_fast32_t tail;      /**< Written by the drainer */
+        atomic_uint_fast32_t dropped;
+        atomic_int state;
+        struct log_ring *next;          /**< Immutable once the ring is published */
+        log_entry_t entries[LOG_RING_SIZE];
+} log_ring_t;
+
+static _Atomic(log_ring_t *) g_log_rings;
+static pthread_mutex_t g_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ring_key;
+static _Thread_local log_ring_t *tls_ring;
+
+
+static void log_ring_orphan(void *ring)
+{
+        atomic_store_explicit(&((log_ring_t *)ring)->state, RING_ORPHANED, memory_order_release);
+}
+
+
+static void log_ring_key_create(void)
+{
+        pthread_key_create(&g_ring_key, log_ring_orphan);
+}
+
+
+/* The calling thread's ring, reusing a drained one if possible; NULL if out of memory */
+static log_ring_t *log_ring_get(void)
+{
+        if (tls_ring) return tls_ring;
+
+        log_ring_t *ring = atomic_load_explicit(&g_log_rings, memory_order_acquire);
+        for (; ring; ring = ring->next) {
+                int expected = RING_FREE;
+                if (atomic_compare_exchange_strong_explicit(&ring->state, &expected, RING_ACTIVE,
+                                                            memory_order_acquire, memory_order_relaxed)) {
+                        break;
+                }
+        }
+
+        if (!ring) {
+                ring = calloc(1, sizeof(*ring));
+                if (!ring) return NULL;
+
+                ring->next = atomic_load_explicit(&g_log_rings, memory_order_relaxed);
+                while (!atomic_compare_exchange_weak_explicit(&g_log_rings, &ring->next, ring,
+                                                              memory_order_release, memory_order_relaxed));
+        }
+
+        pthread_once(&g_ring_key_once, log_ring_key_create);
+        pthread_setspecific(g_ring_key, ring);
+        tls_ring = ring;
+        return ring;
+}
+
+
+static void log_ring_push(sl_log_level_t level, const char *func, const char *fmt, va_list args)
+{
+        log_ring_t *ring = log_ring_get();
+        if (!ring) return;
+
+        uint32_t head = (uint32_t)atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint32_t tail = (uint32_t)atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail >= LOG_RING_SIZE) {
+                atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+                return;
+        }
+
+        log_entry_t *entry = &ring->entries[head & (LOG_RING_SIZE - 1)];
+        entry->level = level;
+        entry->func = func;
+        vsnprintf(entry->msg, sizeof(entry->msg), fmt, args);
+
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+void sl_set_log_deferred(int enabled)
+{
+        atomic_store_explicit(&g_log_deferred, enabled != 0, memory_order_relaxed);
+}
+
+
+int sl_log_drain(void)
+{
+        void *user_data;
+        sl_log_handler_t handler = log_handler(&user_data);
+        int delivered = 0;
+
+        pthread_mutex_lock(&g_drain_lock);
+
+        for (log_ring_t *ring = atomic_load_explicit(&g_log_rings, memory_order_acquire); ring; ring = ring->next) {
+                /* Read the state first: once orphaned, no more messages can arrive */
+                int state = atomic_load_explicit(&ring->state, memory_order_acquire);
+                if (state == RING_FREE) continue;
+
+                uint32_t tail = (uint32_t)atomic_load_explicit(&ring->tail, memory_order_relaxed);
+                uint32_t head = (uint32_t)atomic_load_explicit(&ring->head, memory_order_acquire);
+
+                for (; tail != head; tail++) {
+                        const log_entry_t *entry = &ring->entries[tail & (LOG_RING_SIZE - 1)];
+                        if (handler) {
+                                handler(entry->level, entry->func, entry->msg, user_data);
+                                delivered++;
+                        }
+                }
+                atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+                uint32_t dropped = (uint32_t)atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+                if (dropped > 0 && handler) {
+                        char msg[64];
+                        snprintf(msg, sizeof(msg), "%u messages dropped, log ring was full", dropped);
+                        handler(SL_LOG_WARN, __func__, msg, user_data);
+                }
+
+                if (state == RING_ORPHANED) {
+                        atomic_store_explicit(&ring->state, RING_FREE, memory_order_release);
+                }
+        }
+
+        pthread_mutex_unlock(&g_drain_lock);
+        return delivered;
+}
+
+
+void sl_log(sl_log_level_t level, const char* func, const char* fmt, ...)
+{
+        if ((int)level < atomic_load_explicit(&g_log_level, memory_order_relaxed)) return;
+
         va_list args;
         va_start(args, fmt);
+
+        if (atomic_load_explicit(&g_log_deferred, memory_order_relaxed)) {
+                log_ring_push(level, func, fmt, args);
+                va_end(args);
+                return;
+        }
+
+        void *user_data;
+        sl_log_handler_t handler = log_handler(&user_data);
+        if (!handler) {
+                va_end(args);
+                return;
+        }
+
+        char buffer[LOG_MSG_SIZE];
         vsnprintf(buffer, sizeof(buffer), fmt, args);
         va_end(args);
 
-        g_log_handler(level, func, buffer, g_log_user_data);       
+        handler(level, func, buffer, user_data);
+}
+
+
+static int set_root(root_setting_t *setting, const char *path, const char *fallback, const char *func)
+{
+        if (!path) path = fallback;
+
+        size_t len = strlen(path);
+        if (len == 0 || len >= SL_ROOT_SIZE) {
+                sl_log(SL_LOG_ERROR, func, "root path is empty or too long: %.64s", path);
+                return -1;
+        }
+
+        /* Strip trailing slashes so paths join as root + "/" + name */
+        uint64_t words[ROOT_WORDS] = {0};
+        while (len > 1 && path[len - 1] == '/') len--;
+        memcpy(words, path, len);
+
+        pthread_mutex_lock(&g_settings_lock);
+
+        uint64_t seq = atomic_load_explicit(&setting->seq, memory_order_relaxed);
+        atomic_store_explicit(&setting->seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        for (size_t i = 0; i < ROOT_WORDS; i++) {
+                atomic_store_explicit(&setting->words[i], words[i], memory_order_relaxed);
+        }
+
+        atomic_store_explicit(&setting->seq, seq + 2, memory_order_release);
+        pthread_mutex_unlock(&g_settings_lock);
+        return 0;
+}
+
+
+static const char *get_root(root_setting_t *setting, const char *fallback, char *buf)
+{
+        uint64_t words[ROOT_WORDS];
+        uint64_t seq1, seq2;
+
+        do {
+                seq1 = atomic_load_explicit(&setting->seq, memory_order_acquire);
+                if (seq1 == 0) {
+                        snprintf(buf, SL_ROOT_SIZE, "%s", fallback);
+                        return buf;
+                }
+                for (size_t i = 0; i < ROOT_WORDS; i++) {
+                        words[i] = atomic_load_explicit(&setting->words[i], memory_order_relaxed);
+                }
+                atomic_thread_fence(memory_order_acquire);
+                seq2 = atomic_load_explicit(&setting->seq, memory_order_relaxed);
+        } while ((seq1 & 1) || seq1 != seq2);
+
+        memcpy(buf, words, SL_ROOT_SIZE);
+        return buf;
+}
+
+int sl_set_proc_root(const char *path)
+{
+        return set_root(&g_proc_root, path, "/proc", __func__);
+}
+
+int sl_set_sys_root(const char *path)
+{
+        return set_root(&g_sys_root, path, "/sys", __func__);
+}
+
+const char *sl_proc_root(char *buf)
+{
+        return get_root(&g_proc_root, "/proc", buf);
+}
+
+const char *sl_sys_root(char *buf)
+{
+        return get_root(&g_sys_root, "/sys", buf);
 }
 
 
@@ -62,83 +350,104 @@ uint64_t sl_kb_to_mb(uint64_t kb)
 }
 
 
-int sl_systime_get_info(sl_systime_info_t *result)
-{       
-        if (!result) {
-                sl_log(SL_LOG_ERROR, __func__, "result pointer is NULL");
+int sl_parse_uptime(const char *buf, size_t len, sl_systime_info_t *result)
+{
+        if (len == 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to read /proc/uptime (EOF)");
                 return -1;
         }
 
-        FILE* fptr;
-        int ret;
+        const char *p = sl_parse_udouble(buf, &result->uptime);
+        if (p) p = sl_parse_udouble(p, &result->idle_time);
 
-        fptr = fopen("/proc/uptime", "r");
-        if (fptr == NULL) {
-                sl_log(SL_LOG_ERROR, __func__, "failed to open /proc/uptime");
+        if (!p) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to parse /proc/uptime: %.64s", buf);
                 return -1;
         }
 
-        ret = fscanf(fptr, "%lf %lf", &result->uptime, &result->idle_time);
+        return 0; 
+}
 
-        fclose(fptr);
 
-        if (ret == 2) {
-                return 0;
-        } else if (ret == EOF){
-                sl_log(SL_LOG_ERROR, __func__, "failed to read /proc/uptime (EOF)");
-        } else {
-                sl_log(SL_LOG_ERROR, __func__, "failed to parse /proc/uptime (expected 2 fields, got %d)", ret);
+int sl_systime_get_info(sl_systime_info_t *result)
+{       
+        if (!result) {
+                sl_log(SL_LOG_ERROR, __func__, "result pointer is NULL");
+                return -1;
         }
 
-        return -1; 
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_systime_get_info(&sampler, result);
+        sl_sampler_fini(&sampler);
+
+        return ret;
 }
 
 
-int sl_cpu_get_raw(sl_cpu_raw_t *snapshot)
+/* Parse the counters of one "cpu..." line; returns the number of fields read */
+static int parse_cpu_line(const char *p, sl_cpu_raw_t *snapshot)
 {
-        if (!snapshot) {
-                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
-                return -1;
-        }
+        uint64_t v[8];
+        int n = 0;
 
-        FILE* fptr;
-        int ret;
+        while (*p != ' ' && *p != '\n' && *p != '\0') p++;
 
-        fptr = fopen("/proc/stat", "r");
-        if (fptr == NULL) {
-                sl_log(SL_LOG_ERROR, __func__, "failed to open /proc/stat");
-                return -1;
+        while (n < 8 && (p = sl_parse_u64(p, &v[n])) != NULL) {
+                n++;
         }
 
-        ret = fscanf(fptr, "%*s" " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
-                     &snapshot->user,
-                     &snapshot->nice,
-                     &snapshot->system,
-                     &snapshot->idle,
-                     &snapshot->iowait,
-                     &snapshot->irq,
-                     &snapshot->softirq,        
-                     &snapshot->steal);
-        fclose(fptr); 
+        if (n == 8) {
+                snapshot->user    = v[0];
+                snapshot->nice    = v[1];
+                snapshot->system  = v[2];
+                snapshot->idle    = v[3];
+                snapshot->iowait  = v[4];
+                snapshot->irq     = v[5];
+                snapshot->softirq = v[6];
+                snapshot->steal   = v[7];
+        }
 
-        if (ret == 8) {
-                return 0;
-        } else if (ret == EOF) {
+        return n;
+}
+
+
+int sl_parse_cpu_raw(const char *buf, size_t len, sl_cpu_raw_t *snapshot)
+{
+        if (len == 0) {
                 sl_log(SL_LOG_ERROR, __func__, "failed to read from /proc/stat (EOF)");
-        } else {
+                return -1;
+        }
+
+        int ret = parse_cpu_line(buf, snapshot);
+        if (ret != 8) {
                 sl_log(SL_LOG_ERROR, __func__, "failed to parse /proc/stat (expected 8 fields, got %d)", ret);
+                return -1;
         }
-        return -1;
+
+        return 0;
 }
 
 
-int sl_cpu_calculate(const sl_cpu_raw_t *start, const sl_cpu_raw_t *end, sl_cpu_usage_t *result)
-{       
-        if (!start || !end || !result) {
-                sl_log(SL_LOG_ERROR, __func__, "start, end, result pointers are NULL");
+int sl_cpu_get_raw(sl_cpu_raw_t *snapshot)
+{
+        if (!snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
                 return -1;
         }
 
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_cpu_get_raw(&sampler, snapshot);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
+
+
+/* Usage between two counter sets; -1 if the interval is empty or counters went backwards */
+static int cpu_usage_between(const sl_cpu_raw_t *start, const sl_cpu_raw_t *end, sl_cpu_usage_t *result)
+{
         uint64_t total_start, total_end;
         uint64_t total_diff;
 
@@ -161,16 +470,10 @@ int sl_cpu_calculate(const sl_cpu_raw_t *start, const sl_cpu_raw_t *end, sl_cpu_
                   + end->steal;
 
         if (total_end <= total_start) {
-                sl_log(SL_LOG_ERROR, __func__, "invalid time interval or counter overflow");
                 return -1;
         }
 
         total_diff = total_end - total_start;
-
-        if (total_diff == 0) {
-                memset(result, 0, sizeof(sl_cpu_usage_t));
-                return 0;
-        }
  
         result->user    = ((float)(end->user - start->user) / total_diff) * 100.0f;
         result->nice    = ((float)(end->nice - start->nice) / total_diff) * 100.0f;
@@ -187,6 +490,190 @@ int sl_cpu_calculate(const sl_cpu_raw_t *start, const sl_cpu_raw_t *end, sl_cpu_
 }
 
 
+int sl_cpu_calculate(const sl_cpu_raw_t *start, const sl_cpu_raw_t *end, sl_cpu_usage_t *result)
+{       
+        if (!start || !end || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end, result pointers are NULL");
+                return -1;
+        }
+
+        if (cpu_usage_between(start, end, result) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval or counter overflow");
+                return -1;
+        }
+
+        return 0;
+}
+
+
+int sl_cpu_cores_init(sl_cpu_cores_t *snapshot, int capacity)
+{
+        if (!snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
+                return -1;
+        }
+
+        if (capacity <= 0) {
+                long conf = sysconf(_SC_NPROCESSORS_CONF);
+                capacity = (conf > 0) ? (int)conf : 1;
+        }
+
+        memset(snapshot, 0, sizeof(*snapshot));
+        snapshot->cores = calloc((size_t)capacity, sizeof(sl_cpu_raw_t));
+        snapshot->online = calloc((size_t)capacity, sizeof(uint8_t));
+        if (!snapshot->cores || !snapshot->online) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate %d CPU slots", capacity);
+                free(snapshot->cores);
+                free(snapshot->online);
+                memset(snapshot, 0, sizeof(*snapshot));
+                return -1;
+        }
+
+        snapshot->capacity = capacity;
+        snapshot->owned = 1;
+        return 0;
+}
+
+
+void sl_cpu_cores_init_with(sl_cpu_cores_t *snapshot, sl_cpu_raw_t *cores, uint8_t *online, int capacity)
+{
+        if (!snapshot) return;
+
+        memset(snapshot, 0, sizeof(*snapshot));
+        snapshot->cores = cores;
+        snapshot->online = online;
+        snapshot->capacity = (cores && online && capacity > 0) ? capacity : 0;
+}
+
+
+void sl_cpu_cores_free(sl_cpu_cores_t *snapshot)
+{
+        if (!snapshot) return;
+
+        if (snapshot->owned) {
+                free(snapshot->cores);
+                free(snapshot->online);
+        }
+        memset(snapshot, 0, sizeof(*snapshot));
+}
+
+
+/* Make room for CPU id; only library-owned arrays are grown */
+static int cpu_cores_reserve(sl_cpu_cores_t *snapshot, int id)
+{
+        if (id < snapshot->capacity) return 0;
+
+        if (!snapshot->owned) {
+                sl_log(SL_LOG_ERROR, __func__, "cpu%d exceeds caller-provided capacity of %d", id, snapshot->capacity);
+                return -1;
+        }
+
+        int new_capacity = snapshot->capacity ? snapshot->capacity : 1;
+        while (new_capacity <= id) new_capacity *= 2;
+
+        sl_cpu_raw_t *cores = realloc(snapshot->cores, (size_t)new_capacity * sizeof(sl_cpu_raw_t));
+        if (!cores) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to grow to %d CPU slots", new_capacity);
+                return -1;
+        }
+        snapshot->cores = cores;
+
+        uint8_t *online = realloc(snapshot->online, (size_t)new_capacity);
+        if (!online) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to grow to %d CPU slots", new_capacity);
+                return -1;
+        }
+        memset(online + snapshot->capacity, 0, (size_t)(new_capacity - snapshot->capacity));
+        snapshot->online = online;
+        snapshot->capacity = new_capacity;
+
+        return 0;
+}
+
+
+int sl_parse_cpu_cores(const char *buf, size_t len, sl_cpu_cores_t *snapshot)
+{
+        if (sl_parse_cpu_raw(buf, len, &snapshot->total) != 0) {
+                return -1;
+        }
+
+        if (snapshot->count > 0) {
+                memset(snapshot->online, 0, (size_t)snapshot->count);
+        }
+        snapshot->count = 0;
+
+        const char *end = buf + len;
+        const char *line = sl_next_line(buf, end);
+
+        /* cpuN lines directly follow the aggregate line */
+        while (line && line[0] == 'c' && line[1] == 'p' && line[2] == 'u') {
+                uint64_t id;
+                const char *p = line + 3;
+
+                if ((unsigned)(*p - '0') > 9 || !sl_parse_u64(p, &id) || id >= INT32_MAX) {
+                        sl_log(SL_LOG_ERROR, __func__, "malformed CPU line in /proc/stat: %.32s", line);
+                        return -1;
+                }
+
+                if (cpu_cores_reserve(snapshot, (int)id) != 0) {
+                        return -1;
+                }
+
+                int ret = parse_cpu_line(line, &snapshot->cores[id]);
+                if (ret != 8) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to parse cpu%d (expected 8 fields, got %d)", (int)id, ret);
+                        return -1;
+                }
+
+                snapshot->online[id] = 1;
+                if ((int)id >= snapshot->count) {
+                        snapshot->count = (int)id + 1;
+                }
+
+                line = sl_next_line(line, end);
+        }
+
+        return 0;
+}
+
+
+int sl_cpu_get_raw_cores(sl_cpu_cores_t *snapshot)
+{
+        if (!snapshot) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshot pointer is NULL");
+                return -1;
+        }
+
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_cpu_get_raw_cores(&sampler, snapshot);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
+
+
+int sl_cpu_calculate_cores(const sl_cpu_cores_t *start, const sl_cpu_cores_t *end, sl_cpu_usage_t *results, int max_results)
+{
+        if (!start || !end || !results || max_results <= 0) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end, results pointers are NULL or max_results is zero");
+                return -1;
+        }
+
+        int count = (end->count < max_results) ? end->count : max_results;
+
+        for (int i = 0; i < count; i++) {
+                int present = i < start->count && start->online[i] && end->online[i];
+
+                if (!present || cpu_usage_between(&start->cores[i], &end->cores[i], &results[i]) != 0) {
+                        memset(&results[i], 0, sizeof(sl_cpu_usage_t));
+                }
+        }
+
+        return count;
+}
+
+
 int sl_cpu_get_usage(float interval_sec, sl_cpu_usage_t *result)
 {       
         if (!result) {
@@ -220,37 +707,123 @@ int sl_cpu_get_usage(float interval_sec, sl_cpu_usage_t *result)
 }
 
 
-int parse_meminfo_line(const char *line, sl_mem_info_t *result)
-{       
-        char key[MEMINFO_KEY_SIZE];
-        uint64_t value = 0;
+/* Delta of one counter; a counter that went backwards contributes nothing */
+static inline uint64_t counter_delta(uint64_t start, uint64_t end)
+{
+        return (end > start) ? end - start : 0;
+}
+
+
+void sl_cpu_delta_init(sl_cpu_delta_t *ctx)
+{
+        if (!ctx) return;
+
+        memset(ctx, 0, sizeof(*ctx));
+}
 
-        if (sscanf(line, "%31[^:]: %" SCNu64, key, &value) != 2) {
-                sl_log(SL_LOG_ERROR, __func__, "failed to parse meminfo line: %.100s", line);
+
+int sl_cpu_delta_feed(sl_cpu_delta_t *ctx, const sl_cpu_raw_t *snapshot, uint64_t timestamp_ns,
+                      sl_cpu_usage_t *result, double *elapsed_sec)
+{
+        if (!ctx || !snapshot || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "ctx, snapshot, result pointers are NULL");
                 return -1;
         }
- 
-        meminfo_field_t fields[] = {
-                {"MemTotal",     8,  &result->total},
-                {"MemFree",      7,  &result->free},
-                {"MemAvailable", 12, &result->available},
-                {"Buffers",      7,  &result->buffers},
-                {"Cached",       6,  &result->cached},
-                {"Shmem",        5,  &result->shared}, 
-                {"SwapTotal",    9,  &result->swap_total},
-                {"SwapFree",     8,  &result->swap_free},
-                {NULL,           0,  NULL}
-        };
-
-        for (size_t i = 0; fields[i].key != NULL; i++) {
-                if (strncmp(key, fields[i].key, fields[i].key_len) == 0 &&
-                            key[fields[i].key_len] == '\0') {
-                        *(fields[i].field) = value;
-                        return 0;
+
+        const sl_cpu_raw_t *prev = &ctx->prev;
+        uint64_t total_prev = prev->user + prev->nice + prev->system + prev->idle
+                            + prev->iowait + prev->irq + prev->softirq + prev->steal;
+        uint64_t total_cur = snapshot->user + snapshot->nice + snapshot->system + snapshot->idle
+                           + snapshot->iowait + snapshot->irq + snapshot->softirq + snapshot->steal;
+
+        if (!ctx->primed || total_cur < total_prev) {
+                /* First sample, or counters were reset (e.g. restored checkpoint): rebase */
+                if (ctx->primed) {
+                        sl_log(SL_LOG_INFO, __func__, "CPU counters went backwards, restarting from new baseline");
                 }
+                ctx->prev = *snapshot;
+                ctx->prev_ns = timestamp_ns;
+                ctx->primed = 1;
+                return 1;
+        }
+
+        /* Individual counters (notably iowait) may dip slightly; clamp them */
+        uint64_t d_user    = counter_delta(prev->user, snapshot->user);
+        uint64_t d_nice    = counter_delta(prev->nice, snapshot->nice);
+        uint64_t d_system  = counter_delta(prev->system, snapshot->system);
+        uint64_t d_idle    = counter_delta(prev->idle, snapshot->idle);
+        uint64_t d_iowait  = counter_delta(prev->iowait, snapshot->iowait);
+        uint64_t d_irq     = counter_delta(prev->irq, snapshot->irq);
+        uint64_t d_softirq = counter_delta(prev->softirq, snapshot->softirq);
+        uint64_t d_steal   = counter_delta(prev->steal, snapshot->steal);
+        uint64_t total_diff = d_user + d_nice + d_system + d_idle + d_iowait + d_irq + d_softirq + d_steal;
+
+        if (total_diff == 0) {
+                /* Less than one tick since the baseline; keep it and report nothing yet */
+                return 1;
         }
 
-        return -1;
+        result->user    = ((float)d_user / total_diff) * 100.0f;
+        result->nice    = ((float)d_nice / total_diff) * 100.0f;
+        result->system  = ((float)d_system / total_diff) * 100.0f;
+        result->idle    = ((float)d_idle / total_diff) * 100.0f;
+        result->iowait  = ((float)d_iowait / total_diff) * 100.0f;
+        result->irq     = ((float)d_irq / total_diff) * 100.0f;
+        result->softirq = ((float)d_softirq / total_diff) * 100.0f;
+        result->steal   = ((float)d_steal / total_diff) * 100.0f;
+        result->total   = 100.0f - (result->idle + result->iowait);
+
+        if (elapsed_sec) {
+                *elapsed_sec = (timestamp_ns > ctx->prev_ns) ? (double)(timestamp_ns - ctx->prev_ns) / 1e9 : 0.0;
+        }
+
+        ctx->prev = *snapshot;
+        ctx->prev_ns = timestamp_ns;
+        return 0;
+}
+
+
+int sl_cpu_delta_update(sl_cpu_delta_t *ctx, sl_sampler_t *sampler, sl_cpu_usage_t *result, double *elapsed_sec)
+{
+        if (!ctx || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "ctx or result pointer is NULL");
+                return -1;
+        }
+
+        sl_cpu_raw_t snapshot;
+        int ret = sampler ? sl_sampler_cpu_get_raw(sampler, &snapshot) : sl_cpu_get_raw(&snapshot);
+        if (ret != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to get CPU snapshot");
+                return -1;
+        }
+
+        return sl_cpu_delta_feed(ctx, &snapshot, sl_now_ns(), result, elapsed_sec);
+}
+
+
+/* Map a /proc/meminfo key to its field: switch on length and first char, then confirm */
+static uint64_t *meminfo_field(sl_mem_info_t *result, const char *key, size_t len)
+{
+        switch (len) {
+        case 5:
+                return memcmp(key, "Shmem", 5) == 0 ? &result->shared : NULL;
+        case 6:
+                return memcmp(key, "Cached", 6) == 0 ? &result->cached : NULL;
+        case 7:
+                if (key[0] == 'M') return memcmp(key, "MemFree", 7) == 0 ? &result->free : NULL;
+                if (key[0] == 'B') return memcmp(key, "Buffers", 7) == 0 ? &result->buffers : NULL;
+                return NULL;
+        case 8:
+                if (key[0] == 'M') return memcmp(key, "MemTotal", 8) == 0 ? &result->total : NULL;
+                if (key[0] == 'S') return memcmp(key, "SwapFree", 8) == 0 ? &result->swap_free : NULL;
+                return NULL;
+        case 9:
+                return memcmp(key, "SwapTotal", 9) == 0 ? &result->swap_total : NULL;
+        case 12:
+                return memcmp(key, "MemAvailable", 12) == 0 ? &result->available : NULL;
+        default:
+                return NULL;
+        }
 }
 
 
@@ -283,6 +856,30 @@ int sl_mem_calculate(sl_mem_info_t *result)
 }
 
 
+int sl_parse_meminfo(const char *buf, size_t len, sl_mem_info_t *result)
+{
+        memset(result, 0, sizeof(sl_mem_info_t));
+
+        const char *end = buf + len;
+        const char *line = (len > 0) ? buf : NULL;
+        int found = 0;
+
+        while (line && found < EXPECTED_MEMINFO_KEYS) {
+                const char *colon = memchr(line, ':', (size_t)(end - line));
+                if (!colon) break;
+
+                uint64_t *field = meminfo_field(result, line, (size_t)(colon - line));
+                if (field && sl_parse_u64(colon + 1, field)) {
+                        found++;
+                }
+
+                line = sl_next_line(colon, end);
+        }
+
+        return 0;
+}
+
+
 int sl_mem_get_info(sl_mem_info_t *result)
 {       
         if (!result) {
@@ -290,46 +887,195 @@ int sl_mem_get_info(sl_mem_info_t *result)
                 return -1;
         }
 
-        FILE* fptr;
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_mem_get_info(&sampler, result);
+        sl_sampler_fini(&sampler);
 
-        fptr = fopen("/proc/meminfo", "r");
-        if (fptr == NULL) {
-                sl_log(SL_LOG_ERROR, __func__, "failed to open /proc/meminfo");
-                return -1;
+        return ret;
+}
+
+
+/* All /proc/meminfo keys and their sl_mem_ext_t fields */
+typedef struct
+{
+        const char *key;
+        size_t len;
+        size_t offset;
+} meminfo_key_t;
+
+#define MEMINFO_KEY(name, field) {name, sizeof(name) - 1, offsetof(sl_mem_ext_t, field)}
+
+static const meminfo_key_t meminfo_keys[] = {
+        MEMINFO_KEY("MemTotal", mem_total),
+        MEMINFO_KEY("MemFree", mem_free),
+        MEMINFO_KEY("MemAvailable", mem_available),
+        MEMINFO_KEY("Buffers", buffers),
+        MEMINFO_KEY("Cached", cached),
+        MEMINFO_KEY("SwapCached", swap_cached),
+        MEMINFO_KEY("Active", active),
+        MEMINFO_KEY("Inactive", inactive),
+        MEMINFO_KEY("Active(anon)", active_anon),
+        MEMINFO_KEY("Inactive(anon)", inactive_anon),
+        MEMINFO_KEY("Active(file)", active_file),
+        MEMINFO_KEY("Inactive(file)", inactive_file),
+        MEMINFO_KEY("Unevictable", unevictable),
+        MEMINFO_KEY("Mlocked", mlocked),
+        MEMINFO_KEY("SwapTotal", swap_total),
+        MEMINFO_KEY("SwapFree", swap_free),
+        MEMINFO_KEY("Zswap", zswap),
+        MEMINFO_KEY("Zswapped", zswapped),
+        MEMINFO_KEY("Dirty", dirty),
+        MEMINFO_KEY("Writeback", writeback),
+        MEMINFO_KEY("AnonPages", anon_pages),
+        MEMINFO_KEY("Mapped", mapped),
+        MEMINFO_KEY("Shmem", shmem),
+        MEMINFO_KEY("KReclaimable", kreclaimable),
+        MEMINFO_KEY("Slab", slab),
+        MEMINFO_KEY("SReclaimable", sreclaimable),
+        MEMINFO_KEY("SUnreclaim", sunreclaim),
+        MEMINFO_KEY("KernelStack", kernel_stack),
+        MEMINFO_KEY("PageTables", page_tables),
+        MEMINFO_KEY("SecPageTables", sec_page_tables),
+        MEMINFO_KEY("NFS_Unstable", nfs_unstable),
+        MEMINFO_KEY("Bounce", bounce),
+        MEMINFO_KEY("WritebackTmp", writeback_tmp),
+        MEMINFO_KEY("CommitLimit", commit_limit),
+        MEMINFO_KEY("Committed_AS", committed_as),
+        MEMINFO_KEY("VmallocTotal", vmalloc_total),
+        MEMINFO_KEY("VmallocUsed", vmalloc_used),
+        MEMINFO_KEY("VmallocChunk", vmalloc_chunk),
+        MEMINFO_KEY("Percpu", percpu),
+        MEMINFO_KEY("HardwareCorrupted", hardware_corrupted),
+        MEMINFO_KEY("AnonHugePages", anon_huge_pages),
+        MEMINFO_KEY("ShmemHugePages", shmem_huge_pages),
+        MEMINFO_KEY("ShmemPmdMapped", shmem_pmd_mapped),
+        MEMINFO_KEY("FileHugePages", file_huge_pages),
+        MEMINFO_KEY("FilePmdMapped", file_pmd_mapped),
+        MEMINFO_KEY("CmaTotal", cma_total),
+        MEMINFO_KEY("CmaFree", cma_free),
+        MEMINFO_KEY("Unaccepted", unaccepted),
+        MEMINFO_KEY("Balloon", balloon),
+        MEMINFO_KEY("HugePages_Total", hugepages_total),
+        MEMINFO_KEY("HugePages_Free", hugepages_free),
+        MEMINFO_KEY("HugePages_Rsvd", hugepages_rsvd),
+        MEMINFO_KEY("HugePages_Surp", hugepages_surp),
+        MEMINFO_KEY("Hugepagesize", hugepagesize),
+        MEMINFO_KEY("Hugetlb", hugetlb),
+        MEMINFO_KEY("DirectMap4k", direct_map_4k),
+        MEMINFO_KEY("DirectMap2M", direct_map_2m),
+        MEMINFO_KEY("DirectMap4M", direct_map_4m),
+        MEMINFO_KEY("DirectMap1G", direct_map_1g),
+};
+
+#define MEMINFO_KEY_COUNT (sizeof(meminfo_keys) / sizeof(meminfo_keys[0]))
+
+
+static uint8_t meminfo_lookup(const char *key, size_t len)
+{
+        for (size_t k = 0; k < MEMINFO_KEY_COUNT; k++) {
+                if (meminfo_keys[k].len == len && memcmp(meminfo_keys[k].key, key, len) == 0) return (uint8_t)k;
         }
+        return SL_MEMINFO_UNKNOWN;
+}
 
-        memset(result, 0, sizeof(sl_mem_info_t));
 
-        char line[MEMINFO_LINE_SIZE]; 
+/*
+ * Known layout: each line must still start with the key learned for it.
+ * Lines are found with memchr and only known ones are parsed. Returns 1
+ * if the file no longer matches the layout.
+ */
+static int meminfo_parse_known(const char *buf, size_t len, const sl_meminfo_layout_t *layout, sl_mem_ext_t *result)
+{
+        const char *end = buf + len;
+        const char *line = (len > 0) ? buf : NULL;
+
+        for (int i = 0; i < layout->lines; i++) {
+                if (!line) return 1;
+
+                uint8_t k = layout->key[i];
+                if (k == SL_MEMINFO_UNKNOWN) {
+                        result->unknown++;
+                } else {
+                        const meminfo_key_t *key = &meminfo_keys[k];
+                        if (strncmp(line, key->key, key->len) != 0 || line[key->len] != ':') return 1;
+                        if (!sl_parse_u64(line + key->len + 1, (uint64_t *)((char *)result + key->offset))) return 1;
+                }
+                line = sl_next_line(line, end);
+        }
 
-        while(fgets(line, sizeof(line), fptr) != NULL) {
-                parse_meminfo_line(line, result);
+        return line ? 1 : 0;
+}
+
+
+int sl_parse_meminfo_ext(const char *buf, size_t len, sl_meminfo_layout_t *layout, sl_mem_ext_t *result)
+{
+        memset(result, 0, sizeof(*result));
+        if (layout->lines > 0 && meminfo_parse_known(buf, len, layout, result) == 0) {
+                return 0;
         }
 
-        fclose(fptr);
+        /* First read or changed layout: match every key and remember where it was */
+        memset(result, 0, sizeof(*result));
+        const char *end = buf + len;
+        int lines = 0;
 
+        for (const char *line = (len > 0) ? buf : NULL; line; line = sl_next_line(line, end), lines++) {
+                const char *colon = memchr(line, ':', (size_t)(end - line));
+                uint8_t k = colon ? meminfo_lookup(line, (size_t)(colon - line)) : SL_MEMINFO_UNKNOWN;
 
-        if (sl_mem_calculate(result) != 0) {
-                sl_log(SL_LOG_ERROR, __func__, "failed to calculate memory usage");
-                return -1;
+                if (k == SL_MEMINFO_UNKNOWN || !sl_parse_u64(colon + 1, (uint64_t *)((char *)result + meminfo_keys[k].offset))) {
+                        k = SL_MEMINFO_UNKNOWN;
+                        result->unknown++;
+                }
+                if (lines < SL_MEMINFO_MAX_LINES) layout->key[lines] = k;
         }
 
+        /* Too long to cache; every read takes this path */
+        layout->lines = (lines <= SL_MEMINFO_MAX_LINES) ? lines : 0;
+
+        if (result->mem_total == 0) {
+                sl_log(SL_LOG_ERROR, __func__, "MemTotal missing from meminfo");
+                return -1;
+        }
         return 0;
 }
 
 
-int sl_storage_get_info(const char *path, sl_storage_info_t *result)
-{       
+int sl_mem_get_ext(sl_mem_ext_t *result)
+{
         if (!result) {
                 sl_log(SL_LOG_ERROR, __func__, "result pointer is NULL");
                 return -1;
         }
 
+        sl_sampler_t sampler;
+        sl_sampler_init(&sampler, NULL);
+        int ret = sl_sampler_mem_get_ext(&sampler, result);
+        sl_sampler_fini(&sampler);
+
+        return ret;
+}
+
+
+void sl_storage_derive(sl_storage_info_t *result)
+{
+        result->used = result->total - result->free;
+
+        if (result->total == 0) {
+                result->percent_usage = 0.0;
+        } else {
+                result->percent_usage = ((double)result->used / result->total) * 100.0;
+        }
+}
+
+
+int sl_storage_stat(const char *path, sl_storage_info_t *result)
+{
         struct statvfs svfs;
 
         if (statvfs(path, &svfs) == -1) {
-                sl_log(SL_LOG_ERROR, __func__, "failed to get filesystem info for %s", path);
-                return -1;
+                return errno;
         }
 
         uint64_t block_size = svfs.f_frsize;
@@ -337,14 +1083,23 @@ int sl_storage_get_info(const char *path, sl_storage_info_t *result)
         result->total = (uint64_t)svfs.f_blocks * block_size;
         result->free = (uint64_t)svfs.f_bfree * block_size;
         result->available = (uint64_t)svfs.f_bavail * block_size;
-        
-        result->used = result->total - result->free;
+        sl_storage_derive(result);
 
-        if (result->total == 0) {
-                result->percent_usage = 0.0;
-        } else {
-        result->percent_usage = ((double)result->used / result->total) * 100.0;
-        }
-        
         return 0; 
 }
+
+
+int sl_storage_get_info(const char *path, sl_storage_info_t *result)
+{       
+        if (!result) {
+                sl_log(SL_LOG_ERROR, __func__, "result pointer is NULL");
+                return -1;
+        }
+
+        if (!path || sl_storage_stat(path, result) != 0) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to get filesystem info for %s", path ? path : "(null)");
+                return -1;
+        }
+
+        return 0;
+}
@@ -0,0 +1,222 @@
+#ifndef SYSLOAD_INTERNAL_H
+#define SYSLOAD_INTERNAL_H
+
+#include "sysload.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Symbols shared between library translation units but not exported */
+#define SL_INTERNAL __attribute__((visibility("hidden")))
+
+#define SL_PATH_SIZE 256
+#define SL_ROOT_SIZE 192    /* leaves room in SL_PATH_SIZE for the relative path */
+#define SL_PROCFILE_INIT_SIZE 4096
+
+/* ============================================================= */
+/*                     PERSISTENT FILE HANDLES                   */
+/* ============================================================= */
+
+/* A /proc file kept open and re-read from offset 0 with pread() */
+typedef struct
+{
+        int fd;                     /**< Open descriptor, -1 until first read */
+        char *buf;                  /**< Read buffer, grown on demand, NUL-terminated */
+        size_t cap;                 /**< Allocated size of buf */
+        size_t len;                 /**< Bytes returned by the last read */
+        char path[SL_PATH_SIZE];    /**< Absolute path of the file */
+} sl_procfile_t;
+
+#define SL_NET_MAX_NAMES 128
+
+/*
+ * Interface names seen by one sampler. Each name gets a small id so
+ * snapshots can be matched with integer compares; the tag changes when
+ * the table is reset, invalidating ids handed out before.
+ */
+typedef struct
+{
+        char names[SL_NET_MAX_NAMES][SL_NET_NAME_SIZE];
+        uint32_t hashes[SL_NET_MAX_NAMES];
+        int count;
+        uint64_t tag;
+} sl_net_names_t;
+
+/* Which sl_mem_ext_t field each /proc/meminfo line holds, learned on first read */
+#define SL_MEMINFO_MAX_LINES 96
+#define SL_MEMINFO_UNKNOWN 0xFF
+
+typedef struct
+{
+        int lines;                                  /**< Lines learned, 0 until the first read */
+        uint8_t key[SL_MEMINFO_MAX_LINES];          /**< Index into the key table, or SL_MEMINFO_UNKNOWN */
+} sl_meminfo_layout_t;
+
+/* io_uring instance used to batch procfile reads (opaque, see uring.c) */
+typedef struct sl_uring sl_uring_t;
+
+/* Timeout-bounded statvfs() worker pool (opaque, see statpool.c) */
+typedef struct sl_statvfs_pool sl_statvfs_pool_t;
+
+/* Sampler context: one persistent handle per /proc file */
+struct sl_sampler
+{
+        char proc_root[SL_ROOT_SIZE];
+        sl_procfile_t stat;
+        sl_procfile_t meminfo;
+        sl_meminfo_layout_t meminfo_layout;
+        sl_procfile_t uptime;
+        sl_procfile_t diskstats;
+        sl_procfile_t net_dev;
+        sl_net_names_t net_names;
+        sl_procfile_t pressure[SL_PSI_RESOURCES];
+        sl_procfile_t loadavg;
+        sl_uring_t *uring;          /**< Created by the first io_uring snapshot after files are open */
+        int uring_unavailable;      /**< Set if io_uring could not be set up; pread is used */
+};
+
+/* CLOCK_MONOTONIC timestamp in nanoseconds */
+static inline uint64_t sl_now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+SL_INTERNAL void sl_log(sl_log_level_t level, const char *func, const char *fmt, ...);
+
+/* Copy the library-wide procfs/sysfs root into buf (SL_ROOT_SIZE bytes); returns buf */
+SL_INTERNAL const char *sl_proc_root(char *buf);
+SL_INTERNAL const char *sl_sys_root(char *buf);
+
+SL_INTERNAL void sl_procfile_init(sl_procfile_t *file, const char *root, const char *name);
+SL_INTERNAL int sl_procfile_read(sl_procfile_t *file);
+SL_INTERNAL void sl_procfile_close(sl_procfile_t *file);
+
+/* Kernel layout of entries returned by getdents64 */
+struct sl_dirent64
+{
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+};
+
+/* Raw directory listing without opendir()'s per-DIR allocation */
+static inline long sl_getdents64(int fd, char *buf, size_t size)
+{
+        return syscall(SYS_getdents64, fd, buf, size);
+}
+
+/* statvfs() a path into result; 0 or an errno value, does not log */
+SL_INTERNAL int sl_storage_stat(const char *path, sl_storage_info_t *result);
+
+/* Fill used and percent_usage from total and free */
+SL_INTERNAL void sl_storage_derive(sl_storage_info_t *result);
+
+/*
+ * Submit a pread from offset 0 into each open file's buffer with one
+ * io_uring_enter(). results[i] receives the byte count or -errno; the
+ * caller finishes files whose read failed or filled the buffer. NULL or
+ * -1 if io_uring is unavailable (not built in, old kernel, seccomp); a
+ * failed read waits for the reads already submitted, and returns -2 if
+ * even that failed, leaving them free to write into the buffers later.
+ * After a failure the ring still holds unsubmitted entries; destroy it.
+ */
+SL_INTERNAL sl_uring_t *sl_uring_create(unsigned entries);
+SL_INTERNAL void sl_uring_destroy(sl_uring_t *ring);
+SL_INTERNAL int sl_uring_read(sl_uring_t *ring, sl_procfile_t *const *files, int count, long *results);
+
+/*
+ * Pool of detached threads running statvfs() (see statpool.c). Paths are
+ * queued with add(), which returns the job index (-1 on allocation failure,
+ * dropping the queue); run() posts them and waits up to timeout_ms (0 or
+ * less: no limit), and result() then gives each job's errno, ETIMEDOUT if
+ * it did not finish. Workers stuck on a hung mount outlive release().
+ */
+SL_INTERNAL sl_statvfs_pool_t *sl_statvfs_pool_create(int threads);
+SL_INTERNAL void sl_statvfs_pool_release(sl_statvfs_pool_t *pool);
+SL_INTERNAL int sl_statvfs_pool_add(sl_statvfs_pool_t *pool, const char *path);
+SL_INTERNAL void sl_statvfs_pool_run(sl_statvfs_pool_t *pool, int timeout_ms);
+SL_INTERNAL int sl_statvfs_pool_result(const sl_statvfs_pool_t *pool, int index, sl_storage_info_t *info);
+
+SL_INTERNAL void sl_sampler_init(sl_sampler_t *sampler, const char *proc_root);
+SL_INTERNAL void sl_sampler_fini(sl_sampler_t *sampler);
+
+/* ============================================================= */
+/*                         BUFFER PARSERS                        */
+/* ============================================================= */
+
+/*
+ * Parsers work on NUL-terminated buffers filled by sl_procfile_read(),
+ * so scanning can stop at '\0' without separate bounds checks.
+ */
+
+/* Skip spaces and tabs */
+static inline const char *sl_skip_blanks(const char *p)
+{
+        while (*p == ' ' || *p == '\t') p++;
+        return p;
+}
+
+/* Parse an unsigned decimal after optional blanks; NULL if there is no digit */
+static inline const char *sl_parse_u64(const char *p, uint64_t *value)
+{
+        p = sl_skip_blanks(p);
+        if ((unsigned)(*p - '0') > 9) return NULL;
+
+        uint64_t v = 0;
+        do {
+                v = v * 10 + (uint64_t)(*p - '0');
+                p++;
+        } while ((unsigned)(*p - '0') <= 9);
+
+        *value = v;
+        return p;
+}
+
+/* Parse a non-negative decimal with optional fraction ("123.45") */
+static inline const char *sl_parse_udouble(const char *p, double *value)
+{
+        uint64_t whole;
+        p = sl_parse_u64(p, &whole);
+        if (!p) return NULL;
+
+        double v = (double)whole;
+        if (*p == '.') {
+                double scale = 0.1;
+                for (p++; (unsigned)(*p - '0') <= 9; p++) {
+                        v += (*p - '0') * scale;
+                        scale *= 0.1;
+                }
+        }
+
+        *value = v;
+        return p;
+}
+
+/* Start of the line after p, or NULL at end of buffer */
+static inline const char *sl_next_line(const char *p, const char *end)
+{
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        return (nl && nl + 1 < end) ? nl + 1 : NULL;
+}
+
+SL_INTERNAL int sl_parse_cpu_raw(const char *buf, size_t len, sl_cpu_raw_t *snapshot);
+SL_INTERNAL int sl_parse_cpu_cores(const char *buf, size_t len, sl_cpu_cores_t *snapshot);
+SL_INTERNAL int sl_parse_meminfo(const char *buf, size_t len, sl_mem_info_t *result);
+SL_INTERNAL int sl_parse_meminfo_ext(const char *buf, size_t len, sl_meminfo_layout_t *layout, sl_mem_ext_t *result);
+SL_INTERNAL int sl_parse_uptime(const char *buf, size_t len, sl_systime_info_t *result);
+SL_INTERNAL int sl_parse_diskstats(const char *buf, size_t len, unsigned flags, sl_disk_raw_t *snapshot);
+SL_INTERNAL void sl_net_names_reset(sl_net_names_t *names);
+SL_INTERNAL int sl_parse_net_dev(const char *buf, size_t len, sl_net_names_t *names, sl_net_raw_t *snapshot);
+SL_INTERNAL extern const char *const sl_psi_names[SL_PSI_RESOURCES];
+SL_INTERNAL int sl_parse_pressure(const char *buf, size_t len, sl_psi_raw_t *raw);
+SL_INTERNAL int sl_parse_loadavg(const char *buf, size_t len, sl_loadavg_t *result);
+SL_INTERNAL int sl_parse_pid_stat(const char *buf, size_t len, sl_proc_raw_t *raw);
+
+#endif
@@ -0,0 +1,179 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef SL_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+/*
+ * Just enough io_uring to submit a handful of reads with one
+ * io_uring_enter(): raw syscalls, no SQPOLL, no registered files.
+ * Rings are shared with the kernel, so head/tail use acquire/release.
+ */
+struct sl_uring
+{
+        int fd;
+        unsigned entries;
+        unsigned *sq_tail, *sq_mask, *sq_array;
+        unsigned *cq_head, *cq_tail, *cq_mask;
+        struct io_uring_sqe *sqes;
+        struct io_uring_cqe *cqes;
+        void *sq_ring, *cq_ring;
+        size_t sq_ring_size, cq_ring_size, sqes_size;
+};
+
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete)
+{
+        return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+
+sl_uring_t *sl_uring_create(unsigned entries)
+{
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) return NULL;
+
+        sl_uring_t *ring = calloc(1, sizeof(*ring));
+        if (!ring) {
+                close(fd);
+                return NULL;
+        }
+
+        ring->fd = fd;
+        ring->entries = params.sq_entries;
+        ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        /* Since 5.4 both rings live in one mapping */
+        int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single && ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+
+        ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        ring->cq_ring = single ? ring->sq_ring :
+                        mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+        if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+                if (ring->sq_ring == MAP_FAILED) ring->sq_ring = NULL;
+                if (ring->cq_ring == MAP_FAILED) ring->cq_ring = NULL;
+                if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+                sl_uring_destroy(ring);
+                return NULL;
+        }
+
+        char *sq = ring->sq_ring, *cq = ring->cq_ring;
+        ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+        ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+        ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+        ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+        ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+        ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+        ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+        return ring;
+}
+
+
+void sl_uring_destroy(sl_uring_t *ring)
+{
+        if (!ring) return;
+
+        if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+        if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+        if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        free(ring);
+}
+
+
+int sl_uring_read(sl_uring_t *ring, sl_procfile_t *const *files, int count, long *results)
+{
+        if (count <= 0 || (unsigned)count > ring->entries) return -1;
+
+        struct iovec iov[count];
+        unsigned tail = *ring->sq_tail;
+        unsigned mask = *ring->sq_mask;
+
+        /* IORING_OP_READV rather than READ: it exists since the first io_uring kernel */
+        for (int i = 0; i < count; i++) {
+                unsigned index = (tail + (unsigned)i) & mask;
+                struct io_uring_sqe *sqe = &ring->sqes[index];
+
+                iov[i].iov_base = files[i]->buf;
+                iov[i].iov_len = files[i]->cap - 1;
+
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_READV;
+                sqe->fd = files[i]->fd;
+                sqe->addr = (uint64_t)(uintptr_t)&iov[i];
+                sqe->len = 1;
+                sqe->off = 0;
+                sqe->user_data = (uint64_t)i;
+                ring->sq_array[index] = index;
+        }
+        __atomic_store_n(ring->sq_tail, tail + (unsigned)count, __ATOMIC_RELEASE);
+
+        /*
+         * If submitting fails part way, the reads already submitted still
+         * target the caller's buffers: wait for them before returning so
+         * the caller can reuse the buffers or tear the ring down.
+         */
+        int submitted = 0, completed = 0, failed = 0;
+        while (completed < (failed ? submitted : count)) {
+                unsigned to_submit = failed ? 0 : (unsigned)(count - submitted);
+                unsigned wanted = (unsigned)((failed ? submitted : count) - completed);
+                int ret = uring_enter(ring->fd, to_submit, wanted);
+                if (ret < 0) {
+                        if (errno == EINTR) continue;
+                        if (failed) return -2;
+                        failed = 1;
+                        continue;
+                }
+                if (!failed) submitted += ret;
+
+                unsigned head = *ring->cq_head;
+                unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+                for (; head != cq_tail; head++) {
+                        const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+                        if (cqe->user_data < (uint64_t)count) {
+                                results[cqe->user_data] = cqe->res;
+                                completed++;
+                        }
+                }
+                __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        return failed ? -1 : 0;
+}
+
+#else
+
+sl_uring_t *sl_uring_create(unsigned entries)
+{
+        (void)entries;
+        errno = ENOSYS;
+        return NULL;
+}
+
+
+void sl_uring_destroy(sl_uring_t *ring)
+{
+        (void)ring;
+}
+
+
+int sl_uring_read(sl_uring_t *ring, sl_procfile_t *const *files, int count, long *results)
+{
+        (void)ring; (void)files; (void)count; (void)results;
+        return -1;
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "sysload_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const vmstat_default_keys[SL_VMSTAT_DEFAULT_KEYS] = {
+        "pgfault", "pgmajfault", "pgpgin", "pgpgout", "pswpin", "pswpout",
+        "pgscan_kswapd", "pgscan_direct", "pgsteal_kswapd", "pgsteal_direct", "oom_kill"
+};
+
+struct sl_vmstat
+{
+        sl_procfile_t file;
+        int count;
+        char keys[SL_VMSTAT_MAX_KEYS][SL_VMSTAT_KEY_SIZE];
+        size_t key_len[SL_VMSTAT_MAX_KEYS];
+        int line[SL_VMSTAT_MAX_KEYS];       /**< Line of each key in /proc/vmstat, -1 if absent */
+        int order[SL_VMSTAT_MAX_KEYS];      /**< Present keys by ascending line */
+        int present_count;
+        uint32_t present;
+};
+
+
+/* Find the line of every selected key; one full scan, at setup or after a layout change */
+static void vmstat_resolve(sl_vmstat_t *vm)
+{
+        const char *end = vm->file.buf + vm->file.len;
+        int line_no = 0;
+
+        for (int k = 0; k < vm->count; k++) vm->line[k] = -1;
+
+        for (const char *line = vm->file.len ? vm->file.buf : NULL; line; line = sl_next_line(line, end), line_no++) {
+                size_t len = strcspn(line, " \n");
+                for (int k = 0; k < vm->count; k++) {
+                        if (vm->line[k] < 0 && vm->key_len[k] == len && memcmp(line, vm->keys[k], len) == 0) {
+                                vm->line[k] = line_no;
+                                break;
+                        }
+                }
+        }
+
+        /* Insertion sort by line; at most SL_VMSTAT_MAX_KEYS entries */
+        vm->present_count = 0;
+        vm->present = 0;
+        for (int k = 0; k < vm->count; k++) {
+                if (vm->line[k] < 0) continue;
+                int i = vm->present_count++;
+                while (i > 0 && vm->line[vm->order[i - 1]] > vm->line[k]) {
+                        vm->order[i] = vm->order[i - 1];
+                        i--;
+                }
+                vm->order[i] = k;
+                vm->present |= 1u << k;
+        }
+}
+
+
+/*
+ * Parse only the lines found by vmstat_resolve(): skip to each one with
+ * memchr and check the key is still there. Returns 1 if a key moved.
+ */
+static int vmstat_extract(const sl_vmstat_t *vm, sl_vmstat_raw_t *raw)
+{
+        const char *end = vm->file.buf + vm->file.len;
+        const char *line = vm->file.len ? vm->file.buf : NULL;
+        int line_no = 0;
+
+        for (int i = 0; i < vm->present_count; i++) {
+                int k = vm->order[i];
+                while (line && line_no < vm->line[k]) {
+                        line = sl_next_line(line, end);
+                        line_no++;
+                }
+
+                if (!line || memcmp(line, vm->keys[k], vm->key_len[k]) != 0 || line[vm->key_len[k]] != ' ') return 1;
+                if (!sl_parse_u64(line + vm->key_len[k], &raw->values[k])) return 1;
+        }
+
+        return 0;
+}
+
+
+sl_vmstat_t *sl_vmstat_create(const char *const *keys, int key_count)
+{
+        if (!keys) {
+                keys = vmstat_default_keys;
+                key_count = SL_VMSTAT_DEFAULT_KEYS;
+        }
+
+        if (key_count <= 0 || key_count > SL_VMSTAT_MAX_KEYS) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid key count %d (1 to %d)", key_count, SL_VMSTAT_MAX_KEYS);
+                return NULL;
+        }
+
+        sl_vmstat_t *vm = calloc(1, sizeof(*vm));
+        if (!vm) {
+                sl_log(SL_LOG_ERROR, __func__, "failed to allocate collector");
+                return NULL;
+        }
+
+        for (int k = 0; k < key_count; k++) {
+                size_t len = keys[k] ? strlen(keys[k]) : 0;
+                if (len == 0 || len >= SL_VMSTAT_KEY_SIZE || strpbrk(keys[k], " \n")) {
+                        sl_log(SL_LOG_ERROR, __func__, "invalid key \"%s\"", keys[k] ? keys[k] : "(null)");
+                        free(vm);
+                        return NULL;
+                }
+                /* Each line resolves to one key, so a repeated key would never be found */
+                for (int j = 0; j < k; j++) {
+                        if (vm->key_len[j] == len && memcmp(vm->keys[j], keys[k], len) == 0) {
+                                sl_log(SL_LOG_ERROR, __func__, "duplicate key \"%s\"", keys[k]);
+                                free(vm);
+                                return NULL;
+                        }
+                }
+                memcpy(vm->keys[k], keys[k], len + 1);
+                vm->key_len[k] = len;
+        }
+        vm->count = key_count;
+
+        char root[SL_ROOT_SIZE];
+        sl_procfile_init(&vm->file, sl_proc_root(root), "vmstat");
+        if (sl_procfile_read(&vm->file) != 0) {
+                sl_vmstat_destroy(vm);
+                return NULL;
+        }
+
+        vmstat_resolve(vm);
+        for (int k = 0; k < vm->count; k++) {
+                if (vm->line[k] < 0) sl_log(SL_LOG_INFO, __func__, "%s not in %s, reported as 0", vm->keys[k], vm->file.path);
+        }
+
+        return vm;
+}
+
+
+void sl_vmstat_destroy(sl_vmstat_t *vmstat)
+{
+        if (!vmstat) return;
+
+        sl_procfile_close(&vmstat->file);
+        free(vmstat);
+}
+
+
+const char *sl_vmstat_key(const sl_vmstat_t *vmstat, int index)
+{
+        if (!vmstat || index < 0 || index >= vmstat->count) return NULL;
+        return vmstat->keys[index];
+}
+
+
+int sl_vmstat_get_raw(sl_vmstat_t *vmstat, sl_vmstat_raw_t *raw)
+{
+        if (!vmstat || !raw) {
+                sl_log(SL_LOG_ERROR, __func__, "vmstat or raw pointer is NULL");
+                return -1;
+        }
+
+        if (sl_procfile_read(&vmstat->file) != 0) {
+                return -1;
+        }
+
+        memset(raw->values, 0, sizeof(raw->values));
+        if (vmstat_extract(vmstat, raw) != 0) {
+                vmstat_resolve(vmstat);
+                memset(raw->values, 0, sizeof(raw->values));
+                if (vmstat_extract(vmstat, raw) != 0) {
+                        sl_log(SL_LOG_ERROR, __func__, "failed to parse %s", vmstat->file.path);
+                        return -1;
+                }
+        }
+
+        raw->present = vmstat->present;
+        raw->count = vmstat->count;
+        raw->timestamp_ns = sl_now_ns();
+        return 0;
+}
+
+
+int sl_vmstat_calculate(const sl_vmstat_raw_t *start, const sl_vmstat_raw_t *end, sl_vmstat_rates_t *result)
+{
+        if (!start || !end || !result) {
+                sl_log(SL_LOG_ERROR, __func__, "start, end or result pointer is NULL");
+                return -1;
+        }
+
+        if (start->count != end->count || end->count < 0 || end->count > SL_VMSTAT_MAX_KEYS) {
+                sl_log(SL_LOG_ERROR, __func__, "snapshots are from different key sets");
+                return -1;
+        }
+
+        if (end->timestamp_ns <= start->timestamp_ns) {
+                sl_log(SL_LOG_ERROR, __func__, "invalid time interval");
+                return -1;
+        }
+
+        double elapsed = (double)(end->timestamp_ns - start->timestamp_ns) / 1e9;
+        for (int k = 0; k < end->count; k++) {
+                uint64_t s = start->values[k], e = end->values[k];
+                result->per_sec[k] = (e >= s) ? (double)(e - s) / elapsed : 0.0;
+        }
+        result->count = end->count;
+        return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef SYSLOAD_TEST_COMMON_H
+#define SYSLOAD_TEST_COMMON_H
+
+#include <stdio.h>
+
+static int total = 0, passed = 0;
+
+#define OK      "[ \033[32m OK \033[0m ]"
+#define FAIL    "[ \033[31mFAIL\033[0m ]"
+
+
+#define TEST_EQ(expr, expected) do { \
+        total++; \
+        int _r = (expr); \
+        if (_r == (expected)) { \
+                printf(OK " %s returned %d\n", #expr, _r); \
+                passed++; \
+        } else { \
+                fprintf(stderr, FAIL " %s returned %d (expected %d)\n", #expr, _r, expected); \
+        } \
+} while(0)
+
+#define TEST_RANGE(value, min, max) do { \
+        total++; \
+        if ((value) >= (min) && (value) <= (max)) { \
+                printf(OK " %s = %.2f (in range)\n", #value, (double)(value)); \
+                passed++; \
+        } else { \
+                fprintf(stderr, FAIL " %s = %.2f (out of range %.2f..%.2f)\n", #value, (double)(value), (double)(min), (double)(max)); \
+        } \
+} while(0)
+
+
+#define TEST_SUMMARY() do { \
+        printf("\n--- Summary ---\n"); \
+        printf("Passed: %d / %d\n", passed, total); \
+        printf("Result: %s\n", (passed == total) ? "\033[32mSUCCESS\033[0m" : "\033[31mFAIL\033[0m"); \
+} while(0)
+
+#endif
@@ -0,0 +1,869 @@
+#include "sysload.h"
+#include "test_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Recorded /proc trees under tests/fixtures, from a laptop up to a 256-core server */
+typedef struct
+{
+        const char *name;
+        int cores;              /**< Slots expected in the per-core snapshot */
+        int online;             /**< cpuN lines present */
+        uint64_t mem_total;     /**< MemTotal in KB */
+        double uptime_min;
+        double uptime_max;
+        int disks;              /**< Whole physical disks in diskstats */
+        int disks_all;          /**< Lines in diskstats */
+        int ifaces;             /**< Interfaces in net/dev */
+        int cpu_full;           /**< pressure/cpu has a "full" line */
+        double load1;
+} fixture_t;
+
+static const fixture_t fixtures[] = {
+        {"laptop-2core",          2,   2,   8388608ULL,   958774.0,  958774.2,  3, 7, 4, 1, 0.82},
+        {"laptop-4core-offline",  4,   3,   16777216ULL,  3970229.3, 3970229.4, 1, 3, 2, 0, 0.10},
+        {"server-32core",         32,  32,  134217728ULL, 1308921.2, 1308921.3, 4, 6, 4, 1, 28.44},
+        {"server-256core",        256, 256, 1073741824ULL, 8211549.3, 8211549.4, 4, 7, 3, 1, 240.12},
+};
+
+
+static void fixture_path(char *buf, size_t size, const char *name)
+{
+        snprintf(buf, size, "%s/%s/proc", SYSLOAD_FIXTURE_DIR, name);
+}
+
+
+static void test_fixture(const fixture_t *f)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), f->name);
+        printf("\n--- %s ---\n", f->name);
+
+        sl_sampler_t *sampler = sl_sampler_create_at(root);
+        TEST_EQ(sampler != NULL, 1);
+        if (!sampler) return;
+
+        sl_cpu_cores_t cores;
+        TEST_EQ(sl_cpu_cores_init(&cores, 1), 0);
+        TEST_EQ(sl_sampler_cpu_get_raw_cores(sampler, &cores), 0);
+        TEST_EQ(cores.count, f->cores);
+
+        int online = 0;
+        uint64_t user_sum = 0;
+        for (int i = 0; i < cores.count; i++) {
+                online += cores.online[i] ? 1 : 0;
+                user_sum += cores.online[i] ? cores.cores[i].user : 0;
+        }
+        TEST_EQ(online, f->online);
+        if (online == f->cores) {
+                /* Recorded aggregate line is the sum of all cores */
+                TEST_EQ(user_sum == cores.total.user, 1);
+        }
+
+        sl_cpu_raw_t raw;
+        TEST_EQ(sl_sampler_cpu_get_raw(sampler, &raw), 0);
+        TEST_EQ(memcmp(&raw, &cores.total, sizeof(raw)), 0);
+
+        sl_cpu_usage_t usage[256];
+        TEST_EQ(sl_cpu_calculate_cores(&cores, &cores, usage, 256), f->cores);
+        sl_cpu_cores_free(&cores);
+
+        sl_mem_info_t mem;
+        TEST_EQ(sl_sampler_mem_get_info(sampler, &mem), 0);
+        TEST_EQ(mem.total == f->mem_total, 1);
+        TEST_EQ(mem.used == mem.total - mem.available, 1);
+        TEST_EQ(mem.swap_total > 0 && mem.swap_used == mem.swap_total - mem.swap_free, 1);
+
+        /* Second read goes through the cached line layout and must agree with the first */
+        sl_mem_ext_t ext, ext_cached;
+        TEST_EQ(sl_sampler_mem_get_ext(sampler, &ext), 0);
+        TEST_EQ(sl_sampler_mem_get_ext(sampler, &ext_cached), 0);
+        TEST_EQ(memcmp(&ext, &ext_cached, sizeof(ext)), 0);
+        TEST_EQ(ext.mem_total == mem.total && ext.mem_available == mem.available, 1);
+        TEST_EQ(ext.swap_total == mem.swap_total && ext.swap_free == mem.swap_free, 1);
+
+        sl_systime_info_t systime;
+        TEST_EQ(sl_sampler_systime_get_info(sampler, &systime), 0);
+        TEST_RANGE(systime.uptime, f->uptime_min, f->uptime_max);
+
+        /* Files are open now, so the io_uring batch (or its pread fallback) reads the same bytes */
+        static sl_snapshot_t snapshot;
+        TEST_EQ(sl_sampler_snapshot_collect(sampler, SL_SNAPSHOT_CPU | SL_SNAPSHOT_MEM | SL_SNAPSHOT_SYSTIME | SL_SNAPSHOT_IO_URING,
+                                            NULL, 0, &snapshot), 0);
+        TEST_EQ(memcmp(&snapshot.cpu, &raw, sizeof(raw)), 0);
+        TEST_EQ(memcmp(&snapshot.mem, &mem, sizeof(mem)), 0);
+        TEST_EQ(snapshot.systime.uptime == systime.uptime, 1);
+
+        static sl_disk_raw_t disks;
+        TEST_EQ(sl_sampler_disk_get_raw(sampler, &disks, 0), 0);
+        TEST_EQ(disks.count, f->disks);
+        TEST_EQ(sl_sampler_disk_get_raw(sampler, &disks, SL_DISK_INCLUDE_PARTITIONS | SL_DISK_INCLUDE_VIRTUAL), 0);
+        TEST_EQ(disks.count, f->disks_all);
+
+        static sl_net_raw_t net;
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &net), 0);
+        TEST_EQ(net.count, f->ifaces);
+        TEST_EQ(strcmp(net.ifaces[0].name, "lo"), 0);
+
+        sl_psi_raw_t psi;
+        for (int r = 0; r < SL_PSI_RESOURCES; r++) {
+                TEST_EQ(sl_sampler_psi_get_raw(sampler, (sl_psi_resource_t)r, &psi), 0);
+        }
+        TEST_EQ(sl_sampler_psi_get_raw(sampler, SL_PSI_CPU, &psi), 0);
+        TEST_EQ(psi.has_full, f->cpu_full);
+
+        sl_loadavg_t load;
+        TEST_EQ(sl_sampler_loadavg_get_info(sampler, &load), 0);
+        TEST_RANGE(load.load1, f->load1 - 0.001, f->load1 + 0.001);
+        TEST_EQ(load.running >= 1 && load.running <= load.total, 1);
+
+        sl_sampler_destroy(sampler);
+}
+
+
+static void test_global_root(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "server-32core");
+        printf("\n--- library-wide root ---\n");
+
+        sl_mem_info_t mem;
+        TEST_EQ(sl_set_proc_root(root), 0);
+        TEST_EQ(sl_mem_get_info(&mem), 0);
+        TEST_EQ(mem.total == 134217728ULL, 1);
+
+        sl_sampler_t *sampler = sl_sampler_create();
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+        TEST_EQ(sl_sampler_mem_get_info(sampler, &mem), 0);
+        TEST_EQ(mem.total == 134217728ULL, 1);
+        sl_sampler_destroy(sampler);
+
+        TEST_EQ(sl_mem_get_info(&mem), 0);
+        TEST_EQ(mem.total != 134217728ULL, 1);
+        TEST_EQ(sl_set_proc_root(""), -1);
+}
+
+
+/* Subscriber fallback over a recorded tree: the counters never move, so CPU is never fresh */
+static void test_subscriber(void)
+{
+        char root[512], name[SL_SHARED_NAME_SIZE];
+        fixture_path(root, sizeof(root), "server-32core");
+        snprintf(name, sizeof(name), "/sysload-fixture-%d", (int)getpid());
+        printf("\n--- subscriber fallback ---\n");
+
+        TEST_EQ(sl_set_proc_root(root), 0);
+        sl_subscriber_t *subscriber = sl_subscriber_create(name, 1.0f, NULL, 0);
+        TEST_EQ(subscriber != NULL, 1);
+
+        sl_monitor_snapshot_t snap;
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 1);
+        TEST_EQ(snap.collected & (SL_SNAPSHOT_CPU | SL_SNAPSHOT_MEM), SL_SNAPSHOT_MEM);
+        TEST_EQ(snap.mem.total == 134217728ULL, 1);
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 1);
+        TEST_EQ(snap.collected & SL_SNAPSHOT_CPU, 0);
+
+        sl_subscriber_destroy(subscriber);
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+}
+
+
+/* Scheduler over a recorded tree: the CPU counters never move, so no run gets a new usage */
+static void record_sched_status(const sl_sched_result_t *result, void *user_data)
+{
+        *(int *)user_data = result->status;
+}
+
+
+static void test_sched(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "server-32core");
+        printf("\n--- scheduler ---\n");
+
+        TEST_EQ(sl_set_proc_root(root), 0);
+        sl_sched_t *sched = sl_sched_create();
+        TEST_EQ(sched != NULL, 1);
+
+        int cpu_status = -2, mem_status = -2;
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_CPU, NULL, 0.005f, record_sched_status, &cpu_status) >= 0, 1);
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_MEM, NULL, 0.005f, record_sched_status, &mem_status) >= 0, 1);
+        TEST_EQ(sl_sched_run(sched, 100), 2);
+        TEST_EQ(cpu_status == 1 && mem_status == 0, 1);
+
+        sl_sched_destroy(sched);
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+}
+
+
+static void test_hotplug(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "laptop-4core-offline");
+        printf("\n--- hotplug ---\n");
+
+        sl_sampler_t *sampler = sl_sampler_create_at(root);
+        sl_cpu_raw_t cores_buf[2];
+        uint8_t online_buf[2];
+        sl_cpu_cores_t cores;
+
+        /* Caller-provided arrays are never grown */
+        sl_cpu_cores_init_with(&cores, cores_buf, online_buf, 2);
+        TEST_EQ(sl_sampler_cpu_get_raw_cores(sampler, &cores), -1);
+
+        TEST_EQ(sl_cpu_cores_init(&cores, 4), 0);
+        TEST_EQ(sl_sampler_cpu_get_raw_cores(sampler, &cores), 0);
+        TEST_EQ(cores.online[2], 0);
+        TEST_EQ(cores.online[3], 1);
+        sl_cpu_cores_free(&cores);
+        sl_sampler_destroy(sampler);
+}
+
+
+static void test_process(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "laptop-2core");
+        printf("\n--- process ---\n");
+
+        sl_proc_sampler_t *procs = sl_proc_sampler_create_at(root);
+        sl_proc_raw_t raw, threads[4];
+        TEST_EQ(procs != NULL, 1);
+        if (!procs) return;
+
+        TEST_EQ(sl_proc_get_raw(procs, 1234, &raw), 0);
+        TEST_EQ(strcmp(raw.comm, "my worker"), 0);
+        TEST_EQ(raw.utime == 750 && raw.stime == 250 && raw.num_threads == 2, 1);
+        TEST_EQ(raw.rss == 3000ULL * (uint64_t)sysconf(_SC_PAGESIZE), 1);
+        TEST_EQ(raw.read_bytes == 40960 && raw.write_bytes == 8192, 1);
+        TEST_EQ(sl_proc_get_threads(procs, 1234, threads, 4), 2);
+        TEST_EQ(sl_proc_get_raw(procs, 4321, &raw), -1);
+        sl_proc_sampler_destroy(procs);
+
+        sl_proc_top_t *top = sl_proc_top_create(root, 64, 4, SL_PROC_TOP_RSS);
+        sl_proc_top_entry_t entries[4];
+        TEST_EQ(sl_proc_top_refresh(top, entries, 4), 2);
+        sl_proc_top_destroy(top);
+}
+
+
+static void test_disk(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "laptop-2core");
+        printf("\n--- diskstats ---\n");
+
+        sl_sampler_t *sampler = sl_sampler_create_at(root);
+        static sl_disk_raw_t start, end;
+
+        TEST_EQ(sl_sampler_disk_get_raw(sampler, &start, SL_DISK_INCLUDE_PARTITIONS), 0);
+        TEST_EQ(start.count, 5);
+        TEST_EQ(strcmp(start.devices[0].name, "nvme0n1"), 0);
+        TEST_EQ(strcmp(start.devices[2].name, "nvme0n1p2"), 0);
+        TEST_EQ(start.devices[0].major == 259 && start.devices[0].minor == 0, 1);
+        TEST_EQ(start.devices[0].sectors_written == 51207744ULL, 1);
+        TEST_EQ(start.devices[0].weighted_io_time_ms == 1654220ULL, 1);
+        sl_sampler_destroy(sampler);
+
+        /* One second later: 100 reads of 8 sectors taking 200 ms, 50 writes taking 50 ms, busy 250 ms */
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 1000000000ULL;
+        end.devices[0].reads_completed += 100;
+        end.devices[0].sectors_read += 800;
+        end.devices[0].read_time_ms += 200;
+        end.devices[0].writes_completed += 50;
+        end.devices[0].write_time_ms += 50;
+        end.devices[0].io_time_ms += 250;
+
+        /* Reordered devices are still matched by major:minor */
+        sl_disk_dev_raw_t tmp = end.devices[1];
+        end.devices[1] = end.devices[4];
+        end.devices[4] = tmp;
+
+        sl_disk_usage_t usage[SL_DISK_MAX_DEVICES];
+        TEST_EQ(sl_disk_calculate(&start, &end, usage, SL_DISK_MAX_DEVICES), 5);
+        TEST_RANGE(usage[0].read_iops, 99.9, 100.1);
+        TEST_RANGE(usage[0].write_iops, 49.9, 50.1);
+        TEST_RANGE(usage[0].read_bytes_per_sec, 409599.0, 409601.0);
+        TEST_RANGE(usage[0].read_await_ms, 1.99, 2.01);
+        TEST_RANGE(usage[0].write_await_ms, 0.99, 1.01);
+        TEST_RANGE(usage[0].await_ms, 1.66, 1.67);
+        TEST_RANGE(usage[0].utilization, 24.9, 25.1);
+        TEST_RANGE(usage[1].utilization, 0.0, 0.0);
+
+        TEST_EQ(sl_disk_calculate(&start, &end, usage, 2), 2);
+        TEST_EQ(sl_disk_calculate(&end, &start, usage, SL_DISK_MAX_DEVICES), -1);
+}
+
+
+static void test_net(void)
+{
+        char root[512];
+        printf("\n--- net/dev ---\n");
+
+        static sl_net_raw_t start, end, other;
+        sl_net_usage_t usage[SL_NET_MAX_IFACES];
+
+        fixture_path(root, sizeof(root), "laptop-2core");
+        sl_sampler_t *sampler = sl_sampler_create_at(root);
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &start), 0);
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &end), 0);
+        TEST_EQ(strcmp(start.ifaces[3].name, "veth9f1c2a7b3d0"), 0);
+        TEST_EQ(start.ifaces[1].rx_bytes == 9120334512ULL && start.ifaces[1].rx_multicast == 31220ULL, 1);
+        TEST_EQ(start.ifaces[3].tx_packets == 61200ULL, 1);
+
+        /* Ids are interned: the same names map to the same ids */
+        TEST_EQ(start.names_tag == end.names_tag && start.ifaces[2].id == end.ifaces[2].id, 1);
+        TEST_EQ(start.ifaces[0].id != start.ifaces[1].id, 1);
+        sl_sampler_destroy(sampler);
+
+        end.timestamp_ns = start.timestamp_ns + 2000000000ULL;
+        end.ifaces[1].rx_bytes += 2000000;
+        end.ifaces[1].tx_packets += 300;
+        end.ifaces[1].rx_dropped += 4;
+        TEST_EQ(sl_net_calculate(&start, &end, usage, SL_NET_MAX_IFACES), 4);
+        TEST_EQ(strcmp(usage[1].name, "wlp2s0"), 0);
+        TEST_RANGE(usage[1].rx_bytes_per_sec, 999999.0, 1000001.0);
+        TEST_RANGE(usage[1].tx_packets_per_sec, 149.9, 150.1);
+        TEST_RANGE(usage[1].rx_dropped_per_sec, 1.99, 2.01);
+        TEST_RANGE(usage[0].rx_bytes_per_sec, 0.0, 0.0);
+
+        /* 32-bit counter wrap, as reported by a 32-bit kernel */
+        fixture_path(root, sizeof(root), "laptop-4core-offline");
+        sampler = sl_sampler_create_at(root);
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &start), 0);
+        sl_sampler_destroy(sampler);
+        TEST_EQ(start.counter_bits == 32 || start.counter_bits == 64, 1);
+        start.counter_bits = 32;
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 1000000000ULL;
+        end.ifaces[1].rx_bytes = 704;
+        TEST_EQ(sl_net_calculate(&start, &end, usage, SL_NET_MAX_IFACES), 2);
+        TEST_RANGE(usage[1].rx_bytes_per_sec, 999.9, 1000.1);
+
+        /* On a 64-bit kernel the same drop is a reset */
+        start.counter_bits = end.counter_bits = 64;
+        TEST_EQ(sl_net_calculate(&start, &end, usage, SL_NET_MAX_IFACES), 2);
+        TEST_RANGE(usage[1].rx_bytes_per_sec, 0.0, 0.0);
+
+        /* 64-bit counter wrap */
+        fixture_path(root, sizeof(root), "server-256core");
+        sampler = sl_sampler_create_at(root);
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &start), 0);
+        sl_sampler_destroy(sampler);
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 1000000000ULL;
+        end.ifaces[1].rx_bytes = 448384;
+        TEST_EQ(sl_net_calculate(&start, &end, usage, SL_NET_MAX_IFACES), 3);
+        TEST_RANGE(usage[1].rx_bytes_per_sec, 999999.0, 1000001.0);
+
+        /* A 64-bit counter falling back to a small value is a reset, not a wrap */
+        end.ifaces[2].rx_bytes = 100;
+        TEST_EQ(sl_net_calculate(&start, &end, usage, SL_NET_MAX_IFACES), 3);
+        TEST_RANGE(usage[2].rx_bytes_per_sec, 0.0, 0.0);
+
+        /* So is a small counter dropping to 0 when the interface is recreated */
+        TEST_EQ(start.ifaces[2].rx_dropped == 2988 && start.ifaces[1].rx_errors == 1, 1);
+        end.ifaces[2].rx_dropped = 0;
+        end.ifaces[1].rx_errors = 0;
+        TEST_EQ(sl_net_calculate(&start, &end, usage, SL_NET_MAX_IFACES), 3);
+        TEST_RANGE(usage[2].rx_dropped_per_sec, 0.0, 0.0);
+        TEST_RANGE(usage[1].rx_errors_per_sec, 0.0, 0.0);
+
+        /* Snapshots from different samplers are matched by name */
+        fixture_path(root, sizeof(root), "server-32core");
+        sampler = sl_sampler_create_at(root);
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &other), 0);
+        sl_sampler_destroy(sampler);
+        other.timestamp_ns = end.timestamp_ns + 1000000000ULL;
+        TEST_EQ(other.names_tag != end.names_tag, 1);
+        TEST_EQ(sl_net_calculate(&end, &other, usage, SL_NET_MAX_IFACES), 1);
+        TEST_EQ(strcmp(usage[0].name, "lo"), 0);
+        TEST_EQ(sl_net_calculate(&end, &other, NULL, SL_NET_MAX_IFACES), -1);
+}
+
+
+static void test_pressure(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "laptop-2core");
+        printf("\n--- pressure ---\n");
+
+        sl_sampler_t *sampler = sl_sampler_create_at(root);
+        sl_psi_raw_t start, end;
+        sl_psi_usage_t usage;
+
+        TEST_EQ(sl_sampler_psi_get_raw(sampler, SL_PSI_IO, &start), 0);
+        TEST_RANGE(start.some.avg10, 12.04, 12.06);
+        TEST_RANGE(start.full.avg300, 3.54, 3.56);
+        TEST_EQ(start.some.total_us == 1203344120ULL && start.full.total_us == 1012033441ULL, 1);
+
+        sl_loadavg_t load;
+        TEST_EQ(sl_sampler_loadavg_get_info(sampler, &load), 0);
+        TEST_EQ(load.running == 3 && load.total == 1204 && load.last_pid == 88123, 1);
+        TEST_RANGE(load.load15, 1.019, 1.021);
+        sl_sampler_destroy(sampler);
+
+        /* 250 ms of "some" and 100 ms of "full" stall over 2 s */
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 2000000000ULL;
+        end.some.total_us += 250000;
+        end.full.total_us += 100000;
+        TEST_EQ(sl_psi_calculate(&start, &end, &usage), 0);
+        TEST_EQ(usage.some_us == 250000 && usage.full_us == 100000, 1);
+        TEST_RANGE(usage.some_percent, 12.49, 12.51);
+        TEST_RANGE(usage.full_percent, 4.99, 5.01);
+
+        end.has_full = 0;
+        TEST_EQ(sl_psi_calculate(&start, &end, &usage), 0);
+        TEST_EQ(usage.full_us, 0);
+        TEST_EQ(sl_psi_calculate(&end, &start, &usage), -1);
+
+        /* Threshold above the window is rejected before anything is written */
+        sl_psi_trigger_t trigger;
+        TEST_EQ(sl_psi_trigger_open(&trigger, SL_PSI_CPU, 0, 3000000, 2000000), -1);
+}
+
+
+static void test_cgroup(void)
+{
+        char proc[512], sys[512];
+        printf("\n--- cgroup v2 ---\n");
+
+        sl_cgroup_raw_t start, end;
+        sl_cgroup_usage_t usage;
+
+        /*
+         * Desktop session scope: no cpu.max and memory.max is "max", but
+         * user-1000.slice caps memory at 4 GiB and user.slice CPU at 1.5
+         */
+        fixture_path(proc, sizeof(proc), "laptop-2core");
+        snprintf(sys, sizeof(sys), "%s/laptop-2core/sys", SYSLOAD_FIXTURE_DIR);
+        TEST_EQ(sl_set_proc_root(proc), 0);
+        TEST_EQ(sl_set_sys_root(sys), 0);
+
+        sl_cgroup_t *cgroup = sl_cgroup_create(NULL);
+        TEST_EQ(cgroup != NULL, 1);
+        TEST_EQ(sl_cgroup_get_raw(cgroup, &start), 0);
+        TEST_EQ(start.controllers, SL_CGROUP_MEMORY | SL_CGROUP_IO);
+        TEST_EQ(start.usage_usec == 812033441ULL && start.nr_periods == 0, 1);
+        TEST_EQ(start.memory_max == 4294967296ULL, 1);
+        TEST_EQ(start.cpu_quota_usec == 150000 && start.cpu_period_usec == 100000, 1);
+        TEST_EQ(start.file == 540082176ULL && start.inactive_file == 300113920ULL && start.pgmajfault == 2033, 1);
+        TEST_EQ(start.io_rbytes == 912033792ULL && start.io_wios == 91203, 1);
+        TEST_RANGE(start.host_cpus, 2.0, 2.0);
+        sl_cgroup_destroy(cgroup);
+
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 1000000000ULL;
+        end.usage_usec += 500000;
+        end.io_rbytes += 4096 * 100;
+        end.io_rios += 100;
+        TEST_EQ(sl_cgroup_calculate(&start, &end, &usage), 0);
+        TEST_RANGE(usage.cpu_percent, 49.99, 50.01);
+        TEST_RANGE(usage.cpu_limit, 1.5, 1.5);
+        TEST_RANGE(usage.cpu_percent_of_limit, 33.33, 33.34);
+        TEST_EQ(usage.memory_limit == 4294967296ULL, 1);
+        TEST_EQ(usage.memory_working_set == 1203347456ULL - 300113920ULL, 1);
+
+        /* Without parent limits the host totals apply */
+        end.cpu_quota_usec = SL_CGROUP_UNLIMITED;
+        end.memory_max = SL_CGROUP_UNLIMITED;
+        TEST_EQ(sl_cgroup_calculate(&start, &end, &usage), 0);
+        TEST_RANGE(usage.cpu_limit, 2.0, 2.0);
+        TEST_EQ(usage.memory_limit == 8388608ULL * 1024, 1);
+        TEST_RANGE(usage.read_bytes_per_sec, 409599.0, 409601.0);
+        TEST_RANGE(usage.read_iops, 99.9, 100.1);
+
+        /* Container with 4 CPUs of quota and an 8 GiB limit, seen through its cgroup namespace */
+        fixture_path(proc, sizeof(proc), "server-32core");
+        snprintf(sys, sizeof(sys), "%s/server-32core/sys", SYSLOAD_FIXTURE_DIR);
+        TEST_EQ(sl_set_proc_root(proc), 0);
+        TEST_EQ(sl_set_sys_root(sys), 0);
+
+        cgroup = sl_cgroup_create(NULL);
+        TEST_EQ(cgroup != NULL, 1);
+        TEST_EQ(sl_cgroup_get_raw(cgroup, &start), 0);
+        TEST_EQ(start.controllers, SL_CGROUP_CPU | SL_CGROUP_MEMORY | SL_CGROUP_IO);
+        TEST_EQ(start.cpu_quota_usec == 400000 && start.cpu_period_usec == 100000, 1);
+        TEST_EQ(start.memory_max == 8589934592ULL, 1);
+        TEST_EQ(start.io_rbytes == 2147483648ULL && start.io_rios == 15000, 1);
+        sl_cgroup_destroy(cgroup);
+
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 1000000000ULL;
+        end.usage_usec += 3000000;
+        end.nr_periods += 10;
+        end.nr_throttled += 4;
+        TEST_EQ(sl_cgroup_calculate(&start, &end, &usage), 0);
+        TEST_RANGE(usage.cpu_percent, 299.9, 300.1);
+        TEST_RANGE(usage.cpu_limit, 4.0, 4.0);
+        TEST_RANGE(usage.cpu_percent_of_limit, 74.9, 75.1);
+        TEST_RANGE(usage.throttled_percent, 39.9, 40.1);
+        TEST_EQ(usage.memory_limit == 8589934592ULL, 1);
+        TEST_RANGE(usage.memory_percent, 62.49, 62.51);
+
+        TEST_EQ(sl_cgroup_create("/no/such/group") == NULL, 1);
+        TEST_EQ(sl_cgroup_calculate(&end, &start, &usage), -1);
+
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+        TEST_EQ(sl_set_sys_root(NULL), 0);
+}
+
+
+static void test_vmstat(void)
+{
+        char root[512];
+        printf("\n--- vmstat ---\n");
+
+        sl_vmstat_raw_t start, end;
+        sl_vmstat_rates_t rates;
+
+        fixture_path(root, sizeof(root), "laptop-2core");
+        TEST_EQ(sl_set_proc_root(root), 0);
+        sl_vmstat_t *vm = sl_vmstat_create(NULL, 0);
+        TEST_EQ(vm != NULL, 1);
+        TEST_EQ(sl_vmstat_get_raw(vm, &start), 0);
+        TEST_EQ(start.count == SL_VMSTAT_DEFAULT_KEYS && start.present == (1u << SL_VMSTAT_DEFAULT_KEYS) - 1, 1);
+        TEST_EQ(start.values[SL_VMSTAT_PGFAULT] == 81234567ULL && start.values[SL_VMSTAT_PGMAJFAULT] == 20331, 1);
+        TEST_EQ(start.values[SL_VMSTAT_PSWPOUT] == 3400 && start.values[SL_VMSTAT_OOM_KILL] == 2, 1);
+        TEST_EQ(strcmp(sl_vmstat_key(vm, SL_VMSTAT_PGSCAN_DIRECT), "pgscan_direct"), 0);
+        TEST_EQ(sl_vmstat_key(vm, SL_VMSTAT_DEFAULT_KEYS) == NULL, 1);
+        sl_vmstat_destroy(vm);
+
+        end = start;
+        end.timestamp_ns = start.timestamp_ns + 2000000000ULL;
+        end.values[SL_VMSTAT_PGFAULT] += 5000;
+        end.values[SL_VMSTAT_OOM_KILL] -= 1;
+        TEST_EQ(sl_vmstat_calculate(&start, &end, &rates), 0);
+        TEST_RANGE(rates.per_sec[SL_VMSTAT_PGFAULT], 2499.9, 2500.1);
+        TEST_RANGE(rates.per_sec[SL_VMSTAT_OOM_KILL], 0.0, 0.0);
+        TEST_EQ(sl_vmstat_calculate(&end, &start, &rates), -1);
+
+        /* Older kernel without oom_kill; keys in caller order, one unknown */
+        const char *keys[] = {"oom_kill", "pgmajfault", "no_such_counter", "pgfault"};
+        fixture_path(root, sizeof(root), "laptop-4core-offline");
+        TEST_EQ(sl_set_proc_root(root), 0);
+        vm = sl_vmstat_create(keys, 4);
+        TEST_EQ(vm != NULL, 1);
+        TEST_EQ(sl_vmstat_get_raw(vm, &start), 0);
+        TEST_EQ(start.count == 4 && start.present == 0xA, 1);
+        TEST_EQ(start.values[0] == 0 && start.values[1] == 412 && start.values[3] == 3970001, 1);
+        sl_vmstat_destroy(vm);
+
+        /* A collector re-resolves when lines move under it */
+        char dir[] = "/tmp/sysload-vmstat-XXXXXX";
+        char path[64];
+        TEST_EQ(mkdtemp(dir) != NULL, 1);
+        snprintf(path, sizeof(path), "%s/vmstat", dir);
+        FILE *f = fopen(path, "w");
+        fputs("nr_free_pages 10\npgfault 100\npgmajfault 7\n", f);
+        fclose(f);
+        TEST_EQ(sl_set_proc_root(dir), 0);
+        vm = sl_vmstat_create(keys + 1, 1);
+        TEST_EQ(sl_vmstat_get_raw(vm, &start), 0);
+        TEST_EQ(start.values[0], 7);
+        f = fopen(path, "w");
+        fputs("nr_free_pages 10\nnr_new_counter 5\npgfault 100\npgmajfault 9\n", f);
+        fclose(f);
+        TEST_EQ(sl_vmstat_get_raw(vm, &end), 0);
+        TEST_EQ(end.values[0], 9);
+        sl_vmstat_destroy(vm);
+        unlink(path);
+        rmdir(dir);
+
+        TEST_EQ(sl_vmstat_create(keys, 0) == NULL, 1);
+        TEST_EQ(sl_vmstat_get_raw(NULL, &start), -1);
+
+        /* Only the first of two equal keys would ever resolve */
+        const char *duplicate_keys[] = {"pgfault", "pgmajfault", "pgfault"};
+        fixture_path(root, sizeof(root), "laptop-4core-offline");
+        TEST_EQ(sl_set_proc_root(root), 0);
+        TEST_EQ(sl_vmstat_create(duplicate_keys, 3) == NULL, 1);
+        vm = sl_vmstat_create(duplicate_keys, 2);
+        TEST_EQ(vm != NULL, 1);
+        sl_vmstat_destroy(vm);
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+}
+
+
+static void test_meminfo_ext(void)
+{
+        char root[512];
+        printf("\n--- meminfo ext ---\n");
+
+        fixture_path(root, sizeof(root), "laptop-2core");
+        TEST_EQ(sl_set_proc_root(root), 0);
+        sl_mem_ext_t ext;
+        TEST_EQ(sl_mem_get_ext(&ext), 0);
+        TEST_EQ(ext.dirty == 4848 && ext.writeback == 12, 1);
+        TEST_EQ(ext.slab == 279620 && ext.sreclaimable == 167772 && ext.sunreclaim == 104857, 1);
+        TEST_EQ(ext.active_anon == 1048576 && ext.inactive_file == 1198372, 1);
+        TEST_EQ(ext.anon_huge_pages == 131072 && ext.hugepagesize == 2048, 1);
+        TEST_EQ(ext.hugepages_total == 16 && ext.hugepages_free == 12 && ext.hugepages_rsvd == 2, 1);
+        TEST_EQ(ext.commit_limit == 6291456 && ext.vmalloc_total == 34359738367ULL, 1);
+        TEST_EQ(ext.direct_map_1g == 4194304 && ext.direct_map_4m == 0, 1);
+        TEST_EQ(ext.unknown, 0);
+
+        /* A sampler relearns the layout when keys appear or move */
+        char dir[] = "/tmp/sysload-meminfo-XXXXXX";
+        char path[64];
+        TEST_EQ(mkdtemp(dir) != NULL, 1);
+        snprintf(path, sizeof(path), "%s/meminfo", dir);
+        FILE *f = fopen(path, "w");
+        fputs("MemTotal: 1000 kB\nMemFree: 200 kB\nDirty: 5 kB\n", f);
+        fclose(f);
+        sl_sampler_t *sampler = sl_sampler_create_at(dir);
+        TEST_EQ(sl_sampler_mem_get_ext(sampler, &ext), 0);
+        TEST_EQ(ext.mem_free == 200 && ext.dirty == 5, 1);
+        f = fopen(path, "w");
+        fputs("MemTotal: 1000 kB\nNewCounter: 1 kB\nDirty: 6 kB\nMemFree: 300 kB\n", f);
+        fclose(f);
+        TEST_EQ(sl_sampler_mem_get_ext(sampler, &ext), 0);
+        TEST_EQ(ext.mem_free == 300 && ext.dirty == 6 && ext.unknown == 1, 1);
+        TEST_EQ(sl_sampler_mem_get_ext(sampler, &ext), 0);
+        TEST_EQ(ext.mem_free == 300 && ext.dirty == 6 && ext.unknown == 1, 1);
+        f = fopen(path, "w");
+        fputs("MemFree: 300 kB\n", f);
+        fclose(f);
+        TEST_EQ(sl_sampler_mem_get_ext(sampler, &ext), -1);
+        sl_sampler_destroy(sampler);
+        unlink(path);
+        rmdir(dir);
+
+        TEST_EQ(sl_mem_get_ext(NULL), -1);
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+}
+
+
+static void test_numa(void)
+{
+        char proc[512], sys[512];
+        printf("\n--- numa ---\n");
+
+        /* Two sockets with interleaved SMT siblings; node 0 is nearly out of memory */
+        fixture_path(proc, sizeof(proc), "server-32core");
+        snprintf(sys, sizeof(sys), "%s/server-32core/sys", SYSLOAD_FIXTURE_DIR);
+        TEST_EQ(sl_set_proc_root(proc), 0);
+        TEST_EQ(sl_set_sys_root(sys), 0);
+
+        static sl_numa_raw_t start, end;
+        sl_numa_usage_t usage[SL_NUMA_MAX_NODES];
+        sl_numa_t *numa = sl_numa_create();
+        TEST_EQ(numa != NULL, 1);
+        TEST_EQ(sl_numa_get_raw(numa, &start), 0);
+        TEST_EQ(start.count, 2);
+        TEST_EQ(start.nodes[0].id == 0 && start.nodes[1].id == 1, 1);
+        TEST_EQ(start.nodes[0].cpu_count == 16 && start.nodes[1].cpu_count == 16, 1);
+        TEST_EQ(start.nodes[0].cpu.user == 84247632ULL && start.nodes[1].cpu.user == 91229377ULL, 1);
+        TEST_EQ(start.nodes[0].mem_total == 67108864ULL && start.nodes[0].mem_free == 2097152ULL, 1);
+        TEST_EQ(start.nodes[0].mem_used == 65011712ULL && start.nodes[0].dirty == 20480, 1);
+        TEST_EQ(start.nodes[1].hugepages_total == 512 && start.nodes[1].hugepages_free == 256, 1);
+        TEST_EQ(start.nodes[0].numa_miss == 91234567ULL && start.nodes[1].numa_foreign == 91234567ULL, 1);
+        TEST_EQ(start.nodes[1].other_node == 24536789ULL, 1);
+        TEST_EQ(sl_numa_get_raw(numa, &end), 0);
+        TEST_EQ(memcmp(end.nodes, start.nodes, sizeof(start.nodes[0]) * 2), 0);
+        sl_numa_destroy(numa);
+
+        end.timestamp_ns = start.timestamp_ns + 1000000000ULL;
+        end.nodes[0].cpu.user += 1200;
+        end.nodes[0].cpu.idle += 400;
+        end.nodes[0].numa_miss += 5000;
+        end.nodes[0].local_node += 9000;
+        end.nodes[0].other_node += 1000;
+        TEST_EQ(sl_numa_calculate(&start, &end, usage, SL_NUMA_MAX_NODES), 2);
+        TEST_RANGE(usage[0].cpu.total, 74.9, 75.1);
+        TEST_RANGE(usage[0].mem_percent_used, 96.8, 96.9);
+        TEST_RANGE(usage[0].miss_per_sec, 4999.9, 5000.1);
+        TEST_RANGE(usage[0].local_percent, 89.9, 90.1);
+        TEST_RANGE(usage[1].cpu.total, 0.0, 0.0);
+        TEST_RANGE(usage[1].mem_percent_used, 63.1, 63.2);
+        TEST_RANGE(usage[1].local_percent, 100.0, 100.0);
+        TEST_EQ(sl_numa_calculate(&start, &end, usage, 1), 1);
+        end.count = 1;
+        TEST_EQ(sl_numa_calculate(&start, &end, usage, SL_NUMA_MAX_NODES), -1);
+
+        /* Kernel without NUMA sysfs */
+        fixture_path(proc, sizeof(proc), "laptop-2core");
+        snprintf(sys, sizeof(sys), "%s/laptop-2core/sys", SYSLOAD_FIXTURE_DIR);
+        TEST_EQ(sl_set_proc_root(proc), 0);
+        TEST_EQ(sl_set_sys_root(sys), 0);
+        TEST_EQ(sl_numa_create() == NULL, 1);
+        TEST_EQ(sl_numa_get_raw(NULL, &start), -1);
+
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+        TEST_EQ(sl_set_sys_root(NULL), 0);
+}
+
+
+static void test_irq(void)
+{
+        char root[512];
+        printf("\n--- interrupts ---\n");
+
+        /* cpu2 is offline and has no column */
+        fixture_path(root, sizeof(root), "laptop-4core-offline");
+        TEST_EQ(sl_set_proc_root(root), 0);
+        sl_irq_raw_t start, end;
+        TEST_EQ(sl_irq_raw_init(&start, 0), 0);
+        TEST_EQ(sl_irq_raw_init(&end, 64), 0);
+        sl_irq_t *irq = sl_irq_create(SL_IRQ_INTERRUPTS);
+        TEST_EQ(irq != NULL, 1);
+        TEST_EQ(sl_irq_get_raw(irq, &start), 0);
+        TEST_EQ(start.rows == 6 && start.cpus == 3, 1);
+        TEST_EQ(sl_irq_cpu(irq, 2) == 3 && sl_irq_cpu(irq, 3) == -1, 1);
+        TEST_EQ(strcmp(sl_irq_name(irq, 2), "127"), 0);
+        TEST_EQ(strcmp(sl_irq_desc(irq, 2), "PCI-MSI 409600-edge      wlp2s0"), 0);
+        TEST_EQ(strcmp(sl_irq_name(irq, 4), "LOC"), 0);
+        TEST_EQ(start.counts[2 * 3 + 2] == 5123 && start.counts[4 * 3 + 0] == 3970001, 1);
+        TEST_EQ(sl_irq_name(irq, 6) == NULL, 1);
+        sl_irq_destroy(irq);
+
+        /* Softirqs on 32 CPUs; the second read goes through the learned layout */
+        fixture_path(root, sizeof(root), "server-32core");
+        TEST_EQ(sl_set_proc_root(root), 0);
+        irq = sl_irq_create(SL_IRQ_SOFTIRQS);
+        TEST_EQ(irq != NULL, 1);
+        TEST_EQ(sl_irq_get_raw(irq, &start), 0);
+        TEST_EQ(sl_irq_get_raw(irq, &end), 0);
+        TEST_EQ(start.rows == 10 && start.cpus == 32 && start.layout == end.layout, 1);
+        TEST_EQ(memcmp(start.counts, end.counts, sizeof(uint64_t) * 320), 0);
+        TEST_EQ(strcmp(sl_irq_name(irq, 3), "NET_RX") == 0 && sl_irq_desc(irq, 3)[0] == '\0', 1);
+
+        /* NET_RX piling onto CPU 2, one counter wrapping at 2^32 */
+        end.timestamp_ns = start.timestamp_ns + 2000000000ULL;
+        end.counts[3 * 32 + 2] += 90000;
+        end.counts[3 * 32 + 0] += 30000;
+        start.counts[7 * 32 + 5] = 4294967000ULL;
+        end.counts[7 * 32 + 5] = 100;
+        static double rates[320];
+        sl_irq_hotspot_t top[2];
+        TEST_EQ(sl_irq_calculate(&start, &end, rates, 320), 320);
+        TEST_RANGE(rates[3 * 32 + 2], 44999.9, 45000.1);
+        TEST_RANGE(rates[7 * 32 + 5], 197.9, 198.1);
+        TEST_RANGE(rates[3 * 32 + 3], 0.0, 0.0);
+        TEST_EQ(sl_irq_top(irq, &start, &end, top, 2), 2);
+        TEST_EQ(top[0].row == 3 && top[0].cpu == 2 && top[1].row == 3 && top[1].cpu == 0, 1);
+        TEST_RANGE(top[1].per_sec, 14999.9, 15000.1);
+        TEST_EQ(sl_irq_calculate(&end, &start, rates, 320), -1);
+        sl_irq_destroy(irq);
+
+        /* A new source relearns the layout; matrices from before no longer pair */
+        char dir[] = "/tmp/sysload-irq-XXXXXX";
+        char path[64];
+        TEST_EQ(mkdtemp(dir) != NULL, 1);
+        snprintf(path, sizeof(path), "%s/interrupts", dir);
+        FILE *f = fopen(path, "w");
+        fputs("      CPU0  CPU1\n  1:  5  6  IO-APIC i8042\nLOC:  100  200  Local timer interrupts\nERR:  0\n", f);
+        fclose(f);
+        TEST_EQ(sl_set_proc_root(dir), 0);
+        irq = sl_irq_create(SL_IRQ_INTERRUPTS);
+        TEST_EQ(sl_irq_get_raw(irq, &start), 0);
+        TEST_EQ(start.rows == 2 && start.counts[3] == 200, 1);
+        f = fopen(path, "w");
+        fputs("      CPU0  CPU1\n  1:  5  6  IO-APIC i8042\n 40:  7  8  PCI-MSI eth0\nLOC:  150  250  Local timer interrupts\nERR:  0\n", f);
+        fclose(f);
+        TEST_EQ(sl_irq_get_raw(irq, &end), 0);
+        TEST_EQ(end.rows == 3 && end.counts[5] == 250 && end.layout != start.layout, 1);
+        TEST_EQ(strcmp(sl_irq_desc(irq, 1), "PCI-MSI eth0"), 0);
+        TEST_EQ(sl_irq_calculate(&start, &end, rates, 320), -1);
+
+        /* Fresh interrupts and softirqs collectors of the same 3 x 2 shape do not pair */
+        char soft_path[64];
+        snprintf(soft_path, sizeof(soft_path), "%s/softirqs", dir);
+        f = fopen(soft_path, "w");
+        fputs("        CPU0  CPU1\n  HI:  1  2\n  TIMER:  300  400\n  NET_RX:  5  6\n", f);
+        fclose(f);
+        sl_irq_destroy(irq);
+        irq = sl_irq_create(SL_IRQ_INTERRUPTS);
+        sl_irq_t *soft = sl_irq_create(SL_IRQ_SOFTIRQS);
+        TEST_EQ(sl_irq_get_raw(irq, &end), 0);
+        TEST_EQ(sl_irq_get_raw(soft, &start), 0);
+        TEST_EQ(start.rows == end.rows && start.cpus == end.cpus && start.layout != end.layout, 1);
+        TEST_EQ(sl_irq_calculate(&start, &end, rates, 320), -1);
+        sl_irq_destroy(soft);
+        unlink(soft_path);
+
+        sl_irq_destroy(irq);
+        unlink(path);
+        rmdir(dir);
+
+        sl_irq_raw_free(&start);
+        sl_irq_raw_free(&end);
+        TEST_EQ(sl_irq_create((sl_irq_source_t)7) == NULL, 1);
+        TEST_EQ(sl_irq_get_raw(NULL, &start), -1);
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+}
+
+
+static void test_mounts(void)
+{
+        char root[512];
+        fixture_path(root, sizeof(root), "laptop-2core");
+        printf("\n--- mounts ---\n");
+
+        static sl_mount_info_t mounts[16];
+
+        TEST_EQ(sl_set_proc_root(root), 0);
+        sl_mounts_t *table = sl_mounts_create(0, 0);
+        sl_mounts_t *pooled = sl_mounts_create(2, 1000);
+        TEST_EQ(sl_set_proc_root(NULL), 0);
+        TEST_EQ(table != NULL && pooled != NULL, 1);
+
+        TEST_EQ(sl_mounts_query(table, NULL, NULL, mounts, 16), 10);
+        TEST_EQ(strcmp(mounts[3].mount_point, "/") == 0 && strcmp(mounts[3].fstype, "ext4") == 0, 1);
+        TEST_EQ(strcmp(mounts[3].source, "/dev/nvme0n1p2") == 0 && mounts[3].major == 259 && mounts[3].minor == 2, 1);
+        TEST_EQ(mounts[3].error == 0 && mounts[3].storage.total > 0, 1);
+
+        /* Escaped space in the mount point; recorded mounts absent on this host fail individually */
+        TEST_EQ(sl_mounts_query(table, "xfs", NULL, mounts, 16), 2);
+        TEST_EQ(strcmp(mounts[1].mount_point, "/sysload-fixture/data/my archive"), 0);
+        TEST_EQ(mounts[0].error != 0 && mounts[1].error != 0, 1);
+
+        TEST_EQ(sl_mounts_query(table, "ext4,vfat,tmpfs", NULL, mounts, 16), 3);
+        TEST_EQ(sl_mounts_query(table, NULL, "/sysload-fixture/data", mounts, 16), 2);
+        TEST_EQ(sl_mounts_query(table, NULL, "/sys", mounts, 16), 2);
+        TEST_EQ(sl_mounts_query(table, "nfs4", "/", mounts, 16), 1);
+        TEST_EQ(sl_mounts_query(table, NULL, NULL, mounts, 4), 4);
+
+        /* The pool gives the same results */
+        TEST_EQ(sl_mounts_query(pooled, NULL, NULL, mounts, 16), 10);
+        TEST_EQ(mounts[3].error == 0 && mounts[3].storage.total > 0, 1);
+        TEST_EQ(mounts[9].error != 0 && mounts[9].error != ETIMEDOUT, 1);
+        TEST_EQ(sl_mounts_refresh(pooled), 10);
+
+        TEST_EQ(sl_mounts_query(table, NULL, NULL, NULL, 16), -1);
+        sl_mounts_destroy(table);
+        sl_mounts_destroy(pooled);
+}
+
+
+int main(void)
+{
+        printf("\n=== sysload fixture test ===\n");
+
+        for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); i++) {
+                test_fixture(&fixtures[i]);
+        }
+        test_global_root();
+        test_subscriber();
+        test_sched();
+        test_hotplug();
+        test_process();
+        test_disk();
+        test_net();
+        test_pressure();
+        test_cgroup();
+        test_vmstat();
+        test_meminfo_ext();
+        test_numa();
+        test_irq();
+        test_mounts();
+
+        TEST_SUMMARY();
+        return (passed == total) ? 0 : -1;
+}
@@ -0,0 +1,292 @@
+/*
+ * Concurrency stress test, built with -fsanitize=thread. Worker threads
+ * call the library's public functions while a control thread swaps the
+ * log handler, log level and filesystem roots and starts and stops the
+ * monitor. ThreadSanitizer fails the run on any data race; the checks
+ * below catch calls that fail or handlers invoked with the wrong data.
+ */
+
+#include "sysload.h"
+#include "test_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STRESS_WORKERS 6
+#define STRESS_SECONDS 2
+
+static atomic_int g_stop;
+static atomic_int g_handler_mismatch;
+static atomic_int g_messages;
+static int g_tag_a, g_tag_b;
+static sl_history_t *g_history;
+static char g_shm_name[SL_SHARED_NAME_SIZE];
+
+typedef struct
+{
+        int id;
+        int iterations;
+        int failures;
+        sl_disk_raw_t disk[2];
+        sl_net_raw_t net[2];
+        sl_disk_usage_t disk_usage[SL_DISK_MAX_DEVICES];
+        sl_net_usage_t net_usage[SL_NET_MAX_IFACES];
+        sl_mount_info_t mounts[64];
+        sl_proc_raw_t threads[16];
+        sl_proc_top_entry_t top[4];
+} worker_t;
+
+
+static void handler_a(sl_log_level_t level, const char *func, const char *msg, void *user_data)
+{
+        (void)level; (void)func; (void)msg;
+        if (user_data != &g_tag_a) atomic_fetch_add(&g_handler_mismatch, 1);
+        atomic_fetch_add(&g_messages, 1);
+}
+
+
+static void handler_b(sl_log_level_t level, const char *func, const char *msg, void *user_data)
+{
+        (void)level; (void)func; (void)msg;
+        if (user_data != &g_tag_b) atomic_fetch_add(&g_handler_mismatch, 1);
+        atomic_fetch_add(&g_messages, 1);
+}
+
+
+#define CHECK(expr) do { if (!(expr)) { w->failures++; fprintf(stderr, "worker %d: %s failed\n", w->id, #expr); } } while (0)
+
+static void *worker_main(void *arg)
+{
+        worker_t *w = arg;
+        const char *mount_paths[] = {"/"};
+        char rec_path[64];
+        snprintf(rec_path, sizeof(rec_path), "/tmp/sysload_stress_%d_%d.slr", (int)getpid(), w->id);
+        unlink(rec_path);
+
+        sl_sampler_t *sampler = sl_sampler_create();
+        sl_proc_sampler_t *procs = sl_proc_sampler_create();
+        sl_proc_top_t *top = sl_proc_top_create(NULL, 4096, 4, SL_PROC_TOP_CPU);
+        sl_mounts_t *mounts = sl_mounts_create(1, 5000);
+        sl_cgroup_t *cgroup = sl_cgroup_create(NULL);
+        sl_recorder_t *recorder = sl_recorder_open(rec_path, 0);
+        sl_subscriber_t *subscriber = sl_subscriber_create(g_shm_name, 0.05f, mount_paths, 1);
+        CHECK(sampler && procs && top && mounts && recorder && subscriber);
+        if (!sampler || !procs || !top || !mounts || !recorder || !subscriber) return NULL;
+
+        sl_cpu_delta_t delta;
+        sl_cpu_cores_t cores[2];
+        sl_cpu_delta_init(&delta);
+        CHECK(sl_cpu_cores_init(&cores[0], 0) == 0 && sl_cpu_cores_init(&cores[1], 0) == 0);
+
+        sl_proc_handle_t self;
+        CHECK(sl_proc_open(procs, getpid(), &self) == 0);
+
+        while (!atomic_load(&g_stop)) {
+                int cur = w->iterations & 1, prev = cur ^ 1;
+                sl_cpu_raw_t cpu;
+                sl_cpu_usage_t usage[64];
+                sl_mem_info_t mem;
+                sl_systime_info_t systime;
+                sl_storage_info_t storage;
+                sl_loadavg_t load;
+                sl_psi_raw_t psi;
+                sl_proc_raw_t proc;
+                sl_history_stats_t stats;
+                sl_monitor_snapshot_t snap;
+                sl_snapshot_t snapshot;
+                float values[16];
+
+                CHECK(sl_cpu_get_raw(&cpu) == 0);
+                CHECK(sl_sampler_cpu_get_raw(sampler, &cpu) == 0);
+                CHECK(sl_cpu_delta_update(&delta, sampler, usage, NULL) >= 0);
+                CHECK(sl_cpu_get_raw_cores(&cores[cur]) == 0);
+                CHECK(sl_sampler_cpu_get_raw_cores(sampler, &cores[cur]) == 0);
+                CHECK(sl_cpu_calculate_cores(&cores[prev], &cores[cur], usage, 64) >= 0);
+                CHECK(sl_mem_get_info(&mem) == 0);
+                CHECK(sl_sampler_mem_get_info(sampler, &mem) == 0);
+                CHECK(sl_systime_get_info(&systime) == 0);
+                CHECK(sl_sampler_systime_get_info(sampler, &systime) == 0);
+                CHECK(sl_storage_get_info("/", &storage) == 0);
+                CHECK(sl_sampler_snapshot_collect(sampler, SL_SNAPSHOT_ALL | SL_SNAPSHOT_IO_URING, mount_paths, 1, &snapshot) == 0);
+                CHECK(sl_disk_get_raw(&w->disk[cur], 0) == 0);
+                CHECK(sl_sampler_disk_get_raw(sampler, &w->disk[cur], 0) == 0);
+                CHECK(sl_net_get_raw(&w->net[cur]) == 0);
+                CHECK(sl_sampler_net_get_raw(sampler, &w->net[cur]) == 0);
+                if (w->iterations > 0) {
+                        CHECK(sl_disk_calculate(&w->disk[prev], &w->disk[cur], w->disk_usage, SL_DISK_MAX_DEVICES) >= 0);
+                        CHECK(sl_net_calculate(&w->net[prev], &w->net[cur], w->net_usage, SL_NET_MAX_IFACES) >= 0);
+                }
+                CHECK(sl_loadavg_get_info(&load) == 0);
+                CHECK(sl_sampler_loadavg_get_info(sampler, &load) == 0);
+                sl_psi_get_raw(SL_PSI_CPU, &psi);
+                sl_sampler_psi_get_raw(sampler, SL_PSI_IO, &psi);
+                CHECK(sl_proc_get_raw(procs, getpid(), &proc) == 0);
+                CHECK(sl_proc_handle_get_raw(procs, &self, &proc) == 0);
+                CHECK(sl_proc_get_threads(procs, getpid(), w->threads, 16) >= 1);
+                CHECK(sl_proc_top_refresh(top, w->top, 4) >= 1);
+                CHECK(sl_mounts_query(mounts, NULL, "/", w->mounts, 64) >= 1);
+                if (cgroup) {
+                        sl_cgroup_raw_t cg;
+                        CHECK(sl_cgroup_get_raw(cgroup, &cg) == 0);
+                }
+                CHECK(sl_history_stats(g_history, SL_METRIC_CPU_TOTAL, 0, &stats) == 0);
+                CHECK(sl_history_read(g_history, SL_METRIC_MEM_USED, NULL, values, 16) >= 0);
+                sl_monitor_read(&snap);
+                CHECK(sl_subscriber_read(subscriber, &snap) >= 0 && snap.storage_count == 1 && snap.mem.total > 0);
+                CHECK(sl_recorder_write_cpu(recorder, 0, &cpu) == 0);
+                CHECK(sl_recorder_write_mem(recorder, 0, &mem) == 0);
+
+                /* Error paths log through whatever handler is current */
+                CHECK(sl_cpu_get_raw(NULL) == -1);
+                CHECK(sl_storage_get_info("/notexistfolder", &storage) == -1);
+
+                w->iterations++;
+        }
+
+        CHECK(sl_recorder_close(recorder) == 0);
+        sl_replay_t *replay = sl_replay_open(rec_path);
+        sl_record_t record;
+        int records = 0;
+        CHECK(replay != NULL);
+        while (replay && sl_replay_next(replay, &record) == 1) records++;
+        CHECK(records == 1 + 2 * w->iterations);
+        sl_replay_close(replay);
+        unlink(rec_path);
+
+        sl_subscriber_destroy(subscriber);
+        sl_proc_close(&self);
+        sl_cpu_cores_free(&cores[0]);
+        sl_cpu_cores_free(&cores[1]);
+        sl_cgroup_destroy(cgroup);
+        sl_mounts_destroy(mounts);
+        sl_proc_top_destroy(top);
+        sl_proc_sampler_destroy(procs);
+        sl_sampler_destroy(sampler);
+        return NULL;
+}
+
+
+/* The single writer the history allows */
+static void *history_main(void *arg)
+{
+        int *pushes = arg;
+        sl_cpu_usage_t cpu = {0};
+        sl_mem_info_t mem = {0};
+        struct timespec pause = {0, 100 * 1000L};
+
+        /* Paced like a fast sampler; back-to-back pushes would starve the readers' seqlock retries */
+        while (!atomic_load(&g_stop)) {
+                nanosleep(&pause, NULL);
+                cpu.total = (float)(*pushes % 100);
+                mem.percent_used = 50.0f;
+                if (sl_history_push(g_history, 0, &cpu, &mem) == 0) (*pushes)++;
+        }
+        return NULL;
+}
+
+
+/* Publishes for the workers' subscribers; restarts now and then so they fall back and reattach */
+static void *publisher_main(void *arg)
+{
+        int *updates = arg;
+        const char *mounts[] = {"/"};
+        struct timespec pause = {0, 1000000L};
+
+        while (!atomic_load(&g_stop)) {
+                sl_publisher_t *publisher = sl_publisher_create(g_shm_name, mounts, 1);
+                for (int i = 0; publisher && i < 200 && !atomic_load(&g_stop); i++) {
+                        if (sl_publisher_update(publisher) == 0) (*updates)++;
+                        nanosleep(&pause, NULL);
+                }
+                sl_publisher_destroy(publisher);
+        }
+        return NULL;
+}
+
+
+/* Changes library-wide state while the workers run */
+static void *control_main(void *arg)
+{
+        int *rounds = arg;
+        const char *mounts[] = {"/"};
+        struct timespec pause = {0, 2 * 1000000L};
+
+        while (!atomic_load(&g_stop)) {
+                int round = (*rounds)++;
+
+                if (round & 1) sl_set_log_handler(handler_a, &g_tag_a);
+                else sl_set_log_handler(handler_b, &g_tag_b);
+                sl_set_log_level((round % 3 == 0) ? SL_LOG_ERROR : SL_LOG_INFO);
+                sl_set_log_deferred((round & 2) != 0);
+                sl_log_drain();
+                sl_set_proc_root((round & 1) ? "/proc/" : NULL);
+                sl_set_sys_root((round & 1) ? "/sys/" : "/sys");
+
+                if (round % 8 == 0) {
+                        sl_monitor_start(0.01f, mounts, 1);
+                } else if (round % 8 == 4) {
+                        sl_monitor_stop();
+                }
+                nanosleep(&pause, NULL);
+        }
+
+        sl_monitor_stop();
+        sl_set_log_deferred(0);
+        sl_log_drain();
+        return NULL;
+}
+
+
+int main(void)
+{
+        printf("\n=== sysload stress test (%d workers, %d s) ===\n", STRESS_WORKERS, STRESS_SECONDS);
+
+        float windows[1] = {1.0f};
+        g_history = sl_history_create(1024, windows, 1);
+        TEST_EQ(g_history != NULL, 1);
+
+        static worker_t workers[STRESS_WORKERS];
+        pthread_t threads[STRESS_WORKERS], history_thread, control_thread, publisher_thread;
+        int pushes = 0, rounds = 0, updates = 0;
+        snprintf(g_shm_name, sizeof(g_shm_name), "/sysload-stress-%d", (int)getpid());
+
+        pthread_create(&control_thread, NULL, control_main, &rounds);
+        pthread_create(&publisher_thread, NULL, publisher_main, &updates);
+        pthread_create(&history_thread, NULL, history_main, &pushes);
+        for (int i = 0; i < STRESS_WORKERS; i++) {
+                workers[i].id = i;
+                pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+        }
+
+        sleep(STRESS_SECONDS);
+        atomic_store(&g_stop, 1);
+
+        int iterations = 0, failures = 0;
+        for (int i = 0; i < STRESS_WORKERS; i++) {
+                pthread_join(threads[i], NULL);
+                iterations += workers[i].iterations;
+                failures += workers[i].failures;
+        }
+        pthread_join(history_thread, NULL);
+        pthread_join(control_thread, NULL);
+        pthread_join(publisher_thread, NULL);
+
+        printf("%d worker iterations, %d history pushes, %d control rounds, %d publisher updates, %d messages\n",
+               iterations, pushes, rounds, updates, atomic_load(&g_messages));
+        TEST_EQ(failures, 0);
+        TEST_EQ(iterations >= STRESS_WORKERS, 1);
+        TEST_EQ(pushes > 0 && rounds > 0 && updates > 0, 1);
+        TEST_EQ(atomic_load(&g_handler_mismatch), 0);
+        TEST_EQ(atomic_load(&g_messages) > 0, 1);
+
+        sl_set_log_handler(NULL, NULL);
+        sl_set_log_level(SL_LOG_INFO);
+        sl_history_destroy(g_history);
+
+        TEST_SUMMARY();
+        return (passed == total) ? 0 : -1;
+}
@@ -1,35 +1,56 @@
 #include "sysload.h"
+#include "test_common.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
 
-int total = 0, passed = 0;
+static int g_log_count[3];
 
-#define OK      "[ \033[32m OK \033[0m ]"
-#define FAIL    "[ \033[31mFAIL\033[0m ]"
+static void count_log(sl_log_level_t level, const char *func, const char *msg, void *user_data)
+{
+        (void)func; (void)msg; (void)user_data;
+        g_log_count[level]++;
+}
 
+/* Scheduler callback: counts runs per collector and remembers each one's last batch time */
+typedef struct
+{
+        int runs[SL_SCHED_MAX_COLLECTORS];
+        int failed;
+        uint64_t last_ns[SL_SCHED_MAX_COLLECTORS];
+        uint64_t storage_total;
+        int cpu_id;
+        int mem_with_cpu;       /**< Memory runs in the same batch as a CPU run */
+        sl_sched_t *sched;
+} sched_counts_t;
 
-#define TEST_EQ(expr, expected) do { \
-        total++; \
-        int _r = (expr); \
-        if (_r == (expected)) { \
-                printf(OK " %s returned %d\n", #expr, _r); \
-                passed++; \
-        } else { \
-                fprintf(stderr, FAIL " %s returned %d (expected %d)\n", #expr, _r, expected); \
-        } \
-} while(0)
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
-#define TEST_RANGE(value, min, max) do { \
-        total++; \
-        if ((value) >= (min) && (value) <= (max)) { \
-                printf(OK " %s = %.2f (in range)\n", #value, (double)(value)); \
-                passed++; \
-        } else { \
-                fprintf(stderr, FAIL " %s = %.2f (out of range %.2f..%.2f)\n", #value, (double)(value), (double)(min), (double)(max)); \
-        } \
-} while(0)
+static void count_sched(const sl_sched_result_t *result, void *user_data)
+{
+        sched_counts_t *counts = user_data;
+        counts->runs[result->id]++;
+        counts->last_ns[result->id] = result->timestamp_ns;
+        if (result->status != 0) counts->failed++;
+        if (result->kind == SL_SCHED_STORAGE) counts->storage_total = result->storage.total;
+        if (result->kind == SL_SCHED_MEM && counts->last_ns[counts->cpu_id] == result->timestamp_ns) {
+                counts->mem_with_cpu++;
+        }
 
+        /* Custom collectors unregister themselves after three runs */
+        if (result->kind == SL_SCHED_CUSTOM && counts->runs[result->id] == 3) {
+                sl_sched_remove(counts->sched, result->id);
+        }
+}
 
 int main(void)
 {
@@ -46,18 +67,484 @@ int main(void)
         TEST_RANGE(mem.percent_used, 0.0, 100.0);
         TEST_EQ(sl_mem_get_info(NULL), -1);
 
+        sl_mem_ext_t mem_ext;
+        TEST_EQ(sl_mem_get_ext(&mem_ext), 0);
+        TEST_EQ(mem_ext.mem_total > 0 && mem_ext.mem_free <= mem_ext.mem_total, 1);
+        TEST_EQ(mem_ext.hugepages_free <= mem_ext.hugepages_total, 1);
+
+        sl_irq_raw_t irq_start, irq_end;
+        double irq_rates[4096];
+        sl_irq_hotspot_t irq_top[4];
+        TEST_EQ(sl_irq_raw_init(&irq_start, 0) == 0 && sl_irq_raw_init(&irq_end, 0) == 0, 1);
+        struct timespec irq_wait = {0, 20 * 1000000L};
+        for (int source = SL_IRQ_INTERRUPTS; source <= SL_IRQ_SOFTIRQS; source++) {
+                sl_irq_t *irq = sl_irq_create((sl_irq_source_t)source);
+                TEST_EQ(irq != NULL, 1);
+                if (!irq) continue;
+                TEST_EQ(sl_irq_get_raw(irq, &irq_start), 0);
+                nanosleep(&irq_wait, NULL);
+                TEST_EQ(sl_irq_get_raw(irq, &irq_end), 0);
+                TEST_EQ(irq_end.rows > 0 && irq_end.cpus > 0, 1);
+                TEST_EQ(sl_irq_calculate(&irq_start, &irq_end, irq_rates, 4096) >= 0, 1);
+                TEST_EQ(sl_irq_top(irq, &irq_start, &irq_end, irq_top, 4) >= 0, 1);
+                sl_irq_destroy(irq);
+        }
+        sl_irq_raw_free(&irq_start);
+        sl_irq_raw_free(&irq_end);
+
+        /* NUMA sysfs is missing on some kernels and containers */
+        sl_numa_t *numa = sl_numa_create();
+        if (numa) {
+                static sl_numa_raw_t numa_raw;
+                TEST_EQ(sl_numa_get_raw(numa, &numa_raw), 0);
+                TEST_EQ(numa_raw.count >= 1 && numa_raw.nodes[0].mem_total > 0, 1);
+                sl_numa_destroy(numa);
+        }
+
         sl_storage_info_t storage; 
         TEST_EQ(sl_storage_get_info("/", &storage), 0);
         TEST_EQ(sl_storage_get_info("/notexistfolder", &storage), -1);
         TEST_EQ(sl_storage_get_info(NULL, NULL), -1);
 
+        static sl_mount_info_t mount_infos[64];
+        sl_mounts_t *mount_table = sl_mounts_create(4, 2000);
+        TEST_EQ(mount_table != NULL, 1);
+        int mount_count = sl_mounts_query(mount_table, NULL, NULL, mount_infos, 64);
+        int root_found = 0;
+        for (int i = 0; i < mount_count; i++) {
+                root_found |= strcmp(mount_infos[i].mount_point, "/") == 0 && mount_infos[i].error == 0 && mount_infos[i].storage.total > 0;
+        }
+        TEST_EQ(root_found, 1);
+        TEST_EQ(sl_mounts_query(mount_table, "proc", "/proc", mount_infos, 64) >= 1, 1);
+        sl_mounts_destroy(mount_table);
+
         sl_systime_info_t systime;
         TEST_EQ(sl_systime_get_info(&systime), 0);
         TEST_RANGE(systime.uptime, 0.1, 1e9);
         TEST_EQ(sl_systime_get_info(NULL), -1);
 
-        printf("\n--- Summary ---\n"); 
-        printf("Passed: %d / %d\n", passed, total);
-        printf("Result: %s\n", (passed == total) ? "\033[32mSUCCESS\033[0m" : "\033[31mFAIL\033[0m");
+        sl_sampler_t *sampler = sl_sampler_create();
+        sl_cpu_raw_t raw;
+        TEST_EQ(sampler != NULL, 1);
+        TEST_EQ(sl_sampler_cpu_get_raw(sampler, &raw), 0);
+        TEST_EQ(sl_sampler_cpu_get_raw(sampler, &raw), 0);
+        TEST_EQ(sl_sampler_mem_get_info(sampler, &mem), 0);
+        TEST_RANGE(mem.percent_used, 0.0, 100.0);
+        TEST_EQ(sl_sampler_systime_get_info(sampler, &systime), 0);
+        TEST_RANGE(systime.uptime, 0.1, 1e9);
+        TEST_EQ(sl_sampler_cpu_get_raw(NULL, &raw), -1);
+        TEST_EQ(sl_sampler_mem_get_info(sampler, NULL), -1);
+
+        static sl_snapshot_t snapshot;
+        const char *snapshot_paths[] = {"/", "/proc"};
+        TEST_EQ(sl_snapshot_collect(SL_SNAPSHOT_ALL, snapshot_paths, 2, &snapshot), 0);
+        TEST_EQ(snapshot.collected, SL_SNAPSHOT_ALL);
+        TEST_EQ(snapshot.storage_count == 2 && snapshot.storage[0].total > 0, 1);
+        TEST_RANGE(snapshot.mem.percent_used, 0.1, 100.0);
+        TEST_EQ(snapshot.cpu_time.monotonic_ns > 0 && snapshot.cpu_time.monotonic_ns <= snapshot.storage_time.monotonic_ns, 1);
+        TEST_EQ(snapshot.systime_time.boottime_ns >= snapshot.systime_time.monotonic_ns / 2, 1);
+        for (int i = 0; i < 3; i++) {
+                TEST_EQ(sl_sampler_snapshot_collect(sampler, SL_SNAPSHOT_CPU | SL_SNAPSHOT_SYSTIME | SL_SNAPSHOT_IO_URING,
+                                                    NULL, 0, &snapshot), 0);
+                TEST_EQ(snapshot.collected, SL_SNAPSHOT_CPU | SL_SNAPSHOT_SYSTIME);
+                TEST_EQ(snapshot.cpu.user > 0 && snapshot.systime.uptime > 0.1 && snapshot.mem_time.monotonic_ns == 0, 1);
+        }
+        TEST_EQ(sl_sampler_snapshot_collect(sampler, SL_SNAPSHOT_MEM | SL_SNAPSHOT_STORAGE, snapshot_paths + 1, 1, &snapshot), 0);
+        TEST_EQ(snapshot.collected == (SL_SNAPSHOT_MEM | SL_SNAPSHOT_STORAGE) && snapshot.cpu.user == 0, 1);
+        const char *bad_paths[] = {"/", "/notexistfolder"};
+        TEST_EQ(sl_snapshot_collect(SL_SNAPSHOT_SYSTIME | SL_SNAPSHOT_STORAGE, bad_paths, 2, &snapshot), -1);
+        TEST_EQ(snapshot.collected, SL_SNAPSHOT_SYSTIME);
+        TEST_EQ(sl_snapshot_collect(0, NULL, 0, &snapshot), -1);
+        TEST_EQ(sl_snapshot_collect(SL_SNAPSHOT_STORAGE, NULL, 1, &snapshot), -1);
+        TEST_EQ(sl_sampler_snapshot_collect(NULL, SL_SNAPSHOT_CPU, NULL, 0, &snapshot), -1);
+
+        sl_cpu_cores_t cores_start, cores_end;
+        sl_cpu_usage_t core_usage[64];
+        TEST_EQ(sl_cpu_cores_init(&cores_start, 0), 0);
+        TEST_EQ(sl_cpu_cores_init(&cores_end, 1), 0);
+        TEST_EQ(sl_cpu_get_raw_cores(&cores_start), 0);
+        TEST_EQ(sl_sampler_cpu_get_raw_cores(sampler, &cores_end), 0);
+        TEST_EQ(cores_end.count >= 1 && cores_end.count == cores_start.count, 1);
+        TEST_EQ(sl_cpu_calculate_cores(&cores_start, &cores_end, core_usage, 64) == (cores_end.count < 64 ? cores_end.count : 64), 1);
+        TEST_EQ(sl_cpu_calculate_cores(&cores_start, &cores_end, NULL, 64), -1);
+        sl_cpu_cores_free(&cores_start);
+        sl_cpu_cores_free(&cores_end);
+
+        sl_cpu_delta_t delta;
+        sl_cpu_raw_t delta_raw = {100, 0, 50, 850, 0, 0, 0, 0};
+        double elapsed = 0.0;
+        sl_cpu_delta_init(&delta);
+        TEST_EQ(sl_cpu_delta_update(&delta, sampler, &cpu, &elapsed), 1);
+        TEST_EQ(sl_cpu_delta_update(&delta, NULL, &cpu, NULL) >= 0, 1);
+        sl_cpu_delta_init(&delta);
+        TEST_EQ(sl_cpu_delta_feed(&delta, &delta_raw, 1000000000ULL, &cpu, &elapsed), 1);
+        delta_raw.user += 30; delta_raw.idle += 70;
+        TEST_EQ(sl_cpu_delta_feed(&delta, &delta_raw, 2000000000ULL, &cpu, &elapsed), 0);
+        TEST_RANGE(cpu.total, 29.9, 30.1);
+        TEST_RANGE(elapsed, 0.99, 1.01);
+        delta_raw.user = 10; delta_raw.idle = 20;
+        TEST_EQ(sl_cpu_delta_feed(&delta, &delta_raw, 3000000000ULL, &cpu, &elapsed), 1);
+        delta_raw.user += 10; delta_raw.idle += 10;
+        TEST_EQ(sl_cpu_delta_feed(&delta, &delta_raw, 4000000000ULL, &cpu, &elapsed), 0);
+        TEST_RANGE(cpu.total, 49.9, 50.1);
+        TEST_EQ(sl_cpu_delta_feed(&delta, NULL, 0, &cpu, NULL), -1);
+
+        static sl_disk_raw_t disk_start, disk_end;
+        sl_disk_usage_t disk_usage[SL_DISK_MAX_DEVICES];
+        TEST_EQ(sl_disk_get_raw(&disk_start, SL_DISK_INCLUDE_PARTITIONS | SL_DISK_INCLUDE_VIRTUAL), 0);
+        TEST_EQ(sl_sampler_disk_get_raw(sampler, &disk_end, SL_DISK_INCLUDE_PARTITIONS | SL_DISK_INCLUDE_VIRTUAL), 0);
+        TEST_EQ(disk_end.count >= 0 && disk_end.count <= SL_DISK_MAX_DEVICES, 1);
+        TEST_EQ(sl_disk_calculate(&disk_start, &disk_end, disk_usage, SL_DISK_MAX_DEVICES) >= 0, 1);
+        TEST_EQ(sl_disk_calculate(&disk_start, &disk_end, NULL, SL_DISK_MAX_DEVICES), -1);
+        TEST_EQ(sl_disk_get_raw(NULL, 0), -1);
+
+        static sl_net_raw_t net_start, net_end;
+        sl_net_usage_t net_usage[SL_NET_MAX_IFACES];
+        TEST_EQ(sl_net_get_raw(&net_start), 0);
+        TEST_EQ(sl_sampler_net_get_raw(sampler, &net_end), 0);
+        TEST_EQ(net_end.count >= 1, 1);
+        TEST_EQ(sl_net_calculate(&net_start, &net_end, net_usage, SL_NET_MAX_IFACES), net_end.count);
+        TEST_EQ(sl_net_get_raw(NULL), -1);
+
+        sl_loadavg_t load;
+        TEST_EQ(sl_loadavg_get_info(&load), 0);
+        TEST_EQ(sl_sampler_loadavg_get_info(sampler, &load), 0);
+        TEST_EQ(load.total >= 1 && load.last_pid > 0, 1);
+        TEST_EQ(sl_loadavg_get_info(NULL), -1);
+
+        /* PSI needs CONFIG_PSI and psi=1; unprivileged triggers need a 2 s window multiple */
+        sl_psi_raw_t psi_start, psi_end;
+        sl_psi_usage_t psi_usage;
+        if (sl_psi_get_raw(SL_PSI_CPU, &psi_start) == 0) {
+                TEST_EQ(sl_sampler_psi_get_raw(sampler, SL_PSI_CPU, &psi_end), 0);
+                TEST_EQ(sl_psi_calculate(&psi_start, &psi_end, &psi_usage), 0);
+                TEST_RANGE(psi_usage.some_percent, 0.0, 100.0);
+
+                sl_psi_trigger_t trigger;
+                if (sl_psi_trigger_open(&trigger, SL_PSI_CPU, 0, 500000, 2000000) == 0) {
+                        TEST_EQ(sl_psi_trigger_wait(&trigger, 0) >= 0, 1);
+                        sl_psi_trigger_close(&trigger);
+                        TEST_EQ(trigger.fd, -1);
+                }
+        }
+        TEST_EQ(sl_sampler_psi_get_raw(sampler, SL_PSI_RESOURCES, &psi_end), -1);
+
+        /* Hosts with only cgroup v1 have no group to open */
+        sl_cgroup_t *cgroup = sl_cgroup_create(NULL);
+        if (cgroup) {
+                sl_cgroup_raw_t cg_start, cg_end;
+                sl_cgroup_usage_t cg_usage;
+                TEST_EQ(sl_cgroup_get_raw(cgroup, &cg_start), 0);
+                TEST_EQ(sl_cgroup_get_raw(cgroup, &cg_end), 0);
+                TEST_EQ(sl_cgroup_calculate(&cg_start, &cg_end, &cg_usage), 0);
+                TEST_EQ(cg_usage.cpu_limit > 0.0, 1);
+                sl_cgroup_destroy(cgroup);
+        }
+        TEST_EQ(sl_cgroup_get_raw(NULL, NULL), -1);
+
+        sl_vmstat_t *vmstat = sl_vmstat_create(NULL, 0);
+        sl_vmstat_raw_t vm_start, vm_end;
+        sl_vmstat_rates_t vm_rates;
+        TEST_EQ(vmstat != NULL, 1);
+        TEST_EQ(sl_vmstat_get_raw(vmstat, &vm_start), 0);
+        TEST_EQ(sl_vmstat_get_raw(vmstat, &vm_end), 0);
+        TEST_EQ((vm_end.present & (1u << SL_VMSTAT_PGFAULT)) && vm_end.values[SL_VMSTAT_PGFAULT] > 0, 1);
+        TEST_EQ(sl_vmstat_calculate(&vm_start, &vm_end, &vm_rates), 0);
+        TEST_EQ(vm_rates.count == SL_VMSTAT_DEFAULT_KEYS && vm_rates.per_sec[SL_VMSTAT_PGFAULT] >= 0.0, 1);
+        sl_vmstat_destroy(vmstat);
+
+        sl_sampler_destroy(sampler);
+
+        /* 400 one-second samples cycling 0..99%; capacity rounds up to 256 */
+        float windows[2] = {60.0f, 300.0f};
+        sl_history_t *history = sl_history_create(200, windows, 2);
+        sl_cpu_usage_t hist_cpu = {0};
+        sl_mem_info_t hist_mem = {0};
+        sl_history_stats_t hist_stats;
+        TEST_EQ(history != NULL, 1);
+        TEST_EQ(sl_history_stats(history, SL_METRIC_CPU_TOTAL, 0, &hist_stats), 0);
+        TEST_EQ(hist_stats.count, 0);
+        int hist_failed = 0;
+        for (int i = 0; i < 400; i++) {
+                hist_cpu.total = (float)(i % 100);
+                hist_mem.percent_used = 50.0f;
+                hist_mem.swap_total = 100;
+                hist_mem.swap_used = (uint64_t)(i % 10);
+                if (sl_history_push(history, 1000000000ULL * (uint64_t)(i + 1), &hist_cpu, &hist_mem) != 0) hist_failed++;
+        }
+        TEST_EQ(hist_failed, 0);
+        TEST_EQ(sl_history_stats(history, SL_METRIC_CPU_TOTAL, 0, &hist_stats), 0);
+        TEST_EQ(hist_stats.count, 60);
+        TEST_RANGE(hist_stats.min, 40.0, 40.0);
+        TEST_RANGE(hist_stats.max, 99.0, 99.0);
+        TEST_RANGE(hist_stats.mean, 69.49, 69.51);
+        TEST_RANGE(hist_stats.p50, 69.0, 70.0);
+        TEST_RANGE(hist_stats.p95, 96.0, 97.0);
+        TEST_EQ(sl_history_stats(history, SL_METRIC_CPU_TOTAL, 1, &hist_stats), 0);
+        TEST_EQ(hist_stats.count, 256);
+        TEST_RANGE(hist_stats.min, 0.0, 0.0);
+        TEST_RANGE(hist_stats.mean, 54.30, 54.32);
+        TEST_EQ(sl_history_stats(history, SL_METRIC_MEM_USED, 1, &hist_stats), 0);
+        TEST_RANGE(hist_stats.p99, 50.0, 50.0);
+        TEST_EQ(sl_history_stats(history, SL_METRIC_SWAP_USED, 0, &hist_stats), 0);
+        TEST_RANGE(hist_stats.max, 9.0, 9.0);
+
+        float hist_values[8];
+        uint64_t hist_times[8];
+        TEST_EQ(sl_history_read(history, SL_METRIC_CPU_TOTAL, hist_times, hist_values, 8), 8);
+        TEST_EQ(hist_values[7] == 99.0f && hist_times[7] == 400000000000ULL, 1);
+        TEST_EQ(sl_history_push(history, 1000, &hist_cpu, &hist_mem), -1);
+        TEST_EQ(sl_history_stats(history, SL_METRIC_COUNT, 0, &hist_stats), -1);
+        TEST_EQ(sl_history_create(16, windows, 0) == NULL, 1);
+        sl_history_destroy(history);
+
+        char rec_path[] = "/tmp/sysload_test_XXXXXX";
+        int rec_fd = mkstemp(rec_path);
+        TEST_EQ(rec_fd >= 0, 1);
+        close(rec_fd);
+        sl_recorder_t *rec = sl_recorder_open(rec_path, 0);
+        sl_cpu_raw_t rec_cpu = {1000, 20, 300, 90000, 50, 7, 8, 0};
+        sl_cpu_raw_t rec_cpu_reset = {10, 0, 5, 400, 0, 0, 0, 0};
+        sl_mem_info_t rec_mem = {.total = 16000000, .free = 2000000, .available = 8000000, .buffers = 100000,
+                                 .cached = 4000000, .shared = 300000, .swap_total = 1000000, .swap_free = 900000};
+        sl_systime_info_t rec_time = {12345.67, 40000.5};
+        sl_storage_info_t rec_disk = {.total = 500ULL << 30, .free = 100ULL << 30, .available = 80ULL << 30};
+        TEST_EQ(rec != NULL, 1);
+        TEST_EQ(sl_recorder_write_cpu(rec, 1000000000ULL, &rec_cpu), 0);
+        TEST_EQ(sl_recorder_write_mem(rec, 1000000001ULL, &rec_mem), 0);
+        TEST_EQ(sl_recorder_write_systime(rec, 1000000002ULL, &rec_time), 0);
+        TEST_EQ(sl_recorder_write_storage(rec, 1000000003ULL, 3, &rec_disk), 0);
+        TEST_EQ(sl_recorder_write_storage(rec, 0, SL_RECORD_MAX_SLOTS, &rec_disk), -1);
+        TEST_EQ(sl_recorder_write_cpu(rec, 1100000000ULL, &rec_cpu_reset), 0);
+        TEST_EQ(sl_recorder_close(rec), 0);
+
+        /* A block torn by a crash, then a second session appended after it */
+        FILE *rec_file = fopen(rec_path, "ab");
+        fwrite("\xA5SL\x5A\xE8\x03\x00\x00\x01\x02\x03", 1, 11, rec_file);
+        fclose(rec_file);
+        rec = sl_recorder_open(rec_path, 4096);
+        TEST_EQ(rec != NULL, 1);
+        int rec_failed = 0;
+        for (int i = 1; i <= 500; i++) {
+                rec_cpu.user += 7;
+                rec_cpu.idle += 93;
+                if (sl_recorder_write_cpu(rec, 2000000000ULL + 100000000ULL * (uint64_t)i, &rec_cpu) != 0) rec_failed++;
+        }
+        TEST_EQ(rec_failed, 0);
+        TEST_EQ(sl_recorder_close(rec), 0);
+
+        sl_replay_t *replay = sl_replay_open(rec_path);
+        sl_record_t rec_in;
+        int rec_sessions = 0, rec_cpus = 0;
+        TEST_EQ(replay != NULL, 1);
+        TEST_EQ(sl_replay_next(replay, &rec_in) == 1 && rec_in.type == SL_RECORD_SESSION && rec_in.realtime_ns > 0, 1);
+        TEST_EQ(sl_replay_next(replay, &rec_in) == 1 && rec_in.type == SL_RECORD_CPU, 1);
+        TEST_EQ(rec_in.timestamp_ns == 1000000000ULL && memcmp(&rec_in.cpu, &(sl_cpu_raw_t){1000, 20, 300, 90000, 50, 7, 8, 0}, sizeof(sl_cpu_raw_t)) == 0, 1);
+        TEST_EQ(sl_replay_next(replay, &rec_in) == 1 && rec_in.type == SL_RECORD_MEM, 1);
+        TEST_EQ(sl_mem_calculate(&rec_in.mem), 0);
+        TEST_EQ(rec_in.mem.shared == 300000 && rec_in.mem.swap_used == 100000 && rec_in.mem.used == 8000000, 1);
+        TEST_EQ(sl_replay_next(replay, &rec_in) == 1 && rec_in.type == SL_RECORD_SYSTIME, 1);
+        TEST_RANGE(rec_in.systime.uptime, 12345.665, 12345.675);
+        TEST_RANGE(rec_in.systime.idle_time, 40000.495, 40000.505);
+        TEST_EQ(sl_replay_next(replay, &rec_in) == 1 && rec_in.type == SL_RECORD_STORAGE && rec_in.slot == 3, 1);
+        TEST_EQ(rec_in.storage.used == (400ULL << 30) && rec_in.timestamp_ns == 1000000003ULL, 1);
+        TEST_RANGE(rec_in.storage.percent_usage, 80.0, 80.0);
+        TEST_EQ(sl_replay_next(replay, &rec_in) == 1 && rec_in.type == SL_RECORD_CPU, 1);
+        TEST_EQ(memcmp(&rec_in.cpu, &rec_cpu_reset, sizeof(sl_cpu_raw_t)), 0);
+        while (sl_replay_next(replay, &rec_in) == 1) {
+                rec_sessions += (rec_in.type == SL_RECORD_SESSION);
+                rec_cpus += (rec_in.type == SL_RECORD_CPU);
+        }
+        TEST_EQ(rec_sessions, 1);
+        TEST_EQ(rec_cpus, 500);
+        TEST_EQ(memcmp(&rec_in.cpu, &rec_cpu, sizeof(sl_cpu_raw_t)) == 0 && rec_in.timestamp_ns == 52000000000ULL, 1);
+        TEST_EQ(sl_replay_next(replay, &rec_in), 0);
+        sl_replay_close(replay);
+
+        rec_file = fopen(rec_path, "wb");
+        fputs("not a recording\n", rec_file);
+        fclose(rec_file);
+        TEST_EQ(sl_recorder_open(rec_path, 0) == NULL, 1);
+        TEST_EQ(sl_replay_open(rec_path) == NULL, 1);
+        unlink(rec_path);
+
+        sl_proc_sampler_t *procs = sl_proc_sampler_create();
+        sl_proc_handle_t handle;
+        sl_proc_raw_t proc_start, proc_end, threads[8];
+        sl_proc_usage_t proc_usage;
+        TEST_EQ(procs != NULL, 1);
+        TEST_EQ(sl_proc_get_raw(procs, getpid(), &proc_start), 0);
+        TEST_EQ(proc_start.pid == getpid() && proc_start.rss > 0 && proc_start.num_threads >= 1, 1);
+        TEST_EQ(sl_proc_open(procs, getpid(), &handle), 0);
+        for (volatile long spin = 0; spin < 20000000L; spin++);
+        TEST_EQ(sl_proc_handle_get_raw(procs, &handle, &proc_end), 0);
+        TEST_EQ(sl_proc_calculate(&proc_start, &proc_end, &proc_usage), 0);
+        /* utime and stime are whole clock ticks, so each may be one tick ahead of the interval */
+        double proc_elapsed = (double)(proc_end.timestamp_ns - proc_start.timestamp_ns) / 1e9;
+        double tick_slack = 2.0 * 100.0 / ((double)sysconf(_SC_CLK_TCK) * proc_elapsed);
+        TEST_RANGE(proc_usage.total, 0.0, 100.0 * sysconf(_SC_NPROCESSORS_ONLN) + tick_slack);
+        TEST_EQ(sl_proc_get_threads(procs, getpid(), threads, 8) >= 1, 1);
+        TEST_EQ(sl_proc_get_raw(procs, 0, &proc_start), -1);
+        proc_end.start_time++;
+        TEST_EQ(sl_proc_calculate(&proc_start, &proc_end, &proc_usage), -1);
+        sl_proc_close(&handle);
+        sl_proc_sampler_destroy(procs);
+
+        sl_proc_top_t *top = sl_proc_top_create(NULL, 4096, 5, SL_PROC_TOP_RSS);
+        sl_proc_top_entry_t top_entries[5];
+        TEST_EQ(top != NULL, 1);
+        TEST_EQ(sl_proc_top_refresh(top, top_entries, 5) >= 1, 1);
+        int top_count = sl_proc_top_refresh(top, top_entries, 5);
+        TEST_EQ(top_count >= 1, 1);
+        TEST_EQ(top_count < 2 || top_entries[0].rss >= top_entries[1].rss, 1);
+        TEST_EQ(sl_proc_top_refresh(top, NULL, 5), -1);
+        sl_proc_top_destroy(top);
+        TEST_EQ(sl_proc_top_create("/notexistfolder", 16, 5, SL_PROC_TOP_CPU) == NULL, 1);
+
+        /* available = 0 makes sl_mem_calculate() warn and fall back */
+        sl_mem_info_t log_mem = {.total = 1000, .free = 100};
+        sl_set_log_handler(count_log, NULL);
+        TEST_EQ(sl_mem_calculate(&log_mem), 0);
+        TEST_EQ(g_log_count[SL_LOG_WARN], 1);
+        sl_set_log_level(SL_LOG_ERROR);
+        TEST_EQ(sl_mem_calculate(&log_mem), 0);
+        TEST_EQ(sl_cpu_get_raw(NULL), -1);
+        TEST_EQ(g_log_count[SL_LOG_WARN] == 1 && g_log_count[SL_LOG_ERROR] == 1, 1);
+        sl_set_log_level(SL_LOG_INFO);
+        sl_set_log_deferred(1);
+        for (int i = 0; i < 70; i++) {
+                sl_cpu_get_raw(NULL);
+        }
+        TEST_EQ(g_log_count[SL_LOG_ERROR], 1);
+        TEST_EQ(sl_log_drain(), 64);
+        TEST_EQ(g_log_count[SL_LOG_ERROR] == 65 && g_log_count[SL_LOG_WARN] == 2, 1);
+        TEST_EQ(sl_log_drain(), 0);
+        sl_set_log_deferred(0);
+        sl_set_log_handler(NULL, NULL);
+
+        const char *mounts[] = {"/"};
+        sl_monitor_snapshot_t snap;
+        TEST_EQ(sl_monitor_read(&snap), -1);
+        TEST_EQ(sl_monitor_start(0.05f, mounts, 1), 0);
+        TEST_EQ(sl_monitor_start(0.05f, mounts, 1), -1);
+        struct timespec tick = {0, 20 * 1000000L};
+        for (int i = 0; i < 50 && (sl_monitor_read(&snap) != 0 || snap.sequence < 2); i++) {
+                nanosleep(&tick, NULL);
+        }
+        TEST_EQ(sl_monitor_read(&snap), 0);
+        TEST_EQ(snap.sequence >= 2 && snap.storage_count == 1, 1);
+        TEST_RANGE(snap.cpu.total, 0.0, 100.0);
+        TEST_RANGE(snap.mem.percent_used, 0.1, 100.0);
+        TEST_EQ(snap.storage[0].total > 0, 1);
+        TEST_EQ(snap.collected & (SL_SNAPSHOT_MEM | SL_SNAPSHOT_SYSTIME | SL_SNAPSHOT_STORAGE),
+                SL_SNAPSHOT_MEM | SL_SNAPSHOT_SYSTIME | SL_SNAPSHOT_STORAGE);
+        TEST_EQ(sl_monitor_stop(), 0);
+        TEST_EQ(sl_monitor_stop(), -1);
+
+        /* A missing mount is left out of collected and logged once, not every interval */
+        const char *bad_mounts[] = {"/", "/notexistfolder"};
+        memset(g_log_count, 0, sizeof(g_log_count));
+        sl_set_log_handler(count_log, NULL);
+        TEST_EQ(sl_monitor_start(0.02f, bad_mounts, 2), 0);
+        for (int i = 0; i < 50 && (sl_monitor_read(&snap) != 0 || snap.sequence < 4); i++) {
+                nanosleep(&tick, NULL);
+        }
+        TEST_EQ(sl_monitor_stop(), 0);
+        sl_set_log_handler(NULL, NULL);
+        TEST_EQ(snap.sequence >= 4 && snap.storage[0].total > 0, 1);
+        TEST_EQ(snap.collected & (SL_SNAPSHOT_MEM | SL_SNAPSHOT_STORAGE), SL_SNAPSHOT_MEM);
+        TEST_EQ(g_log_count[SL_LOG_ERROR], 1);
+
+        /* Cross-process sharing: one publisher per name, subscribers fall back without it */
+        char shm_name[SL_SHARED_NAME_SIZE];
+        snprintf(shm_name, sizeof(shm_name), "/sysload-test-%d", (int)getpid());
+        sl_subscriber_t *subscriber = sl_subscriber_create(shm_name, 0.2f, mounts, 1);
+        TEST_EQ(subscriber != NULL, 1);
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 1);
+        TEST_EQ(snap.storage_count == 1 && snap.storage[0].total > 0 && snap.mem.total > 0, 1);
+
+        sl_publisher_t *publisher = sl_publisher_create(shm_name, mounts, 1);
+        TEST_EQ(publisher != NULL, 1);
+        TEST_EQ(sl_publisher_create(shm_name, NULL, 0) == NULL, 1);
+        TEST_EQ(sl_publisher_update(publisher), 0);
+        nanosleep(&tick, NULL);
+        TEST_EQ(sl_publisher_update(publisher), 0);
+
+        /* Attaches on the next retry, at most max_age after the last attempt */
+        struct timespec retry = {0, 250 * 1000000L};
+        nanosleep(&retry, NULL);
+        TEST_EQ(sl_publisher_update(publisher), 0);
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 0);
+        TEST_EQ(snap.sequence == 3 && snap.storage_count == 1, 1);
+        TEST_RANGE(snap.cpu.total, 0.0, 100.0);
+        TEST_EQ(snap.storage[0].total > 0 && snap.mem.total > 0, 1);
+
+        /* Stale heartbeat, then a stopped publisher */
+        nanosleep(&retry, NULL);
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 1);
+        TEST_EQ(sl_publisher_update(publisher), 0);
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 0);
+        TEST_EQ(snap.sequence, 4);
+        sl_publisher_destroy(publisher);
+        TEST_EQ(sl_subscriber_read(subscriber, &snap), 1);
+        sl_subscriber_destroy(subscriber);
+
+        TEST_EQ(sl_publisher_create("no-slash", NULL, 0) == NULL, 1);
+        TEST_EQ(sl_subscriber_create(NULL, 0.0f, NULL, 0) == NULL, 1);
+        TEST_EQ(sl_subscriber_read(NULL, &snap), -1);
+
+        /* Scheduler: 20 ms CPU, 40 ms memory, 100 ms storage, a self-removing 10 ms custom collector */
+        sched_counts_t counts;
+        memset(&counts, 0, sizeof(counts));
+        sl_sched_t *sched = sl_sched_create();
+        TEST_EQ(sched != NULL, 1);
+        TEST_EQ(sl_sched_fd(sched) >= 0, 1);
+        counts.sched = sched;
+        int cpu_id = sl_sched_add(sched, SL_SCHED_CPU, NULL, 0.02f, count_sched, &counts);
+        int mem_id = sl_sched_add(sched, SL_SCHED_MEM, NULL, 0.04f, count_sched, &counts);
+        int storage_id = sl_sched_add(sched, SL_SCHED_STORAGE, "/", 0.1f, count_sched, &counts);
+        int custom_id = sl_sched_add(sched, SL_SCHED_CUSTOM, NULL, 0.01f, count_sched, &counts);
+        counts.cpu_id = cpu_id;
+        TEST_EQ(cpu_id >= 0 && mem_id >= 0 && storage_id >= 0 && custom_id >= 0, 1);
+        TEST_EQ(sl_sched_dispatch(sched), 0);
+
+        uint64_t sched_end = now_ns() + 420 * 1000000ULL;
+        int batches = 0;
+        while (now_ns() < sched_end) {
+                if (sl_sched_run(sched, 50) > 0) batches++;
+        }
+        TEST_RANGE(counts.runs[cpu_id], 15, 22);
+        TEST_RANGE(counts.runs[mem_id], 7, 11);
+        TEST_RANGE(counts.runs[storage_id], 3, 5);
+        TEST_EQ(counts.runs[custom_id], 3);
+        TEST_EQ(counts.failed, 0);
+        TEST_EQ(counts.storage_total > 0, 1);
+        /* Every memory tick is also a CPU tick, so they always share a batch */
+        TEST_EQ(counts.mem_with_cpu, counts.runs[mem_id]);
+        TEST_RANGE(batches, counts.runs[cpu_id] - 1, counts.runs[cpu_id] + 4);
+        TEST_EQ(sl_sched_remove(sched, custom_id), -1);
+
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_CPU, NULL, 0.0001f, count_sched, &counts), -1);
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_CPU, NULL, -1.0f, count_sched, &counts), -1);
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_CPU, NULL, NAN, count_sched, &counts), -1);
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_STORAGE, NULL, 1.0f, count_sched, &counts), -1);
+        TEST_EQ(sl_sched_add(sched, SL_SCHED_MEM, NULL, 1.0f, NULL, NULL), -1);
+        TEST_EQ(sl_sched_remove(sched, cpu_id), 0);
+        TEST_EQ(sl_sched_remove(sched, mem_id), 0);
+        TEST_EQ(sl_sched_remove(sched, storage_id), 0);
+
+        /* Storage runs on the statvfs() workers; a path they fail on gives status -1 */
+        TEST_EQ(sl_sched_set_storage_timeout(NULL, 100), -1);
+        TEST_EQ(sl_sched_set_storage_timeout(sched, 1000), 0);
+        int bad_id = sl_sched_add(sched, SL_SCHED_STORAGE, "/notexistfolder", 0.01f, count_sched, &counts);
+        counts.runs[bad_id] = 0;
+        TEST_EQ(sl_sched_run(sched, 50), 1);
+        TEST_EQ(counts.failed == 1 && counts.runs[bad_id] == 1, 1);
+        TEST_EQ(sl_sched_remove(sched, bad_id), 0);
+        TEST_EQ(sl_sched_run(sched, 30), 0);
+        sl_sched_destroy(sched);
+        sl_sched_destroy(NULL);
+
+        TEST_SUMMARY();
         return (passed == total) ? 0 : -1;
 }
\ No newline at end of file
@@ -0,0 +1,599 @@
+/**
+ * Prometheus/OpenMetrics exporter.
+ * Serves CPU time per mode, memory, swap, storage per mount and uptime at
+ * /metrics from a single-threaded epoll loop. /proc is read at most once per
+ * interval however many clients scrape; the text is rendered once per
+ * collection into a preallocated buffer, without printf, and shared by all
+ * responses until the next one.
+ * Run with: ./sysload_exporter [-l address] [-p port] [-i seconds] [mount ...]
+ */
+
+#define _GNU_SOURCE     /* accept4 */
+#include "sysload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define EXPORTER_PORT 9180
+#define EXPORTER_MAX_CONNS 64
+#define EXPORTER_REQUEST_SIZE 2048
+#define EXPORTER_HEADER_SIZE 256
+#define EXPORTER_BODY_SIZE 65536
+#define EXPORTER_BODIES 3               /* Rendered texts: the current one and older ones still sending */
+#define EXPORTER_IDLE_NS (10 * 1000000000ULL)
+#define EXPORTER_LISTEN_ID UINT32_MAX
+
+#define CONTENT_TYPE_METRICS "application/openmetrics-text; version=1.0.0; charset=utf-8"
+#define CONTENT_TYPE_TEXT "text/plain; charset=utf-8"
+
+/* One client connection; slots are preallocated and reused */
+typedef struct
+{
+        int fd;                                 /**< -1 if the slot is free */
+        uint64_t accepted_ns;                   /**< Connections idle past EXPORTER_IDLE_NS are dropped */
+        size_t request_len;
+        char request[EXPORTER_REQUEST_SIZE];
+        char header[EXPORTER_HEADER_SIZE];
+        size_t header_len;
+        const char *body;
+        size_t body_len;
+        size_t sent;                            /**< Bytes of header and body written so far */
+        int metrics;                            /**< Index of the g_metrics text body points into, -1 if none */
+} conn_t;
+
+/* Bounded output cursor; overflow truncates instead of writing past end */
+typedef struct
+{
+        char *p;
+        char *end;
+        int overflow;
+} out_t;
+
+static volatile sig_atomic_t g_stop;
+static conn_t g_conns[EXPORTER_MAX_CONNS];
+
+/* Rendered texts; responses keep sending the one they started with */
+static struct
+{
+        char text[EXPORTER_BODY_SIZE];
+        size_t len;
+        int users;                      /**< Responses still sending this text */
+} g_metrics[EXPORTER_BODIES];
+static int g_metrics_current;
+static uint64_t g_metrics_ns;           /**< When the current text was collected, 0 = never */
+
+static sl_sampler_t *g_sampler;
+static const char *g_mounts[SL_SNAPSHOT_MAX_PATHS];
+static int g_mount_count;
+static uint64_t g_interval_ns = 1000000000ULL;
+static uint64_t g_clk_tck = 100;
+static uint64_t g_collect_errors;
+
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* ------------------- Text rendering -------------------------- */
+
+static void put_mem(out_t *o, const char *s, size_t n)
+{
+        if ((size_t)(o->end - o->p) < n) {
+                o->overflow = 1;
+                return;
+        }
+        memcpy(o->p, s, n);
+        o->p += n;
+}
+
+static void put_str(out_t *o, const char *s)
+{
+        put_mem(o, s, strlen(s));
+}
+
+static void put_u64(out_t *o, uint64_t value)
+{
+        char digits[20];
+        int n = 0;
+
+        do {
+                digits[n++] = (char)('0' + value % 10);
+                value /= 10;
+        } while (value);
+
+        char out[20];
+        for (int i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+        put_mem(o, out, (size_t)n);
+}
+
+/* value / scale with two decimals, exact for USER_HZ tick counts */
+static void put_ratio(out_t *o, uint64_t value, uint64_t scale)
+{
+        uint64_t hundredths = (value % scale) * 100 / scale;
+        char frac[3] = {'.', (char)('0' + hundredths / 10), (char)('0' + hundredths % 10)};
+
+        put_u64(o, value / scale);
+        put_mem(o, frac, sizeof(frac));
+}
+
+/* Label values escape backslash, double quote and newline */
+static void put_label_value(out_t *o, const char *s)
+{
+        for (; *s; s++) {
+                if (*s == '\\') put_mem(o, "\\\\", 2);
+                else if (*s == '"') put_mem(o, "\\\"", 2);
+                else if (*s == '\n') put_mem(o, "\\n", 2);
+                else put_mem(o, s, 1);
+        }
+}
+
+static void put_family(out_t *o, const char *name, const char *type, const char *unit, const char *help)
+{
+        put_str(o, "# TYPE "); put_str(o, name); put_str(o, " "); put_str(o, type); put_str(o, "\n");
+        if (unit) {
+                put_str(o, "# UNIT "); put_str(o, name); put_str(o, " "); put_str(o, unit); put_str(o, "\n");
+        }
+        put_str(o, "# HELP "); put_str(o, name); put_str(o, " "); put_str(o, help); put_str(o, "\n");
+}
+
+static const struct
+{
+        const char *mode;
+        size_t offset;
+} cpu_modes[] = {
+        {"user",    offsetof(sl_cpu_raw_t, user)},
+        {"nice",    offsetof(sl_cpu_raw_t, nice)},
+        {"system",  offsetof(sl_cpu_raw_t, system)},
+        {"idle",    offsetof(sl_cpu_raw_t, idle)},
+        {"iowait",  offsetof(sl_cpu_raw_t, iowait)},
+        {"irq",     offsetof(sl_cpu_raw_t, irq)},
+        {"softirq", offsetof(sl_cpu_raw_t, softirq)},
+        {"steal",   offsetof(sl_cpu_raw_t, steal)},
+};
+
+/* Fields of sl_mem_info_t, all in KB */
+static const struct
+{
+        const char *name;
+        size_t offset;
+        const char *help;
+} mem_metrics[] = {
+        {"sysload_memory_total_bytes",     offsetof(sl_mem_info_t, total),      "Usable RAM."},
+        {"sysload_memory_free_bytes",      offsetof(sl_mem_info_t, free),       "Unused RAM."},
+        {"sysload_memory_available_bytes", offsetof(sl_mem_info_t, available),  "RAM available without swapping."},
+        {"sysload_memory_buffers_bytes",   offsetof(sl_mem_info_t, buffers),    "RAM used for block device buffers."},
+        {"sysload_memory_cached_bytes",    offsetof(sl_mem_info_t, cached),     "RAM used for the page cache."},
+        {"sysload_memory_shared_bytes",    offsetof(sl_mem_info_t, shared),     "RAM used by shmem and tmpfs."},
+        {"sysload_memory_used_bytes",      offsetof(sl_mem_info_t, used),       "RAM in use (total minus available)."},
+        {"sysload_swap_total_bytes",       offsetof(sl_mem_info_t, swap_total), "Swap space."},
+        {"sysload_swap_free_bytes",        offsetof(sl_mem_info_t, swap_free),  "Unused swap space."},
+        {"sysload_swap_used_bytes",        offsetof(sl_mem_info_t, swap_used),  "Swap space in use."},
+};
+
+/* Fields of sl_storage_info_t, in bytes */
+static const struct
+{
+        const char *name;
+        size_t offset;
+        const char *help;
+} storage_metrics[] = {
+        {"sysload_filesystem_size_bytes",  offsetof(sl_storage_info_t, total),     "Filesystem size."},
+        {"sysload_filesystem_free_bytes",  offsetof(sl_storage_info_t, free),      "Free space, including blocks reserved for root."},
+        {"sysload_filesystem_avail_bytes", offsetof(sl_storage_info_t, available), "Free space available to unprivileged users."},
+};
+
+static size_t render_metrics(char *buf, size_t size, const sl_snapshot_t *snap)
+{
+        out_t o = {buf, buf + size, 0};
+
+        if (snap->collected & SL_SNAPSHOT_CPU) {
+                put_family(&o, "sysload_cpu_seconds", "counter", "seconds", "Time all CPUs spent in each mode.");
+                for (size_t i = 0; i < sizeof(cpu_modes) / sizeof(cpu_modes[0]); i++) {
+                        uint64_t ticks;
+                        memcpy(&ticks, (const char *)&snap->cpu + cpu_modes[i].offset, sizeof(ticks));
+                        put_str(&o, "sysload_cpu_seconds_total{mode=\"");
+                        put_str(&o, cpu_modes[i].mode);
+                        put_str(&o, "\"} ");
+                        put_ratio(&o, ticks, g_clk_tck);
+                        put_str(&o, "\n");
+                }
+        }
+
+        if (snap->collected & SL_SNAPSHOT_MEM) {
+                for (size_t i = 0; i < sizeof(mem_metrics) / sizeof(mem_metrics[0]); i++) {
+                        uint64_t kb;
+                        memcpy(&kb, (const char *)&snap->mem + mem_metrics[i].offset, sizeof(kb));
+                        put_family(&o, mem_metrics[i].name, "gauge", "bytes", mem_metrics[i].help);
+                        put_str(&o, mem_metrics[i].name);
+                        put_str(&o, " ");
+                        put_u64(&o, kb * 1024);
+                        put_str(&o, "\n");
+                }
+        }
+
+        if (snap->collected & SL_SNAPSHOT_SYSTIME) {
+                put_family(&o, "sysload_uptime_seconds", "gauge", "seconds", "Time since boot.");
+                put_str(&o, "sysload_uptime_seconds ");
+                put_ratio(&o, (uint64_t)(snap->systime.uptime * 100.0), 100);
+                put_str(&o, "\n");
+                put_family(&o, "sysload_idle_seconds", "counter", "seconds", "Idle time summed over all CPUs since boot.");
+                put_str(&o, "sysload_idle_seconds_total ");
+                put_ratio(&o, (uint64_t)(snap->systime.idle_time * 100.0), 100);
+                put_str(&o, "\n");
+        }
+
+        /* Mounts that failed statvfs() are zeroed; leave them out rather than report an empty disk */
+        if (snap->storage_count > 0) {
+                for (size_t m = 0; m < sizeof(storage_metrics) / sizeof(storage_metrics[0]); m++) {
+                        put_family(&o, storage_metrics[m].name, "gauge", "bytes", storage_metrics[m].help);
+                        for (int i = 0; i < snap->storage_count; i++) {
+                                uint64_t bytes;
+                                if (snap->storage[i].total == 0) continue;
+                                memcpy(&bytes, (const char *)&snap->storage[i] + storage_metrics[m].offset, sizeof(bytes));
+                                put_str(&o, storage_metrics[m].name);
+                                put_str(&o, "{mountpoint=\"");
+                                put_label_value(&o, g_mounts[i]);
+                                put_str(&o, "\"} ");
+                                put_u64(&o, bytes);
+                                put_str(&o, "\n");
+                        }
+                }
+        }
+
+        put_family(&o, "sysload_collect_errors", "counter", NULL, "Collections where a metric group could not be read.");
+        put_str(&o, "sysload_collect_errors_total ");
+        put_u64(&o, g_collect_errors);
+        put_str(&o, "\n# EOF\n");
+
+        if (o.overflow) {
+                /* Cannot happen with SL_SNAPSHOT_MAX_PATHS mounts; keep the document well-formed anyway */
+                static const char eof[] = "# EOF\n";
+                size_t len = (size_t)(o.p - buf);
+                if (len > size - (sizeof(eof) - 1)) len = size - (sizeof(eof) - 1);
+                while (len > 0 && buf[len - 1] != '\n') len--;
+                memcpy(buf + len, eof, sizeof(eof) - 1);
+                return len + sizeof(eof) - 1;
+        }
+        return (size_t)(o.p - buf);
+}
+
+/*
+ * Collect and re-render unless the current text is younger than the
+ * interval. Rendering goes to a text no response is sending, so slow
+ * clients never see their body change and never hold back new data;
+ * only if every older text is still being sent does the current one
+ * stay until a sender finishes.
+ */
+static void refresh_metrics(void)
+{
+        uint64_t now = now_ns();
+        if (g_metrics_ns != 0 && now - g_metrics_ns < g_interval_ns) return;
+
+        int next = g_metrics_current;
+        for (int i = 1; i <= EXPORTER_BODIES; i++) {
+                int candidate = (g_metrics_current + i) % EXPORTER_BODIES;
+                if (g_metrics[candidate].users == 0) {
+                        next = candidate;
+                        break;
+                }
+        }
+        if (g_metrics[next].users > 0) return;
+
+        static sl_snapshot_t snap;
+        if (sl_sampler_snapshot_collect(g_sampler, SL_SNAPSHOT_ALL, g_mounts, g_mount_count, &snap) != 0) {
+                g_collect_errors++;
+        }
+
+        g_metrics[next].len = render_metrics(g_metrics[next].text, sizeof(g_metrics[next].text), &snap);
+        g_metrics_current = next;
+        g_metrics_ns = now;
+}
+
+/* ------------------- HTTP -------------------------------------- */
+
+static void conn_close(int epfd, conn_t *c)
+{
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        if (c->metrics >= 0) g_metrics[c->metrics].users--;
+        c->fd = -1;
+}
+
+static void conn_respond(conn_t *c, const char *status, const char *type, const char *body, size_t body_len, int head)
+{
+        out_t o = {c->header, c->header + sizeof(c->header), 0};
+
+        put_str(&o, "HTTP/1.1 ");
+        put_str(&o, status);
+        put_str(&o, "\r\nContent-Type: ");
+        put_str(&o, type);
+        put_str(&o, "\r\nContent-Length: ");
+        put_u64(&o, body_len);
+        put_str(&o, "\r\nConnection: close\r\n\r\n");
+
+        c->header_len = (size_t)(o.p - c->header);
+        c->body = body;
+        c->body_len = head ? 0 : body_len;
+        c->sent = 0;
+}
+
+/* Route a complete request head; the request line is all that matters */
+static void conn_dispatch(conn_t *c)
+{
+        static const char index[] = "sysload exporter, metrics at /metrics\n";
+        static const char not_found[] = "not found\n";
+        static const char bad_method[] = "method not allowed\n";
+
+        int head = (strncmp(c->request, "HEAD ", 5) == 0);
+        if (!head && strncmp(c->request, "GET ", 4) != 0) {
+                conn_respond(c, "405 Method Not Allowed", CONTENT_TYPE_TEXT, bad_method, sizeof(bad_method) - 1, 0);
+                return;
+        }
+
+        const char *path = c->request + (head ? 5 : 4);
+        size_t path_len = strcspn(path, " ?\r\n");
+
+        if (path_len == 8 && memcmp(path, "/metrics", 8) == 0) {
+                refresh_metrics();
+                conn_respond(c, "200 OK", CONTENT_TYPE_METRICS, g_metrics[g_metrics_current].text,
+                             g_metrics[g_metrics_current].len, head);
+                c->metrics = g_metrics_current;
+                g_metrics[g_metrics_current].users++;
+        } else if (path_len == 1 && path[0] == '/') {
+                conn_respond(c, "200 OK", CONTENT_TYPE_TEXT, index, sizeof(index) - 1, head);
+        } else {
+                conn_respond(c, "404 Not Found", CONTENT_TYPE_TEXT, not_found, sizeof(not_found) - 1, head);
+        }
+}
+
+/* Send what the socket takes; 1 when the response is complete, 0 to wait, -1 on error */
+static int conn_send(conn_t *c)
+{
+        size_t total = c->header_len + c->body_len;
+
+        while (c->sent < total) {
+                struct iovec iov[2];
+                int n = 0;
+                if (c->sent < c->header_len) {
+                        iov[n].iov_base = c->header + c->sent;
+                        iov[n++].iov_len = c->header_len - c->sent;
+                }
+                size_t body_off = (c->sent > c->header_len) ? c->sent - c->header_len : 0;
+                if (c->body_len > body_off) {
+                        iov[n].iov_base = (void *)(c->body + body_off);
+                        iov[n++].iov_len = c->body_len - body_off;
+                }
+
+                struct msghdr msg = {0};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = (size_t)n;
+                ssize_t w = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+                if (w < 0) {
+                        if (errno == EINTR) continue;
+                        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+                }
+                c->sent += (size_t)w;
+        }
+        return 1;
+}
+
+static void conn_event(int epfd, conn_t *c, uint32_t events)
+{
+        if (events & (EPOLLERR | EPOLLHUP)) {
+                conn_close(epfd, c);
+                return;
+        }
+
+        /* Still reading the request head */
+        if (c->header_len == 0) {
+                for (;;) {
+                        size_t room = sizeof(c->request) - 1 - c->request_len;
+                        if (room == 0) {
+                                conn_close(epfd, c);
+                                return;
+                        }
+                        ssize_t n = read(c->fd, c->request + c->request_len, room);
+                        if (n < 0 && errno == EINTR) continue;
+                        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                        if (n <= 0) {
+                                conn_close(epfd, c);
+                                return;
+                        }
+                        c->request_len += (size_t)n;
+                        c->request[c->request_len] = '\0';
+                        if (strstr(c->request, "\r\n\r\n")) break;
+                }
+                if (!strstr(c->request, "\r\n\r\n")) return;
+                conn_dispatch(c);
+        }
+
+        int ret = conn_send(c);
+        if (ret != 0) {
+                conn_close(epfd, c);
+                return;
+        }
+
+        struct epoll_event ev = {.events = EPOLLOUT, .data.u32 = (uint32_t)(c - g_conns)};
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void accept_all(int epfd, int listen_fd)
+{
+        for (;;) {
+                int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) return;
+
+                conn_t *c = NULL;
+                for (int i = 0; i < EXPORTER_MAX_CONNS && !c; i++) {
+                        if (g_conns[i].fd < 0) c = &g_conns[i];
+                }
+                if (!c) {
+                        close(fd);
+                        continue;
+                }
+
+                c->fd = fd;
+                c->accepted_ns = now_ns();
+                c->request_len = 0;
+                c->header_len = 0;
+                c->metrics = -1;
+
+                struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t)(c - g_conns)};
+                if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                        close(fd);
+                        c->fd = -1;
+                }
+        }
+}
+
+static void drop_idle(int epfd)
+{
+        uint64_t now = now_ns();
+        for (int i = 0; i < EXPORTER_MAX_CONNS; i++) {
+                if (g_conns[i].fd >= 0 && now - g_conns[i].accepted_ns > EXPORTER_IDLE_NS) conn_close(epfd, &g_conns[i]);
+        }
+}
+
+/* ------------------- Setup -------------------------------------- */
+
+static void on_signal(int sig)
+{
+        (void)sig;
+        g_stop = 1;
+}
+
+static void print_log(sl_log_level_t level, const char *func, const char *msg, void *user_data)
+{
+        (void)user_data;
+        fprintf(stderr, "[%s] %s: %s\n", (level == SL_LOG_ERROR) ? "ERROR" : (level == SL_LOG_WARN) ? "WARN" : "INFO", func, msg);
+}
+
+static int usage(const char *argv0)
+{
+        fprintf(stderr, "usage: %s [-l address] [-p port] [-i seconds] [mount ...]\n", argv0);
+        return 1;
+}
+
+static int listen_on(const char *address, int port)
+{
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+                fprintf(stderr, "invalid IPv4 address: %s\n", address);
+                return -1;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+                perror("socket");
+                return -1;
+        }
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+                fprintf(stderr, "cannot listen on %s:%d: %s\n", address, port, strerror(errno));
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+int main(int argc, char **argv)
+{
+        const char *address = "127.0.0.1";
+        int port = EXPORTER_PORT;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "l:p:i:")) != -1) {
+                switch (opt) {
+                case 'l':
+                        address = optarg;
+                        break;
+                case 'p':
+                        port = atoi(optarg);
+                        if (port <= 0 || port > 65535) return usage(argv[0]);
+                        break;
+                case 'i': {
+                        double seconds = strtod(optarg, NULL);
+                        if (seconds < 0.01) return usage(argv[0]);
+                        g_interval_ns = (uint64_t)(seconds * 1e9);
+                        break;
+                }
+                default:
+                        return usage(argv[0]);
+                }
+        }
+
+        for (int i = optind; i < argc; i++) {
+                if (g_mount_count == SL_SNAPSHOT_MAX_PATHS) {
+                        fprintf(stderr, "at most %d mounts\n", SL_SNAPSHOT_MAX_PATHS);
+                        return 1;
+                }
+                g_mounts[g_mount_count++] = argv[i];
+        }
+        if (g_mount_count == 0) g_mounts[g_mount_count++] = "/";
+
+        long tck = sysconf(_SC_CLK_TCK);
+        if (tck > 0) g_clk_tck = (uint64_t)tck;
+
+        sl_set_log_handler(print_log, NULL);
+        sl_set_log_level(SL_LOG_WARN);
+
+        g_sampler = sl_sampler_create();
+        int listen_fd = listen_on(address, port);
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (!g_sampler || listen_fd < 0 || epfd < 0) return 1;
+
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = EXPORTER_LISTEN_ID};
+        epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+        for (int i = 0; i < EXPORTER_MAX_CONNS; i++) g_conns[i].fd = -1;
+
+        /* No SA_RESTART: a signal interrupts epoll_wait() */
+        struct sigaction sa = {0};
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        fprintf(stderr, "serving http://%s:%d/metrics\n", address, port);
+
+        struct epoll_event events[EXPORTER_MAX_CONNS + 1];
+        while (!g_stop) {
+                int n = epoll_wait(epfd, events, EXPORTER_MAX_CONNS + 1, 1000);
+                if (n < 0) {
+                        if (errno == EINTR) continue;
+                        perror("epoll_wait");
+                        break;
+                }
+
+                for (int i = 0; i < n; i++) {
+                        if (events[i].data.u32 == EXPORTER_LISTEN_ID) accept_all(epfd, listen_fd);
+                        else conn_event(epfd, &g_conns[events[i].data.u32], events[i].events);
+                }
+                drop_idle(epfd);
+        }
+
+        for (int i = 0; i < EXPORTER_MAX_CONNS; i++) {
+                if (g_conns[i].fd >= 0) conn_close(epfd, &g_conns[i]);
+        }
+        close(epfd);
+        close(listen_fd);
+        sl_sampler_destroy(g_sampler);
+        return 0;
+}
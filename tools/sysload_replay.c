@@ -0,0 +1,109 @@
+/**
+ * Replays a recording made with sl_recorder_*.
+ * Prints one CSV row per CPU interval (usage from sl_cpu_calculate, with
+ * the latest memory snapshot through sl_mem_calculate), then a summary.
+ * Run with: ./sysload_replay [-q] recording.slr
+ */
+
+#include "sysload.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+static void print_log(sl_log_level_t level, const char *func, const char *msg, void *user_data)
+{
+        (void)user_data;
+        fprintf(stderr, "[%s] %s: %s\n", (level == SL_LOG_ERROR) ? "ERROR" : (level == SL_LOG_WARN) ? "WARN" : "INFO", func, msg);
+}
+
+static uint64_t cpu_ticks(const sl_cpu_raw_t *cpu)
+{
+        return cpu->user + cpu->nice + cpu->system + cpu->idle + cpu->iowait + cpu->irq + cpu->softirq + cpu->steal;
+}
+
+/* UTC time of a record, from the session's clock pair */
+static void format_time(char *buf, size_t size, const sl_record_t *session, uint64_t timestamp_ns)
+{
+        uint64_t ns = session->realtime_ns + (timestamp_ns - session->timestamp_ns);
+        time_t sec = (time_t)(ns / 1000000000ULL);
+        struct tm tm;
+
+        gmtime_r(&sec, &tm);
+        size_t n = strftime(buf, size, "%Y-%m-%dT%H:%M:%S", &tm);
+        snprintf(buf + n, size - n, ".%03uZ", (unsigned)(ns / 1000000ULL % 1000));
+}
+
+int main(int argc, char **argv)
+{
+        int quiet = (argc == 3 && strcmp(argv[1], "-q") == 0);
+        if (argc != 2 + quiet) {
+                fprintf(stderr, "usage: %s [-q] recording\n", argv[0]);
+                return 1;
+        }
+
+        sl_set_log_handler(print_log, NULL);
+
+        sl_replay_t *replay = sl_replay_open(argv[1 + quiet]);
+        if (!replay) return 1;
+
+        sl_record_t record, session = {0}, cpu_prev = {0};
+        sl_mem_info_t mem = {0};
+        int have_cpu = 0, have_mem = 0;
+        uint64_t records = 0, sessions = 0, intervals = 0;
+        double cpu_sum = 0.0, cpu_max = 0.0, mem_max = 0.0;
+        char when[32];
+        int ret;
+
+        if (!quiet) printf("time,cpu_total,cpu_user,cpu_system,cpu_iowait,cpu_steal,mem_used_percent\n");
+
+        while ((ret = sl_replay_next(replay, &record)) == 1) {
+                records++;
+
+                switch (record.type) {
+                case SL_RECORD_SESSION:
+                        session = record;
+                        sessions++;
+                        have_cpu = have_mem = 0;
+                        break;
+                case SL_RECORD_MEM:
+                        mem = record.mem;
+                        have_mem = (sl_mem_calculate(&mem) == 0);
+                        if (have_mem && mem.percent_used > mem_max) mem_max = mem.percent_used;
+                        break;
+                case SL_RECORD_CPU: {
+                        sl_cpu_usage_t usage;
+                        /* Samples closer than a clock tick carry no new information */
+                        if (have_cpu && cpu_ticks(&record.cpu) == cpu_ticks(&cpu_prev.cpu)) break;
+                        if (have_cpu && sl_cpu_calculate(&cpu_prev.cpu, &record.cpu, &usage) == 0) {
+                                intervals++;
+                                cpu_sum += usage.total;
+                                if (usage.total > cpu_max) cpu_max = usage.total;
+
+                                if (!quiet) {
+                                        format_time(when, sizeof(when), &session, record.timestamp_ns);
+                                        printf("%s,%.2f,%.2f,%.2f,%.2f,%.2f,", when, usage.total, usage.user,
+                                               usage.system, usage.iowait, usage.steal);
+                                        if (have_mem) printf("%.2f\n", mem.percent_used);
+                                        else printf("\n");
+                                }
+                        }
+                        cpu_prev = record;
+                        have_cpu = 1;
+                        break;
+                }
+                default:
+                        break;
+                }
+        }
+
+        fprintf(stderr, "%" PRIu64 " records in %" PRIu64 " sessions, %" PRIu64 " CPU intervals\n",
+                records, sessions, intervals);
+        if (intervals > 0) {
+                fprintf(stderr, "CPU mean %.2f%%, max %.2f%%; memory max %.2f%%\n",
+                        cpu_sum / (double)intervals, cpu_max, mem_max);
+        }
+
+        sl_replay_close(replay);
+        return (ret < 0) ? 1 : 0;
+}